@@ -0,0 +1,16 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include "gfc_types.h"
+
+/**
+ * @brief run the scripted benchmark scenes listed in a config file and write a json report
+ * @note call after graphics, fonts and the clock are initialized, but instead of entity_system_init
+ * the benchmark sizes the entity and monster systems for its largest scene
+ * @param config the benchmark config, see config/bench.cfg
+ * @param report where to write the json report, NULL for bench_report.json
+ * @return 1 if every scene ran, 0 on error
+ */
+int bench_run(const char* config, const char* report);
+
+#endif
@@ -10,6 +10,7 @@
 
 #include "gf3d_texture.h"
 #include "gf3d_mesh.h"
+#include "gf3d_aabb_tree.h"
 
 // Forward declarations to avoid circular dependencies
 typedef struct World_S World;
@@ -29,7 +30,19 @@ typedef struct Entity_S
     Uint8           drawShadow;
 
     
-    GFC_Box         bounds;
+    GFC_Box         bounds;         //world space bounds of the mesh, kept in sync with matrix
+    float           radius;         //radius of the sphere enclosing bounds
+    GFC_Vector3D    _cachePosition; //the transform matrix and bounds were last built from
+    GFC_Vector3D    _cacheRotation;
+    GFC_Vector3D    _cacheScale;
+    Mesh*           _cacheMesh;
+    Uint8           _cacheValid;
+    GFC_Vector3D    _prevPosition;  //transform at the start of the last simulation step, for interpolation
+    GFC_Vector3D    _prevRotation;
+    GFC_Vector3D    _prevScale;
+    Uint8           _prevValid;
+    Sint32          _proxy;         //leaf in the entity system's aabb tree, AABB_TREE_NULL if not in it
+    Uint32          _drawMark;      //set when found in the view frustum
     void           (*draw)(struct Entity_S* self);
     void           (*think)(struct Entity_S* self);
     void           (*update)(struct Entity_S* self);
@@ -69,8 +82,39 @@ void entity_system_draw_all(GFC_Vector3D lightPos, GFC_Color lightColor);
 
 void entity_system_think_all();
 
+/**
+ * @brief call before each fixed simulation step to remember where entities were, for interpolation
+ */
+void entity_system_begin_step();
+
+/**
+ * @brief set how far between the previous and current simulation state entities are drawn
+ * @param alpha 0 draws the previous state, 1 the current state
+ */
+void entity_system_set_interpolation(float alpha);
+
+/**
+ * @brief get the bounding volume tree of all entities with a mesh, for spatial queries
+ * @note leaf user data is the Entity pointer.  Leaves are updated when entity transforms are
+ * @return NULL if the entity system is not initialized or the tree
+ */
+AABBTree* entity_system_get_tree();
+
+/**
+ * @brief get how many entities the last entity_system_draw_all drew and skipped
+ * @param visible [optional output] entities inside the view frustum (or without bounds)
+ * @param culled [optional output] entities skipped for being outside the view frustum
+ */
+void entity_system_get_cull_stats(Uint32 *visible, Uint32 *culled);
+
 void entity_system_update_all();
 
+/**
+ * @brief rebuild the entity's model matrix and world bounds if its transform or mesh changed
+ * @param ent the entity to update
+ */
+void entity_update_transform(Entity* ent);
+
 /**
  * @brief draw an entity with lighting
  * @param ent the entity to draw
@@ -0,0 +1,44 @@
+#ifndef __GF2D_ATLAS_H__
+#define __GF2D_ATLAS_H__
+
+#include "gfc_types.h"
+#include "gfc_shape.h"
+
+#include "gf3d_texture.h"
+
+/**
+ * Sprite atlases.
+ * Small sprite images, whole sprite sheets included, are packed into shared atlas pages as they are loaded, so sprites
+ * from different files share a texture and draw in the same batch.  Each image is padded by copies of its edge pixels
+ * so filtering at its border does not pick up a neighbor.  Space is not reclaimed when a sprite is freed, loading the
+ * same image again reuses it.
+ * Atlases can also be packed ahead of time with gf2d_atlas_pack_file, images listed in a prebuilt atlas are drawn from
+ * it instead of being packed at load time.
+ */
+
+/**
+ * @brief start the atlas manager
+ * @param config the setup config.  In "setup", "sprite_atlas" holds "page_size" (0 turns runtime packing off),
+ * "max_image", the largest width or height that is packed, "max_pages" and "prebuilt", a list of atlas files made by
+ * gf2d_atlas_pack_file
+ */
+void gf2d_atlas_init(const char *config);
+
+/**
+ * @brief get an image from an atlas, packing it into a page if it is not in one yet
+ * @param filename the image file
+ * @param rect [output] where the image is in the texture, in pixels
+ * @return NULL if the image is not in an atlas and cannot be packed, the atlas page texture otherwise.  It holds a
+ * reference for the caller, release it with gf3d_texture_free
+ */
+Texture *gf2d_atlas_get_image(const char *filename,GFC_Rect *rect);
+
+/**
+ * @brief pack images into atlases offline, without graphics
+ * @param filename a config with "atlases", a list of objects with "output" (the path without extension), "size" and
+ * "images".  Each atlas is saved as output.png with output.json describing where each image went
+ * @return the number of images that could not be packed
+ */
+Uint32 gf2d_atlas_pack_file(const char *filename);
+
+#endif
@@ -48,22 +48,29 @@ typedef enum
 }FontTypes;
 
 
+typedef struct FontAtlas_S FontAtlas;
+
 typedef struct
 {
     GFC_TextLine filename;
     TTF_Font *font;
     void     *mem;
     Uint32  pointSize;
+    FontAtlas *atlas;   /**<the glyphs rasterized so far, made the first time the font is drawn*/
 }Font;
 
 /**
  * @brief initialized text drawing system
+ * @note text is drawn from a glyph atlas per font, glyphs are rasterized the first time they are drawn.
+ * "atlas_size" in the config sets the size of each atlas page (default 512) and "max_glyphs" how many
+ * different glyphs each font can hold (default 512).  Lines are laid out once and cached by font and text, the least
+ * recently drawn are dropped past "text_cache_kb" (default 256)
  * @param configFile the file to load font information from
  */
 void gf2d_font_init(const char *configFile);
 
 /**
- * @brief should be called every frame to clean up unused font images
+ * @brief should be called every frame
  */
 void gf2d_font_update();
 
@@ -77,6 +84,7 @@ FontTypes gf2d_font_type_from_text(const char *buf);
 
 /**
  * @brief draw text to the screen overlay layer
+ * @note each line is one draw call per atlas page it uses, colored in the shader
  */
 void gf2d_font_draw_line_named(char *text,char *filename,GFC_Color color, GFC_Vector2D position);
 void gf2d_font_draw_line_tag(char *text,FontTypes tag,GFC_Color color, GFC_Vector2D position);
@@ -88,6 +96,7 @@ void gf2d_font_draw_line(char *text,Font *font,GFC_Color color, GFC_Vector2D pos
  * @param block the dimensions to keep to
  * @param color the color to draw with
  * @param font the font to use, IF NULL this is a no-op
+ * @note lines break at spaces, tabs and newlines.  Where they break is cached per font, text and width
  */
 void gf2d_font_draw_text_wrap(
     char    *thetext,
@@ -110,7 +119,8 @@ void gf2d_font_draw_text_wrap_tag(char *text,FontTypes tag,GFC_Color color, GFC_
  * @param thetext the text to check
  * @param font the font to use
  * @param w the width of the desired bounds - will be used for word wrapping
- * @param h the height of the desired bounds
+ * @param h the height of the desired bounds, 0 for no limit
+ * @return w is the widest line, h the height of the lines that fit.  Shares the layout cache with drawing
  */
 GFC_Rect gf2d_font_get_text_wrap_bounds(
     char    *thetext,
@@ -129,7 +139,11 @@ GFC_Rect gf2d_font_get_text_wrap_bounds_tag(
     Uint32      h
 );
 
-
+/**
+ * @brief get the size of a line of text
+ * @note measured from the cached layout, so measuring text before drawing it lays it out once
+ * @return the width and font height, -1,-1 on error
+ */
 GFC_Vector2D gf2d_font_get_bounds_tag(char *text,FontTypes tag);
 GFC_Vector2D gf2d_font_get_bounds(char *text,Font *font);
 
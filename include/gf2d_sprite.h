@@ -28,6 +28,7 @@
 #include "gfc_vector.h"
 #include "gfc_matrix.h"
 #include "gfc_text.h"
+#include "gfc_shape.h"
 
 #include "gf3d_pipeline.h"
 #include "gf3d_texture.h"
@@ -41,12 +42,17 @@ typedef struct
     Uint8                       framesPerLine;          /**<how many frames are per line in the sprite sheet*/
     Uint32                      frameWidth,frameHeight; /*<the size, in pixels, of the individual sprite frames*/
     float                       widthPercent,heightPercent;/**<size percent of the sprite frame from the texture*/
-    VkBuffer                    buffer;
-    VkDeviceMemory              bufferMemory;
+    Uint32                      atlasX,atlasY;          /**<where the sprite's image starts in its texture, non zero when it is packed into an atlas*/
     VkDescriptorSet            *descriptorSet;          /**<descriptor sets used for this sprite to render*/
-    SDL_Surface                *surface;                /**<pointer to the cpu surface data*/
+    SDL_Surface                *surface;                /**<pointer to the texture's cpu surface data, NULL until gf2d_sprite_draw_to_surface needs it*/
 }Sprite;
 
+typedef struct
+{
+    GFC_Rect    dst;        /**<where to draw, in pixels from the draw position*/
+    GFC_Rect    src;        /**<what to draw, in pixels of the texture*/
+}SpriteQuad;
+
 /**
  * @brief initialize the internal management system for sprites, auto-cleaned up on program exit
  * @param max_sprites how many concurrent sprites to support
@@ -62,6 +68,7 @@ Sprite *gf2d_sprite_new();
 
 /**
  * @brief loads a sprite sheet into memory
+ * @note small images are packed into a shared atlas page, see gf2d_atlas.h
  * @param filename the name of the file containing the image data
  * @param frame_width how wide an individual frame is on the sprite sheet.  if <= 0 this is assumed to be the image size
  * @param frame_height how high an individual frame is on the sprite sheet.  if <= 0 this is assumed to be the image size
@@ -91,16 +98,9 @@ Sprite * gf2d_sprite_load_image(const char * filename);
  */
 Sprite *gf2d_sprite_parse(SJson *json);
 
-/**
- * @brief create the internal support for rendering the sprite.
- * @note automatically called for loaded sprites, but any created must call this before it will render properly
- * @param sprite the sprite to setup
- */
-void gf2d_sprite_create_vertex_buffer(Sprite *sprite);
-
 /**
  * @brief create a sprite from an SDL_Surface
- * @param surface pointer to SDL_Surface image data
+ * @param surface pointer to SDL_Surface image data.  It is freed once it is uploaded
  * @param frame_width how wide an individual frame is on the sprite sheet.  if <= 0 this is assumed to be the image size
  * @param frame_height how high an individual frame is on the sprite sheet.  if <= 0 this is assumed to be the image size
  * @param frames_per_line how many frames across are on the sprite sheet
@@ -116,6 +116,8 @@ void gf2d_sprite_free(Sprite *sprite);
 
 /**
  * @brief draw a sprite to the screen with NULLable options
+ * @note sprites are batched: consecutive draws with the same texture are written to the frame's quad buffer
+ * and drawn with one call
  * @param sprite the sprite to draw
  * @param position here on the screen to draw it
  * @param scale (optional) if you want to scale the sprite
@@ -162,7 +164,7 @@ void gf2d_sprite_draw_full(
 
 /**
  * @brief draw a sprite to a surface instead of to the screen.
- * @note sprite must have been loaded with surface data preserved
+ * @note the first draw reloads the sprite image on the cpu if it was freed after upload
  * @param sprite the sprite to draw
  * @param position where on the target surface to draw it to
  * @param scale (optional) if provided the sprite will be scaled by this factor
@@ -194,6 +196,22 @@ void gf2d_sprite_draw_image(
     Sprite   * sprite,
     GFC_Vector2D   position);
 
+/**
+ * @brief draw a run of quads from one texture, like the glyphs of a line of text
+ * @note quads join the same batches as sprites, draws past the frame's capacity are dropped
+ * @param texture the texture every quad samples
+ * @param quads the quads to draw
+ * @param count how many quads there are
+ * @param position where on the screen the quads are drawn from
+ * @param color multiplied with the texture in the shader
+ */
+void gf2d_sprite_draw_quads(
+    Texture        *texture,
+    const SpriteQuad *quads,
+    Uint32          count,
+    GFC_Vector2D    position,
+    GFC_Color       color);
+
 /**
  * @brief get the default pipeline for overlay rendering
  * @return NULL on error or not yet initlialized, the pipeline otherwise
@@ -207,6 +225,12 @@ VkVertexInputBindingDescription * gf2d_sprite_get_bind_description();
 
 VkVertexInputAttributeDescription * gf2d_sprite_get_attribute_descriptions(Uint32 *count);
 
+/**
+ * @brief queue the open sprite batch as a draw call
+ * @note called before the frame is submitted, only needed before drawing to the overlay pipeline some other way
+ */
+void gf2d_sprite_batch_flush();
+
 /**
  * @brief needs to be called once at the beginning of each render frame
  */
@@ -0,0 +1,155 @@
+#ifndef __GF3D_AABB_TREE_H__
+#define __GF3D_AABB_TREE_H__
+
+#include "gfc_types.h"
+#include "gfc_vector.h"
+#include "gfc_primitives.h"
+
+#include "gf3d_frustum.h"
+
+#define AABB_TREE_NULL -1
+
+/**
+ * @brief a node in the dynamic tree.  Leaves hold user data, branches hold the union of their children
+ */
+typedef struct
+{
+    float       min[3];         /**<fattened bounds*/
+    float       max[3];
+    float       tightMin[3];    /**<bounds as last provided, leaves only*/
+    float       tightMax[3];
+    Sint32      parent;         /**<parent node, or the next free node when not in use*/
+    Sint32      child1;
+    Sint32      child2;
+    Sint32      height;         /**<0 for leaves, -1 for free nodes*/
+    void       *data;           /**<user data, leaves only*/
+}AABBTreeNode;
+
+/**
+ * @brief an incrementally updated bounding volume hierarchy for moving objects
+ * leaves are stored with a margin around them so small movements do not need to touch the tree
+ */
+typedef struct
+{
+    AABBTreeNode   *nodes;
+    Uint32          nodeCapacity;
+    Uint32          nodeCount;      /**<how many nodes are in use*/
+    Sint32          root;
+    Sint32          freeList;
+    float           margin;         /**<how far to fatten leaf bounds*/
+}AABBTree;
+
+/**
+ * @brief called for each leaf found by a query
+ * @param data the user data of the leaf
+ * @param userData passed through from the query
+ * @return 0 to stop the query, 1 to keep going
+ */
+typedef Uint8 (*AABBTreeQueryFunc)(void *data,void *userData);
+
+/**
+ * @brief called for each leaf whose bounds the ray passes through
+ * @param data the user data of the leaf
+ * @param start the start of the ray
+ * @param end the end of the ray
+ * @param maxFraction how far along the ray [0,1] to still consider
+ * @param userData passed through from the query
+ * @return the fraction along the ray of a hit to clip the ray there, maxFraction to ignore this leaf, 0 to stop
+ */
+typedef float (*AABBTreeRayFunc)(void *data,GFC_Vector3D start,GFC_Vector3D end,float maxFraction,void *userData);
+
+/**
+ * @brief create a new empty tree
+ * @param capacity how many nodes to allocate up front, it will grow as needed
+ * @param margin how far to fatten leaf bounds
+ * @return NULL on error or a new tree
+ */
+AABBTree *gf3d_aabb_tree_new(Uint32 capacity,float margin);
+
+/**
+ * @brief free a tree created with gf3d_aabb_tree_new
+ * @param tree the tree to free
+ */
+void gf3d_aabb_tree_free(AABBTree *tree);
+
+/**
+ * @brief add a leaf to the tree
+ * @param tree the tree to add to
+ * @param bounds the bounds of the object, x,y,z is the minimum corner and w,h,d the size
+ * @param data user data for the leaf
+ * @return the proxy id for the leaf or AABB_TREE_NULL on error
+ */
+Sint32 gf3d_aabb_tree_insert(AABBTree *tree,GFC_Box bounds,void *data);
+
+/**
+ * @brief remove a leaf from the tree
+ * @param tree the tree to remove from
+ * @param proxy the id returned by gf3d_aabb_tree_insert
+ */
+void gf3d_aabb_tree_remove(AABBTree *tree,Sint32 proxy);
+
+/**
+ * @brief update the bounds of a leaf
+ * @note the tree is only restructured if the new bounds leave the fattened bounds
+ * @param tree the tree
+ * @param proxy the leaf to update
+ * @param bounds the new bounds
+ * @return 1 if the leaf was reinserted, 0 otherwise
+ */
+Uint8 gf3d_aabb_tree_move(AABBTree *tree,Sint32 proxy,GFC_Box bounds);
+
+/**
+ * @brief get the user data for a leaf
+ * @param tree the tree
+ * @param proxy the leaf
+ * @return NULL if not found or the user data
+ */
+void *gf3d_aabb_tree_get_data(AABBTree *tree,Sint32 proxy);
+
+/**
+ * @brief find all leaves whose fattened bounds overlap a box
+ * @param tree the tree to search
+ * @param bounds the box to search with
+ * @param func called for each leaf found
+ * @param userData passed to func
+ */
+void gf3d_aabb_tree_query_box(AABBTree *tree,GFC_Box bounds,AABBTreeQueryFunc func,void *userData);
+
+/**
+ * @brief find all leaves inside or crossing a frustum.  Branches entirely inside are reported without further tests
+ * @param tree the tree to search
+ * @param frustum the frustum to search with
+ * @param func called for each leaf found
+ * @param userData passed to func
+ */
+void gf3d_aabb_tree_query_frustum(AABBTree *tree,Frustum *frustum,AABBTreeQueryFunc func,void *userData);
+
+/**
+ * @brief cast a ray segment through the tree
+ * @param tree the tree to search
+ * @param start where the ray starts
+ * @param end where the ray ends
+ * @param func called for each leaf the ray may hit, see AABBTreeRayFunc
+ * @param userData passed to func
+ */
+void gf3d_aabb_tree_ray_cast(AABBTree *tree,GFC_Vector3D start,GFC_Vector3D end,AABBTreeRayFunc func,void *userData);
+
+/**
+ * @brief find the closest leaves to a point, measured to their tight bounds
+ * @param tree the tree to search
+ * @param point the point to measure from
+ * @param k the most leaves to find
+ * @param results [output] array of at least k, filled with leaf user data closest first
+ * @param distances [optional output] array of at least k, filled with the distance to each result
+ * @return how many leaves were found
+ */
+Uint32 gf3d_aabb_tree_query_nearest(AABBTree *tree,GFC_Vector3D point,Uint32 k,void **results,float *distances);
+
+/**
+ * @brief get the height of the tree, for diagnostics
+ * @param tree the tree
+ * @return 0 for an empty tree or the height of the root
+ */
+Uint32 gf3d_aabb_tree_get_height(AABBTree *tree);
+
+#endif
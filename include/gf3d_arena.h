@@ -0,0 +1,127 @@
+#ifndef __GF3D_ARENA_H__
+#define __GF3D_ARENA_H__
+
+#include "gfc_types.h"
+
+/**
+ * Linear (bump) allocators for transient data.
+ * Each thread owned by gf3d_jobs gets a frame arena, reset at gf3d_vgraphics_render_start, and a scratch
+ * arena for temporaries that are released in the same scope they were taken (loaders, queries).
+ * An arena that runs out borrows overflow blocks from the heap, then grows to its peak the next time it
+ * empties, so after warm up neither touches the heap.
+ * Threads not started by gf3d_jobs share the main thread's arenas, so only the main thread and jobs may use them.
+ */
+
+typedef struct ArenaOverflow_S ArenaOverflow;
+
+typedef struct
+{
+    Uint8          *base;
+    size_t          size;           /**<bytes in the base block*/
+    size_t          used;           /**<bytes used in the base block*/
+    ArenaOverflow  *overflow;       /**<heap blocks taken after the base block filled, newest first*/
+    size_t          overflowUsed;   /**<bytes used across the overflow blocks*/
+    size_t          peak;           /**<most bytes in use at once since the arena last grew*/
+    Uint32          heapAllocs;     /**<heap allocations made by this arena, including growth*/
+}MemoryArena;
+
+typedef struct
+{
+    size_t          used;           /**<position in the newest block*/
+    ArenaOverflow  *overflow;       /**<the newest block, NULL for the base block*/
+    size_t          overflowUsed;
+}ArenaMark;
+
+/**
+ * @brief make a new arena
+ * @param size bytes to reserve up front
+ * @return NULL on error, the arena otherwise
+ */
+MemoryArena *gf3d_arena_new(size_t size);
+
+/**
+ * @brief free an arena and everything allocated from it
+ * @param arena the arena to free
+ */
+void gf3d_arena_free(MemoryArena *arena);
+
+/**
+ * @brief allocate uninitialized memory from an arena, aligned to 16 bytes
+ * @param arena the arena to allocate from
+ * @param size how many bytes
+ * @return NULL on error, the memory otherwise.  It is never freed individually
+ */
+void *gf3d_arena_alloc(MemoryArena *arena,size_t size);
+
+/**
+ * @brief allocate zeroed memory from an arena, the arena version of gfc_allocate_array
+ * @param arena the arena to allocate from
+ * @param size the size of an element
+ * @param count how many elements
+ * @return NULL on error, the memory otherwise
+ */
+void *gf3d_arena_alloc_array(MemoryArena *arena,size_t size,size_t count);
+
+/**
+ * @brief remember the arena's position to release back to later
+ * @param arena the arena
+ * @return the mark
+ */
+ArenaMark gf3d_arena_mark(MemoryArena *arena);
+
+/**
+ * @brief release everything allocated from the arena since the mark was taken
+ * @param arena the arena
+ * @param mark a mark from gf3d_arena_mark on this arena, marks must be released in reverse order
+ */
+void gf3d_arena_release(MemoryArena *arena,ArenaMark mark);
+
+/**
+ * @brief release everything in the arena
+ * @param arena the arena
+ */
+void gf3d_arena_reset(MemoryArena *arena);
+
+/**
+ * @brief set up the per-thread frame and scratch arenas
+ * @note call after gf3d_jobs_init
+ * @param frameSize bytes reserved for each thread's frame arena
+ * @param scratchSize bytes reserved for each thread's scratch arena
+ */
+void gf3d_arena_system_init(size_t frameSize,size_t scratchSize);
+
+/**
+ * @brief reset every thread's frame arena and record arena use in the render stats
+ * @note called by gf3d_vgraphics_render_start while no jobs are running
+ */
+void gf3d_arena_frame_reset();
+
+/**
+ * @brief allocate zeroed memory that lives until the next frame starts
+ * @param size the size of an element
+ * @param count how many elements
+ * @return NULL on error or if the calling thread has no arena, the memory otherwise
+ */
+void *gf3d_frame_alloc_array(size_t size,size_t count);
+
+/**
+ * @brief start a scratch scope on the calling thread's scratch arena
+ * @return the mark to pass to gf3d_scratch_end
+ */
+ArenaMark gf3d_scratch_begin();
+
+/**
+ * @brief allocate zeroed scratch memory on the calling thread, valid until the enclosing gf3d_scratch_end
+ * @param size the size of an element
+ * @param count how many elements
+ * @return NULL on error or if the calling thread has no arena, the memory otherwise
+ */
+void *gf3d_scratch_alloc_array(size_t size,size_t count);
+
+/**
+ * @brief release everything allocated since the matching gf3d_scratch_begin
+ * @param mark the mark returned by gf3d_scratch_begin
+ */
+void gf3d_scratch_end(ArenaMark mark);
+
+#endif
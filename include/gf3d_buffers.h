@@ -3,6 +3,8 @@
 
 #include <vulkan/vulkan.h>
 
+#include "gf3d_memory.h"
+
 /**
  * @brief copy from one buffer to another
  * @param scrBuffer the buffer to copy from
@@ -17,7 +19,8 @@ void gf3d_buffer_copy(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
  * @param usage usage flags
  * @param properties memory properties
  * @param buffer (output) will be set with the handle to the buffer
- * @param bufferMemory (output) will be set with the handle to the bufferMemory
+ * @param bufferMemory (output) will be set with the handle to the bufferMemory, free it with gf3d_memory_vk_free
+ * @param tag the subsystem the memory is charged to
  * @return 1 on success, 0 on failure
  */
 int gf3d_buffer_create(
@@ -25,6 +28,7 @@ int gf3d_buffer_create(
     VkBufferUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkBuffer * buffer,
-    VkDeviceMemory * bufferMemory);
+    VkDeviceMemory * bufferMemory,
+    MemoryTag tag);
 
 #endif
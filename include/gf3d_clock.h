@@ -0,0 +1,72 @@
+#ifndef __GF3D_CLOCK_H__
+#define __GF3D_CLOCK_H__
+
+#include "gfc_types.h"
+
+/**
+ * @brief set up frame timing from the "setup" block of a config file
+ * @note reads "simulation_hz" (default 60), "max_catchup_steps" (default 5) and "max_fps" (default 0, uncapped)
+ * @param config the config file to read, the same one passed to gf3d_vgraphics_init
+ */
+void gf3d_clock_init(const char *config);
+
+/**
+ * @brief start a new frame: measure the time since the last frame and work out how many simulation steps are due
+ * @return how many fixed simulation steps to run this frame
+ */
+Uint32 gf3d_clock_begin_frame();
+
+/**
+ * @brief mark one simulation step as done, advancing simulation time
+ */
+void gf3d_clock_step();
+
+/**
+ * @brief finish the frame, waiting until the frame rate cap allows the next one to start
+ */
+void gf3d_clock_end_frame();
+
+/**
+ * @brief get the length of a simulation step
+ * @return seconds per step
+ */
+float gf3d_clock_get_step();
+
+/**
+ * @brief get how far between the last two simulation states rendering is
+ * @return 0 to 1, where 1 is the most recent state
+ */
+float gf3d_clock_get_alpha();
+
+/**
+ * @brief get how much time has been simulated.  Use this instead of wall clock time in gameplay code
+ * @return seconds of simulation
+ */
+double gf3d_clock_get_sim_time();
+
+/**
+ * @brief get how long the last frame took, including any pacing wait
+ * @return seconds
+ */
+double gf3d_clock_get_frame_time();
+
+/**
+ * @brief get the frame rate, averaged over recent frames
+ * @return frames per second
+ */
+float gf3d_clock_get_fps();
+
+/**
+ * @brief run exactly one simulation step per frame and never wait, regardless of wall clock time
+ * @note for benchmarks and tests that need deterministic simulation faster than real time
+ * @param enable 1 to turn lockstep on, 0 to return to real time
+ */
+void gf3d_clock_set_lockstep(Uint8 enable);
+
+/**
+ * @brief change the frame rate cap
+ * @param fps frames per second, 0 for uncapped
+ */
+void gf3d_clock_set_max_fps(float fps);
+
+#endif
@@ -47,6 +47,60 @@ VkCommandBuffer gf3d_command_rendering_begin(Uint32 index,Pipeline *pipe);
 
 void gf3d_command_rendering_end(VkCommandBuffer commandBuffer);
 
+/**
+ * @brief begin a primary command whose render pass contents will be provided by secondary command buffers
+ * @note the pipeline is NOT bound, each secondary command buffer binds it
+ * @param index the rendering frame to use
+ * @param pipe the pipeline whose render pass to begin
+ * @note a gpu timestamp zone for the pipeline is started ahead of the render pass
+ * @return the primary command buffer used for this drawing pass.  End it with gf3d_command_rendering_end_secondary
+ */
+VkCommandBuffer gf3d_command_rendering_begin_secondary(Uint32 index,Pipeline *pipe);
+
+/**
+ * @brief end the render pass of a command begun with gf3d_command_rendering_begin_secondary, close its timestamp zone and submit it
+ * @param commandBuffer the primary command buffer
+ * @param pipe the pipeline it was begun for
+ */
+void gf3d_command_rendering_end_secondary(VkCommandBuffer commandBuffer,Pipeline *pipe);
+
+/**
+ * @brief execute recorded secondary command buffers inside a render pass begun with gf3d_command_rendering_begin_secondary
+ * @param commandBuffer the primary command buffer
+ * @param secondaryBuffers the recorded secondary command buffers
+ * @param count how many secondary buffers to execute
+ */
+void gf3d_command_execute_secondary(VkCommandBuffer commandBuffer,VkCommandBuffer *secondaryBuffers,Uint32 count);
+
+/**
+ * @brief create the per thread command pools used for recording secondary command buffers
+ * @param threadCount how many threads will be recording (including the main thread)
+ * @param chainLength how many swap chain frames to support
+ */
+void gf3d_command_thread_pools_init(Uint32 threadCount,Uint32 chainLength);
+
+/**
+ * @brief reset all of the thread command pools for a given frame.  Must not be called while recording
+ * @param frame the swap chain frame to reset
+ */
+void gf3d_command_thread_pools_reset(Uint32 frame);
+
+/**
+ * @brief get a secondary command buffer from the calling thread's pool and begin recording into the pipeline's render pass
+ * @note only the thread identified by thread may use the returned buffer
+ * @param thread the job system thread index of the calling thread
+ * @param index the rendering frame to use
+ * @param pipe the pipeline to record for, it is bound in the returned buffer
+ * @return VK_NULL_HANDLE on error or a command buffer ready for draw calls
+ */
+VkCommandBuffer gf3d_command_secondary_begin(Uint32 thread,Uint32 index,Pipeline *pipe);
+
+/**
+ * @brief finish recording a secondary command buffer
+ * @param commandBuffer the buffer to end
+ */
+void gf3d_command_secondary_end(VkCommandBuffer commandBuffer);
+
 void gf3d_command_configure_render_pass_end(VkCommandBuffer commandBuffer);
 
 
@@ -0,0 +1,103 @@
+#ifndef __GF3D_COMPRESSED_H__
+#define __GF3D_COMPRESSED_H__
+
+#include <SDL.h>
+#include <vulkan/vulkan.h>
+
+#include "gfc_types.h"
+
+/**
+ * Block compressed images.
+ * Reads BC1, BC3, BC5 and BC7 data out of DDS and KTX2 containers, decodes BC1/BC3/BC5 in software for
+ * devices that cannot sample them, and encodes BC1/BC3/BC5 for the texture baker.
+ */
+
+#define GF3D_COMPRESSED_MAX_LEVELS 16
+
+typedef struct
+{
+    VkFormat    format;         /**<the UNORM BC format of the data*/
+    Uint32      width,height;   /**<size of the top level in pixels*/
+    Uint32      mipLevels;      /**<how many levels the file contains*/
+    Uint8      *levels[GF3D_COMPRESSED_MAX_LEVELS];     /**<block data for each level, pointing into data*/
+    size_t      levelSize[GF3D_COMPRESSED_MAX_LEVELS];  /**<bytes of block data in each level*/
+    void       *data;           /**<the whole file*/
+}CompressedImage;
+
+/**
+ * @brief load a .dds or .ktx2 file holding BC1, BC3, BC5 or BC7 data
+ * @note sRGB variants are read as UNORM, to match how every other texture is sampled
+ * @param filename the file to load
+ * @return NULL on error or if the format is not supported, the image otherwise.  Free with gf3d_compressed_image_free
+ */
+CompressedImage *gf3d_compressed_image_load(const char *filename);
+
+/**
+ * @brief load the .dds baked from a source image, like images/rock.dds for images/rock.png
+ * @note a missing baked file is only logged in debug, one older than its source is skipped
+ * @param source the source image's filename
+ * @return NULL if there is no usable baked file, the image otherwise.  Free with gf3d_compressed_image_free
+ */
+CompressedImage *gf3d_compressed_image_load_baked(const char *source);
+
+/**
+ * @brief free a loaded compressed image and its data
+ * @param image the image to free
+ */
+void gf3d_compressed_image_free(CompressedImage *image);
+
+/**
+ * @brief get the size of a 4x4 block for a format
+ * @param format the vulkan format
+ * @return 0 if the format is not one of the supported BC formats, 8 or 16 otherwise
+ */
+Uint32 gf3d_compressed_block_bytes(VkFormat format);
+
+/**
+ * @brief get how many bytes a level takes in a format
+ * @param format any format, uncompressed ones are assumed to be 4 bytes per pixel
+ * @param width width of the level in pixels
+ * @param height height of the level in pixels
+ * @return the size of the level
+ */
+size_t gf3d_compressed_level_size(VkFormat format,Uint32 width,Uint32 height);
+
+/**
+ * @brief decode one level to RGBA8 on the cpu
+ * @note BC7 has no software decoder, keep the source image around for devices without BC7 support
+ * @param image the image to decode
+ * @param level which mip level
+ * @return NULL on error, a new RGBA32 surface otherwise
+ */
+SDL_Surface *gf3d_compressed_image_decode(CompressedImage *image,Uint32 level);
+
+/**
+ * @brief encode an RGBA32 surface to BC1, BC3 or BC5
+ * @param surface the image, must be SDL_PIXELFORMAT_RGBA32
+ * @param format VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC3_UNORM_BLOCK or VK_FORMAT_BC5_UNORM_BLOCK
+ * @param size (output) the size of the block data
+ * @return NULL on error, the block data otherwise.  Free with gf3d_memory_free
+ */
+Uint8 *gf3d_compressed_encode(SDL_Surface *surface,VkFormat format,size_t *size);
+
+/**
+ * @brief write block data to a DDS file
+ * @param filename where to save
+ * @param format BC1, BC3 or BC5
+ * @param width width of the top level
+ * @param height height of the top level
+ * @param mipLevels how many levels are in levels
+ * @param levels block data for each level, largest first
+ * @param levelSize size of each level
+ * @return 0 on error, 1 otherwise
+ */
+Uint8 gf3d_compressed_save_dds(
+    const char *filename,
+    VkFormat format,
+    Uint32 width,
+    Uint32 height,
+    Uint32 mipLevels,
+    Uint8 **levels,
+    size_t *levelSize);
+
+#endif
@@ -143,4 +143,25 @@ VkPipelineMultisampleStateCreateInfo gf3d_config_pipline_multisample_state_creat
  */
 VkPipelineColorBlendAttachmentState gf3d_config_pipeline_color_blend_attachment(SJson *config);
 
+/**
+ * @brief parse a VkFilter from a str
+ * @param str the string to parse
+ * @return VK_FILTER_NEAREST on error or the VkFilter
+ */
+VkFilter gf3d_config_filter_from_str(const char *str);
+
+/**
+ * @brief parse a VkSamplerMipmapMode from a str
+ * @param str the string to parse
+ * @return VK_SAMPLER_MIPMAP_MODE_NEAREST on error or the VkSamplerMipmapMode
+ */
+VkSamplerMipmapMode gf3d_config_sampler_mipmap_mode_from_str(const char *str);
+
+/**
+ * @brief parse a VkSamplerAddressMode from a str
+ * @param str the string to parse
+ * @return VK_SAMPLER_ADDRESS_MODE_REPEAT on error or the VkSamplerAddressMode
+ */
+VkSamplerAddressMode gf3d_config_sampler_address_mode_from_str(const char *str);
+
 #endif
@@ -16,7 +16,7 @@ typedef struct
  * @brief initialize the internal manager for vulkan devices
  * @param config path to a json formatted config file containing device information for prioritizing which device to use
  * @param instance the vulkan instance to work with
- * @param renderSurface the surface needed to render to with the device
+ * @param renderSurface the surface needed to render to with the device, VK_NULL_HANDLE when rendering offscreen
  */
 void gf3d_device_manager_init(const char *config, VkInstance instance, VkSurfaceKHR renderSurface);
 
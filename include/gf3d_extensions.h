@@ -23,6 +23,22 @@ void gf3d_extensions_instance_init(const char *config);
  */
 Bool gf3d_extensions_enable(ExtensionType extType, const char *extensionName);
 
+/**
+ * @brief during setup phase, take back an extension that was queued to be enabled
+ * @param extType the type of extension to disable
+ * @param extensionName the name of the extension to disable
+ * @return true if it had been enabled, false otherwise
+ */
+Bool gf3d_extensions_disable(ExtensionType extType, const char *extensionName);
+
+/**
+ * @brief check if an extension was enabled
+ * @param extType instance or device
+ * @param extensionName the name of the extension
+ * @return true if it is in the enabled list, false otherwise
+ */
+Bool gf3d_extensions_is_enabled(ExtensionType extType, const char *extensionName);
+
 /**
  * @brief get the names of instance extensions to support and the count
  * @param count the number of extensions marked to be enabled
@@ -0,0 +1,76 @@
+#ifndef __GF3D_FRUSTUM_H__
+#define __GF3D_FRUSTUM_H__
+
+#include "gfc_types.h"
+#include "gfc_vector.h"
+#include "gfc_matrix.h"
+#include "gfc_primitives.h"
+
+/**
+ * @brief the six clipping planes of a view volume
+ * @note planes are stored structure of arrays and padded to 8 so they can be tested 4 at a time
+ * a point p is inside a plane when n.p + d >= 0
+ */
+typedef struct
+{
+    float   nx[8],ny[8],nz[8],d[8];     /**<plane normals and distances*/
+    float   ax[8],ay[8],az[8];          /**<absolute value of the normals, for box tests*/
+}Frustum;
+
+/**
+ * @brief extract the frustum planes from a combined view projection matrix
+ * @param frustum [output] the frustum to populate
+ * @param viewProj the projection matrix multiplied by the view matrix
+ */
+void gf3d_frustum_from_matrix(Frustum *frustum,GFC_Matrix4 viewProj);
+
+/**
+ * @brief extract the frustum planes from separate view and projection matrices
+ * @param frustum [output] the frustum to populate
+ * @param view the view matrix
+ * @param proj the projection matrix
+ */
+void gf3d_frustum_from_view_projection(Frustum *frustum,GFC_Matrix4 view,GFC_Matrix4 proj);
+
+/**
+ * @brief extract the frustum for the current graphics view and projection
+ * @param frustum [output] the frustum to populate
+ */
+void gf3d_frustum_from_current_view(Frustum *frustum);
+
+/**
+ * @brief test an axis aligned box against the frustum
+ * @param frustum the frustum to test against
+ * @param center the center of the box
+ * @param halfExtents half the size of the box along each axis
+ * @return 0 if the box is entirely outside of the frustum, 1 if it may be visible
+ */
+Uint8 gf3d_frustum_test_box(Frustum *frustum,GFC_Vector3D center,GFC_Vector3D halfExtents);
+
+/**
+ * @brief classify an axis aligned box against the frustum
+ * @param frustum the frustum to test against
+ * @param center the center of the box
+ * @param halfExtents half the size of the box along each axis
+ * @return 0 if the box is entirely outside, 1 if it crosses a plane, 2 if it is entirely inside
+ */
+Uint8 gf3d_frustum_classify_box(Frustum *frustum,GFC_Vector3D center,GFC_Vector3D halfExtents);
+
+/**
+ * @brief test a sphere against the frustum
+ * @param frustum the frustum to test against
+ * @param center the center of the sphere
+ * @param radius the radius of the sphere
+ * @return 0 if the sphere is entirely outside of the frustum, 1 if it may be visible
+ */
+Uint8 gf3d_frustum_test_sphere(Frustum *frustum,GFC_Vector3D center,float radius);
+
+/**
+ * @brief transform a model space bounding box into a world space axis aligned bounding box
+ * @param out [output] the world space box.  x,y,z is the minimum corner, w,h,d the size
+ * @param in the model space box, same layout as Mesh.bounds
+ * @param mat the model matrix
+ */
+void gf3d_frustum_transform_box(GFC_Box *out,GFC_Box in,GFC_Matrix4 mat);
+
+#endif
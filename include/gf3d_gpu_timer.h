@@ -0,0 +1,100 @@
+#ifndef __GF3D_GPU_TIMER_H__
+#define __GF3D_GPU_TIMER_H__
+
+#include <vulkan/vulkan.h>
+
+#include "gfc_types.h"
+#include "gfc_vector.h"
+
+/**
+ * GPU timestamps around each pipeline's commands.
+ * Results are read back GF3D_GPU_TIMER_LATENCY frames after they are recorded, without waiting on the gpu.
+ * The frame time adds up the spans of the frame's primary command buffers, each timed from its first command to its
+ * last.  They are submitted one at a time, so the cpu time between them is left out.
+ */
+
+#define GF3D_GPU_TIMER_LATENCY 3
+#define GF3D_GPU_TIMER_NONE 0xFFFFFFFF
+
+/**
+ * @brief set up the query pools.  Does nothing but log if the graphics queue cannot write timestamps
+ * @param device the logical device to make the query pools with
+ * @param maxZones how many zones may be timed per frame
+ */
+void gf3d_gpu_timer_init(VkDevice device,Uint32 maxZones);
+
+/**
+ * @brief check if gpu timing is available
+ * @return 1 if timestamps are being written, 0 otherwise
+ */
+Bool gf3d_gpu_timer_supported();
+
+/**
+ * @brief start a new frame of zones, reading back the results from the frame that last used the slot
+ * @note called by gf3d_vgraphics_render_start
+ */
+void gf3d_gpu_timer_frame_begin();
+
+/**
+ * @brief write the timestamp that starts one of the frame's primary command buffers
+ * @note record it first, before any zone.  Buffers are timed one at a time, each must end before the next begins
+ * @param commandBuffer the primary command buffer, just begun
+ */
+void gf3d_gpu_timer_buffer_begin(VkCommandBuffer commandBuffer);
+
+/**
+ * @brief write the timestamp that ends the frame command buffer started with gf3d_gpu_timer_buffer_begin
+ * @note record it last, right before the command buffer is ended
+ * @param commandBuffer the same command buffer
+ */
+void gf3d_gpu_timer_buffer_end(VkCommandBuffer commandBuffer);
+
+/**
+ * @brief write a start timestamp for a zone.  Must be recorded outside of a render pass
+ * @param commandBuffer the primary command buffer to write the timestamp into
+ * @param name the name of the zone, kept by pointer until the results are read back
+ * @return the zone to pass to gf3d_gpu_timer_end or GF3D_GPU_TIMER_NONE if unsupported or out of zones
+ */
+Uint32 gf3d_gpu_timer_begin(VkCommandBuffer commandBuffer,const char *name);
+
+/**
+ * @brief write the end timestamp for a zone.  Must be recorded outside of a render pass
+ * @param commandBuffer the same command buffer the zone was started in
+ * @param zone the zone returned by gf3d_gpu_timer_begin
+ */
+void gf3d_gpu_timer_end(VkCommandBuffer commandBuffer,Uint32 zone);
+
+/**
+ * @brief get the gpu time of the most recently resolved frame
+ * @return the time in milliseconds, 0 if nothing has been resolved yet
+ */
+double gf3d_gpu_timer_get_frame_time();
+
+/**
+ * @brief get how many zones the most recently resolved frame had
+ * @return the zone count
+ */
+Uint32 gf3d_gpu_timer_get_zone_count();
+
+/**
+ * @brief get the name of a resolved zone
+ * @param zone the index of the zone, in the order they were recorded
+ * @return NULL if out of range, the name otherwise
+ */
+const char *gf3d_gpu_timer_get_zone_name(Uint32 zone);
+
+/**
+ * @brief get the gpu time of a resolved zone
+ * @param zone the index of the zone, in the order they were recorded
+ * @return the time in milliseconds, 0 if out of range
+ */
+double gf3d_gpu_timer_get_zone_time(Uint32 zone);
+
+/**
+ * @brief draw the resolved timings as text
+ * @note call between render start and render end
+ * @param position where to draw the first line, in screen pixels
+ */
+void gf3d_gpu_timer_draw_overlay(GFC_Vector2D position);
+
+#endif
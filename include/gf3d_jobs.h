@@ -0,0 +1,53 @@
+#ifndef __GF3D_JOBS_H__
+#define __GF3D_JOBS_H__
+
+#include "gfc_types.h"
+
+#ifdef _MSC_VER
+#define GF3D_THREAD_LOCAL __declspec(thread)
+#else
+#define GF3D_THREAD_LOCAL __thread
+#endif
+
+/**
+ * @brief a unit of work for the job system
+ * @param data the shared data passed to gf3d_jobs_dispatch
+ * @param jobIndex which job of the dispatch this is [0,jobCount)
+ * @param threadIndex which thread is running the job.  0 is the calling thread, workers are 1 to gf3d_jobs_get_worker_count()
+ */
+typedef void (*GF3D_JobFunc)(void *data,Uint32 jobIndex,Uint32 threadIndex);
+
+/**
+ * @brief start the worker threads used for parallel work
+ * @param workerCount how many worker threads to start.  Negative will pick based on the cpu count, 0 runs all jobs on the calling thread
+ */
+void gf3d_jobs_init(int workerCount);
+
+/**
+ * @brief get how many worker threads are running, not counting the main thread
+ * @return the number of worker threads
+ */
+Uint32 gf3d_jobs_get_worker_count();
+
+/**
+ * @brief get the total number of threads that may run jobs, including the main thread
+ * @return worker count + 1
+ */
+Uint32 gf3d_jobs_get_thread_count();
+
+/**
+ * @brief get the job system index of the calling thread
+ * @return 0 for the main thread (or any thread not owned by the job system), 1+ for workers
+ */
+Uint32 gf3d_jobs_get_thread_index();
+
+/**
+ * @brief run jobCount jobs across the worker threads and the calling thread, blocking until all have completed
+ * @param jobCount how many jobs to run
+ * @param func the function to run for each job
+ * @param data passed to each job
+ * @note jobs must not call gf3d_jobs_dispatch themselves
+ */
+void gf3d_jobs_dispatch(Uint32 jobCount,GF3D_JobFunc func,void *data);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef __GF3D_LOG_H__
+#define __GF3D_LOG_H__
+
+#include "gfc_types.h"
+
+/**
+ * Asynchronous logging in front of simple_logger.
+ * Messages are formatted on the calling thread, pushed onto a lock-free ring and written by a background
+ * thread, so callers never wait on the disk.  Each call site may log a limited number of messages per
+ * second, repeats past that are counted and reported the next time the site logs after the window.
+ * If the ring is full the message is dropped and counted rather than blocking.
+ * Before gf3d_log_init (or after close) messages go straight to slog.
+ */
+
+typedef enum
+{
+    LL_Debug,       /**<only written when __DEBUG is set*/
+    LL_Info,
+    LL_Warning,
+    LL_Error,
+    LL_MAX
+}LogLevel;
+
+#define GF3D_LOG_MESSAGE_LEN 256
+
+#define gf3d_log(level,...) _gf3d_log(level,__FILE__,__LINE__,__VA_ARGS__)
+
+/**
+ * @brief start the background writer
+ * @note call after init_logger
+ * @param capacity how many messages may wait to be written, rounded up to a power of two
+ */
+void gf3d_log_init(Uint32 capacity);
+
+/**
+ * @brief set the lowest level that gets written.  LL_Debug still requires __DEBUG
+ * @param level the minimum level, LL_Info by default
+ */
+void gf3d_log_set_level(LogLevel level);
+
+/**
+ * @brief set how many messages a single call site may log per second
+ * @param perSecond the limit, 0 for no limit.  Default is 10
+ */
+void gf3d_log_set_rate_limit(Uint32 perSecond);
+
+/**
+ * @brief block until everything logged so far has been written and synced
+ * @note for use before a deliberate crash or exit, not per frame
+ */
+void gf3d_log_flush();
+
+/**
+ * @brief queue a log message.  Use the gf3d_log macro instead
+ * @param level the severity
+ * @param file the source file of the call site
+ * @param line the source line of the call site
+ * @param msg printf style format
+ */
+void _gf3d_log(LogLevel level,const char *file,int line,const char *msg,...) __attribute__((format(printf,4,5)));
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef __GF3D_MEMORY_H__
+#define __GF3D_MEMORY_H__
+
+#include <vulkan/vulkan.h>
+
+#include "gfc_types.h"
+#include "gfc_vector.h"
+
+/**
+ * Tagged allocation tracking.
+ * CPU allocations made through gf3d_memory_alloc_array and device memory allocated through
+ * gf3d_memory_vk_allocate are counted against a subsystem tag, with live totals and high water marks.
+ * Anything still allocated at exit is reported by call site.
+ */
+
+typedef enum
+{
+    MT_General,
+    MT_Mesh,
+    MT_Texture,
+    MT_Sprite,
+    MT_Font,
+    MT_Particle,
+    MT_Entity,
+    MT_Pipeline,
+    MT_Loader,          /**<obj and gltf staging data*/
+    MT_Arena,           /**<frame and scratch arena blocks*/
+    MT_Swapchain,
+    MT_Staging,         /**<short lived upload and readback buffers*/
+    MT_MAX
+}MemoryTag;
+
+typedef enum
+{
+    MD_Cpu,
+    MD_Gpu,
+    MD_MAX
+}MemoryDomain;
+
+typedef struct
+{
+    Uint64  liveBytes;
+    Uint64  peakBytes;
+    Uint32  liveCount;
+    Uint32  allocCount;     /**<allocations made since init*/
+}MemoryStats;
+
+typedef struct
+{
+    VkDeviceSize    size;
+    VkDeviceSize    usage;      /**<what the whole process has allocated from the heap*/
+    VkDeviceSize    budget;     /**<how much the process can allocate before performance suffers*/
+    Uint8           reported;   /**<1 if usage and budget came from VK_EXT_memory_budget, 0 if estimated*/
+    Uint8           deviceLocal;
+}MemoryHeapBudget;
+
+#define gf3d_memory_alloc_array(tag,size,count) _gf3d_memory_alloc_array(tag,size,count,__FILE__,__LINE__)
+
+/**
+ * @brief start tracking
+ * @note call before any other gf3d system so the leak report runs after they close
+ */
+void gf3d_memory_init();
+
+/**
+ * @brief learn about the device heaps and whether the driver reports budgets
+ * @note called by gf3d_vgraphics_init once the logical device exists
+ * @param gpu the physical device in use
+ */
+void gf3d_memory_device_init(VkPhysicalDevice gpu);
+
+/**
+ * @brief allocate zeroed, tracked memory.  Use the gf3d_memory_alloc_array macro instead
+ * @param tag the subsystem to charge
+ * @param size the size of an element
+ * @param count how many elements
+ * @param file the source file of the call site
+ * @param line the source line of the call site
+ * @return NULL on error, the memory otherwise.  It must be freed with gf3d_memory_free
+ */
+void *_gf3d_memory_alloc_array(MemoryTag tag,size_t size,size_t count,const char *file,int line);
+
+/**
+ * @brief free memory from gf3d_memory_alloc_array
+ * @param ptr the memory to free, NULL is ignored
+ */
+void gf3d_memory_free(void *ptr);
+
+/**
+ * @brief vkAllocateMemory with tracking
+ * @param device the logical device
+ * @param allocInfo what to allocate
+ * @param tag the subsystem to charge
+ * @param memory (output) the new allocation
+ * @return the result of vkAllocateMemory
+ */
+VkResult gf3d_memory_vk_allocate(VkDevice device,const VkMemoryAllocateInfo *allocInfo,MemoryTag tag,VkDeviceMemory *memory);
+
+/**
+ * @brief vkFreeMemory for memory from gf3d_memory_vk_allocate
+ * @param device the logical device
+ * @param memory the memory to free, VK_NULL_HANDLE is ignored
+ */
+void gf3d_memory_vk_free(VkDevice device,VkDeviceMemory memory);
+
+/**
+ * @brief get the totals for a subsystem
+ * @param domain cpu or device memory
+ * @param tag the subsystem, or MT_MAX for everything
+ * @return the stats, zeroed if out of range
+ */
+MemoryStats gf3d_memory_get_stats(MemoryDomain domain,MemoryTag tag);
+
+/**
+ * @brief get the name of a tag, for reports
+ * @param tag the tag
+ * @return NULL if out of range, the name otherwise
+ */
+const char *gf3d_memory_get_tag_name(MemoryTag tag);
+
+/**
+ * @brief get how many memory heaps the device has
+ * @return the count, 0 before gf3d_memory_device_init
+ */
+Uint32 gf3d_memory_get_heap_count();
+
+/**
+ * @brief get the current usage and budget of a device heap
+ * @note without VK_EXT_memory_budget usage is what was tracked here and budget is the heap size
+ * @param heap which heap
+ * @param out (output) the heap budget
+ * @return 0 if heap is out of range, 1 otherwise
+ */
+Uint8 gf3d_memory_get_heap_budget(Uint32 heap,MemoryHeapBudget *out);
+
+/**
+ * @brief draw per subsystem and per heap memory use as text
+ * @note call between render start and render end
+ * @param position where to draw the first line, in screen pixels
+ */
+void gf3d_memory_draw_overlay(GFC_Vector2D position);
+
+#endif
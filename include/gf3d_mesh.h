@@ -50,12 +50,20 @@ typedef struct
     ObjData* objData;
 }MeshPrimitive;
 
+typedef enum
+{
+    MR_None,        /**<free the obj data once it is uploaded, the mesh can only be drawn*/
+    MR_Collision,   /**<keep only the triangle bvh, for gf3d_mesh_edge_test*/
+    MR_Full         /**<keep the whole obj data in each primitive*/
+}MeshRetention;
+
 typedef struct
 {
     GFC_TextLine        filename;
     Uint32              _refCount;
     GFC_List* primitives;
     GFC_Box             bounds;
+    MeshRetention       retention;  /**<how much of the obj data the primitives kept*/
 }Mesh;
 
 /**
@@ -74,12 +82,22 @@ Mesh* gf3d_mesh_new();
 /**
  * @brief load mesh data from an obj filename.
  * @note: currently only supporting obj files
- * @note this free's the intermediate data loaded from the obj file, no longer needed for most applications
+ * @note this free's the intermediate data loaded from the obj file, no longer needed for most applications.
+ * Use gf3d_mesh_load_full with MR_Collision for meshes that are edge tested
  * @param filename the name of the file to load
  * @return NULL on error or Mesh data
  */
 Mesh* gf3d_mesh_load(const char* filename);
 
+/**
+ * @brief load mesh data from an obj filename, choosing what stays on the cpu once it is uploaded
+ * @param filename the name of the file to load
+ * @param retention how much of the obj data to keep.  If the mesh is already loaded with less, the file is read
+ * again to get it
+ * @return NULL on error or Mesh data
+ */
+Mesh* gf3d_mesh_load_full(const char* filename, MeshRetention retention);
+
 /**
  * @brief draw a mesh given the parameters
  * @param mesh the mesh to draw
@@ -141,6 +159,18 @@ void gf3d_mesh_free(Mesh* mesh);
  */
 void gf3d_mesh_create_vertex_buffer_from_vertices(MeshPrimitive* primitive);
 
+/**
+ * @brief find the closest point where an edge hits any primitive of a mesh
+ * @param mesh the mesh to test
+ * @param modelMat the matrix the mesh is drawn with
+ * @param e the edge to test with
+ * @param fraction [optional output] how far from e.a to e.b [0,1] the hit is
+ * @param contact [optional output] the point of impact
+ * @return 1 if the edge hits the mesh, 0 otherwise
+ * @note the first test on each primitive builds its triangle bvh.  Meshes loaded with MR_None are never hit
+ */
+Uint8 gf3d_mesh_edge_test(Mesh* mesh, GFC_Matrix4 modelMat, GFC_Edge3D e, float* fraction, GFC_Vector3D* contact);
+
 /**
  * @brief get the pipeline that is used to render basic 3d meshes
  * @return NULL on error or the pipeline in question
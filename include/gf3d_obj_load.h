@@ -2,6 +2,7 @@
 #define __GF3D_OBJ_LOAD_H__
 
 #include "gf3d_mesh.h"
+#include "gf3d_tri_bvh.h"
 
 struct ObjData_S
 {    
@@ -28,6 +29,7 @@ struct ObjData_S
     Vertex *faceVertices;
     Uint32  face_vert_count;
     GFC_Box     bounds;
+    TriBVH     *bvh;            /**<built from faceVertices on the first edge test, or by gf3d_obj_compact*/
 };
 
 /**
@@ -84,13 +86,40 @@ ObjData *gf3d_obj_merge(ObjData *ObjA,GFC_Vector3D offsetA,ObjData *ObjB,GFC_Vec
 void gf3d_obj_free(ObjData *obj);
 
 /**
- * @brief perform a collision test between the edge and an obj.  Searches through each triangle for collision, returning the FIRST triangle with collision (so convex hulls might return the wrong side)
+ * @brief build the triangle bvh used for edge tests, if it has not been built yet
+ * @param obj the object to build for.  Must have been re-organized with gf3d_obj_load_reorg
+ * @return NULL on error or the bvh
+ */
+TriBVH *gf3d_obj_build_bvh(ObjData *obj);
+
+/**
+ * @brief reduce an obj to what edge tests need, once its vertices are uploaded
+ * @note builds the bvh and frees every vertex and face array.  The counts and bounds are kept.
+ * If the bvh cannot be built the obj is left as is
+ * @param obj the object to compact.  Must have been re-organized with gf3d_obj_load_reorg
+ */
+void gf3d_obj_compact(ObjData *obj);
+
+/**
+ * @brief perform a collision test between the edge and an obj.
  * @param obj the object to test
- * @param offset if the model has moved, rotated, scaled etc.  this is applied before the test 
+ * @param offset if the model has moved, rotated, scaled etc.  the edge is moved into model space by its inverse
  * @param e the edge to test with
- * @param contact [optional output] provides the point of impact
+ * @param contact [optional output] provides the point of impact closest to e.a.  Without it the test stops at the first hit
+ * @return 1 if the edge hits the obj, 0 otherwise
  */
 int gf3d_obj_edge_test(ObjData *obj,GFC_Matrix4 offset, GFC_Edge3D e,GFC_Vector3D *contact);
 
+/**
+ * @brief find the closest point the edge hits an obj
+ * @param obj the object to test
+ * @param offset the model matrix of the object
+ * @param e the edge to test with
+ * @param fraction [optional output] how far from e.a to e.b [0,1] the hit is
+ * @param contact [optional output] the point of impact
+ * @return 1 if the edge hits the obj, 0 otherwise
+ */
+int gf3d_obj_edge_test_closest(ObjData *obj,GFC_Matrix4 offset,GFC_Edge3D e,float *fraction,GFC_Vector3D *contact);
+
 
 #endif
@@ -12,17 +12,56 @@
 #include "gf2d_sprite.h"
 #include "gf3d_pipeline.h"
 
+/**
+ * Particles.
+ * Particles are drawn as camera facing quads, instanced from a per frame buffer of positions, sizes and colors.
+ * Particles drawn one at a time are batched by texture, so a run of them is a single draw call.
+ * Emitters keep their particles as a structure of arrays in a ring buffer: new particles go in at the head, dead ones
+ * are retired from the tail, and the oldest are overwritten when the ring is full.  They are simulated four at a time
+ * with SIMD, split across the job threads, and each emitter is drawn with one instanced draw call.
+ */
+
 typedef struct
 {
     GFC_Vector3D position;
     GFC_Color color;
-    GFC_Color color2;   //for color blending
+    GFC_Color color2;   //for color blending, emitters fade from color to color2 over each particle's life
     float size;
 }Particle;
 
+typedef struct
+{
+    Uint8           _inuse;
+    // settings, these can be changed between updates
+    GFC_Vector3D    position;           /**<where particles spawn*/
+    float           spawnRadius;        /**<particles spawn up to this far from the position on each axis*/
+    float           rate;               /**<particles spawned per second*/
+    float           lifetime;           /**<how long particles live, in seconds*/
+    float           lifetimeVariance;   /**<lifetimes vary by up to this much either way*/
+    GFC_Vector3D    velocity;           /**<the starting velocity, per second*/
+    GFC_Vector3D    velocityVariance;   /**<starting velocities vary by up to this much either way on each axis*/
+    GFC_Vector3D    acceleration;       /**<applied every second, like gravity*/
+    float           drag;               /**<the fraction of velocity lost per second*/
+    GFC_Color       color;              /**<the color particles are spawned with*/
+    GFC_Color       color2;             /**<the color particles fade to by the end of their life*/
+    float           size;               /**<the size particles are spawned with*/
+    float           size2;              /**<the size particles grow or shrink to by the end of their life*/
+    Texture        *texture;            /**<NULL for the default soft circle.  Not owned by the emitter*/
+    // state
+    float           spawnDebt;          /**<fractional particles owed to the next update*/
+    Uint32          seed;               /**<for spawn variance*/
+    Uint32          capacity;           /**<how many particles the ring holds*/
+    Uint32          tail;               /**<the oldest particle*/
+    Uint32          count;              /**<particles in the ring, from the tail on, including any that died out of order*/
+    float          *px,*py,*pz;         /**<positions*/
+    float          *vx,*vy,*vz;         /**<velocities*/
+    float          *age;                /**<seconds since spawning*/
+    float          *invLife;            /**<one over the particle's lifetime*/
+}ParticleEmitter;
+
 /**
  * @brief initialize the particle drawing subsystem
- * @param max_particles the limit of concurrent particles to draw
+ * @param max_particles the limit of concurrent particles to draw, across single particles and emitters
  */
 void gf3d_particle_manager_init(Uint32 max_particles);
 
@@ -38,7 +77,7 @@ Particle gf3d_particle(GFC_Vector3D position, GFC_Color color, float size);
 void gf3d_particle_reset_pipes();
 
 /**
- * @brief called to submit all draw commands to the particle pipelines
+ * @brief called to submit all draw commands to the particle pipelines, this flushes the open batch of single particles
  */
 void gf3d_particle_submit_pipe_commands();
 
@@ -89,6 +128,60 @@ void gf3d_particle_draw_list(GFC_List *list);
  */
 Pipeline *gf3d_particle_get_pipeline();
 
+/**
+ * @brief queue a draw of instances made on the gpu, whose count is never read back
+ * @param instanceBuffer instances laid out as the particle pipeline reads them: position and size, then color
+ * @param indirectBuffer holds the VkDrawIndirectCommand for the draw, with its instanceCount written on the gpu
+ * @param indirectOffset where in indirectBuffer the command is
+ * @param texture [optional] the texture to draw with, the default soft circle if NULL
+ */
+void gf3d_particle_queue_indirect(VkBuffer instanceBuffer,VkBuffer indirectBuffer,VkDeviceSize indirectOffset,Texture *texture);
+
+/**
+ * @brief make a new particle emitter
+ * @note defaults to white particles of size 1 that fade out over a second, with a rate of 0
+ * @param maxParticles how many particles the emitter can have alive at once
+ * @return NULL on error, the emitter otherwise.  Free with gf3d_particle_emitter_free
+ */
+ParticleEmitter *gf3d_particle_emitter_new(Uint32 maxParticles);
+
+/**
+ * @brief free an emitter and its particles
+ * @param emitter the emitter to free
+ */
+void gf3d_particle_emitter_free(ParticleEmitter *emitter);
+
+/**
+ * @brief spawn particles right away, on top of the emitter's rate
+ * @param emitter the emitter to spawn from
+ * @param count how many to spawn, the oldest are replaced once the emitter is full
+ */
+void gf3d_particle_emitter_burst(ParticleEmitter *emitter,Uint32 count);
+
+/**
+ * @brief move an emitter's particles forward in time, retire the dead and spawn new ones at its rate
+ * @param emitter the emitter to update
+ * @param dt the time step, in seconds
+ */
+void gf3d_particle_emitter_update(ParticleEmitter *emitter,float dt);
+
+/**
+ * @brief draw an emitter's particles this frame with a single instanced draw
+ * @param emitter the emitter to draw
+ */
+void gf3d_particle_emitter_draw(ParticleEmitter *emitter);
+
+/**
+ * @brief update every emitter, called once per simulation step
+ * @param dt the time step, in seconds
+ */
+void gf3d_particle_emitters_update(float dt);
+
+/**
+ * @brief draw every emitter, called once per render frame
+ */
+void gf3d_particle_emitters_draw();
+
 /**
  * @brief draw a line of red and green particles in parallel from the position, based on the rotation provided.
  * @param postion where to center the lines on
@@ -0,0 +1,120 @@
+#ifndef __GF3D_PARTICLE_GPU_H__
+#define __GF3D_PARTICLE_GPU_H__
+
+#include <vulkan/vulkan.h>
+
+#include "gfc_types.h"
+#include "gfc_vector.h"
+#include "gfc_color.h"
+
+#include "gf3d_texture.h"
+
+/**
+ * GPU particles.
+ * An optional path for emitters too big to simulate on the cpu.  Particle state lives in storage buffers and never
+ * comes back to the cpu: each frame one compute pass takes free slots for new particles, a second moves the live ones,
+ * returns the dead to the free list and compacts the rest into an instance buffer, counting them into the
+ * instanceCount of an indirect draw.  The cpu only sends how many particles to emit and how much time passed.
+ * Settings mean the same as for cpu emitters, except that a full emitter drops new particles instead of replacing the
+ * oldest.  Only core Vulkan 1.0 features are used, so it runs on software drivers like lavapipe.
+ */
+
+typedef struct
+{
+    Uint8           _inuse;
+    // settings, these can be changed between updates
+    GFC_Vector3D    position;           /**<where particles spawn*/
+    float           spawnRadius;        /**<particles spawn up to this far from the position on each axis*/
+    float           rate;               /**<particles spawned per second*/
+    float           lifetime;           /**<how long particles live, in seconds*/
+    float           lifetimeVariance;   /**<lifetimes vary by up to this much either way*/
+    GFC_Vector3D    velocity;           /**<the starting velocity, per second*/
+    GFC_Vector3D    velocityVariance;   /**<starting velocities vary by up to this much either way on each axis*/
+    GFC_Vector3D    acceleration;       /**<applied every second, like gravity*/
+    float           drag;               /**<the fraction of velocity lost per second*/
+    GFC_Color       color;              /**<the color particles are spawned with*/
+    GFC_Color       color2;             /**<the color particles fade to by the end of their life*/
+    float           size;               /**<the size particles are spawned with*/
+    float           size2;              /**<the size particles grow or shrink to by the end of their life*/
+    Texture        *texture;            /**<NULL for the default soft circle.  Not owned by the emitter*/
+    // state
+    float           spawnDebt;          /**<fractional particles owed to the next update*/
+    Uint32          pendingEmit;        /**<particles to spawn at the next dispatch*/
+    float           pendingTime;        /**<seconds to simulate at the next dispatch*/
+    Uint32          seed;               /**<for spawn variance, advanced every dispatch*/
+    Uint32          capacity;           /**<how many particles the emitter holds*/
+    Uint32          parity;             /**<which alive list the next dispatch reads, it writes and draws the other*/
+    VkBuffer        particleBuffer;     /**<position and age, velocity and one over lifetime*/
+    VkDeviceMemory  particleMemory;
+    VkBuffer        indexBuffer;        /**<the free list, then two alive lists, capacity each*/
+    VkDeviceMemory  indexMemory;
+    VkBuffer        counterBuffer;      /**<an indirect draw per alive list and the free count*/
+    VkDeviceMemory  counterMemory;
+    VkBuffer        instanceBuffer;     /**<the compacted live particles, as the particle pipeline reads them*/
+    VkDeviceMemory  instanceMemory;
+}GpuParticleEmitter;
+
+/**
+ * @brief set up the compute pipelines for gpu particles
+ * @note if the device or its shaders cannot do it, gpu emitters cannot be made and the rest of the engine carries on
+ */
+void gf3d_particle_gpu_init();
+
+/**
+ * @brief check if gpu particles are available
+ * @return true if gf3d_particle_gpu_init succeeded
+ */
+Bool gf3d_particle_gpu_enabled();
+
+/**
+ * @brief make a new gpu particle emitter
+ * @note defaults to white particles of size 1 that fade out over a second, with a rate of 0
+ * @param maxParticles how many particles the emitter can have alive at once
+ * @return NULL on error or if gpu particles are not available, the emitter otherwise
+ */
+GpuParticleEmitter *gf3d_particle_gpu_emitter_new(Uint32 maxParticles);
+
+/**
+ * @brief free an emitter and its buffers
+ * @param emitter the emitter to free
+ */
+void gf3d_particle_gpu_emitter_free(GpuParticleEmitter *emitter);
+
+/**
+ * @brief spawn particles at the next dispatch, on top of the emitter's rate
+ * @param emitter the emitter to spawn from
+ * @param count how many to spawn, any that do not fit are dropped
+ */
+void gf3d_particle_gpu_emitter_burst(GpuParticleEmitter *emitter,Uint32 count);
+
+/**
+ * @brief add time for the next dispatch to simulate, and spawn at the emitter's rate
+ * @param emitter the emitter to update
+ * @param dt the time step, in seconds
+ */
+void gf3d_particle_gpu_emitter_update(GpuParticleEmitter *emitter,float dt);
+
+/**
+ * @brief draw an emitter's particles this frame with a single indirect draw
+ * @param emitter the emitter to draw
+ */
+void gf3d_particle_gpu_emitter_draw(GpuParticleEmitter *emitter);
+
+/**
+ * @brief update every gpu emitter, called once per simulation step
+ * @param dt the time step, in seconds
+ */
+void gf3d_particle_gpu_emitters_update(float dt);
+
+/**
+ * @brief draw every gpu emitter, called once per render frame
+ */
+void gf3d_particle_gpu_emitters_draw();
+
+/**
+ * @brief record and submit the compute passes for every gpu emitter
+ * @note called once per render frame, after the draws and before the pipelines submit their commands
+ */
+void gf3d_particle_gpu_dispatch();
+
+#endif
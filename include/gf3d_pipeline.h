@@ -8,6 +8,8 @@
 #include "gf3d_uniform_buffers.h"
 #include "gf3d_texture.h"
 
+#define GF3D_PIPELINE_MAX_IMMUTABLE_SAMPLERS 4
+
 typedef struct
 {
     Uint8                   inuse;
@@ -15,7 +17,12 @@ typedef struct
     VkDescriptorSet        *descriptorSet;  //pointer to the descriptorSet we will use for this draw call
     VkBuffer                vertexBuffer;
     Uint32                  vertexCount;
+    Uint32                  firstIndex;     //where in the index buffer the draw starts
+    Uint32                  instanceCount;  //0 draws a single instance
+    Uint32                  firstInstance;  //where in the per instance vertex buffer the draw starts
     VkBuffer                indexBuffer;
+    VkBuffer                indirectBuffer; //if set, the counts come from a VkDrawIndirectCommand written on the gpu
+    VkDeviceSize            indirectOffset; //where in the indirect buffer the command is
     void                   *uboData;        //pointer to corresponding memory in the pipeline uboData
     Texture                *texture;        //optional!!
 }PipelineDrawCall;
@@ -24,6 +31,7 @@ typedef struct
 {
     Bool                    inUse;
     GFC_TextLine            name;                   /**<name of pipeline for debugging*/
+    VkPipelineBindPoint     bindPoint;              /**<graphics or compute, compute pipelines have no render pass or draw calls*/
     VkPipeline              pipeline;               /**<pipeline handle*/
     VkRenderPass            renderPass;
     VkPipelineLayout        pipelineLayout;
@@ -33,6 +41,10 @@ typedef struct
     char                   *fragShader;             /**<the shader loaded from disk*/
     size_t                  fragSize;               /**<memory size of the shader*/
     VkShaderModule          fragModule;             /**<the index of the shader module within the device*/
+    char                   *compShader;             /**<the compute shader loaded from disk*/
+    size_t                  compSize;               /**<memory size of the compute shader*/
+    VkShaderModule          compModule;
+    Uint32                  pushConstantSize;       /**<bytes of push constants the compute shader takes, 0 for none*/
     VkDevice                device;
     Uint32                 *descriptorCursor;       /**<keeps track of which descriptors have been used per frame*/
     VkDescriptorPool       *descriptorPool;
@@ -50,9 +62,26 @@ typedef struct
     UniformBufferList      *uboBigBuffer;           /**<for batched draws.  This is the memory for ALL draws one per frame*/
     
     VkCommandBuffer         commandBuffer;          /**<for current command*/
+    VkCommandBuffer        *secondaryBuffers;       /**<secondary command buffers recorded this frame, one per slice of the draw list*/
+    Uint32                  secondaryBufferCount;   /**<how many slices the draw list may be split into*/
     VkIndexType             indexType;              /**<size of the indices in the index buffer*/
+    Uint32                  gpuZone;                /**<gpu timer zone for the current command*/
+    VkSampler               immutableSamplers[GF3D_PIPELINE_MAX_IMMUTABLE_SAMPLERS];   /**<baked into the descriptor set layout, one per binding*/
+    Uint32                  immutableSamplerCount;
 }Pipeline;
 
+/**
+ * @brief what the pipelines did for the last frame, for profiling
+ */
+typedef struct
+{
+    Uint32                  drawCalls;              /**<draw calls recorded across all pipelines*/
+    Uint32                  pipelines;              /**<pipelines that had commands submitted*/
+    double                  uboTime;                /**<seconds spent copying uniform data to the gpu*/
+    double                  recordTime;             /**<seconds spent recording command buffers*/
+    double                  submitTime;             /**<seconds spent submitting, including the wait for the gpu to finish*/
+}PipelineFrameStats;
+
 /**
  * @brief setup pipeline system
  */
@@ -77,6 +106,8 @@ Pipeline *gf3d_pipeline_graphics_load(VkDevice device,const char *vertFile,const
 
 /**
  * @brief create a pipeline from config
+ * @note a config with "type":"compute" makes a compute pipeline from its "compute_shader", "descriptorSetLayout",
+ * "descriptorCount" and "pushConstantSize" instead, and the vertex and ubo parameters are ignored
  * @param device the logical device to create the pipeline for
  * @param configFile the filepath to the config file
  * @param extent the screen resolution this pipeline will be working towards
@@ -99,6 +130,34 @@ Pipeline *gf3d_pipeline_create_from_config(
     VkDeviceSize bufferSize,
     VkIndexType indexType);
 
+/**
+ * @brief create a compute pipeline from config
+ * @param device the logical device to create the pipeline for
+ * @param configFile the filepath to the config file, its pipeline "type" must be "compute"
+ * @param descriptorCount how many descriptor sets each frame may use, unless the config sets "descriptorCount"
+ * @returns NULL on error (see logs) or a pointer to a pipeline
+ */
+Pipeline *gf3d_pipeline_compute_create_from_config(VkDevice device,const char *configFile,Uint32 descriptorCount);
+
+/**
+ * @brief record a compute dispatch
+ * @param commandBuffer the command buffer to record into, outside of any render pass
+ * @param pipe a compute pipeline
+ * @param descriptorSet the descriptor set to bind
+ * @param pushConstants [optional] pipe->pushConstantSize bytes of push constants
+ * @param groupCount how many workgroups to dispatch
+ */
+void gf3d_pipeline_dispatch(VkCommandBuffer commandBuffer,Pipeline *pipe,VkDescriptorSet *descriptorSet,const void *pushConstants,Uint32 groupCount);
+
+/**
+ * @brief point the storage buffer bindings of a descriptor set at buffers
+ * @param pipe the pipeline the set was taken from
+ * @param descriptorSet the set to write
+ * @param buffers one per binding, starting from binding 0
+ * @param count how many buffers
+ */
+void gf3d_pipeline_write_storage_buffers(Pipeline *pipe,VkDescriptorSet *descriptorSet,const VkDescriptorBufferInfo *buffers,Uint32 count);
+
 /**
  * @brief setup a pipeline for rendering a basic sprite
  * @param device the logical device that the pipeline will be set up on
@@ -141,6 +200,63 @@ void gf3d_pipeline_queue_render(
     void *uboData,
     Texture *texture);
 
+/**
+ * @brief queue up a render of part of an index buffer, for draws that share a vertex and index buffer
+ * @param pipe the pipeline to queue up for
+ * @param vertexBuffer which buffer to bind
+ * @param firstIndex the first index to draw
+ * @param indexCount how many indices to draw
+ * @param indexBuffer which face buffer to use for the draw, must be provided
+ * @param uboData the UBO data to draw with.  Note this is copied by the function
+ * @param texture [optional] the texture to render with
+ */
+void gf3d_pipeline_queue_render_range(
+    Pipeline *pipe,
+    VkBuffer vertexBuffer,
+    Uint32 firstIndex,
+    Uint32 indexCount,
+    VkBuffer indexBuffer,
+    void *uboData,
+    Texture *texture);
+
+/**
+ * @brief queue up an instanced render, for pipelines whose vertex buffer is read per instance
+ * @param pipe the pipeline to queue up for
+ * @param instanceBuffer the per instance vertex buffer to bind
+ * @param firstInstance the first instance to draw
+ * @param instanceCount how many instances to draw
+ * @param indexCount how many indices (or vertices, without an index buffer) each instance draws
+ * @param indexBuffer [optional] which face buffer to use for each instance, VK_NULL_HANDLE to draw by vertex index alone
+ * @param uboData the UBO data to draw with.  Note this is copied by the function
+ * @param texture [optional] the texture to render with
+ */
+void gf3d_pipeline_queue_render_instanced(
+    Pipeline *pipe,
+    VkBuffer instanceBuffer,
+    Uint32 firstInstance,
+    Uint32 instanceCount,
+    Uint32 indexCount,
+    VkBuffer indexBuffer,
+    void *uboData,
+    Texture *texture);
+
+/**
+ * @brief queue up an instanced render whose counts are written on the gpu, so they are never read back
+ * @param pipe the pipeline to queue up for
+ * @param instanceBuffer the per instance vertex buffer to bind
+ * @param indirectBuffer holds a VkDrawIndirectCommand for a non indexed draw
+ * @param indirectOffset where in indirectBuffer the command is
+ * @param uboData the UBO data to draw with.  Note this is copied by the function
+ * @param texture [optional] the texture to render with
+ */
+void gf3d_pipeline_queue_render_indirect(
+    Pipeline *pipe,
+    VkBuffer instanceBuffer,
+    VkBuffer indirectBuffer,
+    VkDeviceSize indirectOffset,
+    void *uboData,
+    Texture *texture);
+
 /**
  * @brief bind a draw call to the current command
  */
@@ -163,11 +279,26 @@ void gf3d_pipeline_reset_all_pipes();
 void gf3d_pipeline_submit_commands(Pipeline *pipe);
 
 /**
- * @brief submit the commands for ALL pipelines in the order in which they were created
+ * @brief record the queued draw calls for a pipeline into secondary command buffers, split across the job system threads
+ * @note the pipeline's primary command buffer is begun here and ended by gf3d_pipeline_submit_commands
+ * @param pipe the pipeline to record
+ * @param frame the swap chain rendering frame
+ */
+void gf3d_pipeline_record_commands(Pipeline *pipe,Uint32 frame);
+
+/**
+ * @brief submit the commands for ALL graphics pipelines in the order in which they were created
  * @note order might be messed up if any were destroyed and recreated during the life of the program
+ * @note compute pipelines are skipped, whoever owns them records their dispatches
  */
 void gf3d_pipeline_submit_all_pipe_commands();
 
+/**
+ * @brief get the stats for the most recently submitted frame
+ * @param stats [output] where to write the stats
+ */
+void gf3d_pipeline_get_frame_stats(PipelineFrameStats *stats);
+
 VkFormat gf3d_pipeline_find_depth_format();
 
 #endif
@@ -0,0 +1,79 @@
+#ifndef __GF3D_PROFILER_H__
+#define __GF3D_PROFILER_H__
+
+#include "gfc_types.h"
+
+/**
+ * Scoped timing zones and counters, captured for a range of frames and written out as a
+ * Chrome trace (load in about:tracing or ui.perfetto.dev).
+ * Zones cost a single branch while no capture is running.  Define GF3D_PROFILER_DISABLE to compile them out.
+ * Each thread owned by gf3d_jobs records into its own ring buffer, other threads must not use zones.
+ * Zone and counter names are kept by pointer, so they must outlive the capture (string literals are best)
+ */
+
+#ifdef GF3D_PROFILER_DISABLE
+#define GF3D_PROFILE_BEGIN(name)
+#define GF3D_PROFILE_END()
+#define GF3D_PROFILE_COUNTER(name,value)
+#else
+#define GF3D_PROFILE_BEGIN(name) gf3d_profiler_begin(name)
+#define GF3D_PROFILE_END() gf3d_profiler_end()
+#define GF3D_PROFILE_COUNTER(name,value) gf3d_profiler_counter(name,value)
+#endif
+
+/**
+ * @brief set up the profiler
+ * @note reads "profiler_events" (events per thread, default 65536) and "trace_file" (default gf3d_trace.json) from the setup block
+ * @param config the config file to read, the same one passed to gf3d_vgraphics_init
+ */
+void gf3d_profiler_init(const char *config);
+
+/**
+ * @brief mark the start of a new frame.  Starts and stops captures, call once per frame from the main thread
+ */
+void gf3d_profiler_frame_begin();
+
+/**
+ * @brief capture the next few frames, then write the trace
+ * @param frames how many frames to capture
+ */
+void gf3d_profiler_capture(Uint32 frames);
+
+/**
+ * @brief capture a given range of frames, then write the trace
+ * @param first the frame to start on, counting from 1 at the first call to gf3d_profiler_frame_begin
+ * @param frames how many frames to capture
+ */
+void gf3d_profiler_capture_range(Uint32 first,Uint32 frames);
+
+/**
+ * @brief check if a capture is running
+ * @return 1 if zones are being recorded, 0 otherwise
+ */
+Uint8 gf3d_profiler_capturing();
+
+/**
+ * @brief change where the next trace is written
+ * @param filename the file to write, the profiler keeps its own copy
+ */
+void gf3d_profiler_set_output(const char *filename);
+
+/**
+ * @brief open a timing zone on the calling thread.  Use the GF3D_PROFILE_BEGIN macro instead
+ * @param name the name of the zone
+ */
+void gf3d_profiler_begin(const char *name);
+
+/**
+ * @brief close the most recently opened zone on the calling thread.  Use the GF3D_PROFILE_END macro instead
+ */
+void gf3d_profiler_end();
+
+/**
+ * @brief record the value of a counter at this time.  Use the GF3D_PROFILE_COUNTER macro instead
+ * @param name the name of the counter
+ * @param value its current value
+ */
+void gf3d_profiler_counter(const char *name,double value);
+
+#endif
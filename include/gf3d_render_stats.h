@@ -0,0 +1,105 @@
+#ifndef __GF3D_RENDER_STATS_H__
+#define __GF3D_RENDER_STATS_H__
+
+#include "gfc_types.h"
+#include "gfc_vector.h"
+
+/**
+ * Per frame counters for what the renderer did.  Counters are safe to bump from job threads.
+ * A frame's counts become readable once gf3d_vgraphics_render_end has finished with it.
+ */
+
+typedef enum
+{
+    RS_DrawCalls,
+    RS_Instances,
+    RS_Triangles,
+    RS_DescriptorWrites,
+    RS_BytesUploaded,       /**<staging buffer and image copies to device memory*/
+    RS_UboBytes,            /**<uniform data written to mapped memory*/
+    RS_TexturesCreated,
+    RS_GlyphsDrawn,
+    RS_GlyphsRasterized,    /**<glyphs added to a font atlas, 0 once the text on screen has been seen*/
+    RS_TextCacheHits,       /**<lines of text drawn from an already laid out run*/
+    RS_TextCacheMisses,
+    RS_SpriteQuads,         /**<sprites and glyphs written to the sprite batches*/
+    RS_SpriteBatches,       /**<draw calls the sprite batches were flushed as*/
+    RS_Particles,           /**<particle instances written, live emitter particles and single draws*/
+    RS_ParticleBatches,     /**<instanced draw calls the particles were drawn with*/
+    RS_EntitiesVisible,
+    RS_EntitiesCulled,
+    RS_FrameArenaBytes,     /**<frame arena bytes used across all threads*/
+    RS_ArenaHeapAllocs,     /**<heap allocations made by arenas, 0 once warmed up*/
+    RS_HeapAllocs,          /**<tracked allocations made anywhere in the frame, arenas included*/
+    RS_TextureStreamUploads,/**<streamed texture levels uploaded*/
+    RS_TextureEvictions,    /**<streamed textures shrunk to fit the budget*/
+    RS_MAX
+}RenderStat;
+
+#define GF3D_RENDER_STATS_MAX_PIPELINES 16
+
+typedef struct
+{
+    const char *name;
+    Uint32      drawCalls;
+    Uint32      instances;
+    Uint32      triangles;
+}RenderStatsPipeline;
+
+/**
+ * @brief add to a counter for the current frame
+ * @param stat which counter
+ * @param amount how much to add
+ */
+void gf3d_render_stats_add(RenderStat stat,Uint32 amount);
+
+/**
+ * @brief record what a pipeline drew for the current frame
+ * @param name the pipeline name, kept by pointer
+ * @param drawCalls draw calls recorded
+ * @param instances instances drawn across those calls
+ * @param triangles triangles drawn across those calls
+ */
+void gf3d_render_stats_add_pipeline(const char *name,Uint32 drawCalls,Uint32 instances,Uint32 triangles);
+
+/**
+ * @brief close out the current frame, making its counts readable and starting the next from zero
+ * @note called by gf3d_vgraphics_render_end
+ */
+void gf3d_render_stats_frame_end();
+
+/**
+ * @brief get a counter from the last finished frame
+ * @param stat which counter
+ * @return the count, 0 if stat is out of range
+ */
+Uint32 gf3d_render_stats_get(RenderStat stat);
+
+/**
+ * @brief get the name of a counter, for reports
+ * @param stat which counter
+ * @return NULL if out of range, the snake_case name otherwise
+ */
+const char *gf3d_render_stats_get_name(RenderStat stat);
+
+/**
+ * @brief get how many pipelines drew anything in the last finished frame
+ * @return the count
+ */
+Uint32 gf3d_render_stats_get_pipeline_count();
+
+/**
+ * @brief get what a pipeline drew in the last finished frame
+ * @param index which pipeline, in submission order
+ * @return NULL if out of range, the stats otherwise
+ */
+const RenderStatsPipeline *gf3d_render_stats_get_pipeline(Uint32 index);
+
+/**
+ * @brief draw the last finished frame's counters as text
+ * @note call between render start and render end
+ * @param position where to draw the first line, in screen pixels
+ */
+void gf3d_render_stats_draw_overlay(GFC_Vector2D position);
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef __GF3D_SAMPLER_H__
+#define __GF3D_SAMPLER_H__
+
+#include <vulkan/vulkan.h>
+
+#include "simple_json.h"
+
+#include "gfc_types.h"
+
+/**
+ * Shared samplers.
+ * Samplers are cached by their state, so every texture sampled the same way uses the same VkSampler.
+ * A sampler is destroyed when its last reference is freed, so, like the images it samples, only free it once the
+ * frames using it are done.  The default sampler is held by the cache for as long as it is open.
+ */
+
+typedef struct
+{
+    VkFilter                magFilter;
+    VkFilter                minFilter;
+    VkSamplerMipmapMode     mipmapMode;
+    VkSamplerAddressMode    addressModeU;
+    VkSamplerAddressMode    addressModeV;
+    VkSamplerAddressMode    addressModeW;
+    float                   maxAnisotropy;  /**<1 or less turns anisotropic filtering off*/
+    float                   minLod;
+    float                   maxLod;         /**<VK_LOD_CLAMP_NONE leaves the limit to the image view*/
+}SamplerState;
+
+/**
+ * @brief initialize the sampler cache
+ * @param maxSamplers how many different sampler states can be cached
+ */
+void gf3d_sampler_init(Uint32 maxSamplers);
+
+/**
+ * @brief get the state textures are sampled with: linear filtering, repeat addressing, 16x anisotropy and every mip level
+ * @return the default state
+ */
+SamplerState gf3d_sampler_state_default();
+
+/**
+ * @brief read a sampler state from config, starting from the default
+ * @param json an object with any of "magFilter", "minFilter", "mipmapMode", "addressMode" (all three),
+ * "addressModeU", "addressModeV", "addressModeW", "maxAnisotropy", "minLod" and "maxLod"
+ * @return the state
+ */
+SamplerState gf3d_sampler_state_from_json(SJson *json);
+
+/**
+ * @brief get a sampler for a state, creating it the first time it is asked for
+ * @note anisotropy is clamped to what the device supports
+ * @param state the sampler state, NULL for the default
+ * @return the sampler, or the default sampler if this state could not be created.  VK_NULL_HANDLE if neither exists.
+ * Release with gf3d_sampler_free
+ */
+VkSampler gf3d_sampler_get(const SamplerState *state);
+
+/**
+ * @brief release a reference to a sampler from gf3d_sampler_get, destroying it with the last one
+ * @param sampler the sampler
+ */
+void gf3d_sampler_free(VkSampler sampler);
+
+/**
+ * @brief get how many distinct samplers are alive
+ * @return the count
+ */
+Uint32 gf3d_sampler_get_count();
+
+#endif
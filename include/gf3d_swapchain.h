@@ -2,6 +2,7 @@
 #define __GF3D_SWAPCHAIN_H__
 
 #include <vulkan/vulkan.h>
+#include <SDL.h>
 #include "gfc_types.h"
 #include "gf3d_pipeline.h"
 
@@ -15,6 +16,28 @@
 	 */
 	void gf3d_swapchain_init(VkPhysicalDevice device, VkDevice logicalDevice, VkSurfaceKHR surface, uint32_t width, uint32_t height);
 
+	/**
+	 * @brief set up offscreen color images in place of a swap chain, for rendering with no window
+	 * @param logicalDevice the logical device to make the images with
+	 * @param width the width of the images
+	 * @param height the height of the images
+	 */
+	void gf3d_swapchain_init_offscreen(VkDevice logicalDevice, uint32_t width, uint32_t height);
+
+	/**
+	 * @brief check if rendering goes to offscreen images instead of a window
+	 * @returns true if gf3d_swapchain_init_offscreen was used
+	 */
+	Bool gf3d_swapchain_is_offscreen(void);
+
+	/**
+	 * @brief copy the contents of an offscreen image back to system memory
+	 * @note only works offscreen, and only after the frame for that image has been submitted
+	 * @param index which swap image to read
+	 * @returns NULL on error, or a new surface in SDL_PIXELFORMAT_BGRA32.  Free with SDL_FreeSurface
+	 */
+	SDL_Surface *gf3d_swapchain_read_back_image(uint32_t index);
+
 	/**
 	 * @brief check if the initialized swap chain is sufficient for rendering
 	 * @returns false if not, true if it will work for rendering
@@ -5,41 +5,122 @@
 #include "gfc_types.h"
 #include "gfc_text.h"
 
+typedef enum
+{
+    TR_GpuOnly,         /**<free the CPU pixels once they are uploaded*/
+    TR_KeepSurface      /**<keep them in tex->surface, for gf2d_sprite_draw_to_surface and other CPU readers*/
+}TextureRetention;
+
 typedef struct
 {
     Uint8               _inuse;
     Uint32              _refcount;
     Uint32              width,height;
+    Uint32              mipLevels;  /**<how many levels the image has, 1 if it was made without mipmaps*/
+    VkFormat            format;     /**<RGBA8, or a BC format for block compressed textures*/
     GFC_TextLine            filename;
     VkImage             textureImage;
     VkDeviceMemory      textureImageMemory;
     VkImageView         textureImageView;
-    VkSampler           textureSampler;
-    SDL_Surface        *surface;    /**<the image data in CPU space*/
+    VkSampler           textureSampler; /**<shared with other textures, see gf3d_sampler.h*/
+    SDL_Surface        *surface;    /**<the image data in CPU space, only kept with TR_KeepSurface or after gf3d_texture_get_surface*/
+    VkDeviceSize        residentBytes;  /**<device memory held by the image*/
+    Uint32              residentLevel;  /**<the largest level on the gpu, the image holds residentLevel through mipLevels - 1*/
+    Uint8               streamed;       /**<levels are loaded and dropped by the streamer, see gf3d_texture_stream.h*/
+    Uint8               streamPending;  /**<a load is in flight*/
+    Uint32              streamId;       /**<tells a finished load apart from one meant for an earlier texture in this slot*/
+    Uint32              wantedLevel;    /**<the largest level the draw path asked for*/
+    Uint32              lastUsed;       /**<the streamer frame it was last drawn in*/
 }Texture;
 
 /**
  * @brief initialize the texture subsystem
  * @param max_textures the maximum number of concurrent textures to be supported.
  * This is inclusive of all model textures and sprites
+ * @param config the setup config.  In "setup", "mipmaps" (default true) gives textures a full mip chain, blitted on the gpu
+ * when the device supports it and filtered on the cpu otherwise.  "mip_files" makes gf3d_texture_load look for precomputed
+ * levels named like images/rock_mip1.png.  "compressed_textures" makes it load images/rock.dds in place of images/rock.png
+ * when it exists, see gf3d_texture_bake.h
  */
-void gf3d_texture_init(Uint32 max_textures);
+void gf3d_texture_init(Uint32 max_textures,const char *config);
 
 /**
- * @brief load a texture from file.
+ * @brief load a texture from file, keeping only the gpu copy
+ * @note .dds and .ktx2 files holding BC1, BC3, BC5 or BC7 are uploaded as is, or decoded if the device cannot sample them
  * @param filename the path to the file to load
  * @return NULL on error or the texture loaded
  */
 Texture *gf3d_texture_load(const char *filename);
 
 /**
- * @brief create a texture based on the provided surface.
+ * @brief load a texture from file
+ * @param filename the path to the file to load
+ * @param retention whether to keep the CPU pixels in tex->surface after upload.  Asking for them from a texture
+ * already loaded without them loads them again
+ * @return NULL on error or the texture loaded
+ */
+Texture *gf3d_texture_load_full(const char *filename,TextureRetention retention);
+
+/**
+ * @brief create a texture based on the provided surface, keeping only the gpu copy
  * @note the filename is not populated by this
- * @param surface the SDL_Surface image data to convert
+ * @param surface the SDL_Surface image data to convert.  It is freed
  * @return NULL on error or a new Texture otherwise
  */
 Texture *gf3d_texture_convert_surface(SDL_Surface * surface);
 
+/**
+ * @brief create a texture based on the provided surface, optionally without mipmaps
+ * @note use mipmaps = 0 for images drawn at their own size that are made often, like rendered text
+ * @param surface the SDL_Surface image data to convert.  It is freed
+ * @param mipmaps if false only the base level is created, regardless of the texture system setting
+ * @param retention whether to keep the converted pixels in tex->surface
+ * @return NULL on error or a new Texture otherwise
+ */
+Texture *gf3d_texture_convert_surface_full(SDL_Surface * surface,Uint8 mipmaps,TextureRetention retention);
+
+/**
+ * @brief upload part of a texture's CPU pixels again, after drawing into tex->surface
+ * @note only for single level RGBA textures, like those made with gf3d_texture_convert_surface_full without
+ * mipmaps and with TR_KeepSurface.  Waits for the graphics queue to idle
+ * @param tex the texture
+ * @param x the left of the region in pixels
+ * @param y the top of the region in pixels
+ * @param w the width of the region
+ * @param h the height of the region
+ */
+void gf3d_texture_update_region(Texture *tex,Uint32 x,Uint32 y,Uint32 w,Uint32 h);
+
+/**
+ * @brief decode an image file, from the pak if it is in one
+ * @param filename the image
+ * @return NULL on error, the surface otherwise.  Free it with SDL_FreeSurface
+ */
+SDL_Surface *gf3d_texture_load_surface(const char *filename);
+
+/**
+ * @brief get the CPU pixels of a texture, loading them from its file if they were freed after upload
+ * @note pixels loaded this way are kept until the texture is deleted
+ * @param tex the texture
+ * @return NULL if the texture has no pixels and no image file to load them from, the surface otherwise
+ */
+SDL_Surface *gf3d_texture_get_surface(Texture *tex);
+
+/**
+ * @brief get how many mip levels a full chain has for an image size
+ * @param width the width of the base level
+ * @param height the height of the base level
+ * @return the level count, including the base level
+ */
+Uint32 gf3d_texture_get_mip_count(Uint32 width,Uint32 height);
+
+/**
+ * @brief make the next mip level of an RGBA32 surface with an alpha weighted box filter
+ * @param src the level to shrink
+ * @return NULL on error, a new surface half the size (at least 1x1) otherwise
+ */
+SDL_Surface *gf3d_texture_mip_downsample(SDL_Surface *src);
+
 /**
 * @brief free a previously loaded texture
  */
@@ -0,0 +1,36 @@
+#ifndef __GF3D_TEXTURE_BAKE_H__
+#define __GF3D_TEXTURE_BAKE_H__
+
+#include "gfc_types.h"
+
+/**
+ * Offline texture baking.
+ * Converts source PNGs to block compressed DDS files with full mip chains, saved next to the source.
+ * Opaque images become BC1, images with alpha BC3 and normal maps (name containing "normal") BC5.
+ * With "compressed_textures" set in the setup config, gf3d_texture_load picks the DDS up in place of the PNG.
+ */
+
+/**
+ * @brief bake every models/ PNG, recursively, and every PNG directly in images/
+ * @note runs without graphics, from the project root.  Files whose DDS is newer than the source are skipped
+ * @return the number of files that failed
+ */
+Uint32 gf3d_texture_bake_all();
+
+/**
+ * @brief bake the PNGs in a directory
+ * @param path the directory
+ * @param recursive if true, subdirectories are baked as well
+ * @return the number of files that failed
+ */
+Uint32 gf3d_texture_bake_directory(const char *path,Uint8 recursive);
+
+/**
+ * @brief bake one image
+ * @param source the image to compress
+ * @param dest where to save the DDS
+ * @return 0 on error, 1 otherwise
+ */
+Uint8 gf3d_texture_bake_file(const char *source,const char *dest);
+
+#endif
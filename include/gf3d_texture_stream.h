@@ -0,0 +1,57 @@
+#ifndef __GF3D_TEXTURE_STREAM_H__
+#define __GF3D_TEXTURE_STREAM_H__
+
+#include "gfc_types.h"
+
+#include "gf3d_texture.h"
+
+/**
+ * Texture streaming.
+ * Streamed textures load their small mip levels first on a loader thread and draw with the mesh default texture
+ * until those arrive.  The draw path reports how many pixels each texture covers and larger levels are loaded as they
+ * are needed, while textures that have not been drawn recently drop back to their small levels, least recently used
+ * first, to keep the streamed textures under the configured budget.
+ */
+
+/**
+ * @brief start the streamer
+ * @param maxTextures how many streamed textures can be loaded at once
+ * @param config the setup config.  In "setup", "texture_budget_mb" is the device memory streamed textures may use.
+ * 0 turns streaming off and gf3d_texture_load_streaming loads textures whole
+ */
+void gf3d_texture_stream_init(Uint32 maxTextures,const char *config);
+
+/**
+ * @brief load a texture that is streamed in
+ * @note the texture has no image until its first levels are uploaded, width, height and mipLevels are 0 until then
+ * @param filename the image to load, the same files as gf3d_texture_load
+ * @return NULL on error, the texture otherwise.  Free with gf3d_texture_free
+ */
+Texture *gf3d_texture_load_streaming(const char *filename);
+
+/**
+ * @brief report that a texture is being drawn this frame
+ * @param tex the texture, ignored if it is not streamed
+ * @param pixels roughly how many pixels across the texture covers on screen
+ */
+void gf3d_texture_stream_touch(Texture *tex,float pixels);
+
+/**
+ * @brief upload finished loads, evict what is over budget and request the levels the last frame asked for
+ * @note call once per frame, before any draws are queued.  Uploads wait for the queue to idle
+ */
+void gf3d_texture_stream_update();
+
+/**
+ * @brief get how much device memory streamed textures hold
+ * @return the resident bytes as of the last update
+ */
+VkDeviceSize gf3d_texture_stream_get_resident();
+
+/**
+ * @brief get the streaming budget
+ * @return the budget in bytes, 0 if streaming is off
+ */
+VkDeviceSize gf3d_texture_stream_get_budget();
+
+#endif
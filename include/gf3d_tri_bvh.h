@@ -0,0 +1,69 @@
+#ifndef __GF3D_TRI_BVH_H__
+#define __GF3D_TRI_BVH_H__
+
+#include "gfc_types.h"
+#include "gfc_vector.h"
+
+#include "gf3d_mesh.h"
+
+/**
+ * @brief a node of a triangle bvh.  Children of a branch are stored at index + 1 and at start
+ */
+typedef struct
+{
+    float       min[3];
+    float       max[3];
+    Uint32      start;      /**<first triangle for leaves, second child for branches*/
+    Uint16      count;      /**<triangle count for leaves, 0 for branches*/
+    Uint16      axis;       /**<split axis for branches, used to visit the nearer child first*/
+}TriBVHNode;
+
+/**
+ * @brief a static bounding volume hierarchy over a triangle list, built once in model space
+ */
+typedef struct
+{
+    TriBVHNode     *nodes;
+    Uint32          nodeCount;
+    GFC_Vector3D   *triangles;      /**<three corners per triangle, in leaf order*/
+    Uint32         *faces;          /**<the source face index of each triangle, in leaf order*/
+    Uint32          triangleCount;
+}TriBVH;
+
+/**
+ * @brief build a bvh over indexed triangles
+ * @param vertices the vertex list the faces index into
+ * @param faces the triangle list
+ * @param faceCount how many faces there are
+ * @return NULL on error or a new bvh.  Free with gf3d_tri_bvh_free
+ */
+TriBVH *gf3d_tri_bvh_build(const Vertex *vertices,const Face *faces,Uint32 faceCount);
+
+/**
+ * @brief free a bvh built with gf3d_tri_bvh_build
+ * @param bvh the bvh to free
+ */
+void gf3d_tri_bvh_free(TriBVH *bvh);
+
+/**
+ * @brief find the closest triangle hit by a line segment
+ * @param bvh the bvh to search
+ * @param start the start of the segment, in the same space as the bvh
+ * @param end the end of the segment
+ * @param fraction [optional output] how far along the segment [0,1] the hit is
+ * @param contact [optional output] the point of the hit
+ * @param face [optional output] the index of the face that was hit
+ * @return 1 if anything was hit, 0 otherwise
+ */
+Uint8 gf3d_tri_bvh_ray_closest(TriBVH *bvh,GFC_Vector3D start,GFC_Vector3D end,float *fraction,GFC_Vector3D *contact,Uint32 *face);
+
+/**
+ * @brief check if a line segment hits any triangle.  Faster than gf3d_tri_bvh_ray_closest, stops at the first hit
+ * @param bvh the bvh to search
+ * @param start the start of the segment, in the same space as the bvh
+ * @param end the end of the segment
+ * @return 1 if anything was hit, 0 otherwise
+ */
+Uint8 gf3d_tri_bvh_ray_any(TriBVH *bvh,GFC_Vector3D start,GFC_Vector3D end);
+
+#endif
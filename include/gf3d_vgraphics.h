@@ -26,6 +26,19 @@ typedef struct
  */
 void gf3d_vgraphics_init(const char* config);
 
+/**
+ * @brief render offscreen with no window, for machines with no display such as build agents
+ * @note must be called before gf3d_vgraphics_init.  The "headless" key in the config setup also turns this on
+ * @param headless true to render offscreen, false to open a window
+ */
+void gf3d_vgraphics_set_headless(Bool headless);
+
+/**
+ * @brief check if rendering is offscreen
+ * @return true if headless, false if rendering to a window
+ */
+Bool gf3d_vgraphics_is_headless();
+
 /**
  * @brief kick off a rendering call for the next buffer frame.
  */
@@ -36,6 +49,21 @@ void gf3d_vgraphics_render_start();
  */
 void gf3d_vgraphics_render_end();
 
+/**
+ * @brief copy the last rendered frame back to system memory
+ * @note headless only.  Call after gf3d_vgraphics_render_end(), this waits for the GPU
+ * @return NULL on error, or a new surface with the frame.  Free with SDL_FreeSurface
+ */
+SDL_Surface *gf3d_vgraphics_read_back_frame();
+
+/**
+ * @brief read back the last rendered frame and save it as a bitmap
+ * @note headless only.  Call after gf3d_vgraphics_render_end()
+ * @param filename where to save the bitmap
+ * @return 1 on success, 0 on error
+ */
+int gf3d_vgraphics_save_frame(const char *filename);
+
 /**
  * @brief get the buffer frame for the current rendering context
  * @note: THIS SHOULD ONLY BE CALLED BETWEEN CALLS TO gf3d_vgraphics_render_start() and gf3d_vgraphics_render_end()
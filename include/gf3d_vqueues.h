@@ -17,7 +17,7 @@ typedef enum
 /**
  * @brief initialize the vulkan queues
  * @param device the device to use for setup
- * @param surface the vulkan surface to check for compatibility
+ * @param surface the vulkan surface to check for compatibility, VK_NULL_HANDLE when rendering offscreen
  */
 void gf3d_vqueues_init(VkPhysicalDevice device,VkSurfaceKHR surface);
 
@@ -52,6 +52,18 @@ Sint32 gf3d_vqueues_get_graphics_queue_family();
  */
 Sint32 gf3d_vqueues_get_transfer_queue_family();
 
+/**
+ * @brief get how many bits of a timestamp written on the graphics queue are valid
+ * @return 0 if the graphics queue does not support timestamps
+ */
+Uint32 gf3d_vqueues_get_graphics_timestamp_bits();
+
+/**
+ * @brief check if compute dispatches can be recorded alongside the graphics commands
+ * @return true if the graphics queue family also supports compute
+ */
+Bool gf3d_vqueues_graphics_supports_compute();
+
 /**
  * @brief get the queue to be used for graphics calls
  * @returns the queue in question
@@ -7,15 +7,17 @@
 #include "gfc_list.h"
 #include "gf3d_mesh.h"
 #include "gf3d_texture.h"
+#include "entity.h"
 
-typedef struct World_S
+// the World typedef comes from entity.h, which needs it for floor queries
+struct World_S
 {
 	Mesh* terrain;
 	Texture* texture;
 	GFC_List* entities;
 	GFC_Color lightcolor;
 	GFC_Vector3D lightpos;
-} World;
+};
 
 /**
  * @brief create a new world
@@ -36,6 +38,16 @@ World* world_load(const char* filename);
  */
 void world_free(World* world);
 
+/**
+ * @brief test a line segment against the world terrain
+ * @param world the world to test
+ * @param start the start of the segment
+ * @param end the end of the segment
+ * @param contact [optional output] the hit closest to start.  Without it the test stops at the first hit
+ * @return 1 if the segment hits the terrain, 0 otherwise
+ */
+Uint8 world_edge_test(World* world, GFC_Vector3D start, GFC_Vector3D end, GFC_Vector3D* contact);
+
 /**
  * @brief draw a world with all its entities
  * @param world the world to draw
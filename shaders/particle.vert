@@ -0,0 +1,37 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0) uniform UniformBufferObject
+{
+    mat4    view;
+    mat4    proj;
+    vec4    uvRect;
+} ubo;
+
+out gl_PerVertex
+{
+    vec4 gl_Position;
+};
+
+// per instance
+layout(location = 0) in vec4 inPositionSize;
+layout(location = 1) in vec4 inColor;
+
+layout(location = 0) out vec2 fragTexCoord;
+layout(location = 1) out vec4 fragColor;
+
+// two triangles, made from the vertex index so no vertex or index buffer is needed
+const vec2 corners[6] = vec2[](
+    vec2(-1,-1),vec2(1,-1),vec2(-1,1),
+    vec2(-1,1),vec2(1,-1),vec2(1,1));
+
+void main()
+{
+    vec2 corner = corners[gl_VertexIndex];
+    // offset in view space, so the quad always faces the camera
+    vec4 viewPosition = ubo.view * vec4(inPositionSize.xyz,1);
+    viewPosition.xy += corner * inPositionSize.w * 0.5;
+    gl_Position = ubo.proj * viewPosition;
+    fragTexCoord = ubo.uvRect.xy + vec2(corner.x * 0.5 + 0.5,0.5 - corner.y * 0.5) * ubo.uvRect.zw;
+    fragColor = inColor;
+}
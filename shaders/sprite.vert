@@ -23,6 +23,7 @@ out gl_PerVertex
 
 layout(location = 0) in vec2 inPosition;
 layout(location = 1) in vec2 inTexCoord;
+layout(location = 2) in vec4 inColor;
 
 layout(location = 0) out vec2 fragTexCoord;
 layout(location = 1) out vec4 colorMod;
@@ -39,35 +40,12 @@ void main()
     fragTexCoord = inTexCoord + ubo.frame_offset;
     vec4 clip_position = vec4(inPosition,0,1);
     
-    switch (gl_VertexIndex)
-    {
-        case 0:
-            clip_position = vec4(inPosition.x + ubo.clip.x*2,inPosition.y + ubo.clip.y*2,0,1);
-            fragTexCoord.x = fragTexCoord.x + ubo.clip.x/ubo.size.x;
-            fragTexCoord.y = fragTexCoord.y + ubo.clip.y/ubo.size.y;
-        break;
-        case 1:
-            clip_position = vec4(inPosition.x - ubo.clip.z*2,inPosition.y + ubo.clip.y*2,0,1);
-            fragTexCoord.x = fragTexCoord.x - ubo.clip.z/ubo.size.x;
-            fragTexCoord.y = fragTexCoord.y + ubo.clip.y/ubo.size.y;
-        break;
-        case 2:
-            clip_position = vec4(inPosition.x + ubo.clip.x*2,inPosition.y - ubo.clip.w*2,0,1);
-            fragTexCoord.x = fragTexCoord.x + ubo.clip.x/ubo.size.x;
-            fragTexCoord.y = fragTexCoord.y - ubo.clip.w/ubo.size.y;
-        break;
-        case 3:
-            clip_position = vec4(inPosition.x - ubo.clip.z*2,inPosition.y - ubo.clip.w*2,0,1);
-            fragTexCoord.x = fragTexCoord.x - ubo.clip.z/ubo.size.x;
-            fragTexCoord.y = fragTexCoord.y - ubo.clip.w/ubo.size.y;
-        break;
-    }
     center = ubo.center*2;
     clip_position.xy = clip_position.xy - center;
     vec4 r_position = scale_m * ubo.rotation * clip_position;
     r_position.xy = r_position.xy + center;
     vec4 drawOffset = vec4((ubo.position * 2)/ubo.extent,0,0);
     gl_Position = vec4(r_position.xy/ubo.extent,0,1) - vec4(1,1,0,0) + drawOffset;
-    colorMod = ubo.colorMod;
+    colorMod = ubo.colorMod * inColor;
     drawOrder = ubo.drawOrder;
 }
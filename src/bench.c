@@ -0,0 +1,633 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <SDL.h>
+
+#include "simple_json.h"
+#include "simple_logger.h"
+
+#include "gfc_types.h"
+#include "gfc_input.h"
+#include "gfc_pak.h"
+
+#include "gf2d_sprite.h"
+#include "gf2d_font.h"
+
+#include "gf3d_vgraphics.h"
+#include "gf3d_pipeline.h"
+#include "gf3d_camera.h"
+#include "gf3d_mesh.h"
+#include "gf3d_particle.h"
+#include "gf3d_particle_gpu.h"
+#include "gf3d_texture.h"
+#include "gf3d_texture_stream.h"
+#include "gf3d_clock.h"
+#include "gf3d_jobs.h"
+#include "gf3d_profiler.h"
+#include "gf3d_gpu_timer.h"
+#include "gf3d_render_stats.h"
+#include "gf3d_memory.h"
+
+#include "entity.h"
+#include "monster.h"
+#include "bench.h"
+
+#define BENCH_DEFAULT_FRAMES 600
+#define BENCH_DEFAULT_WARMUP 30
+#define BENCH_DINO_SPACING 8.0f
+#define BENCH_ENTITY_SPARE 16   // room for anything else that spawns entities
+
+typedef enum {
+    BS_Dinos,
+    BS_Text,
+    BS_Sprites,
+    BS_MeshLoad,
+    BS_Particles,
+    BS_GpuParticles,
+    BS_MAX
+} BenchSceneType;
+
+static const char* bench_scene_type_names[BS_MAX] = { "dinos", "text", "sprites", "mesh_load", "particles", "gpu_particles" };
+
+typedef enum {
+    BP_Think,
+    BP_Update,
+    BP_Cull,
+    BP_UI,
+    BP_Load,
+    BP_Particles,
+    BP_Ubo,
+    BP_Record,
+    BP_Submit,
+    BP_MAX
+} BenchPhase;
+
+static const char* bench_phase_names[BP_MAX] = { "think", "update", "cull", "ui", "load", "particles", "ubo", "record", "submit" };
+
+typedef struct {
+    GFC_TextLine name;
+    BenchSceneType type;
+    Uint32 count;
+    Uint32 frames;
+    Uint32 warmup;
+    const char* mesh;
+    const char* texture;
+    const char* sprite;
+} BenchScene;
+
+typedef struct {
+    const char* name;
+    Uint64 drawCalls;
+    Uint64 instances;
+    Uint64 triangles;
+} BenchPipeline;
+
+typedef struct {
+    double* frameTimes;         // seconds, one per measured frame
+    double phases[BP_MAX];      // seconds, summed over measured frames
+    double gpuTime;             // milliseconds, summed over measured frames, lags the cpu by a few frames
+    Uint64 renderStats[RS_MAX]; // summed over measured frames
+    Uint32 maxRenderStats[RS_MAX];
+    BenchPipeline pipes[GF3D_RENDER_STATS_MAX_PIPELINES]; // summed over measured frames
+    Uint32 pipeCount;
+    Uint64 drawCalls;
+    Uint32 maxDrawCalls;
+    Uint64 visible;
+    Uint64 culled;
+    Uint32 rssKb;
+    Uint32 peakRssKb;
+    MemoryStats memoryStart[MD_MAX][MT_MAX + 1]; // before setup
+    MemoryStats memoryEnd[MD_MAX][MT_MAX + 1];   // after cleanup, growth here is a leak
+} BenchResult;
+
+typedef struct {
+    Monster** monsters;
+    Uint32 monsterCount;
+    Sprite* sprite;
+    ParticleEmitter* emitter;
+    GpuParticleEmitter* gpuEmitter;
+} BenchSceneState;
+
+static double bench_frequency = 1;
+
+static double bench_now() {
+    return SDL_GetPerformanceCounter() / bench_frequency;
+}
+
+static int bench_compare_double(const void* a, const void* b) {
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+    if (da < db) return -1;
+    if (da > db) return 1;
+    return 0;
+}
+
+/**
+ * nearest rank percentile of an already sorted list
+ */
+static double bench_percentile(double* sorted, Uint32 count, double p) {
+    Uint32 rank;
+    if (!count) return 0;
+    rank = (Uint32)ceil(p * count);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return sorted[rank - 1];
+}
+
+static void bench_get_memory(Uint32* rssKb, Uint32* peakKb) {
+#ifdef __linux__
+    FILE* file;
+    char line[256];
+    file = fopen("/proc/self/status", "r");
+    if (!file) return;
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, "VmRSS:", 6) == 0) sscanf(line + 6, "%u", rssKb);
+        else if (strncmp(line, "VmHWM:", 6) == 0) sscanf(line + 6, "%u", peakKb);
+    }
+    fclose(file);
+#else
+    // no portable way to ask, report zero rather than guess
+    *rssKb = 0;
+    *peakKb = 0;
+#endif
+}
+
+static int bench_scene_parse(SJson* json, BenchScene* scene, Uint32 frames, Uint32 warmup) {
+    const char* str;
+    int i;
+    if ((!json) || (!scene)) return 0;
+    memset(scene, 0, sizeof(BenchScene));
+    str = sj_object_get_value_as_string(json, "type");
+    if (!str) {
+        slog("bench scene missing type");
+        return 0;
+    }
+    for (i = 0; i < BS_MAX; i++) {
+        if (strcmp(str, bench_scene_type_names[i]) == 0) break;
+    }
+    if (i == BS_MAX) {
+        slog("unknown bench scene type %s", str);
+        return 0;
+    }
+    scene->type = i;
+    str = sj_object_get_value_as_string(json, "name");
+    gfc_line_cpy(scene->name, str ? str : bench_scene_type_names[i]);
+    scene->count = 1;
+    scene->frames = frames;
+    scene->warmup = warmup;
+    sj_object_get_value_as_Uint32(json, "count", &scene->count);
+    sj_object_get_value_as_Uint32(json, "frames", &scene->frames);
+    sj_object_get_value_as_Uint32(json, "warmup_frames", &scene->warmup);
+    scene->mesh = sj_object_get_value_as_string(json, "mesh");
+    scene->texture = sj_object_get_value_as_string(json, "texture");
+    scene->sprite = sj_object_get_value_as_string(json, "sprite");
+    if (!scene->mesh) scene->mesh = "models/dino/dino.obj";
+    if (!scene->sprite) scene->sprite = "images/flare.png";
+    if (!scene->frames) {
+        slog("bench scene %s has no frames to run", scene->name);
+        return 0;
+    }
+    return 1;
+}
+
+static void bench_scene_setup(BenchScene* scene, BenchSceneState* state) {
+    Uint32 i, side;
+    float half;
+    Mesh* mesh;
+    Texture* texture;
+    GFC_Vector3D cameraPosition;
+
+    memset(state, 0, sizeof(BenchSceneState));
+    switch (scene->type) {
+        case BS_Dinos:
+            state->monsters = gf3d_memory_alloc_array(MT_General,sizeof(Monster*), scene->count);
+            if (!state->monsters) return;
+            side = (Uint32)ceil(sqrt(scene->count));
+            half = side * BENCH_DINO_SPACING * 0.5f;
+            for (i = 0; i < scene->count; i++) {
+                // every monster holds its own reference, entity_free releases it
+                mesh = gf3d_mesh_load(scene->mesh);
+                texture = scene->texture ? gf3d_texture_load_streaming(scene->texture) : NULL;
+                state->monsters[i] = monster_new(mesh, texture, gfc_vector3d(
+                    (i % side) * BENCH_DINO_SPACING - half,
+                    (i / side) * BENCH_DINO_SPACING - half,
+                    0));
+                if (!state->monsters[i]) {
+                    gf3d_mesh_free(mesh);
+                    gf3d_texture_free(texture);
+                    break;
+                }
+                state->monsterCount++;
+            }
+            cameraPosition = gfc_vector3d(0, -(half * 2 + 30), half + 20);
+            gf3d_camera_look_at(gfc_vector3d(0, 0, 0), &cameraPosition);
+            break;
+        case BS_Sprites:
+            state->sprite = gf2d_sprite_load_image(scene->sprite);
+            if (!state->sprite) slog("bench failed to load sprite %s", scene->sprite);
+            break;
+        case BS_Particles:
+            state->emitter = gf3d_particle_emitter_new(scene->count);
+            if (!state->emitter) break;
+            // a fountain that starts full and stays full, spawning as many each second as die
+            state->emitter->lifetime = 2;
+            state->emitter->lifetimeVariance = 0.5f;
+            state->emitter->rate = scene->count / state->emitter->lifetime;
+            state->emitter->spawnRadius = 1;
+            state->emitter->velocity = gfc_vector3d(0, 0, 12);
+            state->emitter->velocityVariance = gfc_vector3d(4, 4, 3);
+            state->emitter->acceleration = gfc_vector3d(0, 0, -9.8f);
+            state->emitter->drag = 0.2f;
+            state->emitter->color = gfc_color(1, 0.8f, 0.3f, 1);
+            state->emitter->color2 = gfc_color(1, 0.1f, 0, 0);
+            state->emitter->size = 0.3f;
+            state->emitter->size2 = 0.1f;
+            gf3d_particle_emitter_burst(state->emitter, scene->count);
+            cameraPosition = gfc_vector3d(0, -40, 10);
+            gf3d_camera_look_at(gfc_vector3d(0, 0, 6), &cameraPosition);
+            break;
+        case BS_GpuParticles:
+            state->gpuEmitter = gf3d_particle_gpu_emitter_new(scene->count);
+            if (!state->gpuEmitter) break;
+            // the same fountain as the cpu scene, simulated by the compute passes
+            state->gpuEmitter->lifetime = 2;
+            state->gpuEmitter->lifetimeVariance = 0.5f;
+            state->gpuEmitter->rate = scene->count / state->gpuEmitter->lifetime;
+            state->gpuEmitter->spawnRadius = 1;
+            state->gpuEmitter->velocity = gfc_vector3d(0, 0, 12);
+            state->gpuEmitter->velocityVariance = gfc_vector3d(4, 4, 3);
+            state->gpuEmitter->acceleration = gfc_vector3d(0, 0, -9.8f);
+            state->gpuEmitter->drag = 0.2f;
+            state->gpuEmitter->color = gfc_color(1, 0.8f, 0.3f, 1);
+            state->gpuEmitter->color2 = gfc_color(1, 0.1f, 0, 0);
+            state->gpuEmitter->size = 0.3f;
+            state->gpuEmitter->size2 = 0.1f;
+            gf3d_particle_gpu_emitter_burst(state->gpuEmitter, scene->count);
+            cameraPosition = gfc_vector3d(0, -40, 10);
+            gf3d_camera_look_at(gfc_vector3d(0, 0, 6), &cameraPosition);
+            break;
+        default:
+            break;
+    }
+}
+
+static void bench_scene_cleanup(BenchSceneState* state) {
+    Uint32 i;
+    if (state->monsters) {
+        for (i = 0; i < state->monsterCount; i++) {
+            monster_free(state->monsters[i]);
+        }
+        gf3d_memory_free(state->monsters);
+    }
+    gf2d_sprite_free(state->sprite);
+    gf3d_particle_emitter_free(state->emitter);
+    gf3d_particle_gpu_emitter_free(state->gpuEmitter);
+    memset(state, 0, sizeof(BenchSceneState));
+}
+
+static void bench_scene_load(BenchScene* scene) {
+    Uint32 i;
+    Mesh* mesh;
+    if (scene->type != BS_MeshLoad) return;
+    // nothing else holds the mesh, so each load goes all the way to the file
+    for (i = 0; i < scene->count; i++) {
+        mesh = gf3d_mesh_load(scene->mesh);
+        gf3d_mesh_free(mesh);
+    }
+}
+
+static void bench_scene_draw_2d(BenchScene* scene, BenchSceneState* state, Uint32 frame) {
+    Uint32 i, rows;
+    float x, y, t;
+    GFC_Vector2D res;
+    GFC_TextLine text;
+
+    res = gf3d_vgraphics_get_resolution();
+    switch (scene->type) {
+        case BS_Text:
+            rows = (Uint32)(res.y / 20);
+            if (!rows) rows = 1;
+            for (i = 0; i < scene->count; i++) {
+                // half the lines never change, half change every frame
+                if (i % 2) gfc_line_sprintf(text, "line %u: frame %u score %u", i, frame, (frame * 37 + i) % 10000);
+                else gfc_line_sprintf(text, "line %u: the quick brown fox", i);
+                gf2d_font_draw_line_tag(text, FT_Small, GFC_COLOR_WHITE, gfc_vector2d((i / rows) * 320 + 10, (i % rows) * 20));
+            }
+            break;
+        case BS_Sprites:
+            if (!state->sprite) break;
+            t = gf3d_clock_get_sim_time();
+            for (i = 0; i < scene->count; i++) {
+                // fixed pseudo random start and speed per sprite, wrapping around the screen
+                x = fmod((i * 7919) % 1000 / 1000.0f * res.x + t * (20 + (i * 104729) % 200), res.x);
+                y = fmod((i * 6271) % 1000 / 1000.0f * res.y + t * (20 + (i * 130363) % 200), res.y);
+                gf2d_sprite_draw_image(state->sprite, gfc_vector2d(x, y));
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void bench_get_memory_stats(MemoryStats stats[MD_MAX][MT_MAX + 1]) {
+    Uint32 i, j;
+    for (i = 0; i < MD_MAX; i++) {
+        for (j = 0; j <= MT_MAX; j++) stats[i][j] = gf3d_memory_get_stats(i, j);
+    }
+}
+
+static SJson* bench_memory_to_json(BenchResult* result) {
+    Uint32 i, j;
+    SJson* tags, * tag, * heaps, * heap;
+    MemoryHeapBudget budget;
+    static const char* domains[MD_MAX] = { "cpu", "gpu" };
+    GFC_TextLine key;
+
+    tags = sj_object_new();
+    for (i = 0; i <= MT_MAX; i++) {
+        if ((!result->memoryEnd[MD_Cpu][i].allocCount) && (!result->memoryEnd[MD_Gpu][i].allocCount)) continue;
+        tag = sj_object_new();
+        for (j = 0; j < MD_MAX; j++) {
+            gfc_line_sprintf(key, "%s_bytes", domains[j]);
+            sj_object_insert(tag, key, sj_new_float(result->memoryEnd[j][i].liveBytes));
+            gfc_line_sprintf(key, "%s_peak_bytes", domains[j]);
+            sj_object_insert(tag, key, sj_new_float(result->memoryEnd[j][i].peakBytes));
+            gfc_line_sprintf(key, "%s_growth_bytes", domains[j]);
+            sj_object_insert(tag, key, sj_new_float((double)result->memoryEnd[j][i].liveBytes - (double)result->memoryStart[j][i].liveBytes));
+        }
+        sj_object_insert(tags, i < MT_MAX ? gf3d_memory_get_tag_name(i) : "total", tag);
+    }
+    heaps = sj_array_new();
+    for (i = 0; i < gf3d_memory_get_heap_count(); i++) {
+        if (!gf3d_memory_get_heap_budget(i, &budget)) continue;
+        heap = sj_object_new();
+        sj_object_insert(heap, "size", sj_new_float(budget.size));
+        sj_object_insert(heap, "usage", sj_new_float(budget.usage));
+        sj_object_insert(heap, "budget", sj_new_float(budget.budget));
+        sj_object_insert(heap, "device_local", sj_new_bool(budget.deviceLocal));
+        sj_object_insert(heap, "reported", sj_new_bool(budget.reported));
+        sj_array_append(heaps, heap);
+    }
+    tag = sj_object_new();
+    sj_object_insert(tag, "subsystems", tags);
+    sj_object_insert(tag, "heaps", heaps);
+    return tag;
+}
+
+static void bench_add_render_stats(BenchResult* result) {
+    Uint32 i, j, value;
+    const RenderStatsPipeline* pipe;
+    for (i = 0; i < RS_MAX; i++) {
+        value = gf3d_render_stats_get(i);
+        result->renderStats[i] += value;
+        if (value > result->maxRenderStats[i]) result->maxRenderStats[i] = value;
+    }
+    for (i = 0; i < gf3d_render_stats_get_pipeline_count(); i++) {
+        pipe = gf3d_render_stats_get_pipeline(i);
+        for (j = 0; j < result->pipeCount; j++) {
+            if (result->pipes[j].name == pipe->name) break;
+        }
+        if (j == result->pipeCount) {
+            if (result->pipeCount >= GF3D_RENDER_STATS_MAX_PIPELINES) continue;
+            result->pipes[result->pipeCount++].name = pipe->name;
+        }
+        result->pipes[j].drawCalls += pipe->drawCalls;
+        result->pipes[j].instances += pipe->instances;
+        result->pipes[j].triangles += pipe->triangles;
+    }
+}
+
+static void bench_scene_run(BenchScene* scene, BenchResult* result, Uint32 seed) {
+    Uint32 frame, measured, steps, step, visible, culled, i;
+    double frameStart, mark, phases[BP_MAX];
+    PipelineFrameStats stats;
+    BenchSceneState state;
+
+    srand(seed);
+    bench_get_memory_stats(result->memoryStart);
+    bench_scene_setup(scene, &state);
+    slog("bench scene %s: %u %s, %u frames", scene->name, scene->count, bench_scene_type_names[scene->type], scene->frames);
+    slog_sync();
+
+    for (frame = 0, measured = 0; frame < scene->warmup + scene->frames; frame++) {
+        memset(phases, 0, sizeof(phases));
+        gf3d_profiler_frame_begin();
+        frameStart = bench_now();
+        gfc_input_update();
+        gf2d_font_update();
+
+        steps = gf3d_clock_begin_frame();
+        for (step = 0; step < steps; step++) {
+            entity_system_begin_step();
+            mark = bench_now();
+            entity_system_think_all();
+            phases[BP_Think] += bench_now() - mark;
+            mark = bench_now();
+            entity_system_update_all();
+            phases[BP_Update] += bench_now() - mark;
+            mark = bench_now();
+            gf3d_particle_emitters_update(gf3d_clock_get_step());
+            gf3d_particle_gpu_emitters_update(gf3d_clock_get_step());
+            phases[BP_Particles] += bench_now() - mark;
+            gf3d_clock_step();
+        }
+
+        mark = bench_now();
+        GF3D_PROFILE_BEGIN("bench_load");
+        bench_scene_load(scene);
+        GF3D_PROFILE_END();
+        phases[BP_Load] = bench_now() - mark;
+
+        entity_system_set_interpolation(gf3d_clock_get_alpha());
+        gf3d_camera_update_view();
+        gf3d_vgraphics_render_start();
+
+        mark = bench_now();
+        entity_system_draw_all(gfc_vector3d(8, 15, 12), GFC_COLOR_WHITE);
+        phases[BP_Cull] = bench_now() - mark;
+
+        mark = bench_now();
+        gf3d_particle_emitters_draw();
+        gf3d_particle_gpu_emitters_draw();
+        phases[BP_Particles] += bench_now() - mark;
+
+        mark = bench_now();
+        bench_scene_draw_2d(scene, &state, frame);
+        phases[BP_UI] = bench_now() - mark;
+
+        gf3d_vgraphics_render_end();
+        gf3d_clock_end_frame();
+
+        if (frame < scene->warmup) continue;
+        gf3d_pipeline_get_frame_stats(&stats);
+        phases[BP_Ubo] = stats.uboTime;
+        phases[BP_Record] = stats.recordTime;
+        phases[BP_Submit] = stats.submitTime;
+        for (i = 0; i < BP_MAX; i++) {
+            result->phases[i] += phases[i];
+        }
+        entity_system_get_cull_stats(&visible, &culled);
+        result->visible += visible;
+        result->culled += culled;
+        result->drawCalls += stats.drawCalls;
+        result->gpuTime += gf3d_gpu_timer_get_frame_time();
+        bench_add_render_stats(result);
+        if (stats.drawCalls > result->maxDrawCalls) result->maxDrawCalls = stats.drawCalls;
+        result->frameTimes[measured++] = bench_now() - frameStart;
+    }
+    bench_get_memory(&result->rssKb, &result->peakRssKb);
+    bench_scene_cleanup(&state);
+    bench_get_memory_stats(result->memoryEnd);
+}
+
+static SJson* bench_result_to_json(BenchScene* scene, BenchResult* result) {
+    int i;
+    double sum = 0;
+    double frames = scene->frames;
+    SJson* json, * frameTime, * phases, * memory, * stats, * maxStats, * pipes, * pipe;
+
+    for (i = 0; i < scene->frames; i++) sum += result->frameTimes[i];
+    qsort(result->frameTimes, scene->frames, sizeof(double), bench_compare_double);
+
+    frameTime = sj_object_new();
+    sj_object_insert(frameTime, "mean", sj_new_float(sum / frames * 1000.0));
+    sj_object_insert(frameTime, "p50", sj_new_float(bench_percentile(result->frameTimes, scene->frames, 0.50) * 1000.0));
+    sj_object_insert(frameTime, "p95", sj_new_float(bench_percentile(result->frameTimes, scene->frames, 0.95) * 1000.0));
+    sj_object_insert(frameTime, "p99", sj_new_float(bench_percentile(result->frameTimes, scene->frames, 0.99) * 1000.0));
+    sj_object_insert(frameTime, "min", sj_new_float(result->frameTimes[0] * 1000.0));
+    sj_object_insert(frameTime, "max", sj_new_float(result->frameTimes[scene->frames - 1] * 1000.0));
+
+    phases = sj_object_new();
+    for (i = 0; i < BP_MAX; i++) {
+        sj_object_insert(phases, bench_phase_names[i], sj_new_float(result->phases[i] / frames * 1000.0));
+    }
+
+    // per frame means, plus the worst frame so budget blowouts do not average away
+    stats = sj_object_new();
+    maxStats = sj_object_new();
+    for (i = 0; i < RS_MAX; i++) {
+        sj_object_insert(stats, gf3d_render_stats_get_name(i), sj_new_float(result->renderStats[i] / frames));
+        sj_object_insert(maxStats, gf3d_render_stats_get_name(i), sj_new_uint32(result->maxRenderStats[i]));
+    }
+    pipes = sj_object_new();
+    for (i = 0; i < result->pipeCount; i++) {
+        pipe = sj_object_new();
+        sj_object_insert(pipe, "draw_calls", sj_new_float(result->pipes[i].drawCalls / frames));
+        sj_object_insert(pipe, "instances", sj_new_float(result->pipes[i].instances / frames));
+        sj_object_insert(pipe, "triangles", sj_new_float(result->pipes[i].triangles / frames));
+        sj_object_insert(pipes, result->pipes[i].name ? result->pipes[i].name : "pipeline", pipe);
+    }
+
+    memory = sj_object_new();
+    sj_object_insert(memory, "rss_kb", sj_new_uint32(result->rssKb));
+    sj_object_insert(memory, "peak_rss_kb", sj_new_uint32(result->peakRssKb));
+    sj_object_insert(memory, "tracked", bench_memory_to_json(result));
+
+    json = sj_object_new();
+    sj_object_insert(json, "name", sj_new_str(scene->name));
+    sj_object_insert(json, "type", sj_new_str(bench_scene_type_names[scene->type]));
+    sj_object_insert(json, "count", sj_new_uint32(scene->count));
+    sj_object_insert(json, "frames", sj_new_uint32(scene->frames));
+    sj_object_insert(json, "frame_ms", frameTime);
+    sj_object_insert(json, "phase_ms", phases);
+    if (gf3d_gpu_timer_supported()) sj_object_insert(json, "gpu_ms", sj_new_float(result->gpuTime / frames));
+    sj_object_insert(json, "draw_calls", sj_new_float(result->drawCalls / frames));
+    sj_object_insert(json, "max_draw_calls", sj_new_uint32(result->maxDrawCalls));
+    sj_object_insert(json, "visible_entities", sj_new_float(result->visible / frames));
+    sj_object_insert(json, "culled_entities", sj_new_float(result->culled / frames));
+    sj_object_insert(json, "render_stats", stats);
+    sj_object_insert(json, "max_render_stats", maxStats);
+    sj_object_insert(json, "pipelines", pipes);
+    sj_object_insert(json, "memory", memory);
+
+    slog("bench scene %s: mean %.3fms p50 %.3fms p95 %.3fms p99 %.3fms, %.1f draw calls",
+        scene->name,
+        sum / frames * 1000.0,
+        bench_percentile(result->frameTimes, scene->frames, 0.50) * 1000.0,
+        bench_percentile(result->frameTimes, scene->frames, 0.95) * 1000.0,
+        bench_percentile(result->frameTimes, scene->frames, 0.99) * 1000.0,
+        result->drawCalls / frames);
+    return json;
+}
+
+int bench_run(const char* config, const char* report) {
+    SJson* json, * list, * out, * results;
+    BenchScene* scenes;
+    BenchResult result;
+    Uint32 frames = BENCH_DEFAULT_FRAMES;
+    Uint32 warmup = BENCH_DEFAULT_WARMUP;
+    Uint32 seed = 1234;
+    Uint32 maxMonsters = 1;
+    GFC_Vector2D res;
+    int i, count, ok = 1;
+
+    if (!config) return 0;
+    if (!report) report = "bench_report.json";
+    json = gfc_pak_load_json(config);
+    if (!json) {
+        slog("failed to load bench config %s", config);
+        return 0;
+    }
+    sj_object_get_value_as_Uint32(json, "frames", &frames);
+    sj_object_get_value_as_Uint32(json, "warmup_frames", &warmup);
+    sj_object_get_value_as_Uint32(json, "seed", &seed);
+    list = sj_object_get_value(json, "scenes");
+    count = sj_array_get_count(list);
+    if (count <= 0) {
+        slog("bench config %s has no scenes", config);
+        sj_free(json);
+        return 0;
+    }
+    scenes = gf3d_memory_alloc_array(MT_General,sizeof(BenchScene), count);
+    if (!scenes) {
+        sj_free(json);
+        return 0;
+    }
+    for (i = 0; i < count; i++) {
+        if (!bench_scene_parse(sj_array_get_nth(list, i), &scenes[i], frames, warmup)) {
+            gf3d_memory_free(scenes);
+            sj_free(json);
+            return 0;
+        }
+        if ((scenes[i].type == BS_Dinos) && (scenes[i].count > maxMonsters)) maxMonsters = scenes[i].count;
+    }
+
+    bench_frequency = (double)SDL_GetPerformanceFrequency();
+    entity_system_init(maxMonsters + BENCH_ENTITY_SPARE);
+    monster_system_init(maxMonsters);
+    // one simulation step per frame, no pacing, so every run simulates the same thing
+    gf3d_clock_set_lockstep(1);
+
+    results = sj_array_new();
+    for (i = 0; i < count; i++) {
+        memset(&result, 0, sizeof(BenchResult));
+        result.frameTimes = gf3d_memory_alloc_array(MT_General,sizeof(double), scenes[i].frames);
+        if (!result.frameTimes) {
+            ok = 0;
+            break;
+        }
+        bench_scene_run(&scenes[i], &result, seed);
+        sj_array_append(results, bench_result_to_json(&scenes[i], &result));
+        gf3d_memory_free(result.frameTimes);
+    }
+
+    res = gf3d_vgraphics_get_resolution();
+    out = sj_object_new();
+    sj_object_insert(out, "config", sj_new_str(config));
+    sj_object_insert(out, "headless", sj_new_bool(gf3d_vgraphics_is_headless()));
+    sj_object_insert(out, "resolution", sj_vector2d_new(res));
+    sj_object_insert(out, "threads", sj_new_uint32(gf3d_jobs_get_thread_count()));
+    sj_object_insert(out, "seed", sj_new_uint32(seed));
+    sj_object_insert(out, "scenes", results);
+    sj_save(out, report);
+    slog("bench report written to %s", report);
+
+    sj_free(out);
+    gf3d_memory_free(scenes);
+    sj_free(json);
+    return ok;
+}
+
+/*eol@eof*/
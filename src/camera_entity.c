@@ -1,6 +1,7 @@
 #include "simple_logger.h"
 #include "gfc_input.h"
 #include "gf3d_camera.h"
+#include "gf3d_memory.h"
 #include "camera_entity.h"
 #include "entity.h"
 #include "gfc_types.h"
@@ -21,7 +22,7 @@ void camera_entity_free(Entity *self) {
     CameraEntityData *data;
     if ((!self) || (!self->data)) return; 
     data = (CameraEntityData*)self->data;
-    free(data);
+    gf3d_memory_free(data);
     if (g_camera_entity == self) {
         g_camera_entity = NULL;
     }
@@ -60,7 +61,7 @@ Entity* camera_entity_spawn(GFC_Vector3D position, Entity* target) {
     self = entity_new();
     if (!self) return NULL;
     
-    data = (CameraEntityData*)malloc(sizeof(CameraEntityData));
+    data = (CameraEntityData*)gf3d_memory_alloc_array(MT_Entity, sizeof(CameraEntityData), 1);
     if (!data) {
         entity_free(self);
         return NULL;
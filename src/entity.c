@@ -1,19 +1,35 @@
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
 #include "simple_logger.h"
 #include "gfc_types.h"
 #include "gfc_primitives.h"
 #include "gfc_matrix.h"
 #include "gf3d_mesh.h"
+#include "gf3d_frustum.h"
+#include "gf3d_aabb_tree.h"
+#include "gf3d_memory.h"
+#include "gf3d_profiler.h"
+#include "gf3d_render_stats.h"
+#include "world.h"
 #include "entity.h"
 
+#define ENTITY_TREE_MARGIN 0.5   //how far an entity can move before its tree leaf is reinserted
+#define ENTITY_FLOOR_PROBE_UP 1.0       //how far above the entity floor checks start
+#define ENTITY_FLOOR_PROBE_DOWN 1000.0  //how far below the entity floor checks reach
+
 typedef struct
 {
     Entity* entity_list;
     Uint32 entity_max;
+    Uint32 visible;     //drawn by the last draw_all
+    Uint32 culled;      //skipped by the last draw_all
+    Uint32 drawMark;    //incremented each draw_all, entities found in the frustum are stamped with it
+    AABBTree* tree;     //world bounds of every entity with a mesh
+    float alpha;        //interpolation between the previous and current simulation state
 } EntitySystem;
 
-static EntitySystem entity_system = { NULL, 0 };
+static EntitySystem entity_system = { NULL, 0, 0, 0, 0, NULL, 1.0 };
 
 void entity_system_close() {
     int i;
@@ -23,9 +39,11 @@ void entity_system_close() {
                 entity_free(&entity_system.entity_list[i]);
             }
         }
-        free(entity_system.entity_list);
+        gf3d_memory_free(entity_system.entity_list);
         entity_system.entity_list = NULL;
     }
+    gf3d_aabb_tree_free(entity_system.tree);
+    entity_system.tree = NULL;
     entity_system.entity_max = 0;
     slog("entity system closed.");
 }
@@ -38,6 +56,7 @@ Entity* entity_new() {
                 memset(&entity_system.entity_list[i], 0, sizeof(Entity));
                 entity_system.entity_list[i]._inuse = 1;
                 entity_system.entity_list[i].scale = gfc_vector3d(1, 1, 1);
+                entity_system.entity_list[i]._proxy = AABB_TREE_NULL;
                 return &entity_system.entity_list[i];
             }
         }
@@ -48,6 +67,9 @@ Entity* entity_new() {
 void entity_free(Entity* ent) {
     if (!ent) return;
     if (ent->free)ent->free(ent);
+    if (ent->_proxy != AABB_TREE_NULL) {
+        gf3d_aabb_tree_remove(entity_system.tree, ent->_proxy);
+    }
     if (ent->mesh) {
         gf3d_mesh_free(ent->mesh);
     }
@@ -79,16 +101,81 @@ void entity_draw_shadow(Entity *ent){
 }
 
 
-void entity_draw(Entity* ent, GFC_Vector3D lightPos, GFC_Color lightColor) {
+void entity_update_transform(Entity* ent) {
+    float hw, hh, hd;
     if (!ent) return;
-    if (!ent->_inuse) return;
-    
-    GFC_Matrix4 modelMat;
+    if ((ent->_cacheValid) &&
+        (gfc_vector3d_equal(ent->_cachePosition, ent->position)) &&
+        (gfc_vector3d_equal(ent->_cacheRotation, ent->rotation)) &&
+        (gfc_vector3d_equal(ent->_cacheScale, ent->scale)) &&
+        (ent->_cacheMesh == ent->mesh)) return;
     gfc_matrix4_from_vectors(
-        modelMat,
+        ent->matrix,
         ent->position,
         ent->rotation,
         ent->scale);
+    if (ent->mesh) {
+        gf3d_frustum_transform_box(&ent->bounds, ent->mesh->bounds, ent->matrix);
+        hw = ent->bounds.w * 0.5;
+        hh = ent->bounds.h * 0.5;
+        hd = ent->bounds.d * 0.5;
+        ent->radius = sqrtf(hw * hw + hh * hh + hd * hd);
+        if (ent->_proxy == AABB_TREE_NULL) {
+            ent->_proxy = gf3d_aabb_tree_insert(entity_system.tree, ent->bounds, ent);
+        } else {
+            gf3d_aabb_tree_move(entity_system.tree, ent->_proxy, ent->bounds);
+        }
+    } else if (ent->_proxy != AABB_TREE_NULL) {
+        gf3d_aabb_tree_remove(entity_system.tree, ent->_proxy);
+        ent->_proxy = AABB_TREE_NULL;
+    }
+    gfc_vector3d_copy(ent->_cachePosition, ent->position);
+    gfc_vector3d_copy(ent->_cacheRotation, ent->rotation);
+    gfc_vector3d_copy(ent->_cacheScale, ent->scale);
+    ent->_cacheMesh = ent->mesh;
+    ent->_cacheValid = 1;
+}
+
+Uint8 entity_mark_visible(void* data, void* userData) {
+    Entity* ent = (Entity*)data;
+    if (ent) ent->_drawMark = entity_system.drawMark;
+    return 1;
+}
+
+float entity_lerp_angle(float from, float to, float alpha) {
+    float delta = to - from;
+    // rotations are wrapped to [0,2PI), so go the short way around
+    if (delta > GFC_PI) delta -= 2 * GFC_PI;
+    if (delta < -GFC_PI) delta += 2 * GFC_PI;
+    return from + delta * alpha;
+}
+
+void entity_get_render_matrix(Entity* ent, GFC_Matrix4 out) {
+    float a = entity_system.alpha;
+    GFC_Vector3D position, rotation, scale;
+    entity_update_transform(ent);
+    if ((!ent->_prevValid) || (a >= 1)) {
+        gfc_matrix4_copy(out, ent->matrix);
+        return;
+    }
+    position.x = ent->_prevPosition.x + (ent->position.x - ent->_prevPosition.x) * a;
+    position.y = ent->_prevPosition.y + (ent->position.y - ent->_prevPosition.y) * a;
+    position.z = ent->_prevPosition.z + (ent->position.z - ent->_prevPosition.z) * a;
+    rotation.x = entity_lerp_angle(ent->_prevRotation.x, ent->rotation.x, a);
+    rotation.y = entity_lerp_angle(ent->_prevRotation.y, ent->rotation.y, a);
+    rotation.z = entity_lerp_angle(ent->_prevRotation.z, ent->rotation.z, a);
+    scale.x = ent->_prevScale.x + (ent->scale.x - ent->_prevScale.x) * a;
+    scale.y = ent->_prevScale.y + (ent->scale.y - ent->_prevScale.y) * a;
+    scale.z = ent->_prevScale.z + (ent->scale.z - ent->_prevScale.z) * a;
+    gfc_matrix4_from_vectors(out, position, rotation, scale);
+}
+
+void entity_draw(Entity* ent, GFC_Vector3D lightPos, GFC_Color lightColor) {
+    GFC_Matrix4 modelMat;
+    if (!ent) return;
+    if (!ent->_inuse) return;
+    
+    entity_get_render_matrix(ent, modelMat);
     
     gf3d_mesh_draw(
         ent->mesh,
@@ -106,9 +193,14 @@ void entity_draw(Entity* ent, GFC_Vector3D lightPos, GFC_Color lightColor) {
 
 Uint8 entity_get_floor_position(Entity *entity, World *world, GFC_Vector3D *contact){
     GFC_Vector3D up,down;
-    if(!entity)return 0;
-    // TODO: do floor position calculation
-    return 0;
+    if((!entity)||(!world))return 0;
+    // probe from the top of the entity straight down, so ground just under its feet is still found
+    up = entity->position;
+    if (entity->mesh) up.z = entity->bounds.z + entity->bounds.d;
+    up.z += ENTITY_FLOOR_PROBE_UP;
+    down = entity->position;
+    down.z -= ENTITY_FLOOR_PROBE_DOWN;
+    return world_edge_test(world, up, down, contact);
 }
 
 void entity_think(Entity* ent) {
@@ -123,6 +215,7 @@ void entity_update(Entity* ent) {
     if (ent->update) {
         ent->update(ent);
     }
+    entity_update_transform(ent);
 }
 
 void entity_system_init(Uint32 max_ents) {
@@ -130,11 +223,12 @@ void entity_system_init(Uint32 max_ents) {
         slog("cannot init entity system with zero ents");
         return;
     }
-    entity_system.entity_list = gfc_allocate_array(sizeof(Entity), max_ents);
+    entity_system.entity_list = gf3d_memory_alloc_array(MT_Entity, sizeof(Entity), max_ents);
     if (!entity_system.entity_list) {
         slog("failed to allocate %i entities for the system", max_ents);
         return;
     }
+    entity_system.tree = gf3d_aabb_tree_new(max_ents * 2, ENTITY_TREE_MARGIN);
     entity_system.entity_max = max_ents;
     atexit(entity_system_close);
     slog("entity system initialized with %i entities.", max_ents);
@@ -142,11 +236,61 @@ void entity_system_init(Uint32 max_ents) {
 
 void entity_system_draw_all(GFC_Vector3D lightPos, GFC_Color lightColor) {
     int i;
+    Entity* ent;
+    Frustum frustum;
+    GF3D_PROFILE_BEGIN("cull");
+    gf3d_frustum_from_current_view(&frustum);
+    entity_system.visible = 0;
+    entity_system.culled = 0;
+    entity_system.drawMark++;
     for (i = 0; i < entity_system.entity_max; i++) {
-        if (entity_system.entity_list[i]._inuse) {
-            entity_draw(&entity_system.entity_list[i], lightPos, lightColor);
+        if (!entity_system.entity_list[i]._inuse) continue;
+        entity_update_transform(&entity_system.entity_list[i]);
+    }
+    gf3d_aabb_tree_query_frustum(entity_system.tree, &frustum, entity_mark_visible, NULL);
+    GF3D_PROFILE_END();
+    // draw in list order so draw order does not depend on the tree layout
+    for (i = 0; i < entity_system.entity_max; i++) {
+        ent = &entity_system.entity_list[i];
+        if (!ent->_inuse) continue;
+        if ((ent->_proxy != AABB_TREE_NULL) && (ent->_drawMark != entity_system.drawMark)) {
+            entity_system.culled++;
+            continue;
         }
+        entity_system.visible++;
+        entity_draw(ent, lightPos, lightColor);
     }
+    GF3D_PROFILE_COUNTER("visible_entities", entity_system.visible);
+    gf3d_render_stats_add(RS_EntitiesVisible, entity_system.visible);
+    gf3d_render_stats_add(RS_EntitiesCulled, entity_system.culled);
+}
+
+AABBTree* entity_system_get_tree() {
+    return entity_system.tree;
+}
+
+void entity_system_get_cull_stats(Uint32 *visible, Uint32 *culled) {
+    if (visible) *visible = entity_system.visible;
+    if (culled) *culled = entity_system.culled;
+}
+
+void entity_system_begin_step() {
+    int i;
+    Entity* ent;
+    for (i = 0; i < entity_system.entity_max; i++) {
+        ent = &entity_system.entity_list[i];
+        if (!ent->_inuse) continue;
+        gfc_vector3d_copy(ent->_prevPosition, ent->position);
+        gfc_vector3d_copy(ent->_prevRotation, ent->rotation);
+        gfc_vector3d_copy(ent->_prevScale, ent->scale);
+        ent->_prevValid = 1;
+    }
+}
+
+void entity_system_set_interpolation(float alpha) {
+    if (alpha < 0) alpha = 0;
+    if (alpha > 1) alpha = 1;
+    entity_system.alpha = alpha;
 }
 
 void entity_system_think_all() {
@@ -23,20 +23,38 @@
 #include "gf3d_swapchain.h"
 #include "gf3d_camera.h"
 #include "gf3d_mesh.h"
+#include "gf3d_particle.h"
+#include "gf3d_particle_gpu.h"
 #include "gf3d_texture.h"
+#include "gf3d_texture_stream.h"
+#include "gf3d_texture_bake.h"
+#include "gf2d_atlas.h"
+#include "gf3d_clock.h"
+#include "gf3d_profiler.h"
+#include "gf3d_gpu_timer.h"
+#include "gf3d_render_stats.h"
+#include "gf3d_memory.h"
+#include "gf3d_log.h"
 #include "entity.h"
 #include "monster.h"
 #include "camera_entity.h"
+#include "bench.h"
 // #include "world.h"  // not really needed until world map exists
 
 extern int __DEBUG;
 
 static int _done = 0;
-static Uint32 frame_delay = 33;
-static float fps = 0;
+static int frame_limit = 0;             // --frames, 0 runs until exit
+static const char *capture_file = NULL; // --capture, headless only
+static const char *bench_config = NULL; // --bench, runs the benchmark scenes instead of the game
+static const char *bench_report = NULL; // --bench-out
+static int trace_first = 0;             // --trace first:count, captures a range of frames to a chrome trace
+static int trace_count = 0;
+static const char *trace_file = NULL;   // --trace-out
+static int bake_textures = 0;           // --bake-textures, compresses the source images and exits
+static const char *pack_atlas = NULL;   // --pack-atlas, packs the atlases in this config and exits
 
 void parse_arguments(int argc, char* argv[]);
-void game_frame_delay();
 
 void exitGame()
 {
@@ -55,10 +73,25 @@ int main(int argc, char* argv[])
     Monster* dino4;
     Entity* camera_entity;
     GFC_Vector3D lightPos = { 8, 15, 12 };
+    int gpu_overlay = 0;
+    int stats_overlay = 0;
     //initialization    
     parse_arguments(argc, argv);
     init_logger("gf3d.log", 0);
+    gf3d_memory_init(); // first, so its leak report runs after every other system has closed
+    gf3d_log_init(4096); // hot paths log through here so they never wait on the disk
     slog("gf3d begin");
+    if (bake_textures) {
+        // offline tool, needs no window or device
+        Uint32 failed = gf3d_texture_bake_all();
+        slog("gf3d program end");
+        exit(failed ? 1 : 0);
+    }
+    if (pack_atlas) {
+        Uint32 failed = gf2d_atlas_pack_file(pack_atlas);
+        slog("gf3d program end");
+        exit(failed ? 1 : 0);
+    }
     //gfc init
     gfc_input_init("config/input.cfg");
     // Setup controls for entity direction and camera rotation
@@ -70,9 +103,21 @@ int main(int argc, char* argv[])
     gfc_action_init(1024);
     //gf3d init
     gf3d_vgraphics_init("config/setup.cfg");
+    gf3d_clock_init("config/setup.cfg");
+    gf3d_profiler_init("config/setup.cfg");
+    if (trace_file) gf3d_profiler_set_output(trace_file);
+    if (trace_count > 0) gf3d_profiler_capture_range(trace_first, trace_count);
     gf2d_font_init("config/font.cfg");
     gf2d_actor_init(1000);
 
+    if (bench_config) {
+        // scripted benchmark scenes replace the game, they set up their own entities
+        int ok = bench_run(bench_config, bench_report);
+        vkDeviceWaitIdle(gf3d_vgraphics_get_default_logical_device());
+        slog("gf3d program end");
+        exit(ok ? 0 : 1);
+    }
+
     //entity system init
     entity_system_init(10);
     monster_system_init(20); // Increase from 5 to 20 for more digis
@@ -99,7 +144,7 @@ int main(int argc, char* argv[])
     
     // Load entity assets
     mesh = gf3d_mesh_load("models/dino/dino.obj");
-    texture = gf3d_texture_load("models/dino/dino.png");
+    texture = gf3d_texture_load_streaming("models/dino/dino.png");
     if (!texture)
     {
         slog("Failed to load model texture, using default texture");
@@ -133,29 +178,54 @@ int main(int argc, char* argv[])
     
     slog("Entering main game loop");
     int frame_count = 0;
+    Uint32 steps, step;
     while (!_done)
     {
+        gf3d_profiler_frame_begin();
         // Constantly check if things are being sent though input
-        if (frame_count < 5) slog("Frame %d: Starting input update", frame_count);
+        GF3D_PROFILE_BEGIN("input");
         gfc_input_update();
-        if (frame_count < 5) slog("Frame %d: Starting mouse update", frame_count);
         gf2d_mouse_update(); 
-        if (frame_count < 5) slog("Frame %d: Starting font update", frame_count);
         gf2d_font_update();
+        GF3D_PROFILE_END();
+        if (gfc_input_key_pressed("F10")) {
+            // grab a couple seconds of frames for chrome://tracing
+            gf3d_profiler_capture(120);
+        }
+        if (gfc_input_key_pressed("F9")) {
+            gpu_overlay = !gpu_overlay;
+        }
+        if (gfc_input_key_pressed("F8")) {
+            stats_overlay = !stats_overlay;
+        }
         
-        // Update all thinking, entity
-        entity_system_think_all();
-        entity_system_update_all();
-        
-        // Handle camera angle adjustment with left/right keys
-        Entity* cam_ent = camera_entity_get();
-        if (cam_ent) {
-            if (gfc_input_command_down("walkleft")) {
-                camera_entity_adjust_angle(cam_ent, 0.02f); // Rotate left
-            }
-            if (gfc_input_command_down("walkright")) {
-                camera_entity_adjust_angle(cam_ent, -0.02f); // Rotate right
+        // Run as many fixed simulation steps as wall clock time calls for
+        steps = gf3d_clock_begin_frame();
+        for (step = 0; step < steps; step++) {
+            entity_system_begin_step();
+            // Update all thinking, entity
+            GF3D_PROFILE_BEGIN("think");
+            entity_system_think_all();
+            GF3D_PROFILE_END();
+            GF3D_PROFILE_BEGIN("update");
+            entity_system_update_all();
+            GF3D_PROFILE_END();
+            GF3D_PROFILE_BEGIN("particles");
+            gf3d_particle_emitters_update(gf3d_clock_get_step());
+            gf3d_particle_gpu_emitters_update(gf3d_clock_get_step());
+            GF3D_PROFILE_END();
+            
+            // Handle camera angle adjustment with left/right keys
+            Entity* cam_ent = camera_entity_get();
+            if (cam_ent) {
+                if (gfc_input_command_down("walkleft")) {
+                    camera_entity_adjust_angle(cam_ent, 0.6f * gf3d_clock_get_step()); // Rotate left
+                }
+                if (gfc_input_command_down("walkright")) {
+                    camera_entity_adjust_angle(cam_ent, -0.6f * gf3d_clock_get_step()); // Rotate right
+                }
             }
+            gf3d_clock_step();
         }
         
         // entity creation/destruction
@@ -168,7 +238,7 @@ int main(int argc, char* argv[])
             );
             Monster* newMonster = monster_new(mesh, texture, randomPos);
             if (newMonster) {
-                slog("Dynamically created new monster at (%.1f, %.1f, %.1f)", 
+                gf3d_log(LL_Info, "Dynamically created new monster at (%.1f, %.1f, %.1f)", 
                      randomPos.x, randomPos.y, randomPos.z);
             }
         }
@@ -178,8 +248,9 @@ int main(int argc, char* argv[])
             monster_cleanup_oldest();
         }
 
+        // draw between the last two simulation states
+        entity_system_set_interpolation(gf3d_clock_get_alpha());
         gf3d_camera_update_view();
-        if (frame_count < 5) slog("Frame %d: Starting render", frame_count);
         gf3d_vgraphics_render_start();
 
         // TODO: get world to work
@@ -189,26 +260,41 @@ int main(int argc, char* argv[])
         }
         */
 
-        if (frame_count < 5) slog("Frame %d: Drawing entities", frame_count);
         // Draw all entities
+        GF3D_PROFILE_BEGIN("draw_entities");
         entity_system_draw_all(lightPos, GFC_COLOR_WHITE);
+        GF3D_PROFILE_END();
+        GF3D_PROFILE_BEGIN("draw_particles");
+        gf3d_particle_emitters_draw();
+        gf3d_particle_gpu_emitters_draw();
+        GF3D_PROFILE_END();
 
-        if (frame_count < 5) slog("Frame %d: Drawing UI", frame_count);
         // UI elements
+        GF3D_PROFILE_BEGIN("draw_ui");
         gf2d_font_draw_line_tag("ALT+F4 to exit", FT_H1, GFC_COLOR_WHITE, gfc_vector2d(10, 10));
         gf2d_font_draw_line_tag("SPACE: Make Dino", FT_H2, GFC_COLOR_GREEN, gfc_vector2d(10, 40));
         gf2d_font_draw_line_tag("DELETE: Kill Dino (TEST)", FT_H2, GFC_COLOR_RED, gfc_vector2d(10, 70));
         gf2d_font_draw_line_tag("Arrows: Rotate Dino", FT_H3, GFC_COLOR_YELLOW, gfc_vector2d(10, 100));
         
-        // console view that things are rendering
-        if (frame_count < 5) slog("Frame %d: Drawing mouse", frame_count);
+        if (stats_overlay) {
+            gf3d_render_stats_draw_overlay(gfc_vector2d(10, 140));
+            gf3d_memory_draw_overlay(gfc_vector2d(gf3d_vgraphics_get_resolution().x - 420, 140));
+        }
+        if (gpu_overlay) gf3d_gpu_timer_draw_overlay(gfc_vector2d(10, stats_overlay ? 400 : 140));
         gf2d_mouse_draw();
-        if (frame_count < 5) slog("Frame %d: Ending render", frame_count);
+        GF3D_PROFILE_END();
+        GF3D_PROFILE_BEGIN("render_end");
         gf3d_vgraphics_render_end();
+        GF3D_PROFILE_END();
 
         if (gfc_input_command_down("exit")) _done = 1; // exit condition
-        if (frame_count < 5) slog("Frame %d: Frame delay", frame_count);
-        game_frame_delay();
+        if ((frame_limit > 0) && (frame_count + 1 >= frame_limit)) {
+            if ((capture_file) && (gf3d_vgraphics_is_headless())) {
+                if (gf3d_vgraphics_save_frame(capture_file)) slog("saved last frame to %s", capture_file);
+            }
+            _done = 1;
+        }
+        gf3d_clock_end_frame();
         frame_count++;
     }
     vkDeviceWaitIdle(gf3d_vgraphics_get_default_logical_device());
@@ -235,23 +321,47 @@ void parse_arguments(int argc, char* argv[])
         {
             __DEBUG = 1;
         }
+        else if (strcmp(argv[a],"--headless") == 0)
+        {
+            gf3d_vgraphics_set_headless(1);
+        }
+        else if ((strcmp(argv[a],"--frames") == 0) && (a + 1 < argc))
+        {
+            frame_limit = atoi(argv[++a]);
+        }
+        else if ((strcmp(argv[a],"--capture") == 0) && (a + 1 < argc))
+        {
+            capture_file = argv[++a];
+        }
+        else if ((strcmp(argv[a],"--bench") == 0) && (a + 1 < argc))
+        {
+            bench_config = argv[++a];
+        }
+        else if ((strcmp(argv[a],"--bench-out") == 0) && (a + 1 < argc))
+        {
+            bench_report = argv[++a];
+        }
+        else if ((strcmp(argv[a],"--trace") == 0) && (a + 1 < argc))
+        {
+            if (sscanf(argv[++a],"%i:%i",&trace_first,&trace_count) != 2)
+            {
+                slog("--trace expects first_frame:frame_count");
+                trace_count = 0;
+            }
+        }
+        else if ((strcmp(argv[a],"--trace-out") == 0) && (a + 1 < argc))
+        {
+            trace_file = argv[++a];
+        }
+        else if (strcmp(argv[a],"--bake-textures") == 0)
+        {
+            bake_textures = 1;
+        }
+        else if ((strcmp(argv[a],"--pack-atlas") == 0) && (a + 1 < argc))
+        {
+            pack_atlas = argv[++a];
+        }
     }
 }
 
-void game_frame_delay()
-{
-    Uint32 diff;
-    static Uint32 now;
-    static Uint32 then;
-    then = now;
-    slog_sync();// make sure logs get written when we have time to write it
-    now = SDL_GetTicks();
-    diff = (now - then);
-    if (diff < frame_delay)
-    {
-        SDL_Delay(frame_delay - diff);
-    }
-    fps = 1000.0/fmax(SDL_GetTicks() - then,0.001);
-//     slog("fps: %f",fps);
-}
 /*eol@eof*/
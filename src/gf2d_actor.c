@@ -6,6 +6,7 @@
 #include "gfc_config.h"
 #include "gfc_pak.h"
 
+#include "gf3d_memory.h"
 #include "gf2d_actor.h"
 
 
@@ -24,7 +25,7 @@ void gf2d_actor_close()
     gf2d_actor_clear_all();
     if (actor_manager.actorList != NULL)
     {
-        free(actor_manager.actorList);
+        gf3d_memory_free(actor_manager.actorList);
     }
     actor_manager.actorList = NULL;
     actor_manager.maxActors = 0;
@@ -38,7 +39,7 @@ void gf2d_actor_init(Uint32 max)
         return;
     }
     actor_manager.maxActors = max;
-    actor_manager.actorList = (Actor *)gfc_allocate_array(sizeof(Actor),max);
+    actor_manager.actorList = (Actor *)gf3d_memory_alloc_array(MT_Sprite,sizeof(Actor),max);
     atexit(gf2d_actor_close);
 }
 
@@ -0,0 +1,520 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL_image.h>
+
+#include "simple_logger.h"
+#include "simple_json.h"
+
+#include "gfc_pak.h"
+
+#include "gf3d_memory.h"
+#include "gf3d_texture.h"
+#include "gf2d_atlas.h"
+
+#define GF2D_ATLAS_PADDING      1       /**<edge pixels repeated around each image, so filtering stays inside it*/
+#define GF2D_ATLAS_MAX_NODES    256     /**<skyline segments per page*/
+#define GF2D_ATLAS_MAX_PREBUILT 16
+#define GF2D_ATLAS_MAX_ENTRIES  1024
+
+typedef struct
+{
+    Uint32      x,y,w;          /**<a segment of the skyline, everything below y is taken*/
+}AtlasNode;
+
+typedef struct
+{
+    Uint32      size;
+    AtlasNode   nodes[GF2D_ATLAS_MAX_NODES];
+    Uint32      nodeCount;
+}AtlasSkyline;
+
+typedef struct
+{
+    Texture        *texture;    /**<keeps its surface, images are copied into it then uploaded*/
+    AtlasSkyline    skyline;
+}AtlasPage;
+
+typedef struct
+{
+    GFC_TextLine    filename;
+    Texture        *texture;
+    GFC_Rect        rect;       /**<where the image is in the texture, without its padding*/
+}AtlasEntry;
+
+typedef struct
+{
+    AtlasPage      *pages;
+    Uint32          maxPages;
+    Uint32          pageCount;
+    Uint32          pageSize;   /**<0 if runtime packing is off*/
+    Uint32          maxImage;
+    AtlasEntry     *entries;
+    Uint32          entryCount;
+    Texture        *prebuilt[GF2D_ATLAS_MAX_PREBUILT];
+    Uint32          prebuiltCount;
+}AtlasManager;
+
+extern int __DEBUG;
+static AtlasManager gf2d_atlas = {0};
+
+void gf2d_atlas_close();
+void gf2d_atlas_load_prebuilt(const char *filename);
+
+void gf2d_atlas_init(const char *config)
+{
+    Uint32 i,c;
+    int pageSize = 2048,maxImage = 512,maxPages = 4;
+    SJson *json = NULL,*setup,*atlas = NULL,*list;
+
+    if (config)
+    {
+        json = gfc_pak_load_json(config);
+        setup = sj_object_get_value(json,"setup");
+        atlas = sj_object_get_value(setup,"sprite_atlas");
+        sj_get_integer_value(sj_object_get_value(atlas,"page_size"),&pageSize);
+        sj_get_integer_value(sj_object_get_value(atlas,"max_image"),&maxImage);
+        sj_get_integer_value(sj_object_get_value(atlas,"max_pages"),&maxPages);
+    }
+    gf2d_atlas.entries = gf3d_memory_alloc_array(MT_Sprite,sizeof(AtlasEntry),GF2D_ATLAS_MAX_ENTRIES);
+    if ((pageSize > 0)&&(maxPages > 0))
+    {
+        gf2d_atlas.pages = gf3d_memory_alloc_array(MT_Sprite,sizeof(AtlasPage),maxPages);
+    }
+    if (!gf2d_atlas.entries)
+    {
+        slog("failed to allocate sprite atlas entries, atlases off");
+        gf3d_memory_free(gf2d_atlas.pages);
+        gf2d_atlas.pages = NULL;
+        sj_free(json);
+        return;
+    }
+    if (gf2d_atlas.pages)
+    {
+        gf2d_atlas.maxPages = maxPages;
+        gf2d_atlas.pageSize = pageSize;
+        gf2d_atlas.maxImage = MAX(maxImage,0);
+    }
+    atexit(gf2d_atlas_close);
+    list = sj_object_get_value(atlas,"prebuilt");
+    c = sj_array_get_count(list);
+    for (i = 0; i < c; i++)
+    {
+        gf2d_atlas_load_prebuilt(sj_get_string_value(sj_array_get_nth(list,i)));
+    }
+    sj_free(json);
+    if (__DEBUG)slog("sprite atlas initialized, %u pages of %u, images up to %u",gf2d_atlas.maxPages,gf2d_atlas.pageSize,gf2d_atlas.maxImage);
+}
+
+void gf2d_atlas_close()
+{
+    Uint32 i;
+    for (i = 0; i < gf2d_atlas.pageCount; i++)
+    {
+        gf3d_texture_free(gf2d_atlas.pages[i].texture);
+    }
+    for (i = 0; i < gf2d_atlas.prebuiltCount; i++)
+    {
+        gf3d_texture_free(gf2d_atlas.prebuilt[i]);
+    }
+    gf3d_memory_free(gf2d_atlas.pages);
+    gf3d_memory_free(gf2d_atlas.entries);
+    memset(&gf2d_atlas,0,sizeof(AtlasManager));
+}
+
+void gf2d_atlas_skyline_reset(AtlasSkyline *skyline,Uint32 size)
+{
+    memset(skyline,0,sizeof(AtlasSkyline));
+    skyline->size = size;
+    skyline->nodes[0].w = size;
+    skyline->nodeCount = 1;
+}
+
+/**
+ * @brief find how high a rect would sit with its left edge at a skyline node
+ * @return 0 if it does not fit there
+ */
+Uint8 gf2d_atlas_skyline_fit(AtlasSkyline *skyline,Uint32 i,Uint32 w,Uint32 h,Uint32 *y)
+{
+    Uint32 top = 0;
+    Sint64 left = w;
+    if (skyline->nodes[i].x + w > skyline->size)return 0;
+    for (; left > 0; i++)
+    {
+        if (i >= skyline->nodeCount)return 0;
+        top = MAX(top,skyline->nodes[i].y);
+        if (top + h > skyline->size)return 0;
+        left -= skyline->nodes[i].w;
+    }
+    *y = top;
+    return 1;
+}
+
+void gf2d_atlas_skyline_remove(AtlasSkyline *skyline,Uint32 i)
+{
+    memmove(&skyline->nodes[i],&skyline->nodes[i + 1],sizeof(AtlasNode) * (skyline->nodeCount - i - 1));
+    skyline->nodeCount--;
+}
+
+/**
+ * @brief find room for a rect, bottom left first: the lowest it can sit, then the narrowest segment it can sit on
+ * @return 0 if the skyline is full
+ */
+Uint8 gf2d_atlas_skyline_pack(AtlasSkyline *skyline,Uint32 w,Uint32 h,Uint32 *x,Uint32 *y)
+{
+    Uint32 i,top,shrink;
+    Uint32 best = 0,bestTop = 0,bestWidth = 0;
+    Uint8 found = 0;
+    AtlasNode *prev;
+
+    if ((!w)||(!h)||(skyline->nodeCount >= GF2D_ATLAS_MAX_NODES))return 0;
+    for (i = 0; i < skyline->nodeCount; i++)
+    {
+        if (!gf2d_atlas_skyline_fit(skyline,i,w,h,&top))continue;
+        if ((found)&&((top > bestTop)||((top == bestTop)&&(skyline->nodes[i].w >= bestWidth))))continue;
+        found = 1;
+        best = i;
+        bestTop = top;
+        bestWidth = skyline->nodes[i].w;
+    }
+    if (!found)return 0;
+    *x = skyline->nodes[best].x;
+    *y = bestTop;
+    // raise the skyline over the rect, then trim what it now covers
+    memmove(&skyline->nodes[best + 1],&skyline->nodes[best],sizeof(AtlasNode) * (skyline->nodeCount - best));
+    skyline->nodeCount++;
+    skyline->nodes[best].x = *x;
+    skyline->nodes[best].y = bestTop + h;
+    skyline->nodes[best].w = w;
+    for (i = best + 1; i < skyline->nodeCount;)
+    {
+        prev = &skyline->nodes[i - 1];
+        if (skyline->nodes[i].x >= prev->x + prev->w)break;
+        shrink = prev->x + prev->w - skyline->nodes[i].x;
+        if (skyline->nodes[i].w > shrink)
+        {
+            skyline->nodes[i].x += shrink;
+            skyline->nodes[i].w -= shrink;
+            break;
+        }
+        gf2d_atlas_skyline_remove(skyline,i);
+    }
+    for (i = 0; i + 1 < skyline->nodeCount;)
+    {
+        if (skyline->nodes[i].y != skyline->nodes[i + 1].y)
+        {
+            i++;
+            continue;
+        }
+        skyline->nodes[i].w += skyline->nodes[i + 1].w;
+        gf2d_atlas_skyline_remove(skyline,i + 1);
+    }
+    return 1;
+}
+
+/**
+ * @brief copy part of an image into a page, one pixel wide or high strips are stretched to fill dst
+ */
+void gf2d_atlas_copy(SDL_Surface *image,int sx,int sy,int sw,int sh,SDL_Surface *page,int dx,int dy,int dw,int dh)
+{
+    SDL_Rect src = {sx,sy,sw,sh};
+    SDL_Rect dst = {dx,dy,dw,dh};
+    if ((sw == dw)&&(sh == dh))SDL_BlitSurface(image,&src,page,&dst);
+    else SDL_BlitScaled(image,&src,page,&dst);
+}
+
+/**
+ * @brief copy an image into a page at x,y, surrounded by copies of its edge pixels
+ */
+void gf2d_atlas_blit(SDL_Surface *image,SDL_Surface *page,int x,int y)
+{
+    int p = GF2D_ATLAS_PADDING;
+    int w = image->w,h = image->h;
+    SDL_SetSurfaceBlendMode(image,SDL_BLENDMODE_NONE);// copy alpha as is
+    gf2d_atlas_copy(image,0,0,w,h,page,x + p,y + p,w,h);
+    if (!p)return;
+    gf2d_atlas_copy(image,0,0,w,1,page,x + p,y,w,p);
+    gf2d_atlas_copy(image,0,h - 1,w,1,page,x + p,y + p + h,w,p);
+    gf2d_atlas_copy(image,0,0,1,h,page,x,y + p,p,h);
+    gf2d_atlas_copy(image,w - 1,0,1,h,page,x + p + w,y + p,p,h);
+    gf2d_atlas_copy(image,0,0,1,1,page,x,y,p,p);
+    gf2d_atlas_copy(image,w - 1,0,1,1,page,x + p + w,y,p,p);
+    gf2d_atlas_copy(image,0,h - 1,1,1,page,x,y + p + h,p,p);
+    gf2d_atlas_copy(image,w - 1,h - 1,1,1,page,x + p + w,y + p + h,p,p);
+}
+
+SDL_Surface *gf2d_atlas_surface_new(Uint32 size)
+{
+    SDL_Surface *surface;
+    surface = SDL_CreateRGBSurfaceWithFormat(0,size,size,32,SDL_PIXELFORMAT_RGBA32);
+    if (!surface)
+    {
+        slog("failed to create atlas page: %s",SDL_GetError());
+        return NULL;
+    }
+    SDL_FillRect(surface,NULL,SDL_MapRGBA(surface->format,0,0,0,0));
+    return surface;
+}
+
+AtlasEntry *gf2d_atlas_entry_get(const char *filename)
+{
+    Uint32 i;
+    for (i = 0; i < gf2d_atlas.entryCount; i++)
+    {
+        if (gfc_line_cmp(gf2d_atlas.entries[i].filename,filename) == 0)return &gf2d_atlas.entries[i];
+    }
+    return NULL;
+}
+
+AtlasEntry *gf2d_atlas_entry_add(const char *filename,Texture *texture,GFC_Rect rect)
+{
+    AtlasEntry *entry;
+    if (gf2d_atlas.entryCount >= GF2D_ATLAS_MAX_ENTRIES)return NULL;
+    entry = &gf2d_atlas.entries[gf2d_atlas.entryCount++];
+    gfc_line_cpy(entry->filename,filename);
+    entry->texture = texture;
+    entry->rect = rect;
+    return entry;
+}
+
+void gf2d_atlas_load_prebuilt(const char *filename)
+{
+    Uint32 i,c,added = 0;
+    int x = 0,y = 0,w = 0,h = 0;
+    const char *file;
+    SJson *json,*list,*item;
+    Texture *texture;
+
+    if (!filename)return;
+    if (gf2d_atlas.prebuiltCount >= GF2D_ATLAS_MAX_PREBUILT)
+    {
+        slog("too many prebuilt atlases, skipping %s",filename);
+        return;
+    }
+    json = gfc_pak_load_json(filename);
+    if (!json)
+    {
+        slog("failed to load prebuilt atlas %s",filename);
+        return;
+    }
+    texture = gf3d_texture_load(sj_object_get_value_as_string(json,"image"));
+    if (!texture)
+    {
+        slog("failed to load the image for prebuilt atlas %s",filename);
+        sj_free(json);
+        return;
+    }
+    gf2d_atlas.prebuilt[gf2d_atlas.prebuiltCount++] = texture;
+    list = sj_object_get_value(json,"entries");
+    c = sj_array_get_count(list);
+    for (i = 0; i < c; i++)
+    {
+        item = sj_array_get_nth(list,i);
+        file = sj_object_get_value_as_string(item,"file");
+        if ((!file)||(gf2d_atlas_entry_get(file)))continue;
+        sj_object_get_value_as_int(item,"x",&x);
+        sj_object_get_value_as_int(item,"y",&y);
+        sj_object_get_value_as_int(item,"w",&w);
+        sj_object_get_value_as_int(item,"h",&h);
+        if (!gf2d_atlas_entry_add(file,texture,gfc_rect(x,y,w,h)))break;
+        added++;
+    }
+    sj_free(json);
+    if (__DEBUG)slog("loaded prebuilt atlas %s with %u images",filename,added);
+}
+
+/**
+ * @brief pack an image into the first page with room, adding a page if none has any
+ * @return NULL if it does not fit, the page otherwise
+ */
+AtlasPage *gf2d_atlas_pack_image(SDL_Surface *image,Uint32 *x,Uint32 *y)
+{
+    Uint32 i;
+    Uint32 w = image->w + GF2D_ATLAS_PADDING * 2;
+    Uint32 h = image->h + GF2D_ATLAS_PADDING * 2;
+    SDL_Surface *surface;
+    AtlasPage *page;
+    for (i = 0; i < gf2d_atlas.pageCount; i++)
+    {
+        if (gf2d_atlas_skyline_pack(&gf2d_atlas.pages[i].skyline,w,h,x,y))return &gf2d_atlas.pages[i];
+    }
+    if (gf2d_atlas.pageCount >= gf2d_atlas.maxPages)return NULL;
+    surface = gf2d_atlas_surface_new(gf2d_atlas.pageSize);
+    if (!surface)return NULL;
+    page = &gf2d_atlas.pages[gf2d_atlas.pageCount];
+    page->texture = gf3d_texture_convert_surface_full(surface,0,TR_KeepSurface);
+    if (!page->texture)return NULL;
+    gf2d_atlas_skyline_reset(&page->skyline,gf2d_atlas.pageSize);
+    gf2d_atlas.pageCount++;
+    if (!gf2d_atlas_skyline_pack(&page->skyline,w,h,x,y))return NULL;
+    return page;
+}
+
+Texture *gf2d_atlas_get_image(const char *filename,GFC_Rect *rect)
+{
+    Uint32 x,y;
+    SDL_Surface *image;
+    AtlasPage *page;
+    AtlasEntry *entry;
+
+    if ((!filename)||(!rect)||(!gf2d_atlas.entries))return NULL;
+    entry = gf2d_atlas_entry_get(filename);
+    if (!entry)
+    {
+        if ((!gf2d_atlas.pageSize)||(gf2d_atlas.entryCount >= GF2D_ATLAS_MAX_ENTRIES))return NULL;
+        image = gf3d_texture_load_surface(filename);
+        if (!image)return NULL;
+        if ((image->w > gf2d_atlas.maxImage)||(image->h > gf2d_atlas.maxImage))
+        {
+            SDL_FreeSurface(image);
+            return NULL;
+        }
+        page = gf2d_atlas_pack_image(image,&x,&y);
+        if (!page)
+        {
+            if (__DEBUG)slog("sprite atlas is full, %s gets its own texture",filename);
+            SDL_FreeSurface(image);
+            return NULL;
+        }
+        gf2d_atlas_blit(image,page->texture->surface,x,y);
+        gf3d_texture_update_region(page->texture,x,y,image->w + GF2D_ATLAS_PADDING * 2,image->h + GF2D_ATLAS_PADDING * 2);
+        entry = gf2d_atlas_entry_add(filename,page->texture,gfc_rect(x + GF2D_ATLAS_PADDING,y + GF2D_ATLAS_PADDING,image->w,image->h));
+        SDL_FreeSurface(image);
+        if (!entry)return NULL;
+    }
+    *rect = entry->rect;
+    entry->texture->_refcount++;
+    return entry->texture;
+}
+
+typedef struct
+{
+    const char     *filename;
+    SDL_Surface    *image;
+}AtlasPackItem;
+
+int gf2d_atlas_pack_item_compare(const void *a,const void *b)
+{
+    // tallest first packs tightest on a skyline
+    return ((const AtlasPackItem *)b)->image->h - ((const AtlasPackItem *)a)->image->h;
+}
+
+/**
+ * @brief pack one atlas from its config
+ * @return how many of its images could not be packed
+ */
+Uint32 gf2d_atlas_pack_one(SJson *config)
+{
+    Uint32 i,c,x,y,count = 0,failed = 0;
+    int size = 1024;
+    const char *output,*file;
+    GFC_TextLine imagePath,jsonPath;
+    AtlasSkyline *skyline;
+    AtlasPackItem *items;
+    SDL_Surface *page;
+    SJson *list,*out,*entries,*entry;
+
+    output = sj_object_get_value_as_string(config,"output");
+    sj_object_get_value_as_int(config,"size",&size);
+    list = sj_object_get_value(config,"images");
+    c = sj_array_get_count(list);
+    if ((!output)||(size <= 0)||(!c))
+    {
+        slog("atlas needs an output, a size and images");
+        return c;
+    }
+    items = gf3d_memory_alloc_array(MT_Sprite,sizeof(AtlasPackItem),c);
+    skyline = gf3d_memory_alloc_array(MT_Sprite,sizeof(AtlasSkyline),1);
+    page = gf2d_atlas_surface_new(size);
+    if ((!items)||(!skyline)||(!page))
+    {
+        gf3d_memory_free(items);
+        gf3d_memory_free(skyline);
+        if (page)SDL_FreeSurface(page);
+        return c;
+    }
+    for (i = 0; i < c; i++)
+    {
+        file = sj_get_string_value(sj_array_get_nth(list,i));
+        if (!file)
+        {
+            failed++;
+            continue;
+        }
+        items[count].image = IMG_Load(file);
+        if (!items[count].image)
+        {
+            slog("failed to load %s for atlas %s",file,output);
+            failed++;
+            continue;
+        }
+        items[count++].filename = file;
+    }
+    qsort(items,count,sizeof(AtlasPackItem),gf2d_atlas_pack_item_compare);
+
+    gf2d_atlas_skyline_reset(skyline,size);
+    entries = sj_array_new();
+    for (i = 0; i < count; i++)
+    {
+        if (!gf2d_atlas_skyline_pack(skyline,items[i].image->w + GF2D_ATLAS_PADDING * 2,items[i].image->h + GF2D_ATLAS_PADDING * 2,&x,&y))
+        {
+            slog("%s does not fit in atlas %s",items[i].filename,output);
+            failed++;
+            continue;
+        }
+        gf2d_atlas_blit(items[i].image,page,x,y);
+        entry = sj_object_new();
+        sj_object_insert(entry,"file",sj_new_str(items[i].filename));
+        sj_object_insert(entry,"x",sj_new_int(x + GF2D_ATLAS_PADDING));
+        sj_object_insert(entry,"y",sj_new_int(y + GF2D_ATLAS_PADDING));
+        sj_object_insert(entry,"w",sj_new_int(items[i].image->w));
+        sj_object_insert(entry,"h",sj_new_int(items[i].image->h));
+        sj_array_append(entries,entry);
+    }
+
+    gfc_line_sprintf(imagePath,"%s.png",output);
+    gfc_line_sprintf(jsonPath,"%s.json",output);
+    if (IMG_SavePNG(page,imagePath) != 0)
+    {
+        slog("failed to save atlas image %s: %s",imagePath,SDL_GetError());
+        failed = c;
+    }
+    out = sj_object_new();
+    sj_object_insert(out,"image",sj_new_str(imagePath));
+    sj_object_insert(out,"entries",entries);
+    sj_save(out,jsonPath);
+    sj_free(out);
+    slog("packed atlas %s: %u of %u images",output,c - failed,c);
+
+    for (i = 0; i < count; i++)
+    {
+        SDL_FreeSurface(items[i].image);
+    }
+    SDL_FreeSurface(page);
+    gf3d_memory_free(skyline);
+    gf3d_memory_free(items);
+    return failed;
+}
+
+Uint32 gf2d_atlas_pack_file(const char *filename)
+{
+    Uint32 i,c,failed = 0;
+    SJson *json,*list;
+
+    json = sj_load(filename);
+    if (!json)
+    {
+        slog("failed to load atlas pack config %s",filename);
+        return 1;
+    }
+    list = sj_object_get_value(json,"atlases");
+    c = sj_array_get_count(list);
+    for (i = 0; i < c; i++)
+    {
+        failed += gf2d_atlas_pack_one(sj_array_get_nth(list,i));
+    }
+    sj_free(json);
+    return failed;
+}
+
+/*eol@eof*/
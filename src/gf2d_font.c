@@ -1,24 +1,84 @@
 #include "simple_logger.h"
 
 #include "gfc_text.h"
-#include "gfc_list.h"
 #include "gfc_color.h"
 #include "gfc_shape.h"
 #include "gfc_pak.h"
 
 #include "gf3d_vgraphics.h"
 #include "gf3d_texture.h"
+#include "gf3d_memory.h"
+#include "gf3d_render_stats.h"
 #include "gf2d_sprite.h"
 #include "gf2d_font.h"
 
+#define GF2D_FONT_MAX_PAGES     4       /**<atlas pages per font*/
+#define GF2D_FONT_MAX_SHELVES   64      /**<rows of glyphs per page*/
+#define GF2D_FONT_GLYPH_PADDING 1       /**<empty pixels between glyphs, so filtering does not pick up a neighbor*/
+#define GF2D_FONT_LINE_QUADS    256     /**<glyphs drawn per batch, longer lines take more than one*/
+#define GF2D_FONT_RUN_BUCKETS   1024    /**<hash buckets for laid out lines, a power of two*/
+
+extern int __DEBUG;
+
+typedef struct
+{
+    Uint32      codepoint;      /**<0 for an empty slot*/
+    Uint8       page;
+    Sint16      x,y,w,h;        /**<where in the page, w is 0 for glyphs with nothing to draw*/
+    Sint16      minx;           /**<how far left of the pen the glyph starts*/
+    Sint16      advance;
+}FontGlyph;
+
 typedef struct
 {
-    Sprite     *image;
-    GFC_TextBlock   text;
-    GFC_Color       color;
-    Font       *font;
-    Uint32      last_used;
-}FontImage;
+    Uint32      y,height,x;     /**<x is where the next glyph on the shelf goes*/
+}FontShelf;
+
+typedef struct
+{
+    Texture    *texture;        /**<keeps its surface, glyphs are drawn into it then uploaded*/
+    FontShelf   shelves[GF2D_FONT_MAX_SHELVES];
+    Uint32      shelfCount;
+    Uint32      nextY;          /**<where the next shelf starts*/
+    SDL_Rect    dirty;          /**<what has been drawn into the surface but not uploaded*/
+}FontPage;
+
+struct FontAtlas_S
+{
+    FontGlyph  *glyphs;         /**<open addressed by codepoint*/
+    Uint32      glyphSlots;     /**<a power of two, twice the glyph limit*/
+    Uint32      glyphCount;
+    Uint8       full;           /**<set once the glyph limit has been hit and logged*/
+    FontPage    pages[GF2D_FONT_MAX_PAGES];
+    Uint32      pageCount;
+};
+
+typedef struct
+{
+    Uint32      start,length;   /**<the bytes of the text on the line*/
+}TextRunLine;
+
+/**
+ * text laid out for a font, reused for as long as the same font draws or measures the same text.
+ * A single line is laid out into glyph quads, wrapped text into the lines it breaks into
+ */
+typedef struct TextRun_S
+{
+    Uint32              hash;
+    Font               *font;
+    Uint8               wrapped;    /**<if set this is wrapped text, otherwise a single line*/
+    Uint32              wrapWidth;  /**<the width wrapped text was broken to fit*/
+    char               *text;
+    SpriteQuad         *quads;      /**<for a single line*/
+    Uint8              *pages;
+    Uint32              count;
+    TextRunLine        *lines;      /**<for wrapped text*/
+    Uint32              lineCount;
+    int                 width;      /**<of the widest line, in pixels*/
+    size_t              bytes;      /**<the whole allocation, which holds the text and quads too*/
+    struct TextRun_S   *next;       /**<next in the same bucket*/
+    struct TextRun_S   *newer,*older;
+}TextRun;
 
 typedef struct
 {
@@ -26,117 +86,294 @@ typedef struct
     Font *font_tags[FT_MAX];
     Uint32 font_max;
     int row_padding;
-    GFC_List *font_images;
-    Uint32 ttl;         //time to live for font re-use
+    Uint32 atlas_size;  //width and height of each glyph atlas page
+    Uint32 max_glyphs;  //how many glyphs each font can hold
+    TextRun *runs[GF2D_FONT_RUN_BUCKETS];
+    TextRun *newest,*oldest;
+    size_t run_bytes;   //held by all cached runs
+    size_t run_budget;  //runs are evicted oldest first past this
+    TextRun *pinned;    //a wrapped run being drawn, kept while its lines are laid out
 }FontManager;
 
 static FontManager font_manager = {0};
 
 void gf2d_fonts_load(const char *filename);
 void gf2d_fonts_load_json(const char *filename);
+void gf2d_font_atlas_free(FontAtlas *atlas);
+void gf2d_font_run_remove(TextRun *run);
+void gf2d_font_wrap_self_test();
 
 void gf2d_font_close()
 {
-    int i,c;
-    FontImage *image;
+    int i;
+    while (font_manager.oldest)gf2d_font_run_remove(font_manager.oldest);
     for (i = 0;i < font_manager.font_max;i++)
     {
+        gf2d_font_atlas_free(font_manager.font_list[i].atlas);
         if (font_manager.font_list[i].font != NULL)
         {
             TTF_CloseFont(font_manager.font_list[i].font);
             free(font_manager.font_list[i].mem);
         }
     }
-    c = gfc_list_get_count(font_manager.font_images);
-    for (i= 0; i < c; i++)
+    gf3d_memory_free(font_manager.font_list);
+    font_manager.font_list = NULL;
+    TTF_Quit();
+}
+
+void gf2d_font_init(const char *configFile)
+{
+    if (TTF_Init() == -1)
     {
-        image = gfc_list_get_nth(font_manager.font_images,i);
-        if (!image)continue;
-        gf2d_sprite_free(image->image);
-        free(image);
+        slog("TTF_Init: %s\n", TTF_GetError());
+        return;
     }
-    gfc_list_delete(font_manager.font_images);
-    TTF_Quit();
+    font_manager.atlas_size = 512;
+    font_manager.max_glyphs = 512;
+    font_manager.run_budget = 256 * 1024;
+    gf2d_fonts_load_json(configFile);
+    atexit(gf2d_font_close);
+    if (__DEBUG)gf2d_font_wrap_self_test();
 }
 
-void gf2d_font_image_new(
-    Sprite     *sprite,
-    GFC_TextBlock   text,
-    GFC_Color       color,
-    Font       *font
-)
+void gf2d_font_update()
+{
+    // glyphs stay in the atlas for the life of the font, so there is nothing to clean up
+}
+
+FontAtlas *gf2d_font_atlas_new()
+{
+    FontAtlas *atlas;
+    Uint32 slots = 1;
+    while (slots < font_manager.max_glyphs * 2)slots <<= 1;
+    atlas = gf3d_memory_alloc_array(MT_Font,sizeof(FontAtlas),1);
+    if (!atlas)return NULL;
+    atlas->glyphs = gf3d_memory_alloc_array(MT_Font,sizeof(FontGlyph),slots);
+    if (!atlas->glyphs)
+    {
+        gf3d_memory_free(atlas);
+        return NULL;
+    }
+    atlas->glyphSlots = slots;
+    return atlas;
+}
+
+void gf2d_font_atlas_free(FontAtlas *atlas)
 {
-    FontImage *image;
-    if (!sprite)return;
-    image = gfc_allocate_array(sizeof(FontImage),1);
-    if (!image)return;
-    image->image = sprite;
-    gfc_block_cpy(image->text,text);
-    image->color = color;
-    image->font = font;
-    image->last_used = SDL_GetTicks();
-    gfc_list_append(font_manager.font_images,image);
-}
-
-FontImage *gf2d_font_image_get(
-    GFC_TextBlock   text,
-    GFC_Color       color,
-    Font       *font)
-{
-    FontImage *image;
-    int i,c;
-    c = gfc_list_get_count(font_manager.font_images);
-    for (i = 0;i < c;i++)
-    {
-        image = gfc_list_get_nth(font_manager.font_images,i);
-        if (!image)continue;
-        if (image->font != font)continue;
-        if (!gfc_color_cmp(image->color, color))
+    Uint32 i;
+    if (!atlas)return;
+    for (i = 0; i < atlas->pageCount; i++)
+    {
+        gf3d_texture_free(atlas->pages[i].texture);
+    }
+    gf3d_memory_free(atlas->glyphs);
+    gf3d_memory_free(atlas);
+}
+
+/**
+ * @brief add a page to an atlas, cleared to transparent white so filtered edges do not darken
+ * @return NULL if the atlas is out of pages or the texture could not be made
+ */
+FontPage *gf2d_font_atlas_add_page(FontAtlas *atlas)
+{
+    SDL_Surface *surface;
+    FontPage *page;
+    if (atlas->pageCount >= GF2D_FONT_MAX_PAGES)return NULL;
+    surface = gf3d_vgraphics_create_surface(font_manager.atlas_size,font_manager.atlas_size);
+    if (!surface)
+    {
+        slog("failed to create glyph atlas page: %s",SDL_GetError());
+        return NULL;
+    }
+    SDL_FillRect(surface,NULL,SDL_MapRGBA(surface->format,255,255,255,0));
+    page = &atlas->pages[atlas->pageCount];
+    memset(page,0,sizeof(FontPage));
+    page->texture = gf3d_texture_convert_surface_full(surface,0,TR_KeepSurface);
+    if (!page->texture)return NULL;
+    atlas->pageCount++;
+    return page;
+}
+
+/**
+ * @brief find room for a glyph on a page, on the shortest shelf it fits or a new one
+ * @return 0 if the page is full
+ */
+Uint8 gf2d_font_page_pack(FontPage *page,Uint32 w,Uint32 h,Uint32 *x,Uint32 *y)
+{
+    Uint32 i;
+    FontShelf *shelf = NULL;
+    w += GF2D_FONT_GLYPH_PADDING;
+    h += GF2D_FONT_GLYPH_PADDING;
+    for (i = 0; i < page->shelfCount; i++)
+    {
+        if ((page->shelves[i].height < h)||(page->shelves[i].x + w > font_manager.atlas_size))continue;
+        if ((!shelf)||(page->shelves[i].height < shelf->height))shelf = &page->shelves[i];
+    }
+    if (!shelf)
+    {
+        if ((page->shelfCount >= GF2D_FONT_MAX_SHELVES)||(page->nextY + h > font_manager.atlas_size))return 0;
+        if (w > font_manager.atlas_size)return 0;
+        shelf = &page->shelves[page->shelfCount++];
+        shelf->y = page->nextY;
+        shelf->height = h;
+        shelf->x = 0;
+        page->nextY += h;
+    }
+    *x = shelf->x;
+    *y = shelf->y;
+    shelf->x += w;
+    return 1;
+}
+
+/**
+ * @brief render a glyph into the atlas
+ * @note glyphs the font does not have, or with nothing to draw, are kept with no size so they are not tried again
+ */
+void gf2d_font_glyph_rasterize(Font *font,FontGlyph *glyph)
+{
+    Uint32 i,x,y;
+    int minx,maxx,miny,maxy,advance;
+    SDL_Color white = {255,255,255,255};
+    SDL_Surface *surface;
+    SDL_Rect dst;
+    FontPage *page = NULL;
+    FontAtlas *atlas = font->atlas;
+
+    if (TTF_GlyphMetrics32(font->font,glyph->codepoint,&minx,&maxx,&miny,&maxy,&advance) != 0)return;
+    glyph->advance = advance;
+    glyph->minx = MIN(minx,0);
+    if (maxx <= minx)return;// whitespace
+    // rendered the same way as a line of text, the full height of the font with the baseline at the ascent
+    surface = TTF_RenderGlyph32_Blended(font->font,glyph->codepoint,white);
+    if (!surface)
+    {
+        slog("failed to render glyph %u: %s",glyph->codepoint,TTF_GetError());
+        return;
+    }
+    for (i = 0; i < atlas->pageCount; i++)
+    {
+        if (gf2d_font_page_pack(&atlas->pages[i],surface->w,surface->h,&x,&y))
         {
-            continue;
+            page = &atlas->pages[i];
+            break;
         }
-        if (gfc_block_cmp(image->text,text)!= 0)
+    }
+    if (!page)
+    {
+        page = gf2d_font_atlas_add_page(atlas);
+        if ((!page)||(!gf2d_font_page_pack(page,surface->w,surface->h,&x,&y)))
         {
-            continue;
+            slog("glyph atlas for %s is full",font->filename);
+            SDL_FreeSurface(surface);
+            return;
         }
-        return image;
+        i = atlas->pageCount - 1;
+    }
+    glyph->page = i;
+    glyph->x = x;
+    glyph->y = y;
+    glyph->w = surface->w;
+    glyph->h = surface->h;
+    gfc_rect_set(dst,x,y,surface->w,surface->h);
+    SDL_SetSurfaceBlendMode(surface,SDL_BLENDMODE_NONE);
+    SDL_BlitSurface(surface,NULL,page->texture->surface,&dst);
+    SDL_FreeSurface(surface);
+    if (page->dirty.w)SDL_UnionRect(&page->dirty,&dst,&page->dirty);
+    else page->dirty = dst;
+    gf3d_render_stats_add(RS_GlyphsRasterized,1);
+}
+
+/**
+ * @brief get a glyph of a font, rasterizing it the first time
+ * @return NULL if the font cannot hold any more glyphs
+ */
+FontGlyph *gf2d_font_glyph_get(Font *font,Uint32 codepoint)
+{
+    Uint32 slot;
+    FontGlyph *glyph;
+    FontAtlas *atlas = font->atlas;
+    slot = (codepoint * 2654435761u) & (atlas->glyphSlots - 1);
+    for (;;slot = (slot + 1) & (atlas->glyphSlots - 1))
+    {
+        glyph = &atlas->glyphs[slot];
+        if (glyph->codepoint == codepoint)return glyph;
+        if (glyph->codepoint == 0)break;
+    }
+    if (atlas->glyphCount >= font_manager.max_glyphs)
+    {
+        if (!atlas->full)slog("font %s has no room for more glyphs, raise max_glyphs",font->filename);
+        atlas->full = 1;
+        return NULL;
     }
-    return NULL;
+    glyph->codepoint = codepoint;
+    atlas->glyphCount++;
+    gf2d_font_glyph_rasterize(font,glyph);
+    return glyph;
 }
 
-void gf2d_font_init(const char *configFile)
+/**
+ * @brief upload whatever has been drawn into the atlas since it was last uploaded
+ */
+void gf2d_font_atlas_upload(FontAtlas *atlas)
 {
-    if (TTF_Init() == -1)
+    Uint32 i;
+    FontPage *page;
+    for (i = 0; i < atlas->pageCount; i++)
     {
-        slog("TTF_Init: %s\n", TTF_GetError());
-        return;
+        page = &atlas->pages[i];
+        if (!page->dirty.w)continue;
+        gf3d_texture_update_region(page->texture,page->dirty.x,page->dirty.y,page->dirty.w,page->dirty.h);
+        memset(&page->dirty,0,sizeof(SDL_Rect));
     }
-    font_manager.ttl = 100;
-    gf2d_fonts_load_json(configFile);
-    font_manager.font_images = gfc_list_new();
-    atexit(gf2d_font_close);
 }
 
-void gf2d_font_image_free(FontImage *image)
+/**
+ * @brief read the next codepoint from utf-8 text
+ * @return the codepoint, 0 at the end of the text.  Malformed sequences read as U+FFFD
+ */
+Uint32 gf2d_font_utf8_next(const char **text)
 {
-    if (!image)return;
-    gf2d_sprite_free(image->image);
-    free(image);
+    Uint32 i,count,codepoint;
+    const Uint8 *c = (const Uint8 *)*text;
+    if (!*c)return 0;
+    if (*c < 0x80)count = 0,codepoint = *c;
+    else if ((*c & 0xE0) == 0xC0)count = 1,codepoint = *c & 0x1F;
+    else if ((*c & 0xF0) == 0xE0)count = 2,codepoint = *c & 0x0F;
+    else if ((*c & 0xF8) == 0xF0)count = 3,codepoint = *c & 0x07;
+    else
+    {
+        (*text)++;
+        return 0xFFFD;
+    }
+    for (i = 1; i <= count; i++)
+    {
+        if ((c[i] & 0xC0) != 0x80)
+        {
+            *text += i;
+            return 0xFFFD;
+        }
+        codepoint = (codepoint << 6) | (c[i] & 0x3F);
+    }
+    *text += count + 1;
+    return codepoint;
 }
 
-void gf2d_font_update()
+/**
+ * @brief draw a batch of glyph quads, one draw call for each page they use
+ */
+void gf2d_font_draw_quads(FontAtlas *atlas,SpriteQuad *quads,Uint8 *pages,Uint32 count,GFC_Vector2D position,GFC_Color color)
 {
-    FontImage *image;
-    Uint32 now = SDL_GetTicks();
-    int i;
-    for (i = 0;i < gfc_list_get_count(font_manager.font_images);i++)
+    Uint32 i,p,n;
+    SpriteQuad batch[GF2D_FONT_LINE_QUADS];
+    if (!count)return;
+    gf2d_font_atlas_upload(atlas);
+    for (p = 0; p < atlas->pageCount; p++)
     {
-        image = gfc_list_get_nth(font_manager.font_images,i);
-        if (!image)continue;
-        if ((now - image->last_used) < font_manager.ttl)continue;
-        gfc_list_delete_data(font_manager.font_images,image);
-        gf2d_font_image_free(image);
-        i--;
+        for (i = 0,n = 0; i < count; i++)
+        {
+            if (pages[i] == p)batch[n++] = quads[i];
+        }
+        gf2d_sprite_draw_quads(atlas->pages[p].texture,batch,n,position,color);
     }
 }
 
@@ -245,11 +482,15 @@ void gf2d_fonts_load_json(const char *filename)
     size_t fileSize = 0;
     const char *str;
     int size = 10;
+    int cacheKB;
     FontTypes fontType;
     SJson *file,*fonts,*item;
     file = gfc_pak_load_json(filename);
     if (!file)return;
-    sj_object_get_value_as_Uint32(file,"ttl",&font_manager.ttl);
+    sj_object_get_value_as_Uint32(file,"atlas_size",&font_manager.atlas_size);
+    sj_object_get_value_as_Uint32(file,"max_glyphs",&font_manager.max_glyphs);
+    if (sj_object_get_value_as_int(file,"text_cache_kb",&cacheKB))font_manager.run_budget = MAX(cacheKB,0) * 1024;
+    if (!font_manager.max_glyphs)font_manager.max_glyphs = 1;
     sj_object_get_value_as_int(file,"row_padding",&font_manager.row_padding);
     fonts = sj_object_get_value(file,"fonts");
     if (!fonts)
@@ -265,7 +506,13 @@ void gf2d_fonts_load_json(const char *filename)
         sj_free(file);
         return;
     }
-    font_manager.font_list = (Font*)gfc_allocate_array(sizeof(Font),count);
+    font_manager.font_list = (Font*)gf3d_memory_alloc_array(MT_Font,sizeof(Font),count);
+    if (!font_manager.font_list)
+    {
+        sj_free(file);
+        return;
+    }
+    font_manager.font_max = count;
     for (i = 0; i < count; i++)
     {
         item = sj_array_get_nth(fonts,i);
@@ -338,65 +585,283 @@ void gf2d_font_draw_line_tag(char *text,FontTypes tag,GFC_Color color, GFC_Vecto
     gf2d_font_draw_line(text,gf2d_font_get_by_tag(tag),color, position);
 }
 
-void gf2d_font_draw_line(char *text,Font *font,GFC_Color color, GFC_Vector2D position)
+/**
+ * @brief make sure a font can be laid out, making its atlas the first time
+ * @return 0 if the font cannot be used
+ */
+Uint8 gf2d_font_ready(Font *font)
 {
-    SDL_Surface *surface;
-    Sprite *sprite;
-    FontImage *image;
-    if (!text)
+    if ((!font)||(!font->font))return 0;
+    if (!font->atlas)font->atlas = gf2d_font_atlas_new();
+    return font->atlas != NULL;
+}
+
+/**
+ * @brief lay out text into glyph quads from the pen at 0,0
+ * @param length how many bytes of the text to lay out
+ * @param quads [output, optional] room for at least as many quads as the text has codepoints
+ * @param pages [output, optional] the atlas page of each quad
+ * @param width [output, optional] how far right the text reaches
+ * @return how many quads there are
+ */
+Uint32 gf2d_font_layout(Font *font,const char *text,size_t length,SpriteQuad *quads,Uint8 *pages,int *width)
+{
+    Uint32 count = 0;
+    Uint32 codepoint,previous = 0;
+    int pen = 0,right = 0;
+    const char *end = text + length;
+    FontGlyph *glyph;
+    while ((text < end)&&((codepoint = gf2d_font_utf8_next(&text)) != 0))
+    {
+        glyph = gf2d_font_glyph_get(font,codepoint);
+        if (!glyph)continue;
+        if (previous)pen += TTF_GetFontKerningSizeGlyphs32(font->font,previous,codepoint);
+        previous = codepoint;
+        if (glyph->w)
+        {
+            if (quads)
+            {
+                gfc_rect_set(quads[count].dst,pen + glyph->minx,0,glyph->w,glyph->h);
+                gfc_rect_set(quads[count].src,glyph->x,glyph->y,glyph->w,glyph->h);
+                pages[count] = glyph->page;
+            }
+            count++;
+        }
+        pen += glyph->advance;
+        right = MAX(right,pen);
+    }
+    if (width)*width = right;
+    return count;
+}
+
+Uint32 gf2d_font_run_hash(Font *font,const char *text,Uint8 wrapped,Uint32 wrapWidth)
+{
+    Uint32 hash = 2166136261u;// fnv-1a
+    size_t f = (size_t)font;
+    for (;*text;text++)
     {
-        slog("cannot draw text, none provided");
-        return;
+        hash = (hash ^ (Uint8)*text) * 16777619u;
     }
-    if (!font)
+    if (wrapped)hash ^= (wrapWidth + 1) * 2654435761u;
+    return hash ^ (Uint32)(f ^ (f >> 16));
+}
+
+void gf2d_font_run_unlink(TextRun *run)
+{
+    if (run->newer)run->newer->older = run->older;
+    else font_manager.newest = run->older;
+    if (run->older)run->older->newer = run->newer;
+    else font_manager.oldest = run->newer;
+    run->newer = run->older = NULL;
+}
+
+void gf2d_font_run_link_newest(TextRun *run)
+{
+    run->older = font_manager.newest;
+    run->newer = NULL;
+    if (font_manager.newest)font_manager.newest->newer = run;
+    else font_manager.oldest = run;
+    font_manager.newest = run;
+}
+
+void gf2d_font_run_remove(TextRun *run)
+{
+    TextRun **link;
+    if (!run)return;
+    for (link = &font_manager.runs[run->hash & (GF2D_FONT_RUN_BUCKETS - 1)]; *link; link = &(*link)->next)
     {
-        slog("cannot draw text, no font provided");
-        return;
+        if (*link != run)continue;
+        *link = run->next;
+        break;
     }
-    
-    image = gf2d_font_image_get(text,color,font);
-    
-    if (image != NULL)
-    {
-        image->last_used = SDL_GetTicks();
-        gf2d_sprite_draw_full(
-            image->image,
-            position,
-            gfc_vector2d(1,1),
-            gfc_vector2d(0,0),
-            0,
-            gfc_vector2d(0,0),
-            gfc_color(1,1,1,1),
-            gfc_vector4d(0,0,0,0),
-            0);
-        return;
+    gf2d_font_run_unlink(run);
+    font_manager.run_bytes -= run->bytes;
+    gf3d_memory_free(run);
+}
+
+/**
+ * @brief allocate a run with room for its text and extra bytes after the struct, and copy the text in
+ */
+TextRun *gf2d_font_run_alloc(Font *font,const char *text,Uint32 hash,size_t extra)
+{
+    size_t textSize,bytes;
+    TextRun *run;
+    textSize = strlen(text) + 1;
+    bytes = sizeof(TextRun) + extra + textSize;
+    run = gf3d_memory_alloc_array(MT_Font,bytes,1);
+    if (!run)return NULL;
+    run->text = (char *)(run + 1) + extra;
+    memcpy(run->text,text,textSize);
+    run->hash = hash;
+    run->font = font;
+    run->bytes = bytes;
+    return run;
+}
+
+/**
+ * @brief lay out a single line into a new run
+ */
+TextRun *gf2d_font_run_new(Font *font,const char *text,Uint32 hash)
+{
+    Uint32 codepoints = 0;
+    const char *c = text;
+    TextRun *run;
+    while (gf2d_font_utf8_next(&c))codepoints++;
+    run = gf2d_font_run_alloc(font,text,hash,codepoints * (sizeof(SpriteQuad) + 1));
+    if (!run)return NULL;
+    run->quads = (SpriteQuad *)(run + 1);
+    run->pages = (Uint8 *)(run->quads + codepoints);
+    run->count = gf2d_font_layout(font,text,strlen(text),run->quads,run->pages,&run->width);
+    return run;
+}
+
+/**
+ * @brief break text into lines no wider than wrapWidth, at spaces, tabs and newlines
+ * @note a word wider than wrapWidth gets a line to itself
+ */
+TextRun *gf2d_font_run_wrap_new(Font *font,const char *text,Uint32 wrapWidth,Uint32 hash)
+{
+    Uint32 i,maxLines = 1;
+    Uint32 wordStart;
+    Uint8 open = 0;
+    int width,lineWidth = 0;
+    TextRunLine *line = NULL;
+    TextRun *run;
+    // every line but the first starts after a break character
+    for (i = 0; text[i]; i++)
+    {
+        if ((text[i] == ' ')||(text[i] == '\t')||(text[i] == '\n'))maxLines++;
+    }
+    run = gf2d_font_run_alloc(font,text,hash,maxLines * sizeof(TextRunLine));
+    if (!run)return NULL;
+    run->wrapped = 1;
+    run->wrapWidth = wrapWidth;
+    run->lines = (TextRunLine *)(run + 1);
+    i = 0;
+    while (text[i])
+    {
+        if (text[i] == '\n')
+        {
+            if (open)run->width = MAX(run->width,lineWidth);
+            else
+            {
+                // a blank line
+                line = &run->lines[run->lineCount++];
+                line->start = i;
+                line->length = 0;
+            }
+            open = 0;
+            i++;
+            continue;
+        }
+        if ((text[i] == ' ')||(text[i] == '\t'))
+        {
+            i++;
+            continue;
+        }
+        wordStart = i;
+        while ((text[i])&&(text[i] != ' ')&&(text[i] != '\t')&&(text[i] != '\n'))i++;
+        if (open)
+        {
+            gf2d_font_layout(font,&text[line->start],i - line->start,NULL,NULL,&width);
+            if (width <= (int)wrapWidth)
+            {
+                line->length = i - line->start;
+                lineWidth = width;
+                continue;
+            }
+            run->width = MAX(run->width,lineWidth);
+        }
+        line = &run->lines[run->lineCount++];
+        line->start = wordStart;
+        line->length = i - wordStart;
+        gf2d_font_layout(font,&text[wordStart],line->length,NULL,NULL,&lineWidth);
+        open = 1;
+    }
+    if (open)run->width = MAX(run->width,lineWidth);
+    return run;
+}
+
+/**
+ * @brief get text laid out for a font, laying it out if it is not cached
+ * @note the least recently used runs are evicted to keep the cache under its budget
+ * @param wrapped if set the text is broken into lines to fit wrapWidth, otherwise it is laid out as one line
+ */
+TextRun *gf2d_font_run_get(Font *font,const char *text,Uint8 wrapped,Uint32 wrapWidth)
+{
+    Uint32 hash;
+    TextRun *run;
+    TextRun **bucket;
+    hash = gf2d_font_run_hash(font,text,wrapped,wrapWidth);
+    bucket = &font_manager.runs[hash & (GF2D_FONT_RUN_BUCKETS - 1)];
+    for (run = *bucket; run; run = run->next)
+    {
+        if ((run->hash != hash)||(run->font != font)||(run->wrapped != wrapped))continue;
+        if ((wrapped)&&(run->wrapWidth != wrapWidth))continue;
+        if (strcmp(run->text,text) != 0)continue;
+        gf3d_render_stats_add(RS_TextCacheHits,1);
+        if (run != font_manager.newest)
+        {
+            gf2d_font_run_unlink(run);
+            gf2d_font_run_link_newest(run);
+        }
+        return run;
+    }
+    gf3d_render_stats_add(RS_TextCacheMisses,1);
+    if (wrapped)run = gf2d_font_run_wrap_new(font,text,wrapWidth,hash);
+    else run = gf2d_font_run_new(font,text,hash);
+    if (!run)return NULL;
+    run->next = *bucket;
+    *bucket = run;
+    gf2d_font_run_link_newest(run);
+    font_manager.run_bytes += run->bytes;
+    while ((font_manager.run_bytes > font_manager.run_budget)&&(font_manager.oldest != run)&&(font_manager.oldest != font_manager.pinned))
+    {
+        gf2d_font_run_remove(font_manager.oldest);
     }
+    return run;
+}
 
-    surface = TTF_RenderUTF8_Blended(font->font, text, gfc_color_to_sdl(color));
-    if (!surface)
+/**
+ * @brief how tall each line of wrapped text is
+ */
+int gf2d_font_line_height(Font *font)
+{
+    return TTF_FontHeight(font->font) + font_manager.row_padding;
+}
+
+/**
+ * @brief how many lines of wrapped text fit in a height, 0 for no limit.  The first line is always shown
+ */
+Uint32 gf2d_font_lines_in_height(Font *font,TextRun *run,Uint32 h)
+{
+    Uint32 fit;
+    if (!h)return run->lineCount;
+    fit = MAX(1,h / gf2d_font_line_height(font));
+    return MIN(fit,run->lineCount);
+}
+
+void gf2d_font_draw_line(char *text,Font *font,GFC_Color color, GFC_Vector2D position)
+{
+    Uint32 i;
+    TextRun *run;
+    if (!text)
     {
+        slog("cannot draw text, none provided");
         return;
     }
-    
-    sprite = gf2d_sprite_from_surface(surface,0,0,0);
-    if (!sprite)
+    if (!gf2d_font_ready(font))
     {
-        slog("cannot draw text '%s', failed to make overlay sprite",text);
-        SDL_FreeSurface(surface);
+        slog("cannot draw text, no font provided");
         return;
     }
-    gf2d_sprite_draw_full(
-        sprite,
-        position,
-        gfc_vector2d(1,1),
-        gfc_vector2d(0,0),
-        0,
-        gfc_vector2d(0,0),
-        gfc_color(1,1,1,1),
-        gfc_vector4d(0,0,0,0),
-        0);
-
-    gf2d_font_image_new(sprite,text,color,font);
+    run = gf2d_font_run_get(font,text,0,0);
+    if (!run)return;
+    for (i = 0; i < run->count; i += GF2D_FONT_LINE_QUADS)
+    {
+        gf2d_font_draw_quads(font->atlas,&run->quads[i],&run->pages[i],MIN(run->count - i,GF2D_FONT_LINE_QUADS),position,color);
+    }
+    gf3d_render_stats_add(RS_GlyphsDrawn,run->count);
 }
 
 GFC_Vector2D gf2d_font_get_bounds_tag(char *text,FontTypes tag)
@@ -406,38 +871,20 @@ GFC_Vector2D gf2d_font_get_bounds_tag(char *text,FontTypes tag)
 
 GFC_Vector2D gf2d_font_get_bounds(char *text,Font *font)
 {
-    int x = -1,y = -1;
+    TextRun *run;
     if (!text)
     {
         slog("cannot size text, none provided");
         return gfc_vector2d(-1,-1);
     }
-    if (!font)
+    if (!gf2d_font_ready(font))
     {
         slog("cannot size text, no font provided");
         return gfc_vector2d(-1,-1);
     }
-    
-    TTF_SizeUTF8(font->font, text, &x,&y);
-    return gfc_vector2d(x,y);
-}
-
-void gf2d_font_chomp(char *text,int length,int strl)
-{
-    int i;
-    if (!text)return;
-    for(i = 0;i < strl - length;i++)
-    {
-        text[i] = text[i + length];
-    }
-    if (i > 0)
-    {
-        text[i - 1] = '\0';/*null terminate in case its overwritten*/
-    }
-    else
-    {
-        text[0] = '\0';
-    }
+    run = gf2d_font_run_get(font,text,0,0);
+    if (!run)return gfc_vector2d(-1,-1);
+    return gfc_vector2d(run->width,TTF_FontHeight(font->font));
 }
 
 GFC_Rect gf2d_font_get_text_wrap_bounds_tag(
@@ -458,103 +905,59 @@ GFC_Rect gf2d_font_get_text_wrap_bounds(
 )
 {
     GFC_Rect r = {0,0,0,0};
-    GFC_TextBlock textline;
-    GFC_TextBlock temptextline;
-    GFC_TextBlock tempBuffer;
-    GFC_TextBlock text;
-    GFC_TextLine word;
-    Bool whitespace;
-    Uint8 init = 0;
-    int tw = 0, th = 0;
-    int drawheight = 0;
-    int i = 0;
-    int space = 0;
-    int lindex = 0;
+    TextRun *run;
     if((thetext == NULL)||(thetext[0] == '\0'))
     {
         return r;
     }
-    if (font == NULL)
+    if (!gf2d_font_ready(font))
     {
         slog("no font provided for draw.");
         return r;
     }
-    
-    gfc_block_cpy(text,thetext);
-    temptextline[0] = '\0';
-    do
+    run = gf2d_font_run_get(font,thetext,1,w);
+    if (!run)return r;
+    r.w = run->width;
+    r.h = gf2d_font_lines_in_height(font,run,h) * gf2d_font_line_height(font);
+    return r;
+}
+
+/**
+ * @brief check that wrapped text is measured as wide as its widest line, whichever way the lines end
+ * @note run at startup in debug, failures are logged
+ */
+void gf2d_font_wrap_self_test()
+{
+    int i;
+    Font *font = NULL;
+    GFC_Rect bounds;
+    GFC_Vector2D widest;
+    // the widest line ends in a newline, and so does the text
+    char multiline[] = "short\nthe widest line of them all\nmid\n";
+    char single[] = "the widest line of them all\n";
+    char line[] = "the widest line of them all";
+
+    for (i = 0; i < FT_MAX; i++)
     {
-        space = 0;
-        i = 0;
-        whitespace = false;
-        do
-        {
-            if(sscanf(&text[i],"%c",&word[0]) == EOF)break;
-            if(word[0] == ' ')
-            {
-                space++;
-                whitespace = true;
-            }
-            if(word[0] == '\t')
-            {
-                space+=2;
-                whitespace = true;
-            }
-            i++;
-        }while(whitespace);
-        
-        if(sscanf(text,"%s",word) == EOF)
+        if (gf2d_font_ready(font_manager.font_tags[i]))
         {
+            font = font_manager.font_tags[i];
             break;
         }
-        gf2d_font_chomp(text,strlen(word) + 1,GFCTEXTLEN);
-        strncpy(textline,temptextline,GFCTEXTLEN);/*keep the last line that worked*/
-        for(i = 0;i < (space - 1);i++)
-        {
-            gfc_block_sprintf(tempBuffer,"%s%c",temptextline,' '); /*add spaces*/
-            gfc_block_cpy(temptextline,tempBuffer);
-        }
-        if (init)
-        {
-            gfc_block_sprintf(tempBuffer,"%s %s",temptextline,word); /*add a word*/
-        }else 
-        {
-            gfc_block_cpy(tempBuffer,word); /*add a word*/
-            init = 1;
-        }
-        gfc_block_cpy(temptextline,tempBuffer);
-        TTF_SizeText(font->font, temptextline, &tw, &th); /*see how big it is now*/
-        th += font_manager.row_padding;
-        lindex += strlen(word);
-        if(tw > w)         /*see if we have gone over*/
-        {
-            drawheight += th;
-            if (h != 0)
-            {
-                if ((drawheight + th) > h)
-                {
-                    break;
-                }
-            }
-            gfc_block_sprintf(temptextline,"%s",word); /*add a word*/
-        }
-        else if (tw > r.w)
-        {
-            r.w = tw;
-        }
-    }while(1);
-    r.h = drawheight + th;
-    return r;
+    }
+    if (!font)return;
+    widest = gf2d_font_get_bounds(line,font);
+    bounds = gf2d_font_get_text_wrap_bounds(multiline,font,100000,100000);
+    if (bounds.w != widest.x)slog("font self test: multiline text is %i wide, its widest line is %i",(int)bounds.w,(int)widest.x);
+    bounds = gf2d_font_get_text_wrap_bounds(single,font,100000,100000);
+    if (bounds.w != widest.x)slog("font self test: a line ending in a newline is %i wide, should be %i",(int)bounds.w,(int)widest.x);
 }
 
-
-
 void gf2d_font_draw_text_wrap_tag(char *text,FontTypes tag,GFC_Color color, GFC_Rect block)
 {
     gf2d_font_draw_text_wrap(text,block,color, gf2d_font_get_by_tag(tag));
 }
 
-
 void gf2d_font_draw_text_wrap(
     char    *thetext,
     GFC_Rect     block,
@@ -562,100 +965,35 @@ void gf2d_font_draw_text_wrap(
     Font    *font
 )
 {
-    GFC_TextBlock textline = "";
-    GFC_TextBlock temptextline = "";
-    GFC_TextBlock tempBuffer = "";
-    GFC_TextBlock text;
-    GFC_TextLine word;
-    Bool whitespace;
-    Uint8 init = 0;
-    int drawheight = block.y;
-    int w,h = 0;
-    int row = 0;
-    int i;
-    int space;
-    int lindex = 0;
+    Uint32 i,count,length;
+    int lineHeight;
+    GFC_TextBlock line;
+    TextRun *run;
     if ((thetext == NULL)||(thetext[0] == '\0'))
     {
         slog("no text provided for draw.");
         return;
     }
-    if (font == NULL)
+    if (!gf2d_font_ready(font))
     {
         slog("no font provided for draw.");
         return;
     }
-    if (font->font == NULL)
+    run = gf2d_font_run_get(font,thetext,1,block.w);
+    if (!run)return;
+    lineHeight = gf2d_font_line_height(font);
+    count = gf2d_font_lines_in_height(font,run,block.h);
+    font_manager.pinned = run;
+    for (i = 0; i < count; i++)
     {
-        slog("bad Font provided for draw.");
-        return;
+        if (!run->lines[i].length)continue;
+        // each line is its own cached run, the wrapped run only holds where they break
+        length = MIN(run->lines[i].length,GFCTEXTLEN - 1);
+        memcpy(line,&run->text[run->lines[i].start],length);
+        line[length] = '\0';
+        gf2d_font_draw_line(line,font,color,gfc_vector2d(block.x,block.y + i * lineHeight));
     }
-
-    gfc_block_cpy(text,thetext);
-    do
-    {
-        space = 0;
-        i = 0;
-        do
-        {
-            whitespace = false;
-            if(sscanf(&text[i],"%c",&word[0]) == EOF)break;
-            if(word[0] == ' ')
-            {
-                space++;
-                whitespace = true;
-            }
-            if(word[0] == '\t')
-            {
-                space+=2;
-                whitespace = true;
-            }
-            i++;
-        }while (whitespace);
-        if (sscanf(text,"%s",word) == EOF)
-        {
-            block.y=drawheight + (h*row);
-            gf2d_font_draw_line(temptextline,font,color, gfc_vector2d(block.x,block.y));
-            return;
-        }
-        
-        gf2d_font_chomp(text,strlen(word) + space,GFCTEXTLEN);
-        strncpy(textline,temptextline,GFCTEXTLEN);/*keep the last line that worked*/
-        for (i = 0;i < (space - 1);i++)
-        {
-            gfc_block_sprintf(tempBuffer,"%s%c",temptextline,' '); /*add spaces*/
-            gfc_block_cpy(temptextline,tempBuffer);
-        }
-        if (init)
-        {
-            gfc_block_sprintf(tempBuffer,"%s %s",temptextline,word); /*add a word*/
-        }else 
-        {
-            gfc_block_cpy(tempBuffer,word); /*add a word*/
-            init = 1;
-        }
-        gfc_block_cpy(temptextline,tempBuffer);
-        TTF_SizeText(font->font, temptextline, &w, &h); /*see how big it is now*/
-        h += font_manager.row_padding;
-        lindex += strlen(word);
-        if(w > block.w)         /*see if we have gone over*/
-        {
-            block.y=drawheight + (h*row);
-            gf2d_font_draw_line(textline,font,color, gfc_vector2d(block.x,block.y));
-            row++;
-            /*draw the line and get ready for the next line*/
-            if (block.h != 0)
-            {
-                if ((drawheight + (h*row)) > (block.y + block.h))
-                {
-                    break;
-                }
-            }
-            gfc_block_sprintf(temptextline,"%s",word); /*add a word*/
-        }
-    }while(1);
-    
+    font_manager.pinned = NULL;
 }
 
-
 /*eol@eof*/
@@ -6,13 +6,18 @@
 #include "gfc_shape.h"
 
 #include "gf3d_buffers.h"
+#include "gf3d_memory.h"
 #include "gf3d_swapchain.h"
 #include "gf3d_vgraphics.h"
 #include "gf3d_pipeline.h"
 #include "gf3d_commands.h"
+#include "gf3d_log.h"
+#include "gf3d_render_stats.h"
+#include "gf2d_atlas.h"
 #include "gf2d_sprite.h"
 
-#define SPRITE_ATTRIBUTE_COUNT 2
+#define SPRITE_ATTRIBUTE_COUNT 3
+#define SPRITE_MAX_QUADS 16384  /**<per frame, the most 16 bit indices can reach*/
 
 extern int __DEBUG;
 
@@ -35,6 +40,7 @@ typedef struct
 {
     GFC_Vector2D vertex;
     GFC_Vector2D texel;
+    GFC_Vector4D color;
 }SpriteVertex;
 
 typedef struct
@@ -49,25 +55,23 @@ typedef struct
     Uint32          chain_length;     /**<length of swap chain*/
     VkDevice        device;           /**<logical vulkan device*/
     Pipeline       *pipe;             /**<the pipeline associated with sprite rendering*/
-    VkBuffer        faceBuffer;       /**<memory handle for the face buffer (always two faces)*/
-    VkDeviceMemory  faceBufferMemory; /**<memory habdle for tge face memory*/
     VkVertexInputAttributeDescription   attributeDescriptions[SPRITE_ATTRIBUTE_COUNT];
     VkVertexInputBindingDescription     bindingDescription;
     float           drawOrder;
+    VkBuffer       *quadBuffers;      /**<host visible quad vertices, one buffer per swap chain frame*/
+    VkDeviceMemory *quadBufferMemory;
+    SpriteVertex  **quadVertices;     /**<each quad buffer, kept mapped*/
+    VkBuffer        quadFaceBuffer;   /**<two faces for every quad a frame can hold*/
+    VkDeviceMemory  quadFaceBufferMemory;
+    Uint32          quadCount;        /**<quads written to the current frame's buffer*/
+    Texture        *batchTexture;     /**<what the open batch samples*/
+    Uint32          batchStart;       /**<the first quad of the open batch*/
+    Uint32          batchCount;       /**<quads in the open batch, 0 if there is none*/
 }SpriteManager;
 
 
-SpriteUBO gf2d_sprite_get_uniform_buffer(
-    Sprite *sprite,
-    GFC_Vector2D position,
-    GFC_Vector2D scale,
-    GFC_Vector3D rotation,
-    GFC_Color color,
-    GFC_Vector4D clip,
-    GFC_Vector2D flip,
-    Uint32 frame);
-void gf2d_sprite_create_vertex_buffer(Sprite *sprite);
 void gf2d_sprite_delete(Sprite *sprite);
+void gf2d_sprite_quad_buffers_create();
 
 static SpriteManager gf2d_sprite = {0};
 
@@ -81,15 +85,27 @@ void gf2d_sprite_manager_close()
     }
     if (gf2d_sprite.sprite_list)
     {
-        free(gf2d_sprite.sprite_list);
+        gf3d_memory_free(gf2d_sprite.sprite_list);
+    }
+    for (i = 0; (gf2d_sprite.quadBuffers)&&(i < gf2d_sprite.chain_length); i++)
+    {
+        if (gf2d_sprite.quadBuffers[i] != VK_NULL_HANDLE)vkDestroyBuffer(gf2d_sprite.device, gf2d_sprite.quadBuffers[i], NULL);
+        if (gf2d_sprite.quadBufferMemory[i] != VK_NULL_HANDLE)
+        {
+            vkUnmapMemory(gf2d_sprite.device, gf2d_sprite.quadBufferMemory[i]);
+            gf3d_memory_vk_free(gf2d_sprite.device, gf2d_sprite.quadBufferMemory[i]);
+        }
     }
-    if (gf2d_sprite.faceBuffer != VK_NULL_HANDLE)
+    gf3d_memory_free(gf2d_sprite.quadBuffers);
+    gf3d_memory_free(gf2d_sprite.quadBufferMemory);
+    gf3d_memory_free(gf2d_sprite.quadVertices);
+    if (gf2d_sprite.quadFaceBuffer != VK_NULL_HANDLE)
     {
-        vkDestroyBuffer(gf2d_sprite.device, gf2d_sprite.faceBuffer, NULL);
+        vkDestroyBuffer(gf2d_sprite.device, gf2d_sprite.quadFaceBuffer, NULL);
     }
-    if (gf2d_sprite.faceBufferMemory != VK_NULL_HANDLE)
+    if (gf2d_sprite.quadFaceBufferMemory != VK_NULL_HANDLE)
     {
-        vkFreeMemory(gf2d_sprite.device, gf2d_sprite.faceBufferMemory, NULL);
+        gf3d_memory_vk_free(gf2d_sprite.device, gf2d_sprite.quadFaceBufferMemory);
     }
 
     memset(&gf2d_sprite,0,sizeof(SpriteManager));
@@ -98,12 +114,7 @@ void gf2d_sprite_manager_close()
 
 void gf2d_sprite_manager_init(Uint32 max_sprites)
 {
-    void* data;
     Uint32 count;
-    SpriteFace faces[2];
-    size_t bufferSize;    
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
 
     if (max_sprites == 0)
     {
@@ -111,32 +122,11 @@ void gf2d_sprite_manager_init(Uint32 max_sprites)
         return;
     }
     gf2d_sprite.chain_length = gf3d_swapchain_get_chain_length();
-    gf2d_sprite.sprite_list = (Sprite *)gfc_allocate_array(sizeof(Sprite),max_sprites);
+    gf2d_sprite.sprite_list = (Sprite *)gf3d_memory_alloc_array(MT_Sprite,sizeof(Sprite),max_sprites);
     gf2d_sprite.max_sprites = max_sprites;
     gf2d_sprite.device = gf3d_vgraphics_get_default_logical_device();
     
-    // setup the face buffer, which will be used for ALL sprites
-    faces[0].verts[0] = 2;
-    faces[0].verts[1] = 1;
-    faces[0].verts[2] = 0;
-    faces[1].verts[0] = 1;
-    faces[1].verts[1] = 3;
-    faces[1].verts[2] = 2;
-
-    bufferSize = sizeof(SpriteFace) * 2;
-    
-    gf3d_buffer_create(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory);
-
-    vkMapMemory(gf2d_sprite.device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, faces, (size_t) bufferSize);
-    vkUnmapMemory(gf2d_sprite.device, stagingBufferMemory);
-
-    gf3d_buffer_create(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &gf2d_sprite.faceBuffer, &gf2d_sprite.faceBufferMemory);
-
-    gf3d_buffer_copy(stagingBuffer, gf2d_sprite.faceBuffer, bufferSize);
-
-    vkDestroyBuffer(gf2d_sprite.device, stagingBuffer, NULL);
-    vkFreeMemory(gf2d_sprite.device, stagingBufferMemory, NULL);
+    gf2d_sprite_quad_buffers_create();
 
     gf2d_sprite_get_attribute_descriptions(&count);
     gf2d_sprite.pipe = gf3d_pipeline_create_from_config(
@@ -155,12 +145,127 @@ void gf2d_sprite_manager_init(Uint32 max_sprites)
     atexit(gf2d_sprite_manager_close);
 }
 
+/**
+ * @brief make the per frame quad vertex buffers and the face buffer they all share
+ * @note quad q uses vertices 4q through 4q + 3, so a batch of quads is drawn by where its faces start
+ */
+void gf2d_sprite_quad_buffers_create()
+{
+    Uint32 i;
+    void *data;
+    SpriteFace *faces;
+    size_t bufferSize;
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+
+    gf2d_sprite.quadBuffers = gf3d_memory_alloc_array(MT_Sprite,sizeof(VkBuffer),gf2d_sprite.chain_length);
+    gf2d_sprite.quadBufferMemory = gf3d_memory_alloc_array(MT_Sprite,sizeof(VkDeviceMemory),gf2d_sprite.chain_length);
+    gf2d_sprite.quadVertices = gf3d_memory_alloc_array(MT_Sprite,sizeof(SpriteVertex *),gf2d_sprite.chain_length);
+    if ((!gf2d_sprite.quadBuffers)||(!gf2d_sprite.quadBufferMemory)||(!gf2d_sprite.quadVertices))
+    {
+        slog("failed to allocate sprite quad buffers");
+        return;
+    }
+    bufferSize = sizeof(SpriteVertex) * 4 * SPRITE_MAX_QUADS;
+    for (i = 0; i < gf2d_sprite.chain_length; i++)
+    {
+        if (!gf3d_buffer_create(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &gf2d_sprite.quadBuffers[i], &gf2d_sprite.quadBufferMemory[i], MT_Sprite))
+        {
+            slog("failed to create sprite quad buffer");
+            return;
+        }
+        vkMapMemory(gf2d_sprite.device, gf2d_sprite.quadBufferMemory[i], 0, bufferSize, 0, (void **)&gf2d_sprite.quadVertices[i]);
+    }
+
+    bufferSize = sizeof(SpriteFace) * 2 * SPRITE_MAX_QUADS;
+    gf3d_buffer_create(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory, MT_Staging);
+    vkMapMemory(gf2d_sprite.device, stagingBufferMemory, 0, bufferSize, 0, &data);
+        faces = (SpriteFace *)data;
+        for (i = 0; i < SPRITE_MAX_QUADS; i++)
+        {
+            faces[i * 2].verts[0] = i * 4 + 2;
+            faces[i * 2].verts[1] = i * 4 + 1;
+            faces[i * 2].verts[2] = i * 4;
+            faces[i * 2 + 1].verts[0] = i * 4 + 1;
+            faces[i * 2 + 1].verts[1] = i * 4 + 3;
+            faces[i * 2 + 1].verts[2] = i * 4 + 2;
+        }
+    vkUnmapMemory(gf2d_sprite.device, stagingBufferMemory);
+
+    gf3d_buffer_create(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &gf2d_sprite.quadFaceBuffer, &gf2d_sprite.quadFaceBufferMemory, MT_Sprite);
+    gf3d_buffer_copy(stagingBuffer, gf2d_sprite.quadFaceBuffer, bufferSize);
+
+    vkDestroyBuffer(gf2d_sprite.device, stagingBuffer, NULL);
+    gf3d_memory_vk_free(gf2d_sprite.device, stagingBufferMemory);
+}
+
 void gf3d_sprite_reset_pipes()
 {
     Uint32 bufferFrame = gf3d_vgraphics_get_current_buffer_frame();
     
     gf3d_pipeline_reset_frame(gf2d_sprite.pipe,bufferFrame);
     gf2d_sprite.drawOrder = 0;
+    gf2d_sprite.quadCount = 0;
+    gf2d_sprite.batchCount = 0;
+    gf2d_sprite.batchTexture = NULL;
+}
+
+void gf2d_sprite_batch_flush()
+{
+    SpriteUBO spriteUBO = {0};
+    Uint32 bufferFrame;
+    Texture *texture = gf2d_sprite.batchTexture;
+
+    if ((!gf2d_sprite.batchCount)||(!texture))return;
+    bufferFrame = gf3d_vgraphics_get_current_buffer_frame();
+    // the vertices are already where they are drawn and carry their own color, so the uniforms only carry the screen
+    spriteUBO.size = gfc_vector2d(texture->width,texture->height);
+    spriteUBO.extent = gf3d_vgraphics_get_view_extent_as_vector2d();
+    spriteUBO.colorMod = gfc_vector4d(1,1,1,1);
+    spriteUBO.scale = gfc_vector2d(1,1);
+    gfc_matrix4_identity(spriteUBO.rotation);
+    spriteUBO.drawOrder = gf2d_sprite.drawOrder;
+    gf2d_sprite.drawOrder += 0.000000001;
+
+    gf3d_pipeline_queue_render_range(
+        gf2d_sprite.pipe,
+        gf2d_sprite.quadBuffers[bufferFrame],
+        gf2d_sprite.batchStart * 6,
+        gf2d_sprite.batchCount * 6,
+        gf2d_sprite.quadFaceBuffer,
+        &spriteUBO,
+        texture);
+    gf3d_render_stats_add(RS_SpriteBatches,1);
+    gf2d_sprite.batchCount = 0;
+}
+
+/**
+ * @brief make room for quads in the batch for a texture, starting a new batch if it changed
+ * @return NULL if the frame's quad buffer is full, where to write the quads' vertices otherwise
+ */
+SpriteVertex *gf2d_sprite_batch_reserve(Texture *texture,Uint32 count)
+{
+    SpriteVertex *vertices;
+    if ((!gf2d_sprite.quadVertices)||(!gf2d_sprite.quadFaceBuffer))return NULL;
+    if (gf2d_sprite.quadCount + count > SPRITE_MAX_QUADS)
+    {
+        gf3d_log(LL_Warning,"sprite quad buffer full, dropping %u quads",count);
+        return NULL;
+    }
+    if ((gf2d_sprite.batchCount)&&(texture != gf2d_sprite.batchTexture))
+    {
+        gf2d_sprite_batch_flush();
+    }
+    if (!gf2d_sprite.batchCount)
+    {
+        gf2d_sprite.batchTexture = texture;
+        gf2d_sprite.batchStart = gf2d_sprite.quadCount;
+    }
+    vertices = gf2d_sprite.quadVertices[gf3d_vgraphics_get_current_buffer_frame()] + gf2d_sprite.quadCount * 4;
+    gf2d_sprite.quadCount += count;
+    gf2d_sprite.batchCount += count;
+    gf3d_render_stats_add(RS_SpriteQuads,count);
+    return vertices;
 }
 
 void gf3d_sprite_submit_pipe_commands()
@@ -210,7 +315,7 @@ Sprite * gf2d_sprite_from_surface(SDL_Surface *surface,int frame_width,int frame
     {
         return NULL;
     }
-    sprite->texture = gf3d_texture_convert_surface(surface);
+    sprite->texture = gf3d_texture_convert_surface_full(surface,0,TR_GpuOnly);
     if (!sprite->texture)
     {
         gf2d_sprite_free(sprite);
@@ -224,8 +329,7 @@ Sprite * gf2d_sprite_from_surface(SDL_Surface *surface,int frame_width,int frame
     sprite->heightPercent = sprite->frameHeight/ (float)sprite->texture->height;
     if (frames_per_line)sprite->framesPerLine = frames_per_line;
     else sprite->framesPerLine = 1;
-    gf2d_sprite_create_vertex_buffer(sprite);
-    sprite->surface = surface;
+    sprite->surface = sprite->texture->surface;
     return sprite;
 }
 
@@ -257,6 +361,7 @@ Sprite *gf2d_sprite_parse(SJson *json)
 
 Sprite * gf2d_sprite_load(const char * filename,int frame_width,int frame_height, Uint32 frames_per_line)
 {
+    GFC_Rect image;
     Sprite *sprite;
     sprite = gf2d_sprite_get_by_filename(filename);
     if (sprite)
@@ -269,16 +374,23 @@ Sprite * gf2d_sprite_load(const char * filename,int frame_width,int frame_height
     {
         return NULL;
     }
-    sprite->texture = gf3d_texture_load(filename);
+    sprite->texture = gf2d_atlas_get_image(filename,&image);
     if (!sprite->texture)
     {
-        slog("gf2d_sprite_load: failed to load texture for sprite");
-        gf2d_sprite_free(sprite);
-        return NULL;
+        sprite->texture = gf3d_texture_load(filename);
+        if (!sprite->texture)
+        {
+            slog("gf2d_sprite_load: failed to load texture for sprite");
+            gf2d_sprite_free(sprite);
+            return NULL;
+        }
+        gfc_rect_set(image,0,0,sprite->texture->width,sprite->texture->height);
     }
     sprite->surface = sprite->texture->surface;
-    if (frame_width <= 0)frame_width = sprite->texture->width;
-    if (frame_height <= 0)frame_height = sprite->texture->height;
+    sprite->atlasX = image.x;
+    sprite->atlasY = image.y;
+    if (frame_width <= 0)frame_width = image.w;
+    if (frame_height <= 0)frame_height = image.h;
     sprite->frameWidth = frame_width;
     sprite->frameHeight = frame_height;
     sprite->widthPercent = sprite->frameWidth / (float)sprite->texture->width;
@@ -286,7 +398,6 @@ Sprite * gf2d_sprite_load(const char * filename,int frame_width,int frame_height
     if (frames_per_line)sprite->framesPerLine = frames_per_line;
     else sprite->framesPerLine = 1;
     gfc_line_cpy(sprite->filename,filename);
-    gf2d_sprite_create_vertex_buffer(sprite);
     return sprite;
 }
 
@@ -300,16 +411,10 @@ void gf2d_sprite_free(Sprite *sprite)
 void gf2d_sprite_delete(Sprite *sprite)
 {
     if (!sprite)return;
-    
-    if (sprite->buffer != VK_NULL_HANDLE)
+    if ((gf2d_sprite.batchCount)&&(sprite->texture)&&(sprite->texture == gf2d_sprite.batchTexture)&&(sprite->texture->_refcount <= 1))
     {
-        vkDestroyBuffer(gf2d_sprite.device, sprite->buffer, NULL);
+        gf2d_sprite.batchCount = 0;// drop the open batch rather than draw from a freed texture
     }
-    if (sprite->bufferMemory != VK_NULL_HANDLE)
-    {
-        vkFreeMemory(gf2d_sprite.device, sprite->bufferMemory, NULL);
-    }
-
     gf3d_texture_free(sprite->texture);
     memset(sprite,0,sizeof(Sprite));
 }
@@ -381,88 +486,103 @@ void gf2d_sprite_draw(
     GFC_Vector4D * clip,
     Uint32     frame)
 {
-    SpriteUBO spriteUBO = {0};
+    int i,fpl;
+    float c,sn,px,py;
+    float u0,v0,u1,v1,swap;
+    float x[4],y[4];
+    GFC_Vector4D color;
+    SpriteVertex *vertices;
     GFC_Vector2D drawScale = {1,1};
-    GFC_Vector3D drawRotation = {0,0,0};
-    GFC_Vector2D drawFlip = {0,0};
+    GFC_Vector2D drawCenter = {0,0};
     GFC_Vector4D drawClip = {0,0,0,0};
-    GFC_Color    drawGFC_ColorShift = gfc_color(1,1,1,1);
+    GFC_Color    drawColor = gfc_color(1,1,1,1);
 
     if (!sprite)
     {
-        slog("cannot render a NULL sprite");
+        gf3d_log(LL_Warning,"cannot render a NULL sprite");
         return;
     }
-    
+    if ((!sprite->texture)||(!sprite->texture->width)||(!sprite->texture->height))return;
+
     if (scale)gfc_vector2d_copy(drawScale,(*scale));
-    if (center)
-    {
-        gfc_vector2d_copy(drawRotation,(*center));
-    }
-    if (rotation)drawRotation.z = *rotation;
-    if (flip)gfc_vector2d_copy(drawFlip,(*flip));
-    if (colorShift)drawGFC_ColorShift = *colorShift;
+    if (center)gfc_vector2d_copy(drawCenter,(*center));
+    if (colorShift)drawColor = *colorShift;
     if (clip)gfc_vector4d_copy(drawClip,(*clip));
-    
-    
-    spriteUBO = gf2d_sprite_get_uniform_buffer(
-        sprite,
-        position,
-        drawScale,
-        drawRotation,
-        drawGFC_ColorShift,
-        drawClip,
-        drawFlip,
-        frame);
 
-    gf3d_pipeline_queue_render(
-        gf2d_sprite.pipe,
-        sprite->buffer,
-        6,//its a single quad
-        gf2d_sprite.faceBuffer,
-        &spriteUBO,
-        sprite->texture);
+    vertices = gf2d_sprite_batch_reserve(sprite->texture,1);
+    if (!vertices)return;
+
+    fpl = sprite->framesPerLine ? sprite->framesPerLine : 1;
+    // the frame, cropped by the clip, in pixels of the frame and then of the texture
+    x[0] = x[2] = drawClip.x;
+    x[1] = x[3] = sprite->frameWidth - drawClip.z;
+    y[0] = y[1] = drawClip.y;
+    y[2] = y[3] = sprite->frameHeight - drawClip.w;
+    u0 = (sprite->atlasX + frame%fpl * sprite->frameWidth + x[0]) / (float)sprite->texture->width;
+    u1 = (sprite->atlasX + frame%fpl * sprite->frameWidth + x[1]) / (float)sprite->texture->width;
+    v0 = (sprite->atlasY + frame/fpl * sprite->frameHeight + y[0]) / (float)sprite->texture->height;
+    v1 = (sprite->atlasY + frame/fpl * sprite->frameHeight + y[2]) / (float)sprite->texture->height;
+    if ((flip)&&(flip->x))
+    {
+        swap = u0;u0 = u1;u1 = swap;
+    }
+    if ((flip)&&(flip->y))
+    {
+        swap = v0;v0 = v1;v1 = swap;
+    }
+    color = gfc_color_to_vector4f(drawColor);
+    c = rotation ? cos(*rotation) : 1;
+    sn = rotation ? sin(*rotation) : 0;
+    // rotate clockwise about the center then scale, in the doubled pixel space the shader expects
+    for (i = 0; i < 4; i++)
+    {
+        px = x[i] - drawCenter.x;
+        py = y[i] - drawCenter.y;
+        vertices[i].vertex.x = (drawScale.x * (c * px - sn * py) + drawCenter.x + position.x) * 2;
+        vertices[i].vertex.y = (drawScale.y * (sn * px + c * py) + drawCenter.y + position.y) * 2;
+        vertices[i].color = color;
+    }
+    vertices[0].texel = gfc_vector2d(u0,v0);
+    vertices[1].texel = gfc_vector2d(u1,v0);
+    vertices[2].texel = gfc_vector2d(u0,v1);
+    vertices[3].texel = gfc_vector2d(u1,v1);
 }
 
-void gf2d_sprite_create_vertex_buffer(Sprite *sprite)
+void gf2d_sprite_draw_quads(
+    Texture        *texture,
+    const SpriteQuad *quads,
+    Uint32          count,
+    GFC_Vector2D    position,
+    GFC_Color       color)
 {
-    void *data = NULL;
-    VkDevice device = gf2d_sprite.device;
-    size_t bufferSize;
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    SpriteVertex vertices[] = {
-        {
-            {0,0},
-            {0,0}
-        },
-        {
-            {(sprite->frameWidth + 1)*2,0},
-            {sprite->frameWidth/((float)sprite->texture->width + 0.01),0}
-        },
-        {
-            {0,(sprite->frameHeight + 1)*2},
-            {0,sprite->frameHeight/((float)sprite->texture->height + 0.01)}
-        },
-        {
-            {(sprite->frameWidth + 1)*2,(sprite->frameHeight+ 1)*2},
-            {sprite->frameWidth/((float)sprite->texture->width + 0.01),sprite->frameHeight/((float)sprite->texture->height + 0.01)}
-        }
-    };
-    bufferSize = sizeof(SpriteVertex) * 4;
-    
-    gf3d_buffer_create(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory);
-    
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, vertices, (size_t) bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
-
-    gf3d_buffer_create(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT|VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &sprite->buffer, &sprite->bufferMemory);
-
-    gf3d_buffer_copy(stagingBuffer, sprite->buffer, bufferSize);
-
-    vkDestroyBuffer(device, stagingBuffer, NULL);
-    vkFreeMemory(device, stagingBufferMemory, NULL);    
+    Uint32 i;
+    SpriteVertex *vertices;
+    GFC_Vector4D drawColor;
+    float tw,th,x0,y0,x1,y1;
+
+    if ((!texture)||(!quads)||(!count)||(!texture->width)||(!texture->height))return;
+    vertices = gf2d_sprite_batch_reserve(texture,count);
+    if (!vertices)return;
+    drawColor = gfc_color_to_vector4f(color);
+    tw = texture->width;
+    th = texture->height;
+    // vertex positions are in the same doubled pixel space as a single sprite's
+    for (i = 0; i < count; i++,vertices += 4)
+    {
+        x0 = (position.x + quads[i].dst.x) * 2;
+        y0 = (position.y + quads[i].dst.y) * 2;
+        x1 = x0 + quads[i].dst.w * 2;
+        y1 = y0 + quads[i].dst.h * 2;
+        vertices[0].vertex = gfc_vector2d(x0,y0);
+        vertices[1].vertex = gfc_vector2d(x1,y0);
+        vertices[2].vertex = gfc_vector2d(x0,y1);
+        vertices[3].vertex = gfc_vector2d(x1,y1);
+        vertices[0].texel = gfc_vector2d(quads[i].src.x / tw,quads[i].src.y / th);
+        vertices[1].texel = gfc_vector2d((quads[i].src.x + quads[i].src.w) / tw,quads[i].src.y / th);
+        vertices[2].texel = gfc_vector2d(quads[i].src.x / tw,(quads[i].src.y + quads[i].src.h) / th);
+        vertices[3].texel = gfc_vector2d((quads[i].src.x + quads[i].src.w) / tw,(quads[i].src.y + quads[i].src.h) / th);
+        vertices[0].color = vertices[1].color = vertices[2].color = vertices[3].color = drawColor;
+    }
 }
 
 void gf2d_sprite_draw_to_surface(
@@ -483,6 +603,7 @@ void gf2d_sprite_draw_to_surface(
         slog("no sprite provided to draw");
         return;
     }
+    if (!sprite->surface)sprite->surface = gf3d_texture_get_surface(sprite->texture);
     if (!sprite->surface)
     {
         slog("sprite does not contain surface to draw with");
@@ -504,8 +625,8 @@ void gf2d_sprite_draw_to_surface(
     fpl = (sprite->framesPerLine)?sprite->framesPerLine:1;
     gfc_rect_set(
         cell,
-        frame%fpl * sprite->frameWidth,
-        frame/fpl * sprite->frameHeight,
+        sprite->atlasX + frame%fpl * sprite->frameWidth,
+        sprite->atlasY + frame/fpl * sprite->frameHeight,
         sprite->frameWidth,
         sprite->frameHeight);
     gfc_rect_set(
@@ -521,46 +642,6 @@ void gf2d_sprite_draw_to_surface(
         &target);
 }
 
-SpriteUBO gf2d_sprite_get_uniform_buffer(
-    Sprite *sprite,
-    GFC_Vector2D position,
-    GFC_Vector2D scale,
-    GFC_Vector3D rotation,
-    GFC_Color color,
-    GFC_Vector4D clip,
-    GFC_Vector2D flip,
-    Uint32 frame)
-{
-    SpriteUBO spriteUBO = {0};
-    spriteUBO.size = gfc_vector2d(sprite->texture->width,sprite->texture->height);
-    spriteUBO.extent = gf3d_vgraphics_get_view_extent_as_vector2d();;
-    spriteUBO.colorMod = gfc_color_to_vector4f(color);
-    spriteUBO.position = position;
-    spriteUBO.scale = scale;
-    gfc_matrix4_identity(spriteUBO.rotation);
-    spriteUBO.rotation[0][0] = cos(rotation.z);
-    spriteUBO.rotation[0][1] = sin(rotation.z);
-    spriteUBO.rotation[1][0] = sin(rotation.z) * -1;//clockwise rotation
-    spriteUBO.rotation[1][1] = cos(rotation.z);
-    spriteUBO.drawOrder = gf2d_sprite.drawOrder;
-    gf2d_sprite.drawOrder += 0.000000001;
-    spriteUBO.center.x = rotation.x;
-    spriteUBO.center.y = rotation.y;
-    if (flip.x)
-    {
-        scale.x = fabs(scale.x)*-1;
-    }
-    if (flip.y)
-    {
-        scale.y = fabs(scale.y)*-1;
-    }
-    
-    gfc_vector4d_copy(spriteUBO.clip,clip);
-    spriteUBO.frame_offset.x = (frame%sprite->framesPerLine * sprite->frameWidth)/(float)sprite->texture->width;
-    spriteUBO.frame_offset.y = (frame/sprite->framesPerLine * sprite->frameHeight)/(float)sprite->texture->height;
-    return spriteUBO;
-}
-
 VkVertexInputBindingDescription * gf2d_sprite_get_bind_description()
 {
     gf2d_sprite.bindingDescription.binding = 0;
@@ -581,6 +662,11 @@ VkVertexInputAttributeDescription * gf2d_sprite_get_attribute_descriptions(Uint3
     gf2d_sprite.attributeDescriptions[1].location = 1;
     gf2d_sprite.attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
     gf2d_sprite.attributeDescriptions[1].offset = offsetof(SpriteVertex, texel);
+
+    gf2d_sprite.attributeDescriptions[2].binding = 0;
+    gf2d_sprite.attributeDescriptions[2].location = 2;
+    gf2d_sprite.attributeDescriptions[2].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    gf2d_sprite.attributeDescriptions[2].offset = offsetof(SpriteVertex, color);
     if (count)*count = SPRITE_ATTRIBUTE_COUNT;
     return gf2d_sprite.attributeDescriptions;
 }
@@ -0,0 +1,639 @@
+#include <math.h>
+#include <string.h>
+
+#include "simple_logger.h"
+
+#include "gf3d_memory.h"
+#include "gf3d_arena.h"
+#include "gf3d_aabb_tree.h"
+
+#define AABB_TREE_STACK 256     /**<deep enough for any balanced tree that fits in memory*/
+
+#define aabb_max(a,b) ((a) > (b) ? (a) : (b))
+#define aabb_min(a,b) ((a) < (b) ? (a) : (b))
+
+void gf3d_aabb_tree_free(AABBTree *tree)
+{
+    if (!tree)return;
+    if (tree->nodes)gf3d_memory_free(tree->nodes);
+    gf3d_memory_free(tree);
+}
+
+void gf3d_aabb_tree_link_free_nodes(AABBTree *tree,Uint32 start)
+{
+    Uint32 i;
+    for (i = start; i < tree->nodeCapacity; i++)
+    {
+        tree->nodes[i].parent = (i + 1 < tree->nodeCapacity) ? (Sint32)(i + 1) : AABB_TREE_NULL;
+        tree->nodes[i].height = -1;
+    }
+    tree->freeList = start;
+}
+
+AABBTree *gf3d_aabb_tree_new(Uint32 capacity,float margin)
+{
+    AABBTree *tree;
+    if (!capacity)capacity = 16;
+    tree = gf3d_memory_alloc_array(MT_Entity,sizeof(AABBTree),1);
+    if (!tree)
+    {
+        slog("failed to allocate aabb tree");
+        return NULL;
+    }
+    tree->nodes = gf3d_memory_alloc_array(MT_Entity,sizeof(AABBTreeNode),capacity);
+    if (!tree->nodes)
+    {
+        slog("failed to allocate %i aabb tree nodes",capacity);
+        gf3d_memory_free(tree);
+        return NULL;
+    }
+    tree->nodeCapacity = capacity;
+    tree->root = AABB_TREE_NULL;
+    tree->margin = margin;
+    gf3d_aabb_tree_link_free_nodes(tree,0);
+    return tree;
+}
+
+Sint32 gf3d_aabb_tree_allocate_node(AABBTree *tree)
+{
+    Sint32 index;
+    AABBTreeNode *nodes;
+    if (tree->freeList == AABB_TREE_NULL)
+    {
+        nodes = gf3d_memory_alloc_array(MT_Entity,sizeof(AABBTreeNode),tree->nodeCapacity * 2);
+        if (!nodes)
+        {
+            slog("failed to grow aabb tree to %i nodes",tree->nodeCapacity * 2);
+            return AABB_TREE_NULL;
+        }
+        memcpy(nodes,tree->nodes,sizeof(AABBTreeNode)*tree->nodeCapacity);
+        gf3d_memory_free(tree->nodes);
+        tree->nodes = nodes;
+        tree->nodeCapacity *= 2;
+        gf3d_aabb_tree_link_free_nodes(tree,tree->nodeCapacity / 2);
+    }
+    index = tree->freeList;
+    tree->freeList = tree->nodes[index].parent;
+    memset(&tree->nodes[index],0,sizeof(AABBTreeNode));
+    tree->nodes[index].parent = AABB_TREE_NULL;
+    tree->nodes[index].child1 = AABB_TREE_NULL;
+    tree->nodes[index].child2 = AABB_TREE_NULL;
+    tree->nodeCount++;
+    return index;
+}
+
+void gf3d_aabb_tree_release_node(AABBTree *tree,Sint32 index)
+{
+    tree->nodes[index].parent = tree->freeList;
+    tree->nodes[index].height = -1;
+    tree->nodes[index].data = NULL;
+    tree->freeList = index;
+    tree->nodeCount--;
+}
+
+static void gf3d_aabb_tree_union(float *outMin,float *outMax,const AABBTreeNode *a,const AABBTreeNode *b)
+{
+    int i;
+    for (i = 0; i < 3; i++)
+    {
+        outMin[i] = aabb_min(a->min[i],b->min[i]);
+        outMax[i] = aabb_max(a->max[i],b->max[i]);
+    }
+}
+
+static float gf3d_aabb_tree_area(const float *min,const float *max)
+{
+    float dx = max[0] - min[0];
+    float dy = max[1] - min[1];
+    float dz = max[2] - min[2];
+    return 2 * (dx * dy + dy * dz + dz * dx);
+}
+
+static void gf3d_aabb_tree_refit(AABBTree *tree,Sint32 index)
+{
+    AABBTreeNode *node = &tree->nodes[index];
+    AABBTreeNode *child1 = &tree->nodes[node->child1];
+    AABBTreeNode *child2 = &tree->nodes[node->child2];
+    gf3d_aabb_tree_union(node->min,node->max,child1,child2);
+    node->height = 1 + aabb_max(child1->height,child2->height);
+}
+
+/**
+ * if either child of A is more than one level taller than the other, rotate it up to take A's place
+ * returns the index of the node now in A's position
+ */
+Sint32 gf3d_aabb_tree_balance(AABBTree *tree,Sint32 iA)
+{
+    Sint32 iB,iC,iF,iG,iD,iE;
+    AABBTreeNode *A,*B,*C,*F,*G,*D,*E;
+    Sint32 balance;
+
+    A = &tree->nodes[iA];
+    if ((A->height < 2)||(A->child1 == AABB_TREE_NULL))return iA;
+
+    iB = A->child1;
+    iC = A->child2;
+    B = &tree->nodes[iB];
+    C = &tree->nodes[iC];
+    balance = C->height - B->height;
+
+    if (balance > 1)
+    {
+        // rotate C up
+        iF = C->child1;
+        iG = C->child2;
+        F = &tree->nodes[iF];
+        G = &tree->nodes[iG];
+
+        C->child1 = iA;
+        C->parent = A->parent;
+        A->parent = iC;
+        if (C->parent != AABB_TREE_NULL)
+        {
+            if (tree->nodes[C->parent].child1 == iA)tree->nodes[C->parent].child1 = iC;
+            else tree->nodes[C->parent].child2 = iC;
+        }
+        else tree->root = iC;
+
+        if (F->height > G->height)
+        {
+            C->child2 = iF;
+            A->child2 = iG;
+            G->parent = iA;
+        }
+        else
+        {
+            C->child2 = iG;
+            A->child2 = iF;
+            F->parent = iA;
+        }
+        gf3d_aabb_tree_refit(tree,iA);
+        gf3d_aabb_tree_refit(tree,iC);
+        return iC;
+    }
+    if (balance < -1)
+    {
+        // rotate B up
+        iD = B->child1;
+        iE = B->child2;
+        D = &tree->nodes[iD];
+        E = &tree->nodes[iE];
+
+        B->child1 = iA;
+        B->parent = A->parent;
+        A->parent = iB;
+        if (B->parent != AABB_TREE_NULL)
+        {
+            if (tree->nodes[B->parent].child1 == iA)tree->nodes[B->parent].child1 = iB;
+            else tree->nodes[B->parent].child2 = iB;
+        }
+        else tree->root = iB;
+
+        if (D->height > E->height)
+        {
+            B->child2 = iD;
+            A->child1 = iE;
+            E->parent = iA;
+        }
+        else
+        {
+            B->child2 = iE;
+            A->child1 = iD;
+            D->parent = iA;
+        }
+        gf3d_aabb_tree_refit(tree,iA);
+        gf3d_aabb_tree_refit(tree,iB);
+        return iB;
+    }
+    return iA;
+}
+
+/**
+ * walk up from index fixing bounds and heights, rotating as we go
+ */
+void gf3d_aabb_tree_fix_upwards(AABBTree *tree,Sint32 index)
+{
+    while (index != AABB_TREE_NULL)
+    {
+        index = gf3d_aabb_tree_balance(tree,index);
+        gf3d_aabb_tree_refit(tree,index);
+        index = tree->nodes[index].parent;
+    }
+}
+
+float gf3d_aabb_tree_descend_cost(AABBTree *tree,Sint32 child,const AABBTreeNode *leaf,float inheritance)
+{
+    float unionMin[3],unionMax[3];
+    AABBTreeNode *node = &tree->nodes[child];
+    gf3d_aabb_tree_union(unionMin,unionMax,leaf,node);
+    if (node->height == 0)return gf3d_aabb_tree_area(unionMin,unionMax) + inheritance;
+    return gf3d_aabb_tree_area(unionMin,unionMax) - gf3d_aabb_tree_area(node->min,node->max) + inheritance;
+}
+
+void gf3d_aabb_tree_insert_leaf(AABBTree *tree,Sint32 leaf)
+{
+    Sint32 index,sibling,oldParent,newParent;
+    float area,combinedArea,cost,inheritance,cost1,cost2;
+    float unionMin[3],unionMax[3];
+    AABBTreeNode *leafNode;
+
+    if (tree->root == AABB_TREE_NULL)
+    {
+        tree->root = leaf;
+        tree->nodes[leaf].parent = AABB_TREE_NULL;
+        return;
+    }
+
+    // pick the sibling that grows the total surface area the least
+    index = tree->root;
+    while (tree->nodes[index].height > 0)
+    {
+        leafNode = &tree->nodes[leaf];
+        area = gf3d_aabb_tree_area(tree->nodes[index].min,tree->nodes[index].max);
+        gf3d_aabb_tree_union(unionMin,unionMax,&tree->nodes[index],leafNode);
+        combinedArea = gf3d_aabb_tree_area(unionMin,unionMax);
+
+        cost = 2 * combinedArea;                    // cost of a new parent for this node and the leaf
+        inheritance = 2 * (combinedArea - area);    // cost of pushing the leaf further down
+
+        cost1 = gf3d_aabb_tree_descend_cost(tree,tree->nodes[index].child1,leafNode,inheritance);
+        cost2 = gf3d_aabb_tree_descend_cost(tree,tree->nodes[index].child2,leafNode,inheritance);
+
+        if ((cost < cost1)&&(cost < cost2))break;
+        index = (cost1 < cost2) ? tree->nodes[index].child1 : tree->nodes[index].child2;
+    }
+    sibling = index;
+
+    newParent = gf3d_aabb_tree_allocate_node(tree);
+    if (newParent == AABB_TREE_NULL)return;
+    oldParent = tree->nodes[sibling].parent;
+    tree->nodes[newParent].parent = oldParent;
+    tree->nodes[newParent].child1 = sibling;
+    tree->nodes[newParent].child2 = leaf;
+    gf3d_aabb_tree_refit(tree,newParent);
+    if (oldParent != AABB_TREE_NULL)
+    {
+        if (tree->nodes[oldParent].child1 == sibling)tree->nodes[oldParent].child1 = newParent;
+        else tree->nodes[oldParent].child2 = newParent;
+    }
+    else tree->root = newParent;
+    tree->nodes[sibling].parent = newParent;
+    tree->nodes[leaf].parent = newParent;
+
+    gf3d_aabb_tree_fix_upwards(tree,tree->nodes[leaf].parent);
+}
+
+void gf3d_aabb_tree_remove_leaf(AABBTree *tree,Sint32 leaf)
+{
+    Sint32 parent,grandParent,sibling;
+    if (leaf == tree->root)
+    {
+        tree->root = AABB_TREE_NULL;
+        return;
+    }
+    parent = tree->nodes[leaf].parent;
+    grandParent = tree->nodes[parent].parent;
+    sibling = (tree->nodes[parent].child1 == leaf) ? tree->nodes[parent].child2 : tree->nodes[parent].child1;
+
+    if (grandParent != AABB_TREE_NULL)
+    {
+        if (tree->nodes[grandParent].child1 == parent)tree->nodes[grandParent].child1 = sibling;
+        else tree->nodes[grandParent].child2 = sibling;
+        tree->nodes[sibling].parent = grandParent;
+        gf3d_aabb_tree_release_node(tree,parent);
+        gf3d_aabb_tree_fix_upwards(tree,grandParent);
+    }
+    else
+    {
+        tree->root = sibling;
+        tree->nodes[sibling].parent = AABB_TREE_NULL;
+        gf3d_aabb_tree_release_node(tree,parent);
+    }
+}
+
+void gf3d_aabb_tree_set_leaf_bounds(AABBTree *tree,Sint32 proxy,GFC_Box bounds)
+{
+    AABBTreeNode *node = &tree->nodes[proxy];
+    node->tightMin[0] = bounds.x;
+    node->tightMin[1] = bounds.y;
+    node->tightMin[2] = bounds.z;
+    node->tightMax[0] = bounds.x + bounds.w;
+    node->tightMax[1] = bounds.y + bounds.h;
+    node->tightMax[2] = bounds.z + bounds.d;
+}
+
+void gf3d_aabb_tree_fatten_leaf(AABBTree *tree,Sint32 proxy)
+{
+    int i;
+    AABBTreeNode *node = &tree->nodes[proxy];
+    for (i = 0; i < 3; i++)
+    {
+        node->min[i] = node->tightMin[i] - tree->margin;
+        node->max[i] = node->tightMax[i] + tree->margin;
+    }
+}
+
+Sint32 gf3d_aabb_tree_insert(AABBTree *tree,GFC_Box bounds,void *data)
+{
+    Sint32 proxy;
+    if (!tree)return AABB_TREE_NULL;
+    proxy = gf3d_aabb_tree_allocate_node(tree);
+    if (proxy == AABB_TREE_NULL)return AABB_TREE_NULL;
+    tree->nodes[proxy].data = data;
+    tree->nodes[proxy].height = 0;
+    gf3d_aabb_tree_set_leaf_bounds(tree,proxy,bounds);
+    gf3d_aabb_tree_fatten_leaf(tree,proxy);
+    gf3d_aabb_tree_insert_leaf(tree,proxy);
+    return proxy;
+}
+
+Uint8 gf3d_aabb_tree_is_leaf(AABBTree *tree,Sint32 proxy)
+{
+    if ((!tree)||(proxy < 0)||(proxy >= tree->nodeCapacity))return 0;
+    return (tree->nodes[proxy].height == 0);
+}
+
+void gf3d_aabb_tree_remove(AABBTree *tree,Sint32 proxy)
+{
+    if (!gf3d_aabb_tree_is_leaf(tree,proxy))return;
+    gf3d_aabb_tree_remove_leaf(tree,proxy);
+    gf3d_aabb_tree_release_node(tree,proxy);
+}
+
+Uint8 gf3d_aabb_tree_move(AABBTree *tree,Sint32 proxy,GFC_Box bounds)
+{
+    int i;
+    AABBTreeNode *node;
+    if (!gf3d_aabb_tree_is_leaf(tree,proxy))return 0;
+    gf3d_aabb_tree_set_leaf_bounds(tree,proxy,bounds);
+    node = &tree->nodes[proxy];
+    for (i = 0; i < 3; i++)
+    {
+        if ((node->tightMin[i] < node->min[i])||(node->tightMax[i] > node->max[i]))break;
+    }
+    if (i == 3)return 0;// still inside the fat bounds
+    gf3d_aabb_tree_remove_leaf(tree,proxy);
+    gf3d_aabb_tree_fatten_leaf(tree,proxy);
+    gf3d_aabb_tree_insert_leaf(tree,proxy);
+    return 1;
+}
+
+void *gf3d_aabb_tree_get_data(AABBTree *tree,Sint32 proxy)
+{
+    if (!gf3d_aabb_tree_is_leaf(tree,proxy))return NULL;
+    return tree->nodes[proxy].data;
+}
+
+Uint32 gf3d_aabb_tree_get_height(AABBTree *tree)
+{
+    if ((!tree)||(tree->root == AABB_TREE_NULL))return 0;
+    return tree->nodes[tree->root].height;
+}
+
+void gf3d_aabb_tree_query_box(AABBTree *tree,GFC_Box bounds,AABBTreeQueryFunc func,void *userData)
+{
+    Sint32 stack[AABB_TREE_STACK];
+    int top = 0;
+    Sint32 index;
+    AABBTreeNode *node;
+    float min[3],max[3];
+    if ((!tree)||(!func)||(tree->root == AABB_TREE_NULL))return;
+    min[0] = bounds.x;
+    min[1] = bounds.y;
+    min[2] = bounds.z;
+    max[0] = bounds.x + bounds.w;
+    max[1] = bounds.y + bounds.h;
+    max[2] = bounds.z + bounds.d;
+    stack[top++] = tree->root;
+    while (top > 0)
+    {
+        index = stack[--top];
+        node = &tree->nodes[index];
+        if ((node->max[0] < min[0])||(node->min[0] > max[0])||
+            (node->max[1] < min[1])||(node->min[1] > max[1])||
+            (node->max[2] < min[2])||(node->min[2] > max[2]))continue;
+        if (node->height == 0)
+        {
+            if (!func(node->data,userData))return;
+            continue;
+        }
+        if (top + 2 > AABB_TREE_STACK)
+        {
+            slog("aabb tree query stack overflow");
+            return;
+        }
+        stack[top++] = node->child1;
+        stack[top++] = node->child2;
+    }
+}
+
+/**
+ * report every leaf below index without testing, returns 0 if the callback asked to stop
+ */
+Uint8 gf3d_aabb_tree_report_all(AABBTree *tree,Sint32 index,AABBTreeQueryFunc func,void *userData)
+{
+    Sint32 stack[AABB_TREE_STACK];
+    int top = 0;
+    AABBTreeNode *node;
+    stack[top++] = index;
+    while (top > 0)
+    {
+        node = &tree->nodes[stack[--top]];
+        if (node->height == 0)
+        {
+            if (!func(node->data,userData))return 0;
+            continue;
+        }
+        if (top + 2 > AABB_TREE_STACK)return 0;
+        stack[top++] = node->child1;
+        stack[top++] = node->child2;
+    }
+    return 1;
+}
+
+void gf3d_aabb_tree_query_frustum(AABBTree *tree,Frustum *frustum,AABBTreeQueryFunc func,void *userData)
+{
+    Sint32 stack[AABB_TREE_STACK];
+    int top = 0;
+    Sint32 index;
+    Uint8 result;
+    AABBTreeNode *node;
+    GFC_Vector3D center,half;
+    if ((!tree)||(!func)||(tree->root == AABB_TREE_NULL))return;
+    stack[top++] = tree->root;
+    while (top > 0)
+    {
+        index = stack[--top];
+        node = &tree->nodes[index];
+        half.x = (node->max[0] - node->min[0]) * 0.5;
+        half.y = (node->max[1] - node->min[1]) * 0.5;
+        half.z = (node->max[2] - node->min[2]) * 0.5;
+        center.x = node->min[0] + half.x;
+        center.y = node->min[1] + half.y;
+        center.z = node->min[2] + half.z;
+        result = gf3d_frustum_classify_box(frustum,center,half);
+        if (!result)continue;
+        if ((result == 2)||(node->height == 0))
+        {
+            if (!gf3d_aabb_tree_report_all(tree,index,func,userData))return;
+            continue;
+        }
+        if (top + 2 > AABB_TREE_STACK)
+        {
+            slog("aabb tree query stack overflow");
+            return;
+        }
+        stack[top++] = node->child1;
+        stack[top++] = node->child2;
+    }
+}
+
+/**
+ * slab test of the segment start + t*delta for t in [0,maxFraction]
+ */
+Uint8 gf3d_aabb_tree_ray_hits_node(const AABBTreeNode *node,const float *start,const float *delta,float maxFraction)
+{
+    int i;
+    float tmin = 0,tmax = maxFraction;
+    float inv,t1,t2,swap;
+    for (i = 0; i < 3; i++)
+    {
+        if (fabsf(delta[i]) < GFC_EPSILON)
+        {
+            if ((start[i] < node->min[i])||(start[i] > node->max[i]))return 0;
+            continue;
+        }
+        inv = 1.0 / delta[i];
+        t1 = (node->min[i] - start[i]) * inv;
+        t2 = (node->max[i] - start[i]) * inv;
+        if (t1 > t2)
+        {
+            swap = t1;
+            t1 = t2;
+            t2 = swap;
+        }
+        tmin = aabb_max(tmin,t1);
+        tmax = aabb_min(tmax,t2);
+        if (tmin > tmax)return 0;
+    }
+    return 1;
+}
+
+void gf3d_aabb_tree_ray_cast(AABBTree *tree,GFC_Vector3D start,GFC_Vector3D end,AABBTreeRayFunc func,void *userData)
+{
+    Sint32 stack[AABB_TREE_STACK];
+    int top = 0;
+    float p[3],delta[3];
+    float maxFraction = 1,value;
+    AABBTreeNode *node;
+    if ((!tree)||(!func)||(tree->root == AABB_TREE_NULL))return;
+    p[0] = start.x;
+    p[1] = start.y;
+    p[2] = start.z;
+    delta[0] = end.x - start.x;
+    delta[1] = end.y - start.y;
+    delta[2] = end.z - start.z;
+    stack[top++] = tree->root;
+    while (top > 0)
+    {
+        node = &tree->nodes[stack[--top]];
+        if (!gf3d_aabb_tree_ray_hits_node(node,p,delta,maxFraction))continue;
+        if (node->height == 0)
+        {
+            value = func(node->data,start,end,maxFraction,userData);
+            if (value == 0)return;
+            if ((value > 0)&&(value < maxFraction))maxFraction = value;
+            continue;
+        }
+        if (top + 2 > AABB_TREE_STACK)
+        {
+            slog("aabb tree ray cast stack overflow");
+            return;
+        }
+        stack[top++] = node->child1;
+        stack[top++] = node->child2;
+    }
+}
+
+static float gf3d_aabb_tree_distance_squared(const float *min,const float *max,const float *point)
+{
+    int i;
+    float d,dist = 0;
+    for (i = 0; i < 3; i++)
+    {
+        if (point[i] < min[i])d = min[i] - point[i];
+        else if (point[i] > max[i])d = point[i] - max[i];
+        else continue;
+        dist += d * d;
+    }
+    return dist;
+}
+
+Uint32 gf3d_aabb_tree_query_nearest(AABBTree *tree,GFC_Vector3D point,Uint32 k,void **results,float *distances)
+{
+    Sint32 stack[AABB_TREE_STACK];
+    int top = 0;
+    Uint32 i,found = 0;
+    float p[3],d,d1,d2;
+    float *best;
+    ArenaMark mark;
+    AABBTreeNode *node;
+    if ((!tree)||(!k)||(!results)||(tree->root == AABB_TREE_NULL))return 0;
+    mark = gf3d_scratch_begin();
+    best = gf3d_scratch_alloc_array(sizeof(float),k);
+    if (!best)
+    {
+        gf3d_scratch_end(mark);
+        return 0;
+    }
+    p[0] = point.x;
+    p[1] = point.y;
+    p[2] = point.z;
+    stack[top++] = tree->root;
+    while (top > 0)
+    {
+        node = &tree->nodes[stack[--top]];
+        if ((found == k)&&(gf3d_aabb_tree_distance_squared(node->min,node->max,p) >= best[k - 1]))continue;
+        if (node->height == 0)
+        {
+            d = gf3d_aabb_tree_distance_squared(node->tightMin,node->tightMax,p);
+            if ((found == k)&&(d >= best[k - 1]))continue;
+            // insertion sort into the result list
+            i = (found < k) ? found++ : k - 1;
+            while ((i > 0)&&(best[i - 1] > d))
+            {
+                best[i] = best[i - 1];
+                results[i] = results[i - 1];
+                i--;
+            }
+            best[i] = d;
+            results[i] = node->data;
+            continue;
+        }
+        if (top + 2 > AABB_TREE_STACK)break;
+        // push the nearer child last so it is searched first and tightens the bound sooner
+        d1 = gf3d_aabb_tree_distance_squared(tree->nodes[node->child1].min,tree->nodes[node->child1].max,p);
+        d2 = gf3d_aabb_tree_distance_squared(tree->nodes[node->child2].min,tree->nodes[node->child2].max,p);
+        if (d1 < d2)
+        {
+            stack[top++] = node->child2;
+            stack[top++] = node->child1;
+        }
+        else
+        {
+            stack[top++] = node->child1;
+            stack[top++] = node->child2;
+        }
+    }
+    if (distances)
+    {
+        for (i = 0; i < found; i++)
+        {
+            distances[i] = sqrtf(best[i]);
+        }
+    }
+    gf3d_scratch_end(mark);
+    return found;
+}
+
+/*eol@eof*/
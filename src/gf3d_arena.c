@@ -0,0 +1,267 @@
+#include <string.h>
+
+#include "simple_logger.h"
+
+#include "gf3d_jobs.h"
+#include "gf3d_render_stats.h"
+#include "gf3d_memory.h"
+#include "gf3d_log.h"
+#include "gf3d_arena.h"
+
+#define GF3D_ARENA_ALIGN 16
+#define GF3D_ARENA_MIN_OVERFLOW 65536
+
+extern int __DEBUG;
+
+struct ArenaOverflow_S
+{
+    ArenaOverflow  *next;
+    size_t          size;
+    size_t          used;
+    Uint8          *data;           /**<follows the header in the same allocation*/
+};
+
+typedef struct
+{
+    MemoryArena   **frame;          /**<one per job system thread*/
+    MemoryArena   **scratch;        /**<one per job system thread*/
+    Uint32          threadCount;
+    Uint32          heapAllocs;     /**<total across all arenas at the last frame reset*/
+}ArenaManager;
+
+static ArenaManager gf3d_arena_manager = {0};
+
+void gf3d_arena_system_close();
+
+static size_t gf3d_arena_align(size_t size)
+{
+    return (size + GF3D_ARENA_ALIGN - 1) & ~(size_t)(GF3D_ARENA_ALIGN - 1);
+}
+
+MemoryArena *gf3d_arena_new(size_t size)
+{
+    MemoryArena *arena;
+    arena = gf3d_memory_alloc_array(MT_Arena,sizeof(MemoryArena),1);
+    if (!arena)return NULL;
+    size = gf3d_arena_align(size);
+    if (size)
+    {
+        arena->base = gf3d_memory_alloc_array(MT_Arena,size,1);
+        if (!arena->base)
+        {
+            slog("failed to reserve %lu bytes for arena",(unsigned long)size);
+            gf3d_memory_free(arena);
+            return NULL;
+        }
+        arena->heapAllocs++;
+    }
+    arena->size = size;
+    return arena;
+}
+
+static void gf3d_arena_free_overflow(MemoryArena *arena,ArenaOverflow *stop)
+{
+    ArenaOverflow *block;
+    while ((arena->overflow)&&(arena->overflow != stop))
+    {
+        block = arena->overflow;
+        arena->overflow = block->next;
+        gf3d_memory_free(block);
+    }
+}
+
+void gf3d_arena_free(MemoryArena *arena)
+{
+    if (!arena)return;
+    gf3d_arena_free_overflow(arena,NULL);
+    if (arena->base)gf3d_memory_free(arena->base);
+    gf3d_memory_free(arena);
+}
+
+static void *gf3d_arena_alloc_overflow(MemoryArena *arena,size_t size)
+{
+    ArenaOverflow *block = arena->overflow;
+    size_t blockSize;
+    void *ptr;
+    if ((!block)||(block->used + size > block->size))
+    {
+        blockSize = size > GF3D_ARENA_MIN_OVERFLOW ? size : GF3D_ARENA_MIN_OVERFLOW;
+        block = gf3d_memory_alloc_array(MT_Arena,gf3d_arena_align(sizeof(ArenaOverflow)) + blockSize,1);
+        if (!block)
+        {
+            gf3d_log(LL_Error,"arena failed to allocate a %lu byte overflow block",(unsigned long)blockSize);
+            return NULL;
+        }
+        block->data = (Uint8 *)block + gf3d_arena_align(sizeof(ArenaOverflow));
+        block->size = blockSize;
+        block->used = 0;
+        block->next = arena->overflow;
+        arena->overflow = block;
+        arena->heapAllocs++;
+    }
+    ptr = block->data + block->used;
+    block->used += size;
+    arena->overflowUsed += size;
+    return ptr;
+}
+
+void *gf3d_arena_alloc(MemoryArena *arena,size_t size)
+{
+    void *ptr;
+    if (!arena)return NULL;
+    size = gf3d_arena_align(size ? size : 1);
+    if ((!arena->overflow)&&(arena->used + size <= arena->size))
+    {
+        ptr = arena->base + arena->used;
+        arena->used += size;
+    }
+    else
+    {
+        ptr = gf3d_arena_alloc_overflow(arena,size);
+    }
+    if (arena->used + arena->overflowUsed > arena->peak)arena->peak = arena->used + arena->overflowUsed;
+    return ptr;
+}
+
+void *gf3d_arena_alloc_array(MemoryArena *arena,size_t size,size_t count)
+{
+    void *ptr;
+    ptr = gf3d_arena_alloc(arena,size * count);
+    if (ptr)memset(ptr,0,size * count);
+    return ptr;
+}
+
+ArenaMark gf3d_arena_mark(MemoryArena *arena)
+{
+    ArenaMark mark = {0};
+    if (!arena)return mark;
+    mark.used = arena->used;
+    mark.overflow = arena->overflow;
+    mark.overflowUsed = arena->overflowUsed;
+    if (arena->overflow)mark.used = arena->overflow->used;// position within the newest block
+    return mark;
+}
+
+/**
+ * once an arena is empty, swap the base block for one that fits its peak
+ */
+static void gf3d_arena_grow(MemoryArena *arena)
+{
+    Uint8 *base;
+    size_t size;
+    if (arena->peak <= arena->size)return;
+    size = gf3d_arena_align(arena->peak + arena->peak / 2);
+    base = gf3d_memory_alloc_array(MT_Arena,size,1);
+    if (!base)return;
+    if (arena->base)gf3d_memory_free(arena->base);
+    arena->base = base;
+    arena->size = size;
+    arena->heapAllocs++;
+    if (__DEBUG)slog("arena grew to %lu bytes",(unsigned long)size);
+}
+
+void gf3d_arena_release(MemoryArena *arena,ArenaMark mark)
+{
+    if (!arena)return;
+    gf3d_arena_free_overflow(arena,mark.overflow);
+    if (mark.overflow)
+    {
+        mark.overflow->used = mark.used;
+        arena->overflowUsed = mark.overflowUsed;
+        return;
+    }
+    arena->used = mark.used;
+    arena->overflowUsed = 0;
+    if (!arena->used)gf3d_arena_grow(arena);
+}
+
+void gf3d_arena_reset(MemoryArena *arena)
+{
+    ArenaMark mark = {0};
+    gf3d_arena_release(arena,mark);
+}
+
+void gf3d_arena_system_init(size_t frameSize,size_t scratchSize)
+{
+    Uint32 i;
+    gf3d_arena_manager.threadCount = gf3d_jobs_get_thread_count();
+    gf3d_arena_manager.frame = gf3d_memory_alloc_array(MT_Arena,sizeof(MemoryArena *),gf3d_arena_manager.threadCount);
+    gf3d_arena_manager.scratch = gf3d_memory_alloc_array(MT_Arena,sizeof(MemoryArena *),gf3d_arena_manager.threadCount);
+    if ((!gf3d_arena_manager.frame)||(!gf3d_arena_manager.scratch))
+    {
+        slog("failed to allocate thread arenas");
+        gf3d_arena_system_close();
+        return;
+    }
+    for (i = 0; i < gf3d_arena_manager.threadCount; i++)
+    {
+        gf3d_arena_manager.frame[i] = gf3d_arena_new(frameSize);
+        gf3d_arena_manager.scratch[i] = gf3d_arena_new(scratchSize);
+    }
+    atexit(gf3d_arena_system_close);
+    if (__DEBUG)slog("arenas initialized for %i threads: %lu frame, %lu scratch bytes each",
+        gf3d_arena_manager.threadCount,(unsigned long)frameSize,(unsigned long)scratchSize);
+}
+
+void gf3d_arena_system_close()
+{
+    Uint32 i;
+    for (i = 0; i < gf3d_arena_manager.threadCount; i++)
+    {
+        if (gf3d_arena_manager.frame)gf3d_arena_free(gf3d_arena_manager.frame[i]);
+        if (gf3d_arena_manager.scratch)gf3d_arena_free(gf3d_arena_manager.scratch[i]);
+    }
+    if (gf3d_arena_manager.frame)gf3d_memory_free(gf3d_arena_manager.frame);
+    if (gf3d_arena_manager.scratch)gf3d_memory_free(gf3d_arena_manager.scratch);
+    memset(&gf3d_arena_manager,0,sizeof(ArenaManager));
+}
+
+void gf3d_arena_frame_reset()
+{
+    Uint32 i,heapAllocs = 0;
+    size_t used = 0;
+    MemoryArena *arena;
+    for (i = 0; i < gf3d_arena_manager.threadCount; i++)
+    {
+        arena = gf3d_arena_manager.frame[i];
+        if (arena)
+        {
+            used += arena->used + arena->overflowUsed;
+            gf3d_arena_reset(arena);
+            heapAllocs += arena->heapAllocs;
+        }
+        if (gf3d_arena_manager.scratch[i])heapAllocs += gf3d_arena_manager.scratch[i]->heapAllocs;
+    }
+    gf3d_render_stats_add(RS_FrameArenaBytes,used);
+    gf3d_render_stats_add(RS_ArenaHeapAllocs,heapAllocs - gf3d_arena_manager.heapAllocs);
+    gf3d_arena_manager.heapAllocs = heapAllocs;
+}
+
+static MemoryArena *gf3d_arena_get_thread(MemoryArena **list)
+{
+    Uint32 index = gf3d_jobs_get_thread_index();
+    if ((!list)||(index >= gf3d_arena_manager.threadCount))return NULL;
+    return list[index];
+}
+
+void *gf3d_frame_alloc_array(size_t size,size_t count)
+{
+    return gf3d_arena_alloc_array(gf3d_arena_get_thread(gf3d_arena_manager.frame),size,count);
+}
+
+ArenaMark gf3d_scratch_begin()
+{
+    return gf3d_arena_mark(gf3d_arena_get_thread(gf3d_arena_manager.scratch));
+}
+
+void *gf3d_scratch_alloc_array(size_t size,size_t count)
+{
+    return gf3d_arena_alloc_array(gf3d_arena_get_thread(gf3d_arena_manager.scratch),size,count);
+}
+
+void gf3d_scratch_end(ArenaMark mark)
+{
+    gf3d_arena_release(gf3d_arena_get_thread(gf3d_arena_manager.scratch),mark);
+}
+
+/*eol@eof*/
@@ -2,21 +2,25 @@
 
 #include "gf3d_vgraphics.h"
 #include "gf3d_buffers.h"
+#include "gf3d_profiler.h"
+#include "gf3d_render_stats.h"
 
 void gf3d_buffer_copy(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
 {
     VkBufferCopy copyRegion = {0};
 
+    GF3D_PROFILE_BEGIN("buffer_copy");
     VkCommandBuffer commandBuffer = gf3d_command_begin_single_time(gf3d_vgraphics_get_graphics_command_pool());
     
         copyRegion.size = size;
         vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
     gf3d_command_end_single_time(gf3d_vgraphics_get_graphics_command_pool(), commandBuffer);
-    
+    GF3D_PROFILE_END();
+    gf3d_render_stats_add(RS_BytesUploaded,size);
 }
 
-int gf3d_buffer_create(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer * buffer, VkDeviceMemory * bufferMemory)
+int gf3d_buffer_create(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer * buffer, VkDeviceMemory * bufferMemory, MemoryTag tag)
 {
     VkBufferCreateInfo bufferInfo = {0};
     VkMemoryRequirements memRequirements;
@@ -40,7 +44,7 @@ int gf3d_buffer_create(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryProp
     allocInfo.memoryTypeIndex = gf3d_vgraphics_find_memory_type(memRequirements.memoryTypeBits, properties);
 
     
-    if (vkAllocateMemory(gf3d_vgraphics_get_default_logical_device(), &allocInfo, NULL, bufferMemory) != VK_SUCCESS)
+    if (gf3d_memory_vk_allocate(gf3d_vgraphics_get_default_logical_device(), &allocInfo, tag, bufferMemory) != VK_SUCCESS)
     {
         slog("failed to allocate buffer memory!");
         return 0;
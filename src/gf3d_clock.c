@@ -0,0 +1,153 @@
+#include <SDL.h>
+
+#include "simple_logger.h"
+#include "simple_json.h"
+
+#include "gfc_pak.h"
+
+#include "gf3d_clock.h"
+
+#define GF3D_CLOCK_SPIN_MARGIN 0.002    /**<wake this many seconds early from a sleep and spin the rest, SDL_Delay is only millisecond accurate*/
+#define GF3D_CLOCK_FPS_SMOOTHING 0.1    /**<weight of the newest frame in the fps average*/
+
+extern int __DEBUG;
+
+typedef struct
+{
+    Uint64  frequency;          /**<performance counter ticks per second*/
+    Uint64  frameStart;         /**<counter at the start of the current frame*/
+    double  step;               /**<seconds per simulation step*/
+    Uint32  maxSteps;           /**<most steps to run in one frame before dropping time*/
+    double  accumulator;        /**<wall clock time not yet simulated*/
+    double  simTime;            /**<seconds simulated*/
+    double  frameTime;          /**<length of the last frame*/
+    double  minFrameTime;       /**<from the frame rate cap, 0 for uncapped*/
+    float   fps;
+    Uint8   lockstep;
+}GF3D_Clock;
+
+static GF3D_Clock gf3d_clock = {0};
+
+void gf3d_clock_init(const char *config)
+{
+    SJson *json,*setup;
+    int simHz = 60;
+    int maxSteps = 5;
+    float maxFps = 0;
+
+    if (config)
+    {
+        json = gfc_pak_load_json(config);
+        if (json)
+        {
+            setup = sj_object_get_value(json,"setup");
+            sj_object_get_value_as_int(setup,"simulation_hz",&simHz);
+            sj_object_get_value_as_int(setup,"max_catchup_steps",&maxSteps);
+            sj_object_get_value_as_float(setup,"max_fps",&maxFps);
+            sj_free(json);
+        }
+        else slog("failed to load clock config %s, using defaults",config);
+    }
+    if (simHz <= 0)simHz = 60;
+    if (maxSteps <= 0)maxSteps = 1;
+
+    gf3d_clock.frequency = SDL_GetPerformanceFrequency();
+    gf3d_clock.frameStart = SDL_GetPerformanceCounter();
+    gf3d_clock.step = 1.0 / simHz;
+    gf3d_clock.maxSteps = maxSteps;
+    gf3d_clock.accumulator = 0;
+    gf3d_clock.simTime = 0;
+    gf3d_clock.frameTime = gf3d_clock.step;
+    gf3d_clock.fps = simHz;
+    gf3d_clock_set_max_fps(maxFps);
+    if (__DEBUG)slog("clock initialized: %i simulation steps per second, %i max catch up steps",simHz,maxSteps);
+}
+
+void gf3d_clock_set_max_fps(float fps)
+{
+    gf3d_clock.minFrameTime = (fps > 0) ? 1.0 / fps : 0;
+}
+
+void gf3d_clock_set_lockstep(Uint8 enable)
+{
+    gf3d_clock.lockstep = enable;
+    gf3d_clock.accumulator = 0;
+}
+
+Uint32 gf3d_clock_begin_frame()
+{
+    Uint32 steps;
+    Uint64 now;
+    now = SDL_GetPerformanceCounter();
+    gf3d_clock.frameTime = (double)(now - gf3d_clock.frameStart) / gf3d_clock.frequency;
+    gf3d_clock.frameStart = now;
+    if (gf3d_clock.frameTime > 0)
+    {
+        gf3d_clock.fps += ((1.0 / gf3d_clock.frameTime) - gf3d_clock.fps) * GF3D_CLOCK_FPS_SMOOTHING;
+    }
+    if (gf3d_clock.lockstep)
+    {
+        gf3d_clock.accumulator = gf3d_clock.step;
+        return 1;
+    }
+    gf3d_clock.accumulator += gf3d_clock.frameTime;
+    steps = (Uint32)(gf3d_clock.accumulator / gf3d_clock.step);
+    if (steps > gf3d_clock.maxSteps)
+    {
+        // too far behind to catch up, drop the time rather than spiral
+        if (__DEBUG)slog("simulation behind by %i steps, dropping %f seconds",steps,gf3d_clock.accumulator - gf3d_clock.maxSteps * gf3d_clock.step);
+        steps = gf3d_clock.maxSteps;
+        gf3d_clock.accumulator = steps * gf3d_clock.step;
+    }
+    return steps;
+}
+
+void gf3d_clock_step()
+{
+    gf3d_clock.accumulator -= gf3d_clock.step;
+    if (gf3d_clock.accumulator < 0)gf3d_clock.accumulator = 0;
+    gf3d_clock.simTime += gf3d_clock.step;
+}
+
+void gf3d_clock_end_frame()
+{
+    double remaining;
+    Uint64 target;
+    if ((gf3d_clock.lockstep)||(gf3d_clock.minFrameTime <= 0))return;
+    target = gf3d_clock.frameStart + (Uint64)(gf3d_clock.minFrameTime * gf3d_clock.frequency);
+    remaining = (double)((Sint64)(target - SDL_GetPerformanceCounter())) / gf3d_clock.frequency;
+    if (remaining > GF3D_CLOCK_SPIN_MARGIN)
+    {
+        SDL_Delay((Uint32)((remaining - GF3D_CLOCK_SPIN_MARGIN) * 1000));
+    }
+    while ((Sint64)(target - SDL_GetPerformanceCounter()) > 0);
+}
+
+float gf3d_clock_get_step()
+{
+    return gf3d_clock.step;
+}
+
+float gf3d_clock_get_alpha()
+{
+    if (gf3d_clock.lockstep)return 1;
+    if (gf3d_clock.step <= 0)return 1;
+    return gf3d_clock.accumulator / gf3d_clock.step;
+}
+
+double gf3d_clock_get_sim_time()
+{
+    return gf3d_clock.simTime;
+}
+
+double gf3d_clock_get_frame_time()
+{
+    return gf3d_clock.frameTime;
+}
+
+float gf3d_clock_get_fps()
+{
+    return gf3d_clock.fps;
+}
+
+/*eol@eof*/
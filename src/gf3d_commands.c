@@ -2,10 +2,13 @@
 #include <string.h>
 #include "simple_logger.h"
 
+#include "gf3d_memory.h"
+#include "gf3d_log.h"
 #include "gf3d_commands.h"
 #include "gf3d_vgraphics.h"
 #include "gf3d_vqueues.h"
 #include "gf3d_swapchain.h"
+#include "gf3d_gpu_timer.h"
 
 
 extern int __DEBUG;
@@ -16,6 +19,9 @@ typedef struct
     Command     *   command_list;
     Uint32          max_commands;
     VkDevice        device;
+    Command    **   thread_pools;       /**<secondary command pools, one per thread per swap chain frame*/
+    Uint32          thread_count;
+    Uint32          chain_length;
 }CommandManager;
 
 
@@ -25,18 +31,24 @@ void gf3d_command_pool_close();
 void gf3d_command_free(Command *com);
 void gf3d_command_buffer_begin(Command *com,Pipeline *pipe);
 void gf3d_command_configure_render_pass(VkCommandBuffer commandBuffer, VkRenderPass renderPass,VkFramebuffer framebuffer,VkPipeline graphicsPipeline,VkPipelineLayout pipelineLayout);
+void gf3d_command_begin_render_pass(VkCommandBuffer commandBuffer, VkRenderPass renderPass,VkFramebuffer framebuffer,VkSubpassContents contents);
 
 void gf3d_command_system_close()
 {
     int i;
+    if (gf3d_commands.thread_pools != NULL)
+    {
+        gf3d_memory_free(gf3d_commands.thread_pools);//the pools themselves live in the command_list
+    }
     if (gf3d_commands.command_list != NULL)
     {
         for (i = 0; i < gf3d_commands.max_commands; i++)
         {
             gf3d_command_free(&gf3d_commands.command_list[i]);
         }
-        free(gf3d_commands.command_list);
+        gf3d_memory_free(gf3d_commands.command_list);
     }
+    memset(&gf3d_commands,0,sizeof(CommandManager));
     if(__DEBUG)slog("command pool system closed");
 }
 
@@ -50,7 +62,7 @@ void gf3d_command_system_init(Uint32 max_commands,VkDevice defaultDevice)
     }
     gf3d_commands.device = defaultDevice;
     gf3d_commands.max_commands = max_commands;
-    gf3d_commands.command_list = (Command*)gfc_allocate_array(sizeof(Command),max_commands);
+    gf3d_commands.command_list = (Command*)gf3d_memory_alloc_array(MT_General,sizeof(Command),max_commands);
     
     atexit(gf3d_command_system_close);
 }
@@ -79,7 +91,7 @@ void gf3d_command_free(Command *com)
     }
     if (com->commandBuffers)
     {
-        free(com->commandBuffers);
+        gf3d_memory_free(com->commandBuffers);
     }
     memset(com,0,sizeof(Command));
 }
@@ -108,7 +120,7 @@ Command * gf3d_command_graphics_pool_setup(Uint32 count)
         return NULL;
     }
     
-    com->commandBuffers = (VkCommandBuffer*)gfc_allocate_array(sizeof(VkCommandBuffer),count);
+    com->commandBuffers = (VkCommandBuffer*)gf3d_memory_alloc_array(MT_General,sizeof(VkCommandBuffer),count);
     if (!com->commandBuffers)
     {
         slog("failed to allocate command buffer array");
@@ -132,6 +144,175 @@ Command * gf3d_command_graphics_pool_setup(Uint32 count)
     return com;
 }
 
+Command * gf3d_command_secondary_pool_setup(Uint32 count)
+{
+    Command *com;
+    VkCommandPoolCreateInfo poolInfo = {0};
+    VkCommandBufferAllocateInfo allocInfo = {0};
+    
+    com = gf3d_command_pool_new();
+    
+    if (!com)
+    {
+        return NULL;
+    }
+    
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = gf3d_vqueues_get_graphics_queue_family();
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;// reset as a whole each frame
+    
+    if (vkCreateCommandPool(gf3d_commands.device, &poolInfo, NULL, &com->commandPool) != VK_SUCCESS)
+    {
+        slog("failed to create secondary command pool!");
+        gf3d_command_free(com);
+        return NULL;
+    }
+    if (!count)return com;
+    
+    com->commandBuffers = (VkCommandBuffer*)gf3d_memory_alloc_array(MT_General,sizeof(VkCommandBuffer),count);
+    if (!com->commandBuffers)
+    {
+        slog("failed to allocate command buffer array");
+        gf3d_command_free(com);
+        return NULL;
+    }
+    
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = com->commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    allocInfo.commandBufferCount = count;
+    com->commandBufferCount = count;
+
+    if (vkAllocateCommandBuffers(gf3d_commands.device, &allocInfo, com->commandBuffers) != VK_SUCCESS)
+    {
+        slog("failed to allocate secondary command buffers!");
+        gf3d_command_free(com);
+        return NULL;
+    }
+    return com;
+}
+
+void gf3d_command_thread_pools_init(Uint32 threadCount,Uint32 chainLength)
+{
+    int i,c;
+    if ((!threadCount)||(!chainLength))
+    {
+        slog("cannot initialize secondary command pools for zero threads or frames");
+        return;
+    }
+    c = threadCount * chainLength;
+    gf3d_commands.thread_pools = (Command **)gf3d_memory_alloc_array(MT_General,sizeof(Command *),c);
+    if (!gf3d_commands.thread_pools)
+    {
+        slog("failed to allocate secondary command pool list");
+        return;
+    }
+    for (i = 0; i < c; i++)
+    {
+        gf3d_commands.thread_pools[i] = gf3d_command_secondary_pool_setup(4);
+        if (!gf3d_commands.thread_pools[i])
+        {
+            slog("failed to setup secondary command pool %i",i);
+            return;
+        }
+    }
+    gf3d_commands.thread_count = threadCount;
+    gf3d_commands.chain_length = chainLength;
+    if (__DEBUG)slog("created secondary command pools for %i threads",threadCount);
+}
+
+Command *gf3d_command_get_thread_pool(Uint32 thread,Uint32 frame)
+{
+    if ((thread >= gf3d_commands.thread_count)||(frame >= gf3d_commands.chain_length))
+    {
+        gf3d_log(LL_Error,"no secondary command pool for thread %i frame %i",thread,frame);
+        return NULL;
+    }
+    return gf3d_commands.thread_pools[(thread * gf3d_commands.chain_length) + frame];
+}
+
+void gf3d_command_thread_pools_reset(Uint32 frame)
+{
+    int i;
+    Command *com;
+    for (i = 0; i < gf3d_commands.thread_count; i++)
+    {
+        com = gf3d_command_get_thread_pool(i,frame);
+        if (!com)continue;
+        vkResetCommandPool(gf3d_commands.device, com->commandPool, 0);
+        com->commandBufferNext = 0;
+    }
+}
+
+VkCommandBuffer gf3d_command_get_secondary_buffer(Command *com)
+{
+    VkCommandBuffer *buffers;
+    VkCommandBufferAllocateInfo allocInfo = {0};
+    Uint32 count;
+    if (!com)return VK_NULL_HANDLE;
+    if (com->commandBufferNext >= com->commandBufferCount)
+    {
+        count = com->commandBufferCount ? com->commandBufferCount : 4;//double it
+        buffers = (VkCommandBuffer*)gf3d_memory_alloc_array(MT_General,sizeof(VkCommandBuffer),com->commandBufferCount + count);
+        if (!buffers)
+        {
+            gf3d_log(LL_Error,"failed to grow secondary command buffer array");
+            return VK_NULL_HANDLE;
+        }
+        if (com->commandBuffers)
+        {
+            memcpy(buffers,com->commandBuffers,sizeof(VkCommandBuffer)*com->commandBufferCount);
+            gf3d_memory_free(com->commandBuffers);
+        }
+        com->commandBuffers = buffers;
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = com->commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = count;
+        if (vkAllocateCommandBuffers(gf3d_commands.device, &allocInfo, &com->commandBuffers[com->commandBufferCount]) != VK_SUCCESS)
+        {
+            gf3d_log(LL_Error,"failed to allocate more secondary command buffers!");
+            return VK_NULL_HANDLE;
+        }
+        com->commandBufferCount += count;
+    }
+    return com->commandBuffers[com->commandBufferNext++];
+}
+
+VkCommandBuffer gf3d_command_secondary_begin(Uint32 thread,Uint32 index,Pipeline *pipe)
+{
+    VkCommandBuffer commandBuffer;
+    VkCommandBufferInheritanceInfo inheritanceInfo = {0};
+    VkCommandBufferBeginInfo beginInfo = {0};
+    
+    if (!pipe)return VK_NULL_HANDLE;
+    commandBuffer = gf3d_command_get_secondary_buffer(gf3d_command_get_thread_pool(thread,index));
+    if (commandBuffer == VK_NULL_HANDLE)return VK_NULL_HANDLE;
+    
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = pipe->renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = gf3d_swapchain_get_frame_buffer_by_index(index);
+    
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+    
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+    {
+        gf3d_log(LL_Error,"failed to begin secondary command buffer");
+        return VK_NULL_HANDLE;
+    }
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipe->pipeline);
+    return commandBuffer;
+}
+
+void gf3d_command_secondary_end(VkCommandBuffer commandBuffer)
+{
+    if (commandBuffer == VK_NULL_HANDLE)return;
+    vkEndCommandBuffer(commandBuffer);
+}
+
 VkCommandBuffer * gf3d_command_pool_get_used_buffers(Command *com)
 {
     if (!com)return NULL;
@@ -182,6 +363,38 @@ VkCommandBuffer gf3d_command_rendering_begin(Uint32 index,Pipeline *pipe)
     return commandBuffer;
 }
 
+VkCommandBuffer gf3d_command_rendering_begin_secondary(Uint32 index,Pipeline *pipe)
+{
+    VkCommandBuffer commandBuffer;
+    
+    commandBuffer = gf3d_command_begin_single_time(gf3d_vgraphics_get_graphics_command_pool());
+    
+    //timestamps cannot go inside a render pass that only executes secondary buffers
+    gf3d_gpu_timer_buffer_begin(commandBuffer);
+    pipe->gpuZone = gf3d_gpu_timer_begin(commandBuffer,pipe->name);
+    gf3d_command_begin_render_pass(
+            commandBuffer,
+            pipe->renderPass,
+            gf3d_swapchain_get_frame_buffer_by_index(index),
+            VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    
+    return commandBuffer;
+}
+
+void gf3d_command_rendering_end_secondary(VkCommandBuffer commandBuffer,Pipeline *pipe)
+{
+    gf3d_command_configure_render_pass_end(commandBuffer);
+    if (pipe)gf3d_gpu_timer_end(commandBuffer,pipe->gpuZone);
+    gf3d_gpu_timer_buffer_end(commandBuffer);
+    gf3d_command_end_single_time(gf3d_vgraphics_get_graphics_command_pool(), commandBuffer);
+}
+
+void gf3d_command_execute_secondary(VkCommandBuffer commandBuffer,VkCommandBuffer *secondaryBuffers,Uint32 count)
+{
+    if ((!secondaryBuffers)||(!count))return;
+    vkCmdExecuteCommands(commandBuffer, count, secondaryBuffers);
+}
+
 void gf3d_command_rendering_end(VkCommandBuffer commandBuffer)
 {
     gf3d_command_configure_render_pass_end(commandBuffer);
@@ -189,6 +402,12 @@ void gf3d_command_rendering_end(VkCommandBuffer commandBuffer)
 }
 
 void gf3d_command_configure_render_pass(VkCommandBuffer commandBuffer, VkRenderPass renderPass,VkFramebuffer framebuffer,VkPipeline graphicsPipeline,VkPipelineLayout pipelineLayout)
+{
+    gf3d_command_begin_render_pass(commandBuffer,renderPass,framebuffer,VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+}
+
+void gf3d_command_begin_render_pass(VkCommandBuffer commandBuffer, VkRenderPass renderPass,VkFramebuffer framebuffer,VkSubpassContents contents)
 {
     VkClearValue clearValues[2] = {0};
     VkRenderPassBeginInfo renderPassInfo = {0};
@@ -205,8 +424,7 @@ void gf3d_command_configure_render_pass(VkCommandBuffer commandBuffer, VkRenderP
     renderPassInfo.clearValueCount = 2;
     renderPassInfo.pClearValues = clearValues;
     
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
 }
 
 VkCommandBuffer gf3d_command_begin_single_time(Command* com)
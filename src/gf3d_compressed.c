@@ -0,0 +1,709 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#include "simple_logger.h"
+
+#include "gfc_text.h"
+#include "gfc_pak.h"
+
+#include "gf3d_memory.h"
+#include "gf3d_compressed.h"
+
+#define DDS_MAGIC           0x20534444  // "DDS "
+#define DDS_HEADER_SIZE     124
+#define DDS_FOURCC(a,b,c,d) ((Uint32)(a) | ((Uint32)(b) << 8) | ((Uint32)(c) << 16) | ((Uint32)(d) << 24))
+
+#define DXGI_FORMAT_BC1_UNORM       71
+#define DXGI_FORMAT_BC1_UNORM_SRGB  72
+#define DXGI_FORMAT_BC3_UNORM       77
+#define DXGI_FORMAT_BC3_UNORM_SRGB  78
+#define DXGI_FORMAT_BC5_UNORM       83
+#define DXGI_FORMAT_BC7_UNORM       98
+#define DXGI_FORMAT_BC7_UNORM_SRGB  99
+
+#define KTX2_HEADER_SIZE    80
+static const Uint8 ktx2_identifier[12] = {0xAB,'K','T','X',' ','2','0',0xBB,'\r','\n',0x1A,'\n'};
+
+extern int __DEBUG;
+
+Uint32 gf3d_compressed_read_u32(const Uint8 *data)
+{
+    return (Uint32)data[0] | ((Uint32)data[1] << 8) | ((Uint32)data[2] << 16) | ((Uint32)data[3] << 24);
+}
+
+Uint64 gf3d_compressed_read_u64(const Uint8 *data)
+{
+    return (Uint64)gf3d_compressed_read_u32(data) | ((Uint64)gf3d_compressed_read_u32(data + 4) << 32);
+}
+
+Uint32 gf3d_compressed_block_bytes(VkFormat format)
+{
+    switch (format)
+    {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            return 8;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+size_t gf3d_compressed_level_size(VkFormat format,Uint32 width,Uint32 height)
+{
+    Uint32 blockBytes = gf3d_compressed_block_bytes(format);
+    if (!blockBytes)return (size_t)width * height * 4;
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+}
+
+VkFormat gf3d_compressed_format_from_dxgi(Uint32 dxgi)
+{
+    switch (dxgi)
+    {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+            return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+            return VK_FORMAT_BC3_UNORM_BLOCK;
+        case DXGI_FORMAT_BC5_UNORM:
+            return VK_FORMAT_BC5_UNORM_BLOCK;
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            return VK_FORMAT_BC7_UNORM_BLOCK;
+        default:
+            return VK_FORMAT_UNDEFINED;
+    }
+}
+
+VkFormat gf3d_compressed_format_from_vk(Uint32 vkFormat)
+{
+    switch (vkFormat)
+    {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+            return VK_FORMAT_BC3_UNORM_BLOCK;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            return VK_FORMAT_BC5_UNORM_BLOCK;
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return VK_FORMAT_BC7_UNORM_BLOCK;
+        default:
+            return VK_FORMAT_UNDEFINED;
+    }
+}
+
+/**
+ * @brief point each level at its data, checking that it all fits in the file
+ * @param offset where the top level starts, the others follow it
+ */
+Uint8 gf3d_compressed_image_set_levels(CompressedImage *image,size_t fileSize,size_t offset)
+{
+    Uint32 i;
+    for (i = 0; i < image->mipLevels; i++)
+    {
+        image->levelSize[i] = gf3d_compressed_level_size(image->format,MAX(1,image->width >> i),MAX(1,image->height >> i));
+        if ((offset > fileSize)||(image->levelSize[i] > fileSize - offset))return 0;
+        image->levels[i] = (Uint8 *)image->data + offset;
+        offset += image->levelSize[i];
+    }
+    return 1;
+}
+
+Uint8 gf3d_compressed_parse_dds(CompressedImage *image,size_t size,const char *filename)
+{
+    Uint32 fourCC;
+    size_t offset = 4 + DDS_HEADER_SIZE;
+    const Uint8 *data = image->data;
+
+    if ((size < offset)||(gf3d_compressed_read_u32(data + 4) != DDS_HEADER_SIZE))
+    {
+        slog("%s: bad DDS header",filename);
+        return 0;
+    }
+    image->height = gf3d_compressed_read_u32(data + 12);
+    image->width = gf3d_compressed_read_u32(data + 16);
+    image->mipLevels = MAX(1,gf3d_compressed_read_u32(data + 28));
+    fourCC = gf3d_compressed_read_u32(data + 84);
+    if (fourCC == DDS_FOURCC('D','X','1','0'))
+    {
+        if (size < offset + 20)
+        {
+            slog("%s: truncated DDS DX10 header",filename);
+            return 0;
+        }
+        image->format = gf3d_compressed_format_from_dxgi(gf3d_compressed_read_u32(data + offset));
+        offset += 20;
+    }
+    else if (fourCC == DDS_FOURCC('D','X','T','1'))image->format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    else if (fourCC == DDS_FOURCC('D','X','T','5'))image->format = VK_FORMAT_BC3_UNORM_BLOCK;
+    else if ((fourCC == DDS_FOURCC('A','T','I','2'))||(fourCC == DDS_FOURCC('B','C','5','U')))image->format = VK_FORMAT_BC5_UNORM_BLOCK;
+    if (image->format == VK_FORMAT_UNDEFINED)
+    {
+        slog("%s: DDS is not BC1, BC3, BC5 or BC7",filename);
+        return 0;
+    }
+    if ((!image->width)||(!image->height)||(image->mipLevels > GF3D_COMPRESSED_MAX_LEVELS))
+    {
+        slog("%s: unsupported DDS size %ux%u with %u levels",filename,image->width,image->height,image->mipLevels);
+        return 0;
+    }
+    if (!gf3d_compressed_image_set_levels(image,size,offset))
+    {
+        slog("%s: DDS data is truncated",filename);
+        return 0;
+    }
+    return 1;
+}
+
+Uint8 gf3d_compressed_parse_ktx2(CompressedImage *image,size_t size,const char *filename)
+{
+    Uint32 i;
+    Uint64 levelOffset,levelLength;
+    const Uint8 *data = image->data;
+
+    if (size < KTX2_HEADER_SIZE)
+    {
+        slog("%s: bad KTX2 header",filename);
+        return 0;
+    }
+    image->format = gf3d_compressed_format_from_vk(gf3d_compressed_read_u32(data + 12));
+    image->width = gf3d_compressed_read_u32(data + 20);
+    image->height = gf3d_compressed_read_u32(data + 24);
+    image->mipLevels = MAX(1,gf3d_compressed_read_u32(data + 40));
+    if (image->format == VK_FORMAT_UNDEFINED)
+    {
+        slog("%s: KTX2 is not BC1, BC3, BC5 or BC7",filename);
+        return 0;
+    }
+    if ((gf3d_compressed_read_u32(data + 28) > 1)||     // depth
+        (gf3d_compressed_read_u32(data + 32) > 1)||     // layers
+        (gf3d_compressed_read_u32(data + 36) != 1)||    // faces
+        (gf3d_compressed_read_u32(data + 44) != 0))     // supercompression
+    {
+        slog("%s: only plain 2D KTX2 textures are supported",filename);
+        return 0;
+    }
+    if ((!image->width)||(!image->height)||(image->mipLevels > GF3D_COMPRESSED_MAX_LEVELS)||
+        (size < KTX2_HEADER_SIZE + image->mipLevels * 24))
+    {
+        slog("%s: unsupported KTX2 size %ux%u with %u levels",filename,image->width,image->height,image->mipLevels);
+        return 0;
+    }
+    // levels are indexed individually, they are not required to be in order in the file
+    for (i = 0; i < image->mipLevels; i++)
+    {
+        levelOffset = gf3d_compressed_read_u64(data + KTX2_HEADER_SIZE + i * 24);
+        levelLength = gf3d_compressed_read_u64(data + KTX2_HEADER_SIZE + i * 24 + 8);
+        image->levelSize[i] = gf3d_compressed_level_size(image->format,MAX(1,image->width >> i),MAX(1,image->height >> i));
+        if ((levelLength < image->levelSize[i])||(levelOffset > size)||(image->levelSize[i] > size - levelOffset))
+        {
+            slog("%s: KTX2 level %u is truncated",filename,i);
+            return 0;
+        }
+        image->levels[i] = (Uint8 *)image->data + levelOffset;
+    }
+    return 1;
+}
+
+/**
+ * @brief load and parse a compressed image
+ * @param optional if set, a missing file is expected and only logged in debug
+ */
+CompressedImage *gf3d_compressed_image_load_file(const char *filename,Uint8 optional)
+{
+    size_t size = 0;
+    CompressedImage *image;
+
+    if (!filename)return NULL;
+    image = gf3d_memory_alloc_array(MT_Loader,sizeof(CompressedImage),1);
+    if (!image)return NULL;
+    image->data = gfc_pak_file_extract(filename,&size);
+    if (!image->data)
+    {
+        if ((!optional)||(__DEBUG))slog("failed to load compressed image %s",filename);
+        gf3d_compressed_image_free(image);
+        return NULL;
+    }
+    if ((size >= 4)&&(gf3d_compressed_read_u32(image->data) == DDS_MAGIC))
+    {
+        if (!gf3d_compressed_parse_dds(image,size,filename))
+        {
+            gf3d_compressed_image_free(image);
+            return NULL;
+        }
+    }
+    else if ((size >= sizeof(ktx2_identifier))&&(memcmp(image->data,ktx2_identifier,sizeof(ktx2_identifier)) == 0))
+    {
+        if (!gf3d_compressed_parse_ktx2(image,size,filename))
+        {
+            gf3d_compressed_image_free(image);
+            return NULL;
+        }
+    }
+    else
+    {
+        slog("%s is not a DDS or KTX2 file",filename);
+        gf3d_compressed_image_free(image);
+        return NULL;
+    }
+    if (__DEBUG)slog("loaded %s: %ux%u, %u levels",filename,image->width,image->height,image->mipLevels);
+    return image;
+}
+
+CompressedImage *gf3d_compressed_image_load(const char *filename)
+{
+    return gf3d_compressed_image_load_file(filename,0);
+}
+
+CompressedImage *gf3d_compressed_image_load_baked(const char *source)
+{
+    const char *ext;
+    GFC_TextLine baked;
+    struct stat sourceStat,bakedStat;
+
+    if (!source)return NULL;
+    ext = strrchr(source,'.');
+    if (!ext)ext = source + strlen(source);
+    gfc_line_sprintf(baked,"%.*s.dds",(int)(ext - source),source);
+    // files only in a pak have no timestamps to compare, so they are trusted
+    if ((stat(source,&sourceStat) == 0)&&(stat(baked,&bakedStat) == 0)&&(bakedStat.st_mtime < sourceStat.st_mtime))
+    {
+        if (__DEBUG)slog("%s is older than %s, loading the source",baked,source);
+        return NULL;
+    }
+    return gf3d_compressed_image_load_file(baked,1);
+}
+
+void gf3d_compressed_image_free(CompressedImage *image)
+{
+    if (!image)return;
+    if (image->data)free(image->data);
+    gf3d_memory_free(image);
+}
+
+/*decoding*/
+
+void gf3d_compressed_color565(Uint16 c,Uint8 *out)
+{
+    Uint8 r = (c >> 11) & 31,g = (c >> 5) & 63,b = c & 31;
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+    out[3] = 255;
+}
+
+/**
+ * @brief decode the color half of a BC1 or BC3 block into a 4x4 RGBA block
+ * @param fourColor BC3 always interpolates four colors, BC1 uses three and black when c0 <= c1
+ * @param punchThrough if the black of three color mode is transparent, as in BC1 RGBA
+ */
+void gf3d_compressed_decode_bc1(const Uint8 *block,Uint8 *out,Uint8 fourColor,Uint8 punchThrough)
+{
+    int i,j;
+    Uint8 palette[4][4];
+    Uint16 c0,c1;
+    Uint32 indices;
+
+    c0 = block[0] | (block[1] << 8);
+    c1 = block[2] | (block[3] << 8);
+    gf3d_compressed_color565(c0,palette[0]);
+    gf3d_compressed_color565(c1,palette[1]);
+    for (j = 0; j < 3; j++)
+    {
+        if ((fourColor)||(c0 > c1))
+        {
+            palette[2][j] = (2 * palette[0][j] + palette[1][j]) / 3;
+            palette[3][j] = (palette[0][j] + 2 * palette[1][j]) / 3;
+        }
+        else
+        {
+            palette[2][j] = (palette[0][j] + palette[1][j]) / 2;
+            palette[3][j] = 0;
+        }
+    }
+    palette[2][3] = 255;
+    palette[3][3] = ((punchThrough)&&(!fourColor)&&(c0 <= c1)) ? 0 : 255;
+    indices = gf3d_compressed_read_u32(block + 4);
+    for (i = 0; i < 16; i++)
+    {
+        memcpy(out + i * 4,palette[(indices >> (i * 2)) & 3],4);
+    }
+}
+
+/**
+ * @brief decode a BC4 block, the alpha of BC3 and each channel of BC5, into one channel of a 4x4 RGBA block
+ */
+void gf3d_compressed_decode_bc4(const Uint8 *block,Uint8 *out)
+{
+    int i;
+    Uint8 palette[8];
+    Uint64 indices = 0;
+
+    palette[0] = block[0];
+    palette[1] = block[1];
+    if (palette[0] > palette[1])
+    {
+        for (i = 1; i < 7; i++)palette[i + 1] = ((7 - i) * palette[0] + i * palette[1]) / 7;
+    }
+    else
+    {
+        for (i = 1; i < 5; i++)palette[i + 1] = ((5 - i) * palette[0] + i * palette[1]) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+    for (i = 0; i < 6; i++)indices |= (Uint64)block[2 + i] << (i * 8);
+    for (i = 0; i < 16; i++)
+    {
+        out[i * 4] = palette[(indices >> (i * 3)) & 7];
+    }
+}
+
+SDL_Surface *gf3d_compressed_image_decode(CompressedImage *image,Uint32 level)
+{
+    Uint32 bx,by,x,y,w,h,blocksWide,blocksHigh;
+    Uint8 texels[16 * 4];
+    Uint32 blockBytes;
+    const Uint8 *block;
+    SDL_Surface *surface;
+
+    if ((!image)||(level >= image->mipLevels))return NULL;
+    if (image->format == VK_FORMAT_BC7_UNORM_BLOCK)
+    {
+        slog("BC7 cannot be decoded in software, the device needs BC7 support");
+        return NULL;
+    }
+    w = MAX(1,image->width >> level);
+    h = MAX(1,image->height >> level);
+    surface = SDL_CreateRGBSurfaceWithFormat(0,w,h,32,SDL_PIXELFORMAT_RGBA32);
+    if (!surface)
+    {
+        slog("failed to create surface to decode into: %s",SDL_GetError());
+        return NULL;
+    }
+    blockBytes = gf3d_compressed_block_bytes(image->format);
+    blocksWide = (w + 3) / 4;
+    blocksHigh = (h + 3) / 4;
+    block = image->levels[level];
+    SDL_LockSurface(surface);
+    for (by = 0; by < blocksHigh; by++)
+    {
+        for (bx = 0; bx < blocksWide; bx++,block += blockBytes)
+        {
+            switch (image->format)
+            {
+                case VK_FORMAT_BC3_UNORM_BLOCK:
+                    gf3d_compressed_decode_bc1(block + 8,texels,1,0);
+                    gf3d_compressed_decode_bc4(block,texels + 3);
+                    break;
+                case VK_FORMAT_BC5_UNORM_BLOCK:
+                    // the same as sampling BC5 on the gpu: red, green, no blue, opaque
+                    memset(texels,0,sizeof(texels));
+                    for (x = 0; x < 16; x++)texels[x * 4 + 3] = 255;
+                    gf3d_compressed_decode_bc4(block,texels);
+                    gf3d_compressed_decode_bc4(block + 8,texels + 1);
+                    break;
+                default:
+                    gf3d_compressed_decode_bc1(block,texels,0,image->format == VK_FORMAT_BC1_RGBA_UNORM_BLOCK);
+                    break;
+            }
+            for (y = 0; (y < 4)&&(by * 4 + y < h); y++)
+            {
+                for (x = 0; (x < 4)&&(bx * 4 + x < w); x++)
+                {
+                    memcpy((Uint8 *)surface->pixels + (by * 4 + y) * surface->pitch + (bx * 4 + x) * 4,texels + (y * 4 + x) * 4,4);
+                }
+            }
+        }
+    }
+    SDL_UnlockSurface(surface);
+    return surface;
+}
+
+/*encoding*/
+
+Uint16 gf3d_compressed_to565(const float *color)
+{
+    int r,g,b;
+    r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+    g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+    b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+    r = MIN(31,MAX(0,r));
+    g = MIN(63,MAX(0,g));
+    b = MIN(31,MAX(0,b));
+    return (r << 11) | (g << 5) | b;
+}
+
+/**
+ * @brief encode the color of a 4x4 RGBA block in four color mode
+ * @note endpoints are the extremes along the principal axis of the block colors, pulled in slightly since
+ * the extremes are rarely hit exactly
+ */
+void gf3d_compressed_encode_bc1(const Uint8 *texels,Uint8 *out)
+{
+    int i,j,k,best;
+    float mean[3] = {0},cov[6] = {0},axis[3] = {1,1,1},next[3];
+    float d[3],t,tmin,tmax,len,inset;
+    float lo[3],hi[3];
+    Uint16 c0,c1,swap;
+    Uint8 palette[4][4];
+    Uint32 indices = 0,dist,bestDist;
+
+    for (i = 0; i < 16; i++)
+    {
+        for (j = 0; j < 3; j++)mean[j] += texels[i * 4 + j];
+    }
+    for (j = 0; j < 3; j++)mean[j] /= 16.0f;
+    for (i = 0; i < 16; i++)
+    {
+        for (j = 0; j < 3; j++)d[j] = texels[i * 4 + j] - mean[j];
+        cov[0] += d[0] * d[0];
+        cov[1] += d[0] * d[1];
+        cov[2] += d[0] * d[2];
+        cov[3] += d[1] * d[1];
+        cov[4] += d[1] * d[2];
+        cov[5] += d[2] * d[2];
+    }
+    // a few rounds of power iteration finds the principal axis well enough for 16 points
+    for (k = 0; k < 4; k++)
+    {
+        next[0] = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        next[1] = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        next[2] = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        len = next[0] * next[0] + next[1] * next[1] + next[2] * next[2];
+        if (len < 0.0001f)break;
+        len = 1.0f / sqrtf(len);
+        for (j = 0; j < 3; j++)axis[j] = next[j] * len;
+    }
+    tmin = tmax = 0;
+    for (i = 0; i < 16; i++)
+    {
+        t = 0;
+        for (j = 0; j < 3; j++)t += (texels[i * 4 + j] - mean[j]) * axis[j];
+        if (t < tmin)tmin = t;
+        if (t > tmax)tmax = t;
+    }
+    inset = (tmax - tmin) / 32.0f;
+    for (j = 0; j < 3; j++)
+    {
+        hi[j] = mean[j] + (tmax - inset) * axis[j];
+        lo[j] = mean[j] + (tmin + inset) * axis[j];
+    }
+    c0 = gf3d_compressed_to565(hi);
+    c1 = gf3d_compressed_to565(lo);
+    if (c0 < c1)
+    {
+        swap = c0;
+        c0 = c1;
+        c1 = swap;
+    }
+    out[0] = c0 & 0xff;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xff;
+    out[3] = c1 >> 8;
+    if (c0 != c1)
+    {
+        // pick from the palette the decoder will actually build
+        gf3d_compressed_color565(c0,palette[0]);
+        gf3d_compressed_color565(c1,palette[1]);
+        for (j = 0; j < 3; j++)
+        {
+            palette[2][j] = (2 * palette[0][j] + palette[1][j]) / 3;
+            palette[3][j] = (palette[0][j] + 2 * palette[1][j]) / 3;
+        }
+        for (i = 0; i < 16; i++)
+        {
+            best = 0;
+            bestDist = 0xffffffff;
+            for (k = 0; k < 4; k++)
+            {
+                dist = 0;
+                for (j = 0; j < 3; j++)dist += (texels[i * 4 + j] - palette[k][j]) * (texels[i * 4 + j] - palette[k][j]);
+                if (dist < bestDist)
+                {
+                    bestDist = dist;
+                    best = k;
+                }
+            }
+            indices |= (Uint32)best << (i * 2);
+        }
+    }
+    out[4] = indices & 0xff;
+    out[5] = (indices >> 8) & 0xff;
+    out[6] = (indices >> 16) & 0xff;
+    out[7] = indices >> 24;
+}
+
+/**
+ * @brief encode one channel of a 4x4 RGBA block as BC4, using the eight value mode
+ */
+void gf3d_compressed_encode_bc4(const Uint8 *texels,Uint8 *out)
+{
+    int i,k,best;
+    Uint8 lo = 255,hi = 0,v;
+    Uint8 palette[8];
+    Uint64 indices = 0;
+    int dist,bestDist;
+
+    for (i = 0; i < 16; i++)
+    {
+        v = texels[i * 4];
+        if (v < lo)lo = v;
+        if (v > hi)hi = v;
+    }
+    out[0] = hi;
+    out[1] = lo;
+    if (hi != lo)
+    {
+        palette[0] = hi;
+        palette[1] = lo;
+        for (i = 1; i < 7; i++)palette[i + 1] = ((7 - i) * hi + i * lo) / 7;
+        for (i = 0; i < 16; i++)
+        {
+            best = 0;
+            bestDist = 256;
+            for (k = 0; k < 8; k++)
+            {
+                dist = abs(texels[i * 4] - palette[k]);
+                if (dist < bestDist)
+                {
+                    bestDist = dist;
+                    best = k;
+                }
+            }
+            indices |= (Uint64)best << (i * 3);
+        }
+    }
+    for (i = 0; i < 6; i++)out[2 + i] = (indices >> (i * 8)) & 0xff;
+}
+
+Uint8 *gf3d_compressed_encode(SDL_Surface *surface,VkFormat format,size_t *size)
+{
+    Uint32 bx,by,x,y,sx,sy,blocksWide,blocksHigh,blockBytes;
+    Uint8 texels[16 * 4];
+    Uint8 *data,*block;
+
+    if ((!surface)||(!size))return NULL;
+    if ((surface->format->format != SDL_PIXELFORMAT_RGBA32)||
+        ((format != VK_FORMAT_BC1_RGB_UNORM_BLOCK)&&(format != VK_FORMAT_BC3_UNORM_BLOCK)&&(format != VK_FORMAT_BC5_UNORM_BLOCK)))
+    {
+        slog("can only encode RGBA32 surfaces to BC1, BC3 or BC5");
+        return NULL;
+    }
+    blockBytes = gf3d_compressed_block_bytes(format);
+    blocksWide = (surface->w + 3) / 4;
+    blocksHigh = (surface->h + 3) / 4;
+    *size = (size_t)blocksWide * blocksHigh * blockBytes;
+    data = gf3d_memory_alloc_array(MT_Loader,*size,1);
+    if (!data)return NULL;
+    block = data;
+    SDL_LockSurface(surface);
+    for (by = 0; by < blocksHigh; by++)
+    {
+        for (bx = 0; bx < blocksWide; bx++,block += blockBytes)
+        {
+            // partial blocks at the edges repeat the last row and column
+            for (y = 0; y < 4; y++)
+            {
+                sy = MIN(by * 4 + y,surface->h - 1);
+                for (x = 0; x < 4; x++)
+                {
+                    sx = MIN(bx * 4 + x,surface->w - 1);
+                    memcpy(texels + (y * 4 + x) * 4,(Uint8 *)surface->pixels + sy * surface->pitch + sx * 4,4);
+                }
+            }
+            switch (format)
+            {
+                case VK_FORMAT_BC3_UNORM_BLOCK:
+                    gf3d_compressed_encode_bc4(texels + 3,block);
+                    gf3d_compressed_encode_bc1(texels,block + 8);
+                    break;
+                case VK_FORMAT_BC5_UNORM_BLOCK:
+                    gf3d_compressed_encode_bc4(texels,block);
+                    gf3d_compressed_encode_bc4(texels + 1,block + 8);
+                    break;
+                default:
+                    gf3d_compressed_encode_bc1(texels,block);
+                    break;
+            }
+        }
+    }
+    SDL_UnlockSurface(surface);
+    return data;
+}
+
+Uint8 gf3d_compressed_save_dds(
+    const char *filename,
+    VkFormat format,
+    Uint32 width,
+    Uint32 height,
+    Uint32 mipLevels,
+    Uint8 **levels,
+    size_t *levelSize)
+{
+    FILE *file;
+    Uint32 i;
+    Uint32 header[32] = {0};   // magic then the 124 byte header
+
+    if ((!filename)||(!levels)||(!levelSize)||(!mipLevels))return 0;
+    header[0] = DDS_MAGIC;
+    header[1] = DDS_HEADER_SIZE;
+    header[2] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;  // caps, height, width, pixelformat, mipmapcount, linearsize
+    header[3] = height;
+    header[4] = width;
+    header[5] = (Uint32)levelSize[0];
+    header[7] = mipLevels;
+    header[19] = 32;            // pixel format size
+    header[20] = 0x4;           // fourcc
+    switch (format)
+    {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            header[21] = DDS_FOURCC('D','X','T','1');
+            break;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+            header[21] = DDS_FOURCC('D','X','T','5');
+            break;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            header[21] = DDS_FOURCC('A','T','I','2');
+            break;
+        default:
+            slog("can only save BC1, BC3 or BC5 to DDS");
+            return 0;
+    }
+    header[27] = 0x1000;        // texture
+    if (mipLevels > 1)header[27] |= 0x8 | 0x400000;    // complex, mipmap
+    file = fopen(filename,"wb");
+    if (!file)
+    {
+        slog("failed to open %s for writing",filename);
+        return 0;
+    }
+    // the header is written in host order, every platform this builds for is little endian
+    fwrite(header,sizeof(header),1,file);
+    for (i = 0; i < mipLevels; i++)
+    {
+        if (fwrite(levels[i],levelSize[i],1,file) != 1)
+        {
+            slog("failed to write %s",filename);
+            fclose(file);
+            return 0;
+        }
+    }
+    fclose(file);
+    return 1;
+}
+
+/*eol@eof*/
@@ -516,6 +516,10 @@ VkImageLayout gf3d_config_image_layer_from_str(const char *str)
     {
         return VK_IMAGE_LAYOUT_PREINITIALIZED;
     }
+    else if (strcmp(str,"VK_IMAGE_LAYOUT_PRESENT_SRC_KHR")==0)
+    {
+        return VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    }
     //NOTE: there are a lot more of these, but are specific to later versions or extensions.  If you want to support more, just
     // add another else if set for what you want to support.
     return VK_IMAGE_LAYOUT_UNDEFINED;
@@ -817,4 +821,33 @@ VkPipelineColorBlendAttachmentState gf3d_config_pipeline_color_blend_attachment(
     colorBlendAttachment.dstAlphaBlendFactor =  gf3d_config_parse_blend_factor(sj_object_get_value_as_string(config,"dstAlphaBlendFactor"));
     return colorBlendAttachment;
 }
+
+VkFilter gf3d_config_filter_from_str(const char *str)
+{
+    if (!str)return VK_FILTER_NEAREST;
+    if (strcmp(str,"VK_FILTER_NEAREST")==0)return VK_FILTER_NEAREST;
+    if (strcmp(str,"VK_FILTER_LINEAR")==0)return VK_FILTER_LINEAR;
+    slog("unknown filter %s",str);
+    return VK_FILTER_NEAREST;
+}
+
+VkSamplerMipmapMode gf3d_config_sampler_mipmap_mode_from_str(const char *str)
+{
+    if (!str)return VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    if (strcmp(str,"VK_SAMPLER_MIPMAP_MODE_NEAREST")==0)return VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    if (strcmp(str,"VK_SAMPLER_MIPMAP_MODE_LINEAR")==0)return VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    slog("unknown mipmap mode %s",str);
+    return VK_SAMPLER_MIPMAP_MODE_NEAREST;
+}
+
+VkSamplerAddressMode gf3d_config_sampler_address_mode_from_str(const char *str)
+{
+    if (!str)return VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    if (strcmp(str,"VK_SAMPLER_ADDRESS_MODE_REPEAT")==0)return VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    if (strcmp(str,"VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT")==0)return VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+    if (strcmp(str,"VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE")==0)return VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    if (strcmp(str,"VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER")==0)return VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    slog("unknown sampler address mode %s",str);
+    return VK_SAMPLER_ADDRESS_MODE_REPEAT;
+}
 /*eol@eof*/
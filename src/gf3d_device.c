@@ -5,6 +5,7 @@
 #include "gfc_list.h"
 #include "gfc_pak.h"
 
+#include "gf3d_memory.h"
 #include "gf3d_vqueues.h"
 #include "gf3d_validation.h"
 #include "gf3d_extensions.h"
@@ -42,12 +43,12 @@ void gf3d_device_manager_close()
     sj_free(gf3d_device_manager.config);
     if (gf3d_device_manager.device_list)
     {
-        gfc_list_foreach(gf3d_device_manager.device_list,free);
+        gfc_list_foreach(gf3d_device_manager.device_list,gf3d_memory_free);
     }
     gfc_list_delete(gf3d_device_manager.device_list);
     if (gf3d_device_manager.devices)
     {
-        free(gf3d_device_manager.devices);
+        gf3d_memory_free(gf3d_device_manager.devices);
     }
     memset(&gf3d_device_manager,0,sizeof(GF3D_DeviceManager));
     if (__DEBUG)slog("gf2d_devices manager closed");
@@ -100,6 +101,11 @@ void gf3d_device_manager_init(const char *config, VkInstance instance, VkSurface
     
     //setup device extensions
     gf3d_extensions_device_init(gf3d_device_manager.chosen_gpu->device,config);
+    if (gf3d_device_manager.renderSurface == VK_NULL_HANDLE)
+    {
+        // rendering offscreen, there is nothing to present to
+        if ((gf3d_extensions_disable(ET_Device,"VK_KHR_swapchain"))&&(__DEBUG))slog("no render surface, VK_KHR_swapchain not needed");
+    }
 
     gf3d_device_create_logic_device(enable_validation);
     
@@ -113,7 +119,7 @@ GF3D_Device *gf3d_device_get_info(VkPhysicalDevice device)
     SJson *device_config;
     
     if (!device)return NULL;
-    device_info = gfc_allocate_array(sizeof(GF3D_Device),1);
+    device_info = gf3d_memory_alloc_array(MT_General,sizeof(GF3D_Device),1);
     if (!device_info)return NULL;
     
     device_info->device = device;
@@ -168,7 +174,7 @@ int gf3d_devices_enumerate()
     slog_sync();
     
     gf3d_device_manager.device_list = gfc_list_new();
-    gf3d_device_manager.devices = (VkPhysicalDevice *)malloc(sizeof(VkPhysicalDevice)*count);
+    gf3d_device_manager.devices = (VkPhysicalDevice *)gf3d_memory_alloc_array(MT_General,sizeof(VkPhysicalDevice),count);
     vkEnumeratePhysicalDevices(gf3d_device_manager.instance, &count, gf3d_device_manager.devices);
     
     for (i = 0; i < count; i++)
@@ -8,6 +8,7 @@
 #include "gfc_vector.h"
 #include "gfc_pak.h"
 
+#include "gf3d_memory.h"
 #include "gf3d_extensions.h"
 
 extern int __DEBUG;
@@ -36,11 +37,11 @@ void gf3d_extensions_device_init(VkPhysicalDevice device, const char *config)
     if (__DEBUG)slog("Total available device extensions: %i",gf3d_device_extensions.available_extension_count);
     if (!gf3d_device_extensions.available_extension_count)return;
 
-    gf3d_device_extensions.available_extensions = (VkExtensionProperties*)gfc_allocate_array(sizeof (VkExtensionProperties),gf3d_device_extensions.available_extension_count);    
+    gf3d_device_extensions.available_extensions = (VkExtensionProperties*)gf3d_memory_alloc_array(MT_General,sizeof (VkExtensionProperties),gf3d_device_extensions.available_extension_count);    
 
     if (!gf3d_device_extensions.available_extensions)return;
 
-    gf3d_device_extensions.enabled_extension_names = gfc_allocate_array(sizeof(const char *),gf3d_device_extensions.available_extension_count);
+    gf3d_device_extensions.enabled_extension_names = gf3d_memory_alloc_array(MT_General,sizeof(const char *),gf3d_device_extensions.available_extension_count);
     if (!gf3d_device_extensions.enabled_extension_names)return;
 
     vkEnumerateDeviceExtensionProperties(device,NULL, &gf3d_device_extensions.available_extension_count, gf3d_device_extensions.available_extensions);
@@ -61,11 +62,11 @@ void gf3d_extensions_device_close()
 {
     if (gf3d_device_extensions.available_extensions)
     {
-        free(gf3d_device_extensions.available_extensions);
+        gf3d_memory_free(gf3d_device_extensions.available_extensions);
     }
     if (gf3d_device_extensions.enabled_extension_names)
     {
-        free(gf3d_device_extensions.enabled_extension_names);
+        gf3d_memory_free(gf3d_device_extensions.enabled_extension_names);
     }
     memset(&gf3d_device_extensions,0,sizeof(vExtensions));
     if (__DEBUG)slog("device extensions closed");
@@ -79,10 +80,10 @@ void gf3d_extensions_instance_init(const char *config)
     if (__DEBUG)slog("Total available instance extensions: %i",gf3d_instance_extensions.available_extension_count);
     if (!gf3d_instance_extensions.available_extension_count)return;
 
-    gf3d_instance_extensions.available_extensions = (VkExtensionProperties*)gfc_allocate_array(sizeof (VkExtensionProperties),gf3d_instance_extensions.available_extension_count);    
+    gf3d_instance_extensions.available_extensions = (VkExtensionProperties*)gf3d_memory_alloc_array(MT_General,sizeof (VkExtensionProperties),gf3d_instance_extensions.available_extension_count);    
     if (!gf3d_instance_extensions.available_extensions)return;
 
-    gf3d_instance_extensions.enabled_extension_names = gfc_allocate_array(sizeof(const char *),gf3d_instance_extensions.available_extension_count);
+    gf3d_instance_extensions.enabled_extension_names = gf3d_memory_alloc_array(MT_General,sizeof(const char *),gf3d_instance_extensions.available_extension_count);
     if (!gf3d_instance_extensions.enabled_extension_names)return;
 
     vkEnumerateInstanceExtensionProperties(NULL, &gf3d_instance_extensions.available_extension_count, gf3d_instance_extensions.available_extensions);
@@ -103,11 +104,11 @@ void gf3d_extensions_instance_close()
 {
     if (gf3d_instance_extensions.available_extensions)
     {
-        free(gf3d_instance_extensions.available_extensions);
+        gf3d_memory_free(gf3d_instance_extensions.available_extensions);
     }
     if (gf3d_instance_extensions.enabled_extension_names)
     {
-        free(gf3d_instance_extensions.enabled_extension_names);
+        gf3d_memory_free(gf3d_instance_extensions.enabled_extension_names);
     }
     memset(&gf3d_instance_extensions,0,sizeof(vExtensions));
     if (__DEBUG)slog("instance extentions closed");
@@ -215,6 +216,46 @@ Bool gf3d_extensions_enable(ExtensionType extType, const char *extensionName)
     return true;
 }
 
+Bool gf3d_extensions_disable(ExtensionType extType, const char *extensionName)
+{
+    vExtensions *extensions;
+    Uint32 i;
+    if (!extensionName)return false;
+    switch(extType)
+    {
+        case ET_Instance:
+            extensions = &gf3d_instance_extensions;
+        break;
+        case ET_Device:
+            extensions = &gf3d_device_extensions;
+        break;
+        default:
+            slog("unknown extension type");
+            return false;
+    }
+    for (i = 0; i < extensions->enabled_extension_count;i++)
+    {
+        if (strcmp(extensions->enabled_extension_names[i],extensionName) != 0)continue;
+        extensions->enabled_extension_count--;
+        memmove(&extensions->enabled_extension_names[i],&extensions->enabled_extension_names[i + 1],sizeof(const char *)*(extensions->enabled_extension_count - i));
+        return true;
+    }
+    return false;
+}
+
+Bool gf3d_extensions_is_enabled(ExtensionType extType, const char *extensionName)
+{
+    vExtensions *extensions;
+    Uint32 i;
+    if (!extensionName)return false;
+    extensions = (extType == ET_Instance) ? &gf3d_instance_extensions : &gf3d_device_extensions;
+    for (i = 0; i < extensions->enabled_extension_count;i++)
+    {
+        if (strcmp(extensions->enabled_extension_names[i],extensionName) == 0)return true;
+    }
+    return false;
+}
+
 const char* const* gf3d_extensions_get_instance_enabled_names(Uint32 *count)
 {
     if (count != NULL)*count = gf3d_instance_extensions.enabled_extension_count;
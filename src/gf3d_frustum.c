@@ -0,0 +1,201 @@
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE__)||defined(_M_X64)||(defined(_M_IX86_FP)&&(_M_IX86_FP >= 1))
+#define GF3D_FRUSTUM_SSE
+#include <xmmintrin.h>
+#endif
+
+#include "simple_logger.h"
+
+#include "gf3d_vgraphics.h"
+#include "gf3d_frustum.h"
+
+void gf3d_frustum_set_plane(Frustum *frustum,int i,float a,float b,float c,float d)
+{
+    float length;
+    length = sqrtf(a*a + b*b + c*c);
+    if (length > 0)
+    {
+        a /= length;
+        b /= length;
+        c /= length;
+        d /= length;
+    }
+    frustum->nx[i] = a;
+    frustum->ny[i] = b;
+    frustum->nz[i] = c;
+    frustum->d[i] = d;
+    frustum->ax[i] = fabsf(a);
+    frustum->ay[i] = fabsf(b);
+    frustum->az[i] = fabsf(c);
+}
+
+void gf3d_frustum_from_matrix(Frustum *frustum,GFC_Matrix4 m)
+{
+    int i;
+    if (!frustum)return;
+    // matrices are column major: m[column][row], clip = m * world
+    // left, right, bottom, top
+    for (i = 0; i < 2; i++)
+    {
+        gf3d_frustum_set_plane(frustum,i * 2,
+                               m[0][3] + m[0][i],m[1][3] + m[1][i],m[2][3] + m[2][i],m[3][3] + m[3][i]);
+        gf3d_frustum_set_plane(frustum,i * 2 + 1,
+                               m[0][3] - m[0][i],m[1][3] - m[1][i],m[2][3] - m[2][i],m[3][3] - m[3][i]);
+    }
+    // near uses the -w <= z convention, which also covers 0 <= z projections
+    gf3d_frustum_set_plane(frustum,4,m[0][3] + m[0][2],m[1][3] + m[1][2],m[2][3] + m[2][2],m[3][3] + m[3][2]);
+    gf3d_frustum_set_plane(frustum,5,m[0][3] - m[0][2],m[1][3] - m[1][2],m[2][3] - m[2][2],m[3][3] - m[3][2]);
+    // padding planes always pass
+    for (i = 6; i < 8; i++)
+    {
+        frustum->nx[i] = frustum->ny[i] = frustum->nz[i] = 0;
+        frustum->ax[i] = frustum->ay[i] = frustum->az[i] = 0;
+        frustum->d[i] = 1;
+    }
+}
+
+void gf3d_frustum_from_view_projection(Frustum *frustum,GFC_Matrix4 view,GFC_Matrix4 proj)
+{
+    int c,r,k;
+    GFC_Matrix4 viewProj;
+    if (!frustum)return;
+    for (c = 0; c < 4; c++)
+    {
+        for (r = 0; r < 4; r++)
+        {
+            viewProj[c][r] = 0;
+            for (k = 0; k < 4; k++)
+            {
+                viewProj[c][r] += proj[k][r] * view[c][k];
+            }
+        }
+    }
+    gf3d_frustum_from_matrix(frustum,viewProj);
+}
+
+void gf3d_frustum_from_current_view(Frustum *frustum)
+{
+    GFC_Matrix4 view,proj;
+    if (!frustum)return;
+    gf3d_vgraphics_get_view(&view);
+    gf3d_vgraphics_get_projection_matrix(&proj);
+    gf3d_frustum_from_view_projection(frustum,view,proj);
+}
+
+Uint8 gf3d_frustum_test_box(Frustum *frustum,GFC_Vector3D center,GFC_Vector3D halfExtents)
+{
+#ifdef GF3D_FRUSTUM_SSE
+    int i;
+    __m128 cx,cy,cz,ex,ey,ez,dist,radius,zero;
+    if (!frustum)return 1;
+    cx = _mm_set1_ps(center.x);
+    cy = _mm_set1_ps(center.y);
+    cz = _mm_set1_ps(center.z);
+    ex = _mm_set1_ps(halfExtents.x);
+    ey = _mm_set1_ps(halfExtents.y);
+    ez = _mm_set1_ps(halfExtents.z);
+    zero = _mm_setzero_ps();
+    for (i = 0; i < 8; i += 4)
+    {
+        dist = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&frustum->nx[i]),cx),_mm_mul_ps(_mm_loadu_ps(&frustum->ny[i]),cy)),
+            _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&frustum->nz[i]),cz),_mm_loadu_ps(&frustum->d[i])));
+        radius = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&frustum->ax[i]),ex),_mm_mul_ps(_mm_loadu_ps(&frustum->ay[i]),ey)),
+            _mm_mul_ps(_mm_loadu_ps(&frustum->az[i]),ez));
+        if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(dist,radius),zero)))return 0;
+    }
+    return 1;
+#else
+    int i;
+    float dist,radius;
+    if (!frustum)return 1;
+    for (i = 0; i < 6; i++)
+    {
+        dist = frustum->nx[i]*center.x + frustum->ny[i]*center.y + frustum->nz[i]*center.z + frustum->d[i];
+        radius = frustum->ax[i]*halfExtents.x + frustum->ay[i]*halfExtents.y + frustum->az[i]*halfExtents.z;
+        if (dist + radius < 0)return 0;
+    }
+    return 1;
+#endif
+}
+
+Uint8 gf3d_frustum_classify_box(Frustum *frustum,GFC_Vector3D center,GFC_Vector3D halfExtents)
+{
+#ifdef GF3D_FRUSTUM_SSE
+    int i,crossing = 0;
+    __m128 cx,cy,cz,ex,ey,ez,dist,radius,zero;
+    if (!frustum)return 1;
+    cx = _mm_set1_ps(center.x);
+    cy = _mm_set1_ps(center.y);
+    cz = _mm_set1_ps(center.z);
+    ex = _mm_set1_ps(halfExtents.x);
+    ey = _mm_set1_ps(halfExtents.y);
+    ez = _mm_set1_ps(halfExtents.z);
+    zero = _mm_setzero_ps();
+    for (i = 0; i < 8; i += 4)
+    {
+        dist = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&frustum->nx[i]),cx),_mm_mul_ps(_mm_loadu_ps(&frustum->ny[i]),cy)),
+            _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&frustum->nz[i]),cz),_mm_loadu_ps(&frustum->d[i])));
+        radius = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&frustum->ax[i]),ex),_mm_mul_ps(_mm_loadu_ps(&frustum->ay[i]),ey)),
+            _mm_mul_ps(_mm_loadu_ps(&frustum->az[i]),ez));
+        if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(dist,radius),zero)))return 0;
+        if (_mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(dist,radius),zero)))crossing = 1;
+    }
+    return crossing ? 1 : 2;
+#else
+    int i,crossing = 0;
+    float dist,radius;
+    if (!frustum)return 1;
+    for (i = 0; i < 6; i++)
+    {
+        dist = frustum->nx[i]*center.x + frustum->ny[i]*center.y + frustum->nz[i]*center.z + frustum->d[i];
+        radius = frustum->ax[i]*halfExtents.x + frustum->ay[i]*halfExtents.y + frustum->az[i]*halfExtents.z;
+        if (dist + radius < 0)return 0;
+        if (dist - radius < 0)crossing = 1;
+    }
+    return crossing ? 1 : 2;
+#endif
+}
+
+Uint8 gf3d_frustum_test_sphere(Frustum *frustum,GFC_Vector3D center,float radius)
+{
+    int i;
+    if (!frustum)return 1;
+    for (i = 0; i < 6; i++)
+    {
+        if (frustum->nx[i]*center.x + frustum->ny[i]*center.y + frustum->nz[i]*center.z + frustum->d[i] < -radius)return 0;
+    }
+    return 1;
+}
+
+void gf3d_frustum_transform_box(GFC_Box *out,GFC_Box in,GFC_Matrix4 mat)
+{
+    int r;
+    float center[3],half[3],worldCenter[3],worldHalf[3];
+    if (!out)return;
+    half[0] = in.w * 0.5;
+    half[1] = in.h * 0.5;
+    half[2] = in.d * 0.5;
+    center[0] = in.x + half[0];
+    center[1] = in.y + half[1];
+    center[2] = in.z + half[2];
+    // the extents of a transformed box are the absolute value of the rotation scaled extents
+    for (r = 0; r < 3; r++)
+    {
+        worldCenter[r] = mat[0][r]*center[0] + mat[1][r]*center[1] + mat[2][r]*center[2] + mat[3][r];
+        worldHalf[r] = fabsf(mat[0][r])*half[0] + fabsf(mat[1][r])*half[1] + fabsf(mat[2][r])*half[2];
+    }
+    out->x = worldCenter[0] - worldHalf[0];
+    out->y = worldCenter[1] - worldHalf[1];
+    out->z = worldCenter[2] - worldHalf[2];
+    out->w = worldHalf[0] * 2;
+    out->h = worldHalf[1] * 2;
+    out->d = worldHalf[2] * 2;
+}
+
+/*eol@eof*/
@@ -7,6 +7,7 @@
 #include "gfc_config.h"
 #include "gfc_pak.h"
 
+#include "gf3d_memory.h"
 #include "gf3d_obj_load.h"
 
 #include "gf3d_gltf_parse.h"
@@ -18,7 +19,7 @@ char* gf3d_gltf_decode(SJson* gltf, Uint32 bufferIndex);
 
 GLTF* gf3d_gltf_new()
 {
-    GLTF* gltf = gfc_allocate_array(sizeof(GLTF), 1);
+    GLTF* gltf = gf3d_memory_alloc_array(MT_Loader,sizeof(GLTF), 1);
     gltf->buffers = gfc_list_new();
     return gltf;
 }
@@ -37,7 +38,7 @@ void gf3d_gltf_free(GLTF* gltf)
     }
     gfc_list_delete(gltf->buffers);
     sj_free(gltf->json);
-    free(gltf);
+    gf3d_memory_free(gltf);
 }
 
 GLTF* gf3d_gltf_load(const char* filename)
@@ -210,7 +211,7 @@ ObjData* gf3d_gltf_parse_primitive(GLTF* gltf, SJson* primitive)
 
     if (!attributes)
     {
-        free(obj);
+        gf3d_obj_free(obj);
         slog("primitive contains no attributes");
         return NULL;
     }
@@ -219,7 +220,7 @@ ObjData* gf3d_gltf_parse_primitive(GLTF* gltf, SJson* primitive)
     {
         if (gf3d_gltf_accessor_get_details(gltf,index, &bufferIndex, (int *)&obj->vertex_count))
         {
-            obj->vertices = (GFC_Vector3D *)gfc_allocate_array(sizeof(GFC_Vector3D),obj->vertex_count);
+            obj->vertices = (GFC_Vector3D *)gf3d_memory_alloc_array(MT_Loader,sizeof(GFC_Vector3D),obj->vertex_count);
 
             gf3d_gltf_get_buffer_view_data(gltf,bufferIndex,(char *)obj->vertices);
 
@@ -236,7 +237,7 @@ ObjData* gf3d_gltf_parse_primitive(GLTF* gltf, SJson* primitive)
     {
         if (gf3d_gltf_accessor_get_details(gltf,index, &bufferIndex, (int *)&obj->normal_count))
         {
-            obj->normals = (GFC_Vector3D *)gfc_allocate_array(sizeof(GFC_Vector3D),obj->normal_count);
+            obj->normals = (GFC_Vector3D *)gf3d_memory_alloc_array(MT_Loader,sizeof(GFC_Vector3D),obj->normal_count);
 
             gf3d_gltf_get_buffer_view_data(gltf,bufferIndex,(char *)obj->normals);            
         }
@@ -247,7 +248,7 @@ ObjData* gf3d_gltf_parse_primitive(GLTF* gltf, SJson* primitive)
     {
         if (gf3d_gltf_accessor_get_details(gltf,index, &bufferIndex, (int *)&obj->texel_count))
         {
-            obj->texels = (GFC_Vector2D *)gfc_allocate_array(sizeof(GFC_Vector2D),obj->texel_count);
+            obj->texels = (GFC_Vector2D *)gf3d_memory_alloc_array(MT_Loader,sizeof(GFC_Vector2D),obj->texel_count);
 
             gf3d_gltf_get_buffer_view_data(gltf,bufferIndex,(char *)obj->texels);            
         }
@@ -259,7 +260,7 @@ ObjData* gf3d_gltf_parse_primitive(GLTF* gltf, SJson* primitive)
     {
         if (gf3d_gltf_accessor_get_details(gltf,index, &bufferIndex, (int *)&obj->bone_count))
         {
-            obj->boneIndices = (GFC_Vector4UI8 *)gfc_allocate_array(sizeof(GFC_Vector4UI8),obj->bone_count);
+            obj->boneIndices = (GFC_Vector4UI8 *)gf3d_memory_alloc_array(MT_Loader,sizeof(GFC_Vector4UI8),obj->bone_count);
 
             gf3d_gltf_get_buffer_view_data(gltf,bufferIndex,(char *)obj->boneIndices);
 
@@ -271,7 +272,7 @@ ObjData* gf3d_gltf_parse_primitive(GLTF* gltf, SJson* primitive)
     {
         if (gf3d_gltf_accessor_get_details(gltf,index, &bufferIndex, (int *)&obj->weight_count))
         {
-            obj->boneWeights = (GFC_Vector4D *)gfc_allocate_array(sizeof(GFC_Vector4D),obj->weight_count);
+            obj->boneWeights = (GFC_Vector4D *)gf3d_memory_alloc_array(MT_Loader,sizeof(GFC_Vector4D),obj->weight_count);
 
             gf3d_gltf_get_buffer_view_data(gltf,bufferIndex,(char *)obj->boneWeights);
         }
@@ -283,7 +284,7 @@ ObjData* gf3d_gltf_parse_primitive(GLTF* gltf, SJson* primitive)
         if (gf3d_gltf_accessor_get_details(gltf,index, &bufferIndex, (int *)&obj->face_count))
         {
             obj->face_count /= 3;
-            obj->outFace = (Face *)gfc_allocate_array(sizeof(Face),obj->face_count);
+            obj->outFace = (Face *)gf3d_memory_alloc_array(MT_Loader,sizeof(Face),obj->face_count);
 
             gf3d_gltf_get_buffer_view_data(gltf,bufferIndex,(char *)obj->outFace);            
         }
@@ -300,7 +301,7 @@ void gf3d_gltf_reorg_obj(ObjData* obj)
     if (!obj)return;
 
     obj->face_vert_count = obj->vertex_count;
-    obj->faceVertices = (Vertex *)gfc_allocate_array(sizeof(Vertex),obj->face_vert_count);
+    obj->faceVertices = (Vertex *)gf3d_memory_alloc_array(MT_Loader,sizeof(Vertex),obj->face_vert_count);
 
     for (i = 0; i< obj->vertex_count;i++)
     {
@@ -0,0 +1,302 @@
+#include <string.h>
+
+#include "simple_logger.h"
+
+#include "gfc_text.h"
+
+#include "gf2d_font.h"
+
+#include "gf3d_memory.h"
+#include "gf3d_device.h"
+#include "gf3d_vqueues.h"
+#include "gf3d_profiler.h"
+#include "gf3d_gpu_timer.h"
+
+extern int __DEBUG;
+
+typedef struct
+{
+    VkQueryPool     pool;           /**<two timestamps per zone, then two per frame command buffer*/
+    Uint32          zoneCount;      /**<zones recorded when this slot was last used*/
+    Uint32          bufferCount;    /**<frame command buffers recorded when this slot was last used*/
+    const char    **names;          /**<zone names in the order they were recorded*/
+}GPUTimerFrame;
+
+typedef struct
+{
+    const char     *name;
+    double          time;           /**<milliseconds*/
+    GFC_TextLine    counter;        /**<profiler counter name for this zone*/
+}GPUTimerZone;
+
+typedef struct
+{
+    VkDevice        device;
+    Bool            supported;
+    Uint32          maxZones;
+    float           period;         /**<nanoseconds per timestamp tick*/
+    Uint64          mask;           /**<valid timestamp bits*/
+    Uint32          frame;          /**<frames started, the current slot is frame % GF3D_GPU_TIMER_LATENCY*/
+    GPUTimerFrame   frames[GF3D_GPU_TIMER_LATENCY];
+    Uint64         *results;        /**<timestamp and availability pairs read back from a pool*/
+    GPUTimerZone   *zones;          /**<most recently resolved frame*/
+    Uint32          zoneCount;
+    double          frameTime;      /**<milliseconds*/
+}GPUTimer;
+
+static GPUTimer gf3d_gpu_timer = {0};
+
+void gf3d_gpu_timer_close();
+
+void gf3d_gpu_timer_init(VkDevice device,Uint32 maxZones)
+{
+    int i;
+    Uint32 bits;
+    GF3D_Device *gpu;
+    VkQueryPoolCreateInfo poolInfo = {0};
+
+    if (!maxZones)
+    {
+        slog("cannot time zero gpu zones");
+        return;
+    }
+    gpu = gf3d_device_get_chosen_gpu_info();
+    bits = gf3d_vqueues_get_graphics_timestamp_bits();
+    if ((!gpu)||(!bits)||(gpu->deviceProperties.limits.timestampPeriod <= 0))
+    {
+        slog("graphics queue does not support timestamps, gpu timing disabled");
+        return;
+    }
+    gf3d_gpu_timer.device = device;
+    gf3d_gpu_timer.maxZones = maxZones;
+    gf3d_gpu_timer.period = gpu->deviceProperties.limits.timestampPeriod;
+    gf3d_gpu_timer.mask = (bits >= 64) ? 0xFFFFFFFFFFFFFFFFull : ((1ull << bits) - 1);
+    gf3d_gpu_timer.results = gf3d_memory_alloc_array(MT_General,sizeof(Uint64),maxZones * 4);
+    gf3d_gpu_timer.zones = gf3d_memory_alloc_array(MT_General,sizeof(GPUTimerZone),maxZones);
+    if ((!gf3d_gpu_timer.results)||(!gf3d_gpu_timer.zones))
+    {
+        slog("failed to allocate gpu timer results");
+        gf3d_gpu_timer_close();
+        return;
+    }
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = maxZones * 4;// a zone per frame command buffer at most, so as many buffers as zones
+    for (i = 0; i < GF3D_GPU_TIMER_LATENCY; i++)
+    {
+        gf3d_gpu_timer.frames[i].names = gf3d_memory_alloc_array(MT_General,sizeof(const char *),maxZones);
+        if ((!gf3d_gpu_timer.frames[i].names)||
+            (vkCreateQueryPool(device, &poolInfo, NULL, &gf3d_gpu_timer.frames[i].pool) != VK_SUCCESS))
+        {
+            slog("failed to create gpu timestamp query pool");
+            gf3d_gpu_timer_close();
+            return;
+        }
+    }
+    gf3d_gpu_timer.supported = 1;
+    atexit(gf3d_gpu_timer_close);
+    if (__DEBUG)slog("gpu timer initialized: %i zones, %i valid bits, %fns per tick",maxZones,bits,gf3d_gpu_timer.period);
+}
+
+void gf3d_gpu_timer_close()
+{
+    int i;
+    for (i = 0; i < GF3D_GPU_TIMER_LATENCY; i++)
+    {
+        if (gf3d_gpu_timer.frames[i].pool != VK_NULL_HANDLE)
+        {
+            vkDestroyQueryPool(gf3d_gpu_timer.device, gf3d_gpu_timer.frames[i].pool, NULL);
+        }
+        if (gf3d_gpu_timer.frames[i].names)gf3d_memory_free(gf3d_gpu_timer.frames[i].names);
+    }
+    if (gf3d_gpu_timer.results)gf3d_memory_free(gf3d_gpu_timer.results);
+    if (gf3d_gpu_timer.zones)gf3d_memory_free(gf3d_gpu_timer.zones);
+    memset(&gf3d_gpu_timer,0,sizeof(GPUTimer));
+}
+
+Bool gf3d_gpu_timer_supported()
+{
+    return gf3d_gpu_timer.supported;
+}
+
+static double gf3d_gpu_timer_ticks_to_ms(Uint64 start,Uint64 end)
+{
+    return ((end - start) & gf3d_gpu_timer.mask) * gf3d_gpu_timer.period / 1000000.0;
+}
+
+/**
+ * read start and end timestamp pairs into results
+ * @return 1 if every pair was available, 0 otherwise
+ */
+static Uint8 gf3d_gpu_timer_read(GPUTimerFrame *frame,Uint32 firstQuery,Uint32 pairCount)
+{
+    Uint32 i;
+    Uint64 *query;
+    VkResult result;
+
+    result = vkGetQueryPoolResults(
+        gf3d_gpu_timer.device,
+        frame->pool,
+        firstQuery,
+        pairCount * 2,
+        sizeof(Uint64) * pairCount * 4,
+        gf3d_gpu_timer.results,
+        sizeof(Uint64) * 2,
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if ((result != VK_SUCCESS)&&(result != VK_NOT_READY))
+    {
+        slog("failed to read gpu timestamps");
+        return 0;
+    }
+    for (i = 0; i < pairCount; i++)
+    {
+        query = &gf3d_gpu_timer.results[i * 4];
+        if ((!query[1])||(!query[3]))
+        {
+            if (__DEBUG)slog("gpu timestamps not ready after %i frames",GF3D_GPU_TIMER_LATENCY);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * read back a slot if the gpu is done with it.  Leaves the previous results in place otherwise
+ */
+static void gf3d_gpu_timer_resolve(GPUTimerFrame *frame)
+{
+    Uint32 i;
+    Uint64 start,end;
+    Uint64 *query;
+    double frameTime = 0;
+
+    if ((!frame->zoneCount)&&(!frame->bufferCount))return;
+    // the frame's command buffers are submitted one after another, so the frame is the sum of their spans.
+    // the time between them is cpu time and not counted
+    if (frame->bufferCount)
+    {
+        if (!gf3d_gpu_timer_read(frame,gf3d_gpu_timer.maxZones * 2,frame->bufferCount))return;
+        for (i = 0; i < frame->bufferCount; i++)
+        {
+            query = &gf3d_gpu_timer.results[i * 4];
+            frameTime += gf3d_gpu_timer_ticks_to_ms(query[0],query[2]);
+        }
+    }
+    if ((frame->zoneCount)&&(!gf3d_gpu_timer_read(frame,0,frame->zoneCount)))return;
+    for (i = 0; i < frame->zoneCount; i++)
+    {
+        query = &gf3d_gpu_timer.results[i * 4];
+        start = query[0];
+        end = query[2];
+        if (gf3d_gpu_timer.zones[i].name != frame->names[i])
+        {
+            gf3d_gpu_timer.zones[i].name = frame->names[i];
+            gfc_line_sprintf(gf3d_gpu_timer.zones[i].counter,"gpu %s",frame->names[i] ? frame->names[i] : "zone");
+        }
+        gf3d_gpu_timer.zones[i].time = gf3d_gpu_timer_ticks_to_ms(start,end);
+        GF3D_PROFILE_COUNTER(gf3d_gpu_timer.zones[i].counter,gf3d_gpu_timer.zones[i].time);
+    }
+    gf3d_gpu_timer.zoneCount = frame->zoneCount;
+    gf3d_gpu_timer.frameTime = frameTime;
+    GF3D_PROFILE_COUNTER("gpu frame",gf3d_gpu_timer.frameTime);
+}
+
+void gf3d_gpu_timer_frame_begin()
+{
+    GPUTimerFrame *frame;
+    if (!gf3d_gpu_timer.supported)return;
+    gf3d_gpu_timer.frame++;
+    frame = &gf3d_gpu_timer.frames[gf3d_gpu_timer.frame % GF3D_GPU_TIMER_LATENCY];
+    gf3d_gpu_timer_resolve(frame);
+    frame->zoneCount = 0;
+    frame->bufferCount = 0;
+}
+
+void gf3d_gpu_timer_buffer_begin(VkCommandBuffer commandBuffer)
+{
+    Uint32 query;
+    GPUTimerFrame *frame;
+    if ((!gf3d_gpu_timer.supported)||(commandBuffer == VK_NULL_HANDLE))return;
+    frame = &gf3d_gpu_timer.frames[gf3d_gpu_timer.frame % GF3D_GPU_TIMER_LATENCY];
+    if (frame->bufferCount >= gf3d_gpu_timer.maxZones)return;
+    query = (gf3d_gpu_timer.maxZones + frame->bufferCount++) * 2;
+    vkCmdResetQueryPool(commandBuffer, frame->pool, query, 2);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame->pool, query);
+}
+
+void gf3d_gpu_timer_buffer_end(VkCommandBuffer commandBuffer)
+{
+    GPUTimerFrame *frame;
+    if ((!gf3d_gpu_timer.supported)||(commandBuffer == VK_NULL_HANDLE))return;
+    frame = &gf3d_gpu_timer.frames[gf3d_gpu_timer.frame % GF3D_GPU_TIMER_LATENCY];
+    if (!frame->bufferCount)return;
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame->pool, (gf3d_gpu_timer.maxZones + frame->bufferCount - 1) * 2 + 1);
+}
+
+Uint32 gf3d_gpu_timer_begin(VkCommandBuffer commandBuffer,const char *name)
+{
+    Uint32 zone;
+    GPUTimerFrame *frame;
+    if ((!gf3d_gpu_timer.supported)||(commandBuffer == VK_NULL_HANDLE))return GF3D_GPU_TIMER_NONE;
+    frame = &gf3d_gpu_timer.frames[gf3d_gpu_timer.frame % GF3D_GPU_TIMER_LATENCY];
+    if (frame->zoneCount >= gf3d_gpu_timer.maxZones)return GF3D_GPU_TIMER_NONE;
+    zone = frame->zoneCount++;
+    frame->names[zone] = name;
+    vkCmdResetQueryPool(commandBuffer, frame->pool, zone * 2, 2);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame->pool, zone * 2);
+    return zone;
+}
+
+void gf3d_gpu_timer_end(VkCommandBuffer commandBuffer,Uint32 zone)
+{
+    GPUTimerFrame *frame;
+    if ((!gf3d_gpu_timer.supported)||(commandBuffer == VK_NULL_HANDLE))return;
+    frame = &gf3d_gpu_timer.frames[gf3d_gpu_timer.frame % GF3D_GPU_TIMER_LATENCY];
+    if (zone >= frame->zoneCount)return;
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame->pool, zone * 2 + 1);
+}
+
+double gf3d_gpu_timer_get_frame_time()
+{
+    return gf3d_gpu_timer.frameTime;
+}
+
+Uint32 gf3d_gpu_timer_get_zone_count()
+{
+    return gf3d_gpu_timer.zoneCount;
+}
+
+const char *gf3d_gpu_timer_get_zone_name(Uint32 zone)
+{
+    if (zone >= gf3d_gpu_timer.zoneCount)return NULL;
+    return gf3d_gpu_timer.zones[zone].name;
+}
+
+double gf3d_gpu_timer_get_zone_time(Uint32 zone)
+{
+    if (zone >= gf3d_gpu_timer.zoneCount)return 0;
+    return gf3d_gpu_timer.zones[zone].time;
+}
+
+void gf3d_gpu_timer_draw_overlay(GFC_Vector2D position)
+{
+    Uint32 i;
+    GFC_TextLine line;
+    if (!gf3d_gpu_timer.supported)
+    {
+        gf2d_font_draw_line_tag("gpu timing unsupported",FT_Small,GFC_COLOR_YELLOW,position);
+        return;
+    }
+    gfc_line_sprintf(line,"gpu frame: %.3fms",gf3d_gpu_timer.frameTime);
+    gf2d_font_draw_line_tag(line,FT_Small,GFC_COLOR_WHITE,position);
+    for (i = 0; i < gf3d_gpu_timer.zoneCount; i++)
+    {
+        position.y += 16;
+        gfc_line_sprintf(line,"  %s: %.3fms",
+            gf3d_gpu_timer.zones[i].name ? gf3d_gpu_timer.zones[i].name : "zone",
+            gf3d_gpu_timer.zones[i].time);
+        gf2d_font_draw_line_tag(line,FT_Small,GFC_COLOR_WHITE,position);
+    }
+}
+
+/*eol@eof*/
@@ -0,0 +1,204 @@
+#include <string.h>
+#include <SDL.h>
+
+#include "simple_logger.h"
+
+#include "gf3d_memory.h"
+#include "gf3d_jobs.h"
+
+#define GF3D_JOBS_MAX_WORKERS 31
+
+extern int __DEBUG;
+
+typedef struct
+{
+    SDL_Thread    **threads;
+    Uint32          workerCount;
+    SDL_mutex      *lock;
+    SDL_cond       *wake;           /**<signaled when a new dispatch is ready*/
+    SDL_cond       *done;           /**<signaled when a worker checks back in*/
+    Uint32          generation;     /**<incremented for each dispatch*/
+    Uint32          busy;           /**<how many workers are currently running jobs*/
+    int             quit;
+    GF3D_JobFunc    func;
+    void           *data;
+    Uint32          jobCount;
+    SDL_atomic_t    nextJob;
+    SDL_atomic_t    jobsDone;
+}JobManager;
+
+static JobManager gf3d_jobs = {0};
+
+static GF3D_THREAD_LOCAL Uint32 gf3d_jobs_thread_index = 0;
+
+void gf3d_jobs_run(GF3D_JobFunc func,void *data,Uint32 jobCount,Uint32 threadIndex)
+{
+    int job;
+    while ((job = SDL_AtomicAdd(&gf3d_jobs.nextJob,1)) < (int)jobCount)
+    {
+        func(data,job,threadIndex);
+        SDL_AtomicAdd(&gf3d_jobs.jobsDone,1);
+    }
+}
+
+int gf3d_jobs_worker(void *data)
+{
+    Uint32 seen = 0;
+    GF3D_JobFunc func;
+    void *jobData;
+    Uint32 jobCount;
+
+    gf3d_jobs_thread_index = (Uint32)(size_t)data;
+    for (;;)
+    {
+        SDL_LockMutex(gf3d_jobs.lock);
+        while ((!gf3d_jobs.quit)&&(seen == gf3d_jobs.generation))
+        {
+            SDL_CondWait(gf3d_jobs.wake,gf3d_jobs.lock);
+        }
+        if (gf3d_jobs.quit)
+        {
+            SDL_UnlockMutex(gf3d_jobs.lock);
+            break;
+        }
+        seen = gf3d_jobs.generation;
+        func = gf3d_jobs.func;
+        jobData = gf3d_jobs.data;
+        jobCount = gf3d_jobs.jobCount;
+        gf3d_jobs.busy++;
+        SDL_UnlockMutex(gf3d_jobs.lock);
+
+        gf3d_jobs_run(func,jobData,jobCount,gf3d_jobs_thread_index);
+
+        SDL_LockMutex(gf3d_jobs.lock);
+        gf3d_jobs.busy--;
+        SDL_CondSignal(gf3d_jobs.done);
+        SDL_UnlockMutex(gf3d_jobs.lock);
+    }
+    return 0;
+}
+
+void gf3d_jobs_close()
+{
+    int i;
+    if (gf3d_jobs.lock)
+    {
+        SDL_LockMutex(gf3d_jobs.lock);
+        gf3d_jobs.quit = 1;
+        SDL_CondBroadcast(gf3d_jobs.wake);
+        SDL_UnlockMutex(gf3d_jobs.lock);
+    }
+    if (gf3d_jobs.threads)
+    {
+        for (i = 0; i < gf3d_jobs.workerCount; i++)
+        {
+            if (!gf3d_jobs.threads[i])continue;
+            SDL_WaitThread(gf3d_jobs.threads[i],NULL);
+        }
+        gf3d_memory_free(gf3d_jobs.threads);
+    }
+    if (gf3d_jobs.wake)SDL_DestroyCond(gf3d_jobs.wake);
+    if (gf3d_jobs.done)SDL_DestroyCond(gf3d_jobs.done);
+    if (gf3d_jobs.lock)SDL_DestroyMutex(gf3d_jobs.lock);
+    memset(&gf3d_jobs,0,sizeof(JobManager));
+    if (__DEBUG)slog("job system closed");
+}
+
+void gf3d_jobs_init(int workerCount)
+{
+    int i;
+    if (workerCount < 0)
+    {
+        workerCount = SDL_GetCPUCount() - 1;
+    }
+    if (workerCount > GF3D_JOBS_MAX_WORKERS)workerCount = GF3D_JOBS_MAX_WORKERS;
+    if (workerCount < 0)workerCount = 0;
+
+    gf3d_jobs.lock = SDL_CreateMutex();
+    gf3d_jobs.wake = SDL_CreateCond();
+    gf3d_jobs.done = SDL_CreateCond();
+    if ((!gf3d_jobs.lock)||(!gf3d_jobs.wake)||(!gf3d_jobs.done))
+    {
+        slog("failed to create job system sync objects: %s",SDL_GetError());
+        gf3d_jobs_close();
+        return;
+    }
+    atexit(gf3d_jobs_close);
+    if (!workerCount)
+    {
+        if (__DEBUG)slog("job system initialized with no workers, jobs run on the main thread");
+        return;
+    }
+    gf3d_jobs.threads = (SDL_Thread **)gf3d_memory_alloc_array(MT_General,sizeof(SDL_Thread *),workerCount);
+    if (!gf3d_jobs.threads)
+    {
+        slog("failed to allocate job system threads");
+        return;
+    }
+    gf3d_jobs.workerCount = workerCount;
+    for (i = 0; i < workerCount; i++)
+    {
+        gf3d_jobs.threads[i] = SDL_CreateThread(gf3d_jobs_worker,"gf3d_worker",(void *)(size_t)(i + 1));
+        if (!gf3d_jobs.threads[i])
+        {
+            slog("failed to create worker thread %i: %s",i,SDL_GetError());
+            gf3d_jobs.workerCount = i;
+            break;
+        }
+    }
+    if (__DEBUG)slog("job system initialized with %i workers",gf3d_jobs.workerCount);
+}
+
+Uint32 gf3d_jobs_get_worker_count()
+{
+    return gf3d_jobs.workerCount;
+}
+
+Uint32 gf3d_jobs_get_thread_count()
+{
+    return gf3d_jobs.workerCount + 1;
+}
+
+Uint32 gf3d_jobs_get_thread_index()
+{
+    return gf3d_jobs_thread_index;
+}
+
+void gf3d_jobs_dispatch(Uint32 jobCount,GF3D_JobFunc func,void *data)
+{
+    Uint32 i;
+    if ((!jobCount)||(!func))return;
+    if ((jobCount == 1)||(!gf3d_jobs.workerCount))
+    {
+        for (i = 0; i < jobCount; i++)
+        {
+            func(data,i,gf3d_jobs_thread_index);
+        }
+        return;
+    }
+    SDL_LockMutex(gf3d_jobs.lock);
+    // a late waking worker may still be checked out from the last dispatch
+    while (gf3d_jobs.busy)
+    {
+        SDL_CondWait(gf3d_jobs.done,gf3d_jobs.lock);
+    }
+    gf3d_jobs.func = func;
+    gf3d_jobs.data = data;
+    gf3d_jobs.jobCount = jobCount;
+    SDL_AtomicSet(&gf3d_jobs.nextJob,0);
+    SDL_AtomicSet(&gf3d_jobs.jobsDone,0);
+    gf3d_jobs.generation++;
+    SDL_CondBroadcast(gf3d_jobs.wake);
+    SDL_UnlockMutex(gf3d_jobs.lock);
+
+    gf3d_jobs_run(func,data,jobCount,gf3d_jobs_thread_index);
+
+    SDL_LockMutex(gf3d_jobs.lock);
+    while ((SDL_AtomicGet(&gf3d_jobs.jobsDone) < (int)jobCount)||(gf3d_jobs.busy))
+    {
+        SDL_CondWait(gf3d_jobs.done,gf3d_jobs.lock);
+    }
+    SDL_UnlockMutex(gf3d_jobs.lock);
+}
+
+/*eol@eof*/
@@ -0,0 +1,311 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <SDL.h>
+
+#include "simple_logger.h"
+
+#include "gf3d_memory.h"
+#include "gf3d_log.h"
+
+#define GF3D_LOG_DEFAULT_CAPACITY 4096
+#define GF3D_LOG_RATE_WINDOW 1000       // milliseconds
+#define GF3D_LOG_DEFAULT_RATE 10
+#define GF3D_LOG_SITES 256              // call sites tracked for rate limiting, must be a power of two
+#define GF3D_LOG_WRITER_WAIT 100        // milliseconds between syncs when idle
+
+extern int __DEBUG;
+
+typedef struct
+{
+    SDL_atomic_t    sequence;           /**<which lap of the ring this cell is ready for*/
+    LogLevel        level;
+    const char     *file;
+    int             line;
+    char            message[GF3D_LOG_MESSAGE_LEN];
+}LogEntry;
+
+typedef struct
+{
+    const char     *file;
+    int             line;
+    Uint32          windowStart;
+    SDL_atomic_t    count;              /**<messages in the current window*/
+    SDL_atomic_t    suppressed;         /**<messages dropped in the current window*/
+}LogSite;
+
+typedef struct
+{
+    LogEntry       *ring;
+    Uint32          capacity;
+    Uint32          mask;
+    SDL_atomic_t    enqueuePos;         /**<claimed by producers*/
+    SDL_atomic_t    dequeuePos;         /**<only written by the writer thread*/
+    SDL_atomic_t    dropped;            /**<messages lost to a full ring*/
+    SDL_atomic_t    signaled;           /**<set while the writer has a wake up pending*/
+    SDL_atomic_t    running;
+    SDL_sem        *wake;
+    SDL_Thread     *writer;
+    LogLevel        level;
+    Uint32          rateLimit;
+    LogSite         sites[GF3D_LOG_SITES];
+}AsyncLogger;
+
+static AsyncLogger gf3d_log_manager = {0};
+
+static const char *gf3d_log_level_tags[LL_MAX] =
+{
+    "debug: ",
+    "",
+    "warning: ",
+    "error: "
+};
+
+void gf3d_log_close();
+static int gf3d_log_writer(void *data);
+
+void gf3d_log_init(Uint32 capacity)
+{
+    Uint32 i;
+    if (gf3d_log_manager.ring)return;
+    if (!capacity)capacity = GF3D_LOG_DEFAULT_CAPACITY;
+    for (i = 1; i < capacity; i <<= 1);
+    capacity = i;
+    gf3d_log_manager.ring = gf3d_memory_alloc_array(MT_General,sizeof(LogEntry),capacity);
+    if (!gf3d_log_manager.ring)
+    {
+        slog("failed to allocate log ring of %i messages, logging synchronously",capacity);
+        return;
+    }
+    for (i = 0; i < capacity; i++)
+    {
+        SDL_AtomicSet(&gf3d_log_manager.ring[i].sequence,i);
+    }
+    gf3d_log_manager.capacity = capacity;
+    gf3d_log_manager.mask = capacity - 1;
+    gf3d_log_manager.level = LL_Info;
+    gf3d_log_manager.rateLimit = GF3D_LOG_DEFAULT_RATE;
+    gf3d_log_manager.wake = SDL_CreateSemaphore(0);
+    if (!gf3d_log_manager.wake)
+    {
+        slog("failed to create log semaphore: %s",SDL_GetError());
+        gf3d_log_close();
+        return;
+    }
+    SDL_AtomicSet(&gf3d_log_manager.running,1);
+    gf3d_log_manager.writer = SDL_CreateThread(gf3d_log_writer,"gf3d_log",NULL);
+    if (!gf3d_log_manager.writer)
+    {
+        slog("failed to start log writer thread: %s",SDL_GetError());
+        gf3d_log_close();
+        return;
+    }
+    atexit(gf3d_log_close);
+    if (__DEBUG)slog("async logging started with room for %i messages",capacity);
+}
+
+void gf3d_log_set_level(LogLevel level)
+{
+    if ((level < 0)||(level >= LL_MAX))return;
+    gf3d_log_manager.level = level;
+}
+
+void gf3d_log_set_rate_limit(Uint32 perSecond)
+{
+    gf3d_log_manager.rateLimit = perSecond;
+}
+
+/**
+ * claim a cell, fill it and publish it.  Returns 0 if the ring is full
+ */
+static int gf3d_log_push(LogLevel level,const char *file,int line,const char *msg,va_list ap)
+{
+    int pos,diff;
+    LogEntry *entry;
+
+    pos = SDL_AtomicGet(&gf3d_log_manager.enqueuePos);
+    for (;;)
+    {
+        entry = &gf3d_log_manager.ring[pos & gf3d_log_manager.mask];
+        diff = (int)((Uint32)SDL_AtomicGet(&entry->sequence) - (Uint32)pos);// wraps cleanly
+        if (diff == 0)
+        {
+            if (SDL_AtomicCAS(&gf3d_log_manager.enqueuePos,pos,pos + 1))break;
+            pos = SDL_AtomicGet(&gf3d_log_manager.enqueuePos);
+        }
+        else if (diff < 0)
+        {
+            return 0;// writer has not freed this cell yet
+        }
+        else
+        {
+            pos = SDL_AtomicGet(&gf3d_log_manager.enqueuePos);// another producer took it
+        }
+    }
+    entry->level = level;
+    entry->file = file;
+    entry->line = line;
+    vsnprintf(entry->message,GF3D_LOG_MESSAGE_LEN,msg,ap);
+    SDL_AtomicSet(&entry->sequence,pos + 1);
+    if (SDL_AtomicCAS(&gf3d_log_manager.signaled,0,1))
+    {
+        SDL_SemPost(gf3d_log_manager.wake);
+    }
+    return 1;
+}
+
+static void gf3d_log_push_note(LogLevel level,const char *file,int line,const char *msg,...)
+{
+    va_list ap;
+    va_start(ap,msg);
+    if (!gf3d_log_push(level,file,line,msg,ap))SDL_AtomicAdd(&gf3d_log_manager.dropped,1);
+    va_end(ap);
+}
+
+/**
+ * returns 1 if this call site is still under its rate limit.
+ * Sites sharing a slot just take it over, the limit is approximate by design
+ */
+static int gf3d_log_site_allow(LogLevel level,const char *file,int line)
+{
+    Uint32 now,hash,suppressed;
+    LogSite *site;
+
+    if (!gf3d_log_manager.rateLimit)return 1;
+    hash = (Uint32)(((size_t)file >> 3) ^ (line * 2654435761u));
+    site = &gf3d_log_manager.sites[hash & (GF3D_LOG_SITES - 1)];
+    now = SDL_GetTicks();
+    if ((site->file != file)||(site->line != line))
+    {
+        site->file = file;
+        site->line = line;
+        site->windowStart = now;
+        SDL_AtomicSet(&site->count,0);
+        SDL_AtomicSet(&site->suppressed,0);
+    }
+    else if (now - site->windowStart >= GF3D_LOG_RATE_WINDOW)
+    {
+        site->windowStart = now;
+        SDL_AtomicSet(&site->count,0);
+        suppressed = SDL_AtomicSet(&site->suppressed,0);
+        if (suppressed)
+        {
+            gf3d_log_push_note(level,file,line,"(%u more messages from here were suppressed)",suppressed);
+        }
+    }
+    if ((Uint32)SDL_AtomicAdd(&site->count,1) < gf3d_log_manager.rateLimit)return 1;
+    SDL_AtomicAdd(&site->suppressed,1);
+    return 0;
+}
+
+void _gf3d_log(LogLevel level,const char *file,int line,const char *msg,...)
+{
+    va_list ap;
+    char buffer[GF3D_LOG_MESSAGE_LEN];
+
+    if ((level < 0)||(level >= LL_MAX))level = LL_Info;
+    if ((level == LL_Debug)&&(!__DEBUG))return;
+    if (level < gf3d_log_manager.level)return;
+    if (!SDL_AtomicGet(&gf3d_log_manager.running))
+    {
+        va_start(ap,msg);
+        vsnprintf(buffer,GF3D_LOG_MESSAGE_LEN,msg,ap);
+        va_end(ap);
+        _slog((char *)file,line,"%s%s",gf3d_log_level_tags[level],buffer);
+        return;
+    }
+    if (!gf3d_log_site_allow(level,file,line))return;
+    va_start(ap,msg);
+    if (!gf3d_log_push(level,file,line,msg,ap))
+    {
+        SDL_AtomicAdd(&gf3d_log_manager.dropped,1);
+    }
+    va_end(ap);
+}
+
+/**
+ * write everything that has been published.  Returns how many messages were written
+ */
+static Uint32 gf3d_log_drain()
+{
+    int pos,dropped;
+    Uint32 count = 0;
+    LogEntry *entry;
+
+    pos = SDL_AtomicGet(&gf3d_log_manager.dequeuePos);
+    for (;;)
+    {
+        entry = &gf3d_log_manager.ring[pos & gf3d_log_manager.mask];
+        if ((int)((Uint32)SDL_AtomicGet(&entry->sequence) - (Uint32)(pos + 1)) < 0)break;// not published yet
+        _slog((char *)entry->file,entry->line,"%s%s",gf3d_log_level_tags[entry->level],entry->message);
+        SDL_AtomicSet(&entry->sequence,pos + gf3d_log_manager.capacity);
+        pos++;
+        count++;
+    }
+    SDL_AtomicSet(&gf3d_log_manager.dequeuePos,pos);
+    dropped = SDL_AtomicSet(&gf3d_log_manager.dropped,0);
+    if (dropped)
+    {
+        slog("log ring was full, %i messages were dropped",dropped);
+        count++;
+    }
+    return count;
+}
+
+static int gf3d_log_writer(void *data)
+{
+    while (SDL_AtomicGet(&gf3d_log_manager.running))
+    {
+        SDL_SemWaitTimeout(gf3d_log_manager.wake,GF3D_LOG_WRITER_WAIT);
+        SDL_AtomicSet(&gf3d_log_manager.signaled,0);
+        if (gf3d_log_drain())slog_sync();
+    }
+    return 0;
+}
+
+void gf3d_log_flush()
+{
+    if (!SDL_AtomicGet(&gf3d_log_manager.running))
+    {
+        slog_sync();
+        return;
+    }
+    while (SDL_AtomicGet(&gf3d_log_manager.dequeuePos) != SDL_AtomicGet(&gf3d_log_manager.enqueuePos))
+    {
+        SDL_SemPost(gf3d_log_manager.wake);
+        SDL_Delay(1);
+    }
+    slog_sync();
+}
+
+void gf3d_log_close()
+{
+    int i;
+    Uint32 suppressed;
+    LogSite *site;
+
+    SDL_AtomicSet(&gf3d_log_manager.running,0);
+    if (gf3d_log_manager.writer)
+    {
+        SDL_SemPost(gf3d_log_manager.wake);
+        SDL_WaitThread(gf3d_log_manager.writer,NULL);
+    }
+    if (gf3d_log_manager.ring)
+    {
+        // anything published after the writer's last pass
+        gf3d_log_drain();
+        for (i = 0; i < GF3D_LOG_SITES; i++)
+        {
+            site = &gf3d_log_manager.sites[i];
+            suppressed = SDL_AtomicGet(&site->suppressed);
+            if ((!site->file)||(!suppressed))continue;
+            _slog((char *)site->file,site->line,"(%u more messages from here were suppressed)",suppressed);
+        }
+        slog_sync();
+        gf3d_memory_free(gf3d_log_manager.ring);
+    }
+    if (gf3d_log_manager.wake)SDL_DestroySemaphore(gf3d_log_manager.wake);
+    memset(&gf3d_log_manager,0,sizeof(AsyncLogger));
+}
+
+/*eol@eof*/
@@ -0,0 +1,424 @@
+#include <stdint.h>
+#include <string.h>
+#include <SDL.h>
+
+#include "simple_logger.h"
+
+#include "gfc_text.h"
+
+#include "gf2d_font.h"
+
+#include "gf3d_extensions.h"
+#include "gf3d_log.h"
+#include "gf3d_memory.h"
+
+#define GF3D_MEMORY_HEADER 16               // keeps the caller's memory 16 byte aligned
+#define GF3D_MEMORY_CHECK 0x676D656D        // marks a live header, catches foreign and double frees
+#define GF3D_MEMORY_SITES 1024              // call sites tracked for the leak report, must be a power of two
+#define GF3D_MEMORY_NO_SITE 0xFFFF
+#define GF3D_MEMORY_VK_START 256            // must be a power of two
+#define GF3D_MEMORY_VK_TOMBSTONE (~(Uint64)0)
+
+extern int __DEBUG;
+
+typedef struct
+{
+    size_t  size;
+    Uint16  tag;
+    Uint16  site;
+    Uint32  check;
+}MemoryHeader;
+
+typedef struct
+{
+    const char *file;
+    int         line;
+    MemoryTag   tag;
+    Uint64      liveBytes;
+    Uint32      liveCount;
+}MemorySite;
+
+typedef struct
+{
+    Uint64          key;                /**<the VkDeviceMemory handle, 0 for an empty slot*/
+    VkDeviceSize    size;
+    Uint16          tag;
+    Uint16          heap;
+}MemoryVkEntry;
+
+typedef struct
+{
+    SDL_SpinLock                        lock;
+    MemoryStats                         stats[MD_MAX][MT_MAX + 1];     /**<the last is the total across tags*/
+    MemorySite                          sites[GF3D_MEMORY_SITES];
+    MemoryVkEntry                      *vkTable;
+    Uint32                              vkCapacity;
+    Uint32                              vkUsed;         /**<live entries and tombstones*/
+    VkPhysicalDevice                    gpu;
+    VkPhysicalDeviceMemoryProperties    memProperties;
+    VkDeviceSize                        heapUsed[VK_MAX_MEMORY_HEAPS];
+    Uint8                               budgetSupported;
+}MemoryManager;
+
+static MemoryManager gf3d_memory = {0};
+
+static const char *gf3d_memory_tag_names[MT_MAX] =
+{
+    "general",
+    "mesh",
+    "texture",
+    "sprite",
+    "font",
+    "particle",
+    "entity",
+    "pipeline",
+    "loader",
+    "arena",
+    "swapchain",
+    "staging"
+};
+
+void gf3d_memory_close();
+
+void gf3d_memory_init()
+{
+    atexit(gf3d_memory_close);
+    if (__DEBUG)slog("memory tracking initialized");
+}
+
+void gf3d_memory_device_init(VkPhysicalDevice gpu)
+{
+    Uint32 i;
+    gf3d_memory.gpu = gpu;
+    vkGetPhysicalDeviceMemoryProperties(gpu,&gf3d_memory.memProperties);
+    gf3d_memory.budgetSupported = gf3d_extensions_is_enabled(ET_Device,"VK_EXT_memory_budget");
+    if (!__DEBUG)return;
+    for (i = 0; i < gf3d_memory.memProperties.memoryHeapCount; i++)
+    {
+        slog("memory heap %i: %.1fMB%s",i,
+            gf3d_memory.memProperties.memoryHeaps[i].size / (1024.0 * 1024.0),
+            (gf3d_memory.memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " device local" : "");
+    }
+    if (!gf3d_memory.budgetSupported)slog("VK_EXT_memory_budget not enabled, heap budgets are estimated");
+}
+
+static void gf3d_memory_stats_add(MemoryDomain domain,MemoryTag tag,Uint64 bytes)
+{
+    int i;
+    MemoryStats *stats;
+    for (i = 0; i < 2; i++)
+    {
+        stats = &gf3d_memory.stats[domain][i ? MT_MAX : tag];
+        stats->liveBytes += bytes;
+        stats->liveCount++;
+        stats->allocCount++;
+        if (stats->liveBytes > stats->peakBytes)stats->peakBytes = stats->liveBytes;
+    }
+}
+
+static void gf3d_memory_stats_remove(MemoryDomain domain,MemoryTag tag,Uint64 bytes)
+{
+    int i;
+    MemoryStats *stats;
+    for (i = 0; i < 2; i++)
+    {
+        stats = &gf3d_memory.stats[domain][i ? MT_MAX : tag];
+        stats->liveBytes -= bytes;
+        stats->liveCount--;
+    }
+}
+
+/**
+ * find or claim the slot for a call site, must hold the lock
+ */
+static Uint16 gf3d_memory_site_get(const char *file,int line,MemoryTag tag)
+{
+    Uint32 i,hash;
+    MemorySite *site;
+    hash = (Uint32)(((size_t)file >> 3) ^ (line * 2654435761u));
+    for (i = 0; i < GF3D_MEMORY_SITES; i++)
+    {
+        site = &gf3d_memory.sites[(hash + i) & (GF3D_MEMORY_SITES - 1)];
+        if (!site->file)
+        {
+            site->file = file;
+            site->line = line;
+            site->tag = tag;
+        }
+        if ((site->file == file)&&(site->line == line))
+        {
+            return (hash + i) & (GF3D_MEMORY_SITES - 1);
+        }
+    }
+    return GF3D_MEMORY_NO_SITE;// still counted against its tag, just not by site
+}
+
+void *_gf3d_memory_alloc_array(MemoryTag tag,size_t size,size_t count,const char *file,int line)
+{
+    MemoryHeader *header;
+    size_t bytes;
+    if ((tag < 0)||(tag >= MT_MAX))tag = MT_General;
+    if ((count)&&(size > (SIZE_MAX - GF3D_MEMORY_HEADER) / count))
+    {
+        gf3d_log(LL_Error,"allocation of %lu x %lu bytes at %s:%i is too large",(unsigned long)count,(unsigned long)size,file,line);
+        return NULL;
+    }
+    bytes = size * count;
+    header = malloc(GF3D_MEMORY_HEADER + bytes);
+    if (!header)
+    {
+        gf3d_log(LL_Error,"failed to allocate %lu bytes at %s:%i",(unsigned long)bytes,file,line);
+        return NULL;
+    }
+    memset(header,0,GF3D_MEMORY_HEADER + bytes);
+    header->size = bytes;
+    header->tag = tag;
+    header->check = GF3D_MEMORY_CHECK;
+    SDL_AtomicLock(&gf3d_memory.lock);
+    header->site = gf3d_memory_site_get(file,line,tag);
+    if (header->site != GF3D_MEMORY_NO_SITE)
+    {
+        gf3d_memory.sites[header->site].liveBytes += bytes;
+        gf3d_memory.sites[header->site].liveCount++;
+    }
+    gf3d_memory_stats_add(MD_Cpu,tag,bytes);
+    SDL_AtomicUnlock(&gf3d_memory.lock);
+    return (Uint8 *)header + GF3D_MEMORY_HEADER;
+}
+
+void gf3d_memory_free(void *ptr)
+{
+    MemoryHeader *header;
+    if (!ptr)return;
+    header = (MemoryHeader *)((Uint8 *)ptr - GF3D_MEMORY_HEADER);
+    if (header->check != GF3D_MEMORY_CHECK)
+    {
+        // leaking it is safer than handing free() something it may not own
+        gf3d_log(LL_Error,"gf3d_memory_free: %p was not allocated by gf3d_memory_alloc_array or was already freed",ptr);
+        return;
+    }
+    header->check = 0;
+    SDL_AtomicLock(&gf3d_memory.lock);
+    if (header->site != GF3D_MEMORY_NO_SITE)
+    {
+        gf3d_memory.sites[header->site].liveBytes -= header->size;
+        gf3d_memory.sites[header->site].liveCount--;
+    }
+    gf3d_memory_stats_remove(MD_Cpu,header->tag,header->size);
+    SDL_AtomicUnlock(&gf3d_memory.lock);
+    free(header);
+}
+
+static Uint32 gf3d_memory_vk_hash(Uint64 key)
+{
+    return (Uint32)((key ^ (key >> 29)) * 2654435761u);
+}
+
+/**
+ * rebuild the handle table without tombstones, growing it if it is getting full.  Must hold the lock
+ */
+static int gf3d_memory_vk_rehash()
+{
+    Uint32 i,j,live = 0,capacity;
+    MemoryVkEntry *table,*entry;
+    for (i = 0; i < gf3d_memory.vkCapacity; i++)
+    {
+        if ((gf3d_memory.vkTable[i].key)&&(gf3d_memory.vkTable[i].key != GF3D_MEMORY_VK_TOMBSTONE))live++;
+    }
+    for (capacity = GF3D_MEMORY_VK_START; capacity < live * 4; capacity <<= 1);
+    table = gfc_allocate_array(sizeof(MemoryVkEntry),capacity);
+    if (!table)return 0;
+    for (i = 0; i < gf3d_memory.vkCapacity; i++)
+    {
+        entry = &gf3d_memory.vkTable[i];
+        if ((!entry->key)||(entry->key == GF3D_MEMORY_VK_TOMBSTONE))continue;
+        for (j = gf3d_memory_vk_hash(entry->key) & (capacity - 1); table[j].key; j = (j + 1) & (capacity - 1));
+        memcpy(&table[j],entry,sizeof(MemoryVkEntry));
+    }
+    if (gf3d_memory.vkTable)free(gf3d_memory.vkTable);
+    gf3d_memory.vkTable = table;
+    gf3d_memory.vkCapacity = capacity;
+    gf3d_memory.vkUsed = live;
+    return 1;
+}
+
+VkResult gf3d_memory_vk_allocate(VkDevice device,const VkMemoryAllocateInfo *allocInfo,MemoryTag tag,VkDeviceMemory *memory)
+{
+    VkResult result;
+    Uint32 i,heap = 0;
+    Uint64 key;
+    if ((!allocInfo)||(!memory))return VK_ERROR_INITIALIZATION_FAILED;
+    result = vkAllocateMemory(device,allocInfo,NULL,memory);
+    if (result != VK_SUCCESS)return result;
+    if ((tag < 0)||(tag >= MT_MAX))tag = MT_General;
+    if (allocInfo->memoryTypeIndex < gf3d_memory.memProperties.memoryTypeCount)
+    {
+        heap = gf3d_memory.memProperties.memoryTypes[allocInfo->memoryTypeIndex].heapIndex;
+    }
+    key = (Uint64)*memory;
+    SDL_AtomicLock(&gf3d_memory.lock);
+    if (((gf3d_memory.vkUsed + 1) * 4 >= gf3d_memory.vkCapacity * 3)&&(!gf3d_memory_vk_rehash()))
+    {
+        SDL_AtomicUnlock(&gf3d_memory.lock);
+        slog("failed to grow the device memory table, allocation will not be tracked");
+        return result;
+    }
+    for (i = gf3d_memory_vk_hash(key) & (gf3d_memory.vkCapacity - 1);
+        (gf3d_memory.vkTable[i].key)&&(gf3d_memory.vkTable[i].key != GF3D_MEMORY_VK_TOMBSTONE);
+        i = (i + 1) & (gf3d_memory.vkCapacity - 1));
+    if (!gf3d_memory.vkTable[i].key)gf3d_memory.vkUsed++;// reusing a tombstone does not add to the load
+    gf3d_memory.vkTable[i].key = key;
+    gf3d_memory.vkTable[i].size = allocInfo->allocationSize;
+    gf3d_memory.vkTable[i].tag = tag;
+    gf3d_memory.vkTable[i].heap = heap;
+    gf3d_memory.heapUsed[heap] += allocInfo->allocationSize;
+    gf3d_memory_stats_add(MD_Gpu,tag,allocInfo->allocationSize);
+    SDL_AtomicUnlock(&gf3d_memory.lock);
+    return result;
+}
+
+void gf3d_memory_vk_free(VkDevice device,VkDeviceMemory memory)
+{
+    Uint32 i;
+    Uint64 key;
+    MemoryVkEntry *entry;
+    if (memory == VK_NULL_HANDLE)return;
+    key = (Uint64)memory;
+    SDL_AtomicLock(&gf3d_memory.lock);
+    if (gf3d_memory.vkCapacity)
+    {
+        for (i = gf3d_memory_vk_hash(key) & (gf3d_memory.vkCapacity - 1);
+            gf3d_memory.vkTable[i].key;
+            i = (i + 1) & (gf3d_memory.vkCapacity - 1))
+        {
+            entry = &gf3d_memory.vkTable[i];
+            if (entry->key != key)continue;
+            gf3d_memory.heapUsed[entry->heap] -= entry->size;
+            gf3d_memory_stats_remove(MD_Gpu,entry->tag,entry->size);
+            entry->key = GF3D_MEMORY_VK_TOMBSTONE;
+            break;
+        }
+    }
+    SDL_AtomicUnlock(&gf3d_memory.lock);
+    vkFreeMemory(device,memory,NULL);
+}
+
+MemoryStats gf3d_memory_get_stats(MemoryDomain domain,MemoryTag tag)
+{
+    MemoryStats stats = {0};
+    if ((domain < 0)||(domain >= MD_MAX)||(tag < 0)||(tag > MT_MAX))return stats;
+    SDL_AtomicLock(&gf3d_memory.lock);
+    stats = gf3d_memory.stats[domain][tag];
+    SDL_AtomicUnlock(&gf3d_memory.lock);
+    return stats;
+}
+
+const char *gf3d_memory_get_tag_name(MemoryTag tag)
+{
+    if ((tag < 0)||(tag >= MT_MAX))return NULL;
+    return gf3d_memory_tag_names[tag];
+}
+
+Uint32 gf3d_memory_get_heap_count()
+{
+    return gf3d_memory.memProperties.memoryHeapCount;
+}
+
+Uint8 gf3d_memory_get_heap_budget(Uint32 heap,MemoryHeapBudget *out)
+{
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {0};
+    VkPhysicalDeviceMemoryProperties2 properties = {0};
+    if ((!out)||(heap >= gf3d_memory.memProperties.memoryHeapCount))return 0;
+    memset(out,0,sizeof(MemoryHeapBudget));
+    out->size = gf3d_memory.memProperties.memoryHeaps[heap].size;
+    out->deviceLocal = (gf3d_memory.memProperties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? 1 : 0;
+    if (gf3d_memory.budgetSupported)
+    {
+        budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        properties.pNext = &budget;
+        vkGetPhysicalDeviceMemoryProperties2(gf3d_memory.gpu,&properties);
+        out->usage = budget.heapUsage[heap];
+        out->budget = budget.heapBudget[heap];
+        out->reported = 1;
+        return 1;
+    }
+    SDL_AtomicLock(&gf3d_memory.lock);
+    out->usage = gf3d_memory.heapUsed[heap];
+    SDL_AtomicUnlock(&gf3d_memory.lock);
+    out->budget = out->size;
+    return 1;
+}
+
+void gf3d_memory_draw_overlay(GFC_Vector2D position)
+{
+    Uint32 i;
+    GFC_TextLine line;
+    MemoryStats cpu,gpu;
+    MemoryHeapBudget budget;
+    const double mb = 1024.0 * 1024.0;
+
+    for (i = 0; i <= MT_MAX; i++)
+    {
+        cpu = gf3d_memory_get_stats(MD_Cpu,i);
+        gpu = gf3d_memory_get_stats(MD_Gpu,i);
+        if ((!cpu.allocCount)&&(!gpu.allocCount))continue;
+        gfc_line_sprintf(line,"%s: cpu %.2fMB (peak %.2f)  gpu %.2fMB (peak %.2f)",
+            i < MT_MAX ? gf3d_memory_tag_names[i] : "total",
+            cpu.liveBytes / mb,cpu.peakBytes / mb,
+            gpu.liveBytes / mb,gpu.peakBytes / mb);
+        gf2d_font_draw_line_tag(line,FT_Small,GFC_COLOR_WHITE,position);
+        position.y += 16;
+    }
+    for (i = 0; i < gf3d_memory_get_heap_count(); i++)
+    {
+        if (!gf3d_memory_get_heap_budget(i,&budget))continue;
+        gfc_line_sprintf(line,"heap %u%s: %.1f of %.1fMB %s",i,budget.deviceLocal ? " (device)" : "",
+            budget.usage / mb,budget.budget / mb,budget.reported ? "budget" : "(estimated)");
+        gf2d_font_draw_line_tag(line,FT_Small,budget.usage > budget.budget ? GFC_COLOR_RED : GFC_COLOR_WHITE,position);
+        position.y += 16;
+    }
+}
+
+void gf3d_memory_close()
+{
+    Uint32 i;
+    MemoryStats *stats;
+    MemorySite *site;
+    const double mb = 1024.0 * 1024.0;
+
+    if (__DEBUG)
+    {
+        slog("memory high water: cpu %.2fMB gpu %.2fMB",
+            gf3d_memory.stats[MD_Cpu][MT_MAX].peakBytes / mb,
+            gf3d_memory.stats[MD_Gpu][MT_MAX].peakBytes / mb);
+    }
+    for (i = 0; i < MT_MAX; i++)
+    {
+        stats = &gf3d_memory.stats[MD_Cpu][i];
+        if (stats->liveCount)
+        {
+            slog("memory leak: %u %s allocations, %lu bytes",stats->liveCount,gf3d_memory_tag_names[i],(unsigned long)stats->liveBytes);
+        }
+        stats = &gf3d_memory.stats[MD_Gpu][i];
+        if (stats->liveCount)
+        {
+            slog("memory leak: %u %s device allocations, %lu bytes",stats->liveCount,gf3d_memory_tag_names[i],(unsigned long)stats->liveBytes);
+        }
+    }
+    for (i = 0; i < GF3D_MEMORY_SITES; i++)
+    {
+        site = &gf3d_memory.sites[i];
+        if ((!site->file)||(!site->liveCount))continue;
+        slog("  %s:%i (%s): %u allocations, %lu bytes",site->file,site->line,gf3d_memory_tag_names[site->tag],site->liveCount,(unsigned long)site->liveBytes);
+    }
+    // device memory freed after this is no longer looked up, the totals stay readable
+    SDL_AtomicLock(&gf3d_memory.lock);
+    if (gf3d_memory.vkTable)free(gf3d_memory.vkTable);
+    gf3d_memory.vkTable = NULL;
+    gf3d_memory.vkCapacity = 0;
+    gf3d_memory.vkUsed = 0;
+    SDL_AtomicUnlock(&gf3d_memory.lock);
+}
+
+/*eol@eof*/
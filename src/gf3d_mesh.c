@@ -1,6 +1,8 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <float.h>
+#include <math.h>
 #include "simple_logger.h"
 #include "simple_json.h"
 #include "gfc_types.h"
@@ -15,7 +17,11 @@
 #include "gf3d_vgraphics.h"
 #include "gf3d_camera.h"
 #include "gf3d_texture.h"
+#include "gf3d_texture_stream.h"
+#include "gf3d_frustum.h"
 #include "gf3d_buffers.h"
+#include "gf3d_memory.h"
+#include "gf3d_profiler.h"
 
 #define MESH_ATTRIBUTE_COUNT 3
 
@@ -38,7 +44,9 @@ static MeshManager mesh_manager = { 0 };
 
 // Internal function declarations
 static void gf3d_mesh_delete(Mesh* mesh);
+static float gf3d_mesh_get_screen_size(Mesh* mesh, GFC_Matrix4 modelMat, GFC_Matrix4 proj, GFC_Vector3D camera);
 static void gf3d_mesh_manager_close(void);
+static void gf3d_mesh_primitive_retain(MeshPrimitive* prim, ObjData* obj, MeshRetention retention);
 static void gf3d_mesh_primitive_create_vertex_buffers(MeshPrimitive* prim);
 static void gf3d_mesh_setup_face_buffers(MeshPrimitive* prim);
 static VkVertexInputBindingDescription* gf3d_mesh_manager_get_bind_description(void);
@@ -51,7 +59,7 @@ void gf3d_mesh_manager_init(Uint32 mesh_max, Uint32 chain_length, VkDevice devic
         return;
     }
 
-    mesh_manager.mesh_list = gfc_allocate_array(sizeof(Mesh), mesh_max);
+    mesh_manager.mesh_list = gf3d_memory_alloc_array(MT_Mesh, sizeof(Mesh), mesh_max);
     if (!mesh_manager.mesh_list) {
         slog("Failed to allocate %i meshes for the system", mesh_max);
         return;
@@ -75,7 +83,7 @@ void gf3d_mesh_init(Uint32 mesh_max)
         return;
     }
     mesh_manager.chain_length = gf3d_swapchain_get_chain_length();
-    mesh_manager.mesh_list = (Mesh *)gfc_allocate_array(sizeof(Mesh),mesh_max);
+    mesh_manager.mesh_list = (Mesh *)gf3d_memory_alloc_array(MT_Mesh,sizeof(Mesh),mesh_max);
     if (!mesh_manager.mesh_list)
     {
         slog("failed to allocate mesh list for %u meshes",mesh_max);
@@ -138,7 +146,7 @@ void gf3d_mesh_manager_close(void) {
                 gf3d_mesh_delete(&mesh_manager.mesh_list[i]);
             }
         }
-        free(mesh_manager.mesh_list);
+        gf3d_memory_free(mesh_manager.mesh_list);
         mesh_manager.mesh_list = NULL;
     }
     mesh_manager.mesh_max = 0;
@@ -180,7 +188,7 @@ Mesh* gf3d_mesh_new(void) {
 }
 
 MeshPrimitive* gf3d_mesh_primitive_new(void) {
-    MeshPrimitive* prim = gfc_allocate_array(sizeof(MeshPrimitive), 1);
+    MeshPrimitive* prim = gf3d_memory_alloc_array(MT_Mesh, sizeof(MeshPrimitive), 1);
     if (!prim) slog("Failed to allocate MeshPrimitive.");
     return prim;
 }
@@ -191,15 +199,16 @@ void gf3d_mesh_primitive_free(MeshPrimitive* prim) {
         vkDestroyBuffer(mesh_manager.device, prim->vertexBuffer, NULL);
     }
     if (prim->vertexBufferMemory != VK_NULL_HANDLE) {
-        vkFreeMemory(mesh_manager.device, prim->vertexBufferMemory, NULL);
+        gf3d_memory_vk_free(mesh_manager.device, prim->vertexBufferMemory);
     }
     if (prim->faceBuffer != VK_NULL_HANDLE) {
         vkDestroyBuffer(mesh_manager.device, prim->faceBuffer, NULL);
     }
     if (prim->faceBufferMemory != VK_NULL_HANDLE) {
-        vkFreeMemory(mesh_manager.device, prim->faceBufferMemory, NULL);
+        gf3d_memory_vk_free(mesh_manager.device, prim->faceBufferMemory);
     }
-    free(prim);
+    gf3d_obj_free(prim->objData);
+    gf3d_memory_free(prim);
 }
 
 static int gf3d_mesh_primitive_build_from_obj(MeshPrimitive* prim, ObjData* obj) {
@@ -218,7 +227,7 @@ static int gf3d_mesh_primitive_build_from_obj(MeshPrimitive* prim, ObjData* obj)
     device = mesh_manager.device;
     bufferSize = sizeof(Vertex) * obj->face_vert_count;
 
-    if (!gf3d_buffer_create(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingMemory)) {
+    if (!gf3d_buffer_create(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingMemory, MT_Staging)) {
         slog("Failed to create staging buffer for mesh primitive");
         return 0;
     }
@@ -226,24 +235,24 @@ static int gf3d_mesh_primitive_build_from_obj(MeshPrimitive* prim, ObjData* obj)
     if (vkMapMemory(device, stagingMemory, 0, bufferSize, 0, &data) != VK_SUCCESS) {
         slog("Failed to map staging buffer memory for mesh primitive");
         vkDestroyBuffer(device, stagingBuffer, NULL);
-        vkFreeMemory(device, stagingMemory, NULL);
+        gf3d_memory_vk_free(device, stagingMemory);
         return 0;
     }
 
     memcpy(data, obj->faceVertices, bufferSize);
     vkUnmapMemory(device, stagingMemory);
 
-    if (!gf3d_buffer_create(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &prim->vertexBuffer, &prim->vertexBufferMemory)) {
+    if (!gf3d_buffer_create(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &prim->vertexBuffer, &prim->vertexBufferMemory, MT_Mesh)) {
         slog("Failed to create vertex buffer for mesh primitive");
         vkDestroyBuffer(device, stagingBuffer, NULL);
-        vkFreeMemory(device, stagingMemory, NULL);
+        gf3d_memory_vk_free(device, stagingMemory);
         return 0;
     }
 
     gf3d_buffer_copy(stagingBuffer, prim->vertexBuffer, bufferSize);
 
     vkDestroyBuffer(device, stagingBuffer, NULL);
-    vkFreeMemory(device, stagingMemory, NULL);
+    gf3d_memory_vk_free(device, stagingMemory);
 
     prim->vertexCount = obj->face_vert_count;
     prim->faceCount = obj->face_count;
@@ -264,12 +273,47 @@ Mesh* gf3d_mesh_get_by_filename(const char* filename) {
     return NULL;
 }
 
+static void gf3d_mesh_primitive_retain(MeshPrimitive* prim, ObjData* obj, MeshRetention retention) {
+    if (prim->objData != obj) gf3d_obj_free(prim->objData);
+    prim->objData = NULL;
+    switch (retention) {
+        case MR_None:
+            gf3d_obj_free(obj);
+            return;
+        case MR_Collision:
+            gf3d_obj_compact(obj);
+            break;
+        case MR_Full:
+            break;
+    }
+    prim->objData = obj;
+}
+
 Mesh* gf3d_mesh_load(const char* filename) {
+    return gf3d_mesh_load_full(filename, MR_None);
+}
+
+Mesh* gf3d_mesh_load_full(const char* filename, MeshRetention retention) {
+    int built;
+    ObjData* reload;
+    MeshPrimitive* prim;
     if (!filename) return NULL;
 
     Mesh* mesh = gf3d_mesh_get_by_filename(filename);
     if (mesh) {
         mesh->_refCount++;
+        if (mesh->retention < retention) {
+            // loaded by someone who only needed to draw it, read the file again for the cpu side
+            prim = gfc_list_get_nth(mesh->primitives, 0);
+            reload = gf3d_obj_load_from_file(filename);
+            if ((prim) && (reload)) {
+                gf3d_mesh_primitive_retain(prim, reload, retention);
+                mesh->retention = retention;
+            } else {
+                slog("failed to reload %s to keep its obj data", filename);
+                gf3d_obj_free(reload);
+            }
+        }
         return mesh;
     }
 
@@ -297,20 +341,46 @@ Mesh* gf3d_mesh_load(const char* filename) {
     }
 
     primitive->objData = obj;
-    if (!gf3d_mesh_primitive_build_from_obj(primitive, obj)) {
+    GF3D_PROFILE_BEGIN("mesh_upload");
+    built = gf3d_mesh_primitive_build_from_obj(primitive, obj);
+    GF3D_PROFILE_END();
+    if (!built) {
         slog("Failed to build GPU buffers for mesh %s", filename);
-        gf3d_mesh_primitive_free(primitive);
+        gf3d_mesh_primitive_free(primitive);// takes the obj with it
         gf3d_mesh_free(mesh);
-        gf3d_obj_free(obj);
         return NULL;
     }
 
     mesh->bounds = obj->bounds;
+    mesh->retention = retention;
+    gf3d_mesh_primitive_retain(primitive, obj, retention);
     gfc_list_append(mesh->primitives, primitive);
 
     return mesh;
 }
 
+Uint8 gf3d_mesh_edge_test(Mesh* mesh, GFC_Matrix4 modelMat, GFC_Edge3D e, float* fraction, GFC_Vector3D* contact) {
+    int i, count;
+    float t, best = 2;
+    MeshPrimitive* prim;
+    if (!mesh) return 0;
+    count = gfc_list_get_count(mesh->primitives);
+    for (i = 0; i < count; i++) {
+        prim = gfc_list_get_nth(mesh->primitives, i);
+        if ((!prim) || (!prim->objData)) continue;
+        if (!gf3d_obj_edge_test_closest(prim->objData, modelMat, e, &t, NULL)) continue;
+        if (t < best) best = t;
+    }
+    if (best > 1) return 0;
+    if (fraction) *fraction = best;
+    if (contact) {
+        contact->x = e.a.x + (e.b.x - e.a.x) * best;
+        contact->y = e.a.y + (e.b.y - e.a.y) * best;
+        contact->z = e.a.z + (e.b.z - e.a.z) * best;
+    }
+    return 1;
+}
+
 void gf3d_mesh_free(Mesh* mesh) {
     if (!mesh) return;
     if (mesh->_refCount > 0) mesh->_refCount--;
@@ -334,6 +404,10 @@ void gf3d_mesh_draw(Mesh *mesh,GFC_Matrix4 modelMat,GFC_Color mod,Texture *textu
     ubo.lightColor = gfc_color_to_vector4f(lightColor);
     ubo.lightPos = gfc_vector3dw(lightPos,1.0);
     ubo.camera = gfc_vector3dw(gf3d_camera_get_position(),1.0);
+    if ((texture)&&(texture->streamed))
+    {
+        gf3d_texture_stream_touch(texture,gf3d_mesh_get_screen_size(mesh,modelMat,ubo.proj,gf3d_camera_get_position()));
+    }
     gf3d_mesh_queue_render(mesh,mesh_manager.pipe,&ubo,texture);
 }
 
@@ -351,6 +425,8 @@ void gf3d_mesh_sky_draw(Mesh *mesh,GFC_Matrix4 modelMat,GFC_Color mod,Texture *t
     ubo.lightColor = gfc_color_to_vector4f(GFC_COLOR_WHITE);
     ubo.lightPos = gfc_vector4d(0,0,0,1);
     ubo.camera = gfc_vector4d(0,0,0,1);
+    // the sky surrounds the camera, it always wants its largest level
+    gf3d_texture_stream_touch(texture,FLT_MAX);
     
     gf3d_mesh_queue_render(mesh,mesh_manager.skypipe,&ubo,texture);
 }
@@ -369,9 +445,24 @@ static void gf3d_mesh_delete(Mesh* mesh) {
     mesh_manager.mesh_count--;
 }
 
+static float gf3d_mesh_get_screen_size(Mesh* mesh, GFC_Matrix4 modelMat, GFC_Matrix4 proj, GFC_Vector3D camera) {
+    GFC_Box box;
+    GFC_Vector3D center, delta;
+    float radius, distance;
+    // bounding sphere of the world bounds, assumes the texture is spread across the mesh once
+    gf3d_frustum_transform_box(&box, mesh->bounds, modelMat);
+    radius = 0.5f * sqrtf(box.w * box.w + box.h * box.h + box.d * box.d);
+    center = gfc_vector3d(box.x + box.w * 0.5f, box.y + box.h * 0.5f, box.z + box.d * 0.5f);
+    gfc_vector3d_sub(delta, center, camera);
+    distance = gfc_vector3d_magnitude(delta);
+    if (distance <= radius) return FLT_MAX;
+    return radius * fabsf(proj[1][1]) * gf3d_vgraphics_get_resolution().y / distance;
+}
+
 void gf3d_mesh_primitive_queue_render(MeshPrimitive* prim, Pipeline* pipe, void* uboData, Texture* texture) {
     if (!prim || !pipe || !uboData) return;
-    if (!texture) texture = mesh_manager.defaultTexture;
+    // streamed textures draw with the default until their first levels are uploaded
+    if (!texture || !texture->textureImageView) texture = mesh_manager.defaultTexture;
     gf3d_pipeline_queue_render(
         pipe,
         prim->vertexBuffer,
@@ -1,32 +1,102 @@
 #include <stdio.h>
+#include <math.h>
 
 #include "simple_logger.h"
 
 #include "gfc_pak.h"
 
 #include "gf3d_obj_load.h"
+#include "gf3d_memory.h"
+#include "gf3d_profiler.h"
 
-int gf3d_obj_edge_test(ObjData* obj, GFC_Matrix4 offset, GFC_Edge3D e, GFC_Vector3D* contact)
+/**
+ * invert a rotation / scale / translation matrix.  Returns 0 if it cannot be inverted
+ */
+static int gf3d_obj_affine_inverse(GFC_Matrix4 out, GFC_Matrix4 in)
 {
-    int i;
-    GFC_Vector4D out;
-    GFC_Triangle3D t;
-    if ((!obj) || (!obj->outFace))return 0;
-    for (i = 0; i < obj->face_count; i++)
+    int c, r;
+    float det, invDet;
+    float m[3][3];
+    det = in[0][0] * (in[1][1] * in[2][2] - in[2][1] * in[1][2])
+        - in[1][0] * (in[0][1] * in[2][2] - in[2][1] * in[0][2])
+        + in[2][0] * (in[0][1] * in[1][2] - in[1][1] * in[0][2]);
+    if (fabsf(det) < GFC_EPSILON)return 0;
+    invDet = 1.0 / det;
+    m[0][0] = (in[1][1] * in[2][2] - in[2][1] * in[1][2]) * invDet;
+    m[0][1] = (in[2][1] * in[0][2] - in[0][1] * in[2][2]) * invDet;
+    m[0][2] = (in[0][1] * in[1][2] - in[1][1] * in[0][2]) * invDet;
+    m[1][0] = (in[2][0] * in[1][2] - in[1][0] * in[2][2]) * invDet;
+    m[1][1] = (in[0][0] * in[2][2] - in[2][0] * in[0][2]) * invDet;
+    m[1][2] = (in[1][0] * in[0][2] - in[0][0] * in[1][2]) * invDet;
+    m[2][0] = (in[1][0] * in[2][1] - in[2][0] * in[1][1]) * invDet;
+    m[2][1] = (in[2][0] * in[0][1] - in[0][0] * in[2][1]) * invDet;
+    m[2][2] = (in[0][0] * in[1][1] - in[1][0] * in[0][1]) * invDet;
+    for (c = 0; c < 3; c++)
+    {
+        for (r = 0; r < 3; r++)
+        {
+            out[c][r] = m[c][r];
+        }
+        out[c][3] = 0;
+    }
+    for (r = 0; r < 3; r++)
     {
-        t.a = obj->faceVertices[obj->outFace[i].verts[0]].vertex;
-        t.b = obj->faceVertices[obj->outFace[i].verts[1]].vertex;
-        t.c = obj->faceVertices[obj->outFace[i].verts[2]].vertex;
-        //apply offset
-        gfc_matrix4_multiply_v(&out, offset, gfc_vector3dw(t.a, 0));
-        t.a = gfc_vector4dxyz(out);
-        gfc_matrix4_multiply_v(&out, offset, gfc_vector3dw(t.b, 0));
-        t.b = gfc_vector4dxyz(out);
-        gfc_matrix4_multiply_v(&out, offset, gfc_vector3dw(t.c, 0));
-        t.c = gfc_vector4dxyz(out);
-        if (gfc_trigfc_angle_edge_test(e, t, contact))return 1;
-    }
-    return 0;
+        out[3][r] = -(m[0][r] * in[3][0] + m[1][r] * in[3][1] + m[2][r] * in[3][2]);
+    }
+    out[3][3] = 1;
+    return 1;
+}
+
+static GFC_Vector3D gf3d_obj_transform_point(GFC_Matrix4 mat, GFC_Vector3D p)
+{
+    GFC_Vector3D out;
+    out.x = mat[0][0] * p.x + mat[1][0] * p.y + mat[2][0] * p.z + mat[3][0];
+    out.y = mat[0][1] * p.x + mat[1][1] * p.y + mat[2][1] * p.z + mat[3][1];
+    out.z = mat[0][2] * p.x + mat[1][2] * p.y + mat[2][2] * p.z + mat[3][2];
+    return out;
+}
+
+TriBVH* gf3d_obj_build_bvh(ObjData* obj)
+{
+    if (!obj)return NULL;
+    if (obj->bvh)return obj->bvh;// compacted objs only have this
+    if ((!obj->outFace) || (!obj->faceVertices))return NULL;
+    obj->bvh = gf3d_tri_bvh_build(obj->faceVertices, obj->outFace, obj->face_count);
+    return obj->bvh;
+}
+
+int gf3d_obj_edge_test_closest(ObjData* obj, GFC_Matrix4 offset, GFC_Edge3D e, float* fraction, GFC_Vector3D* contact)
+{
+    float t;
+    GFC_Matrix4 inverse;
+    GFC_Vector3D start, end;
+    if (!gf3d_obj_build_bvh(obj))return 0;
+    // move the edge into model space rather than every triangle out of it
+    if (!gf3d_obj_affine_inverse(inverse, offset))return 0;
+    start = gf3d_obj_transform_point(inverse, e.a);
+    end = gf3d_obj_transform_point(inverse, e.b);
+    if (!gf3d_tri_bvh_ray_closest(obj->bvh, start, end, &t, NULL, NULL))return 0;
+    // the fraction along the edge survives the transform, so the contact can be found in world space
+    if (fraction)*fraction = t;
+    if (contact)
+    {
+        contact->x = e.a.x + (e.b.x - e.a.x) * t;
+        contact->y = e.a.y + (e.b.y - e.a.y) * t;
+        contact->z = e.a.z + (e.b.z - e.a.z) * t;
+    }
+    return 1;
+}
+
+int gf3d_obj_edge_test(ObjData* obj, GFC_Matrix4 offset, GFC_Edge3D e, GFC_Vector3D* contact)
+{
+    GFC_Matrix4 inverse;
+    if (contact)return gf3d_obj_edge_test_closest(obj, offset, e, NULL, contact);
+    if (!gf3d_obj_build_bvh(obj))return 0;
+    if (!gf3d_obj_affine_inverse(inverse, offset))return 0;
+    return gf3d_tri_bvh_ray_any(
+        obj->bvh,
+        gf3d_obj_transform_point(inverse, e.a),
+        gf3d_obj_transform_point(inverse, e.b));
 }
 
 void gf3d_obj_get_counts_from_file(ObjData* obj, const char* mem, size_t fileSize);
@@ -38,53 +108,94 @@ void gf3d_obj_free(ObjData* obj)
 
     if (obj->vertices != NULL)
     {
-        free(obj->vertices);
+        gf3d_memory_free(obj->vertices);
     }
     if (obj->normals != NULL)
     {
-        free(obj->normals);
+        gf3d_memory_free(obj->normals);
     }
     if (obj->texels != NULL)
     {
-        free(obj->texels);
+        gf3d_memory_free(obj->texels);
     }
     if (obj->boneIndices != NULL)
     {
-        free(obj->boneIndices);
+        gf3d_memory_free(obj->boneIndices);
     }
     if (obj->boneWeights != NULL)
     {
-        free(obj->boneWeights);
+        gf3d_memory_free(obj->boneWeights);
     }
 
     if (obj->faceVerts != NULL)
     {
-        free(obj->faceVerts);
+        gf3d_memory_free(obj->faceVerts);
     }
     if (obj->faceNormals != NULL)
     {
-        free(obj->faceNormals);
+        gf3d_memory_free(obj->faceNormals);
     }
     if (obj->faceTexels != NULL)
     {
-        free(obj->faceTexels);
+        gf3d_memory_free(obj->faceTexels);
     }
     if (obj->faceBones != NULL)
     {
-        free(obj->faceBones);
+        gf3d_memory_free(obj->faceBones);
     }
 
     if (obj->faceWeights != NULL)
     {
-        free(obj->faceWeights);
+        gf3d_memory_free(obj->faceWeights);
     }
 
     if (obj->outFace != NULL)
     {
-        free(obj->outFace);
+        gf3d_memory_free(obj->outFace);
+    }
+
+    if (obj->faceVertices != NULL)
+    {
+        gf3d_memory_free(obj->faceVertices);
     }
 
-    free(obj);
+    gf3d_tri_bvh_free(obj->bvh);
+    gf3d_memory_free(obj);
+}
+
+void gf3d_obj_compact(ObjData* obj)
+{
+    if (!obj)return;
+    if (!gf3d_obj_build_bvh(obj))
+    {
+        slog("failed to build collision for obj, keeping its full data");
+        return;
+    }
+    // the bvh holds its own copy of every triangle, nothing else is read by the edge tests
+    gf3d_memory_free(obj->vertices);
+    gf3d_memory_free(obj->normals);
+    gf3d_memory_free(obj->texels);
+    gf3d_memory_free(obj->boneIndices);
+    gf3d_memory_free(obj->boneWeights);
+    gf3d_memory_free(obj->faceVerts);
+    gf3d_memory_free(obj->faceNormals);
+    gf3d_memory_free(obj->faceTexels);
+    gf3d_memory_free(obj->faceBones);
+    gf3d_memory_free(obj->faceWeights);
+    gf3d_memory_free(obj->outFace);
+    gf3d_memory_free(obj->faceVertices);
+    obj->vertices = NULL;
+    obj->normals = NULL;
+    obj->texels = NULL;
+    obj->boneIndices = NULL;
+    obj->boneWeights = NULL;
+    obj->faceVerts = NULL;
+    obj->faceNormals = NULL;
+    obj->faceTexels = NULL;
+    obj->faceBones = NULL;
+    obj->faceWeights = NULL;
+    obj->outFace = NULL;
+    obj->faceVertices = NULL;
 }
 
 //while normal obj files don't support bones, the obj structure is used as a staging area for gltf loading.
@@ -98,8 +209,8 @@ void gf3d_obj_load_reorg(ObjData* obj)
     if (!obj)return;
 
     obj->face_vert_count = obj->face_count * 3;
-    obj->faceVertices = (Vertex*)gfc_allocate_array(sizeof(Vertex), obj->face_vert_count);
-    obj->outFace = (Face*)gfc_allocate_array(sizeof(Face), obj->face_count);
+    obj->faceVertices = (Vertex*)gf3d_memory_alloc_array(MT_Loader, sizeof(Vertex), obj->face_vert_count);
+    obj->outFace = (Face*)gf3d_memory_alloc_array(MT_Loader, sizeof(Face), obj->face_count);
 
     for (i = 0; i < obj->face_count; i++)
     {
@@ -148,28 +259,37 @@ ObjData* gf3d_obj_load_from_file(const char* filename)
     void* mem = NULL;
     size_t fileSize;
 
+    GF3D_PROFILE_BEGIN("file_read");
     mem = gfc_pak_file_extract(filename, &fileSize);
+    GF3D_PROFILE_END();
 
     if (!mem)return NULL;
 
-    obj = (ObjData*)gfc_allocate_array(sizeof(ObjData), 1);
-    if (!obj)return NULL;
+    obj = (ObjData*)gf3d_memory_alloc_array(MT_Loader, sizeof(ObjData), 1);
+    if (!obj)
+    {
+        free(mem);
+        return NULL;
+    }
+
+    GF3D_PROFILE_BEGIN("obj_parse");
 
     gf3d_obj_get_counts_from_file(obj, mem, fileSize);
 
-    obj->vertices = (GFC_Vector3D*)gfc_allocate_array(sizeof(GFC_Vector3D), obj->vertex_count);
-    obj->normals = (GFC_Vector3D*)gfc_allocate_array(sizeof(GFC_Vector3D), obj->normal_count);
-    obj->texels = (GFC_Vector2D*)gfc_allocate_array(sizeof(GFC_Vector2D), obj->texel_count);
+    obj->vertices = (GFC_Vector3D*)gf3d_memory_alloc_array(MT_Loader, sizeof(GFC_Vector3D), obj->vertex_count);
+    obj->normals = (GFC_Vector3D*)gf3d_memory_alloc_array(MT_Loader, sizeof(GFC_Vector3D), obj->normal_count);
+    obj->texels = (GFC_Vector2D*)gf3d_memory_alloc_array(MT_Loader, sizeof(GFC_Vector2D), obj->texel_count);
 
-    obj->faceVerts = (Face*)gfc_allocate_array(sizeof(Face), obj->face_count);
-    obj->faceNormals = (Face*)gfc_allocate_array(sizeof(Face), obj->face_count);
-    obj->faceTexels = (Face*)gfc_allocate_array(sizeof(Face), obj->face_count);
+    obj->faceVerts = (Face*)gf3d_memory_alloc_array(MT_Loader, sizeof(Face), obj->face_count);
+    obj->faceNormals = (Face*)gf3d_memory_alloc_array(MT_Loader, sizeof(Face), obj->face_count);
+    obj->faceTexels = (Face*)gf3d_memory_alloc_array(MT_Loader, sizeof(Face), obj->face_count);
 
     gf3d_obj_load_get_data_from_file(obj, mem, fileSize);
-
+    free(mem);
 
     gf3d_obj_get_bounds(obj);
     gf3d_obj_load_reorg(obj);
+    GF3D_PROFILE_END();
     return obj;
 }
 
@@ -330,6 +450,9 @@ void gf3d_obj_move(ObjData* obj, GFC_Vector3D offset, GFC_Vector3D rotation)
     GFC_Matrix4 matrix = { 0 };
     int i;
     if (!obj)return;
+    //the triangles are moving, rebuild on the next test
+    gf3d_tri_bvh_free(obj->bvh);
+    obj->bvh = NULL;
     for (i = 0; i < obj->face_vert_count; i++)
     {
         //update the vertices
@@ -355,7 +478,7 @@ void gf3d_obj_move(ObjData* obj, GFC_Vector3D offset, GFC_Vector3D rotation)
 ObjData* gf3d_obj_new()
 {
     ObjData* out = NULL;
-    out = (ObjData*)gfc_allocate_array(sizeof(ObjData), 1);
+    out = (ObjData*)gf3d_memory_alloc_array(MT_Loader, sizeof(ObjData), 1);
     return out;
 }
 
@@ -371,7 +494,7 @@ ObjData* gf3d_obj_duplicate(ObjData* in)
 
     if ((in->vertices) && (in->vertex_count))
     {
-        out->vertices = gfc_allocate_array(sizeof(GFC_Vector3D), in->vertex_count);
+        out->vertices = gf3d_memory_alloc_array(MT_Loader, sizeof(GFC_Vector3D), in->vertex_count);
         if (out->vertices)
         {
             memcpy(out->vertices, in->vertices, sizeof(GFC_Vector3D) * in->vertex_count);
@@ -380,7 +503,7 @@ ObjData* gf3d_obj_duplicate(ObjData* in)
     }
     if ((in->normals) && (in->normal_count))
     {
-        out->normals = gfc_allocate_array(sizeof(GFC_Vector3D), in->normal_count);
+        out->normals = gf3d_memory_alloc_array(MT_Loader, sizeof(GFC_Vector3D), in->normal_count);
         if (out->normals)
         {
             memcpy(out->normals, in->normals, sizeof(GFC_Vector3D) * in->normal_count);
@@ -389,7 +512,7 @@ ObjData* gf3d_obj_duplicate(ObjData* in)
     }
     if ((in->texels) && (in->texel_count))
     {
-        out->texels = gfc_allocate_array(sizeof(GFC_Vector2D), in->texel_count);
+        out->texels = gf3d_memory_alloc_array(MT_Loader, sizeof(GFC_Vector2D), in->texel_count);
         if (out->texels)
         {
             memcpy(out->texels, in->texels, sizeof(GFC_Vector2D) * in->texel_count);
@@ -398,7 +521,7 @@ ObjData* gf3d_obj_duplicate(ObjData* in)
     }
     if ((in->boneIndices) && (in->bone_count))
     {
-        out->boneIndices = gfc_allocate_array(sizeof(GFC_Vector4UI8), in->bone_count);
+        out->boneIndices = gf3d_memory_alloc_array(MT_Loader, sizeof(GFC_Vector4UI8), in->bone_count);
         if (out->boneIndices)
         {
             memcpy(out->boneIndices, in->boneIndices, sizeof(GFC_Vector4UI8) * in->bone_count);
@@ -407,7 +530,7 @@ ObjData* gf3d_obj_duplicate(ObjData* in)
     }
     if ((in->boneWeights) && (in->weight_count))
     {
-        out->boneWeights = gfc_allocate_array(sizeof(GFC_Vector4D), in->weight_count);
+        out->boneWeights = gf3d_memory_alloc_array(MT_Loader, sizeof(GFC_Vector4D), in->weight_count);
         if (out->boneWeights)
         {
             memcpy(out->boneWeights, in->boneWeights, sizeof(GFC_Vector4D) * in->weight_count);
@@ -418,7 +541,7 @@ ObjData* gf3d_obj_duplicate(ObjData* in)
     {
         if (in->faceVerts)
         {
-            out->faceVerts = gfc_allocate_array(sizeof(Face), in->face_count);
+            out->faceVerts = gf3d_memory_alloc_array(MT_Loader, sizeof(Face), in->face_count);
             if (out->faceVerts)
             {
                 memcpy(out->faceVerts, in->faceVerts, sizeof(Face) * in->face_count);
@@ -426,7 +549,7 @@ ObjData* gf3d_obj_duplicate(ObjData* in)
         }
         if (in->faceNormals)
         {
-            out->faceNormals = gfc_allocate_array(sizeof(Face), in->face_count);
+            out->faceNormals = gf3d_memory_alloc_array(MT_Loader, sizeof(Face), in->face_count);
             if (out->faceNormals)
             {
                 memcpy(out->faceNormals, in->faceNormals, sizeof(Face) * in->face_count);
@@ -434,7 +557,7 @@ ObjData* gf3d_obj_duplicate(ObjData* in)
         }
         if (in->faceTexels)
         {
-            out->faceTexels = gfc_allocate_array(sizeof(Face), in->face_count);
+            out->faceTexels = gf3d_memory_alloc_array(MT_Loader, sizeof(Face), in->face_count);
             if (out->faceTexels)
             {
                 memcpy(out->faceTexels, in->faceTexels, sizeof(Face) * in->face_count);
@@ -442,7 +565,7 @@ ObjData* gf3d_obj_duplicate(ObjData* in)
         }
         if (in->faceBones)
         {
-            out->faceBones = gfc_allocate_array(sizeof(Face), in->face_count);
+            out->faceBones = gf3d_memory_alloc_array(MT_Loader, sizeof(Face), in->face_count);
             if (out->faceBones)
             {
                 memcpy(out->faceBones, in->faceBones, sizeof(Face) * in->face_count);
@@ -450,7 +573,7 @@ ObjData* gf3d_obj_duplicate(ObjData* in)
         }
         if (in->faceWeights)
         {
-            out->faceWeights = gfc_allocate_array(sizeof(Face), in->face_count);
+            out->faceWeights = gf3d_memory_alloc_array(MT_Loader, sizeof(Face), in->face_count);
             if (out->faceWeights)
             {
                 memcpy(out->faceWeights, in->faceWeights, sizeof(Face) * in->face_count);
@@ -458,7 +581,7 @@ ObjData* gf3d_obj_duplicate(ObjData* in)
         }
         if (in->outFace)
         {
-            out->outFace = gfc_allocate_array(sizeof(Face), in->face_count);
+            out->outFace = gf3d_memory_alloc_array(MT_Loader, sizeof(Face), in->face_count);
             if (out->outFace)
             {
                 memcpy(out->outFace, in->outFace, sizeof(Face) * in->face_count);
@@ -468,7 +591,7 @@ ObjData* gf3d_obj_duplicate(ObjData* in)
     }
     if ((in->faceVertices) && (in->face_vert_count))
     {
-        out->faceVertices = gfc_allocate_array(sizeof(Vertex), in->face_vert_count);
+        out->faceVertices = gf3d_memory_alloc_array(MT_Loader, sizeof(Vertex), in->face_vert_count);
         if (out->faceVertices)
         {
             memcpy(out->faceVertices, in->faceVertices, sizeof(Vertex) * in->face_vert_count);
@@ -495,14 +618,14 @@ ObjData* gf3d_obj_merge(ObjData* ObjA, GFC_Vector3D offsetA, ObjData* ObjB, GFC_
     if (!ObjNew)return NULL;
     //allocate space for new verices
     ObjNew->face_vert_count = ObjA->face_vert_count + ObjB->face_vert_count;
-    ObjNew->faceVertices = gfc_allocate_array(sizeof(Vertex), ObjNew->face_vert_count);
+    ObjNew->faceVertices = gf3d_memory_alloc_array(MT_Loader, sizeof(Vertex), ObjNew->face_vert_count);
     if (!ObjNew->faceVertices)
     {
         gf3d_obj_free(ObjNew);
         return NULL;
     }
     ObjNew->face_count = ObjA->face_count + ObjB->face_count;
-    ObjNew->outFace = gfc_allocate_array(sizeof(Face), ObjNew->face_count);
+    ObjNew->outFace = gf3d_memory_alloc_array(MT_Loader, sizeof(Face), ObjNew->face_count);
     if (!ObjNew->outFace)
     {
         gf3d_obj_free(ObjNew);
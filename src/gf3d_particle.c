@@ -0,0 +1,792 @@
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE__)||defined(_M_X64)||(defined(_M_IX86_FP)&&(_M_IX86_FP >= 1))
+#define GF3D_PARTICLE_SSE
+#include <xmmintrin.h>
+#endif
+
+#include "simple_logger.h"
+
+#include "gfc_types.h"
+
+#include "gf3d_buffers.h"
+#include "gf3d_memory.h"
+#include "gf3d_swapchain.h"
+#include "gf3d_vgraphics.h"
+#include "gf3d_pipeline.h"
+#include "gf3d_jobs.h"
+#include "gf3d_log.h"
+#include "gf3d_render_stats.h"
+#include "gf3d_particle.h"
+
+#define PARTICLE_ATTRIBUTE_COUNT 2
+#define PARTICLE_MAX_EMITTERS 64
+#define PARTICLE_MAX_BATCHES 1024           /**<instanced draw calls per frame*/
+#define PARTICLE_SLICE 16384                /**<particles per job, a multiple of 4*/
+#define PARTICLE_TEXTURE_SIZE 64            /**<the default soft circle*/
+
+extern int __DEBUG;
+
+typedef struct
+{
+    GFC_Matrix4     view;
+    GFC_Matrix4     proj;
+    GFC_Vector4D    uvRect;     /**<x,y of the top left and the width and height, in texture coordinates*/
+}ParticleUBO;
+
+typedef struct
+{
+    float   position[3];
+    float   size;
+    float   color[4];
+}ParticleInstance;
+
+typedef struct
+{
+    ParticleEmitter    *emitter;
+    ParticleInstance   *instances;  /**<where the emitter's first particle is written*/
+    Uint32              count;      /**<how many particles from the tail the jobs cover*/
+    float               dt;
+    float               damping;
+    float               color[4];
+    float               colorDelta[4];
+    float               size;
+    float               sizeDelta;
+}ParticleJob;
+
+typedef struct
+{
+    Pipeline           *pipe;
+    VkDevice            device;
+    Uint32              chain_length;
+    Uint32              maxParticles;       /**<instances each frame can hold*/
+    VkVertexInputAttributeDescription   attributeDescriptions[PARTICLE_ATTRIBUTE_COUNT];
+    VkVertexInputBindingDescription     bindingDescription;
+    VkBuffer           *instanceBuffers;    /**<host visible instances, one buffer per swap chain frame*/
+    VkDeviceMemory     *instanceMemory;
+    ParticleInstance  **instances;          /**<each instance buffer, kept mapped*/
+    Uint32              instanceCount;      /**<instances written to the current frame's buffer*/
+    Texture            *defaultTexture;
+    Texture            *batchTexture;       /**<what the open batch samples*/
+    GFC_Vector4D        batchRect;          /**<the part of the texture the open batch draws*/
+    Uint32              batchStart;         /**<the first instance of the open batch*/
+    Uint32              batchCount;         /**<instances in the open batch, 0 if there is none*/
+    ParticleEmitter     emitterList[PARTICLE_MAX_EMITTERS];
+}ParticleManager;
+
+static ParticleManager gf3d_particle_manager = {0};
+
+void gf3d_particle_instance_buffers_create();
+Texture *gf3d_particle_default_texture_create();
+VkVertexInputBindingDescription *gf3d_particle_get_bind_description();
+VkVertexInputAttributeDescription *gf3d_particle_get_attribute_descriptions(Uint32 *count);
+
+void gf3d_particle_manager_close()
+{
+    Uint32 i;
+    for (i = 0; i < PARTICLE_MAX_EMITTERS; i++)
+    {
+        gf3d_particle_emitter_free(&gf3d_particle_manager.emitterList[i]);
+    }
+    for (i = 0; (gf3d_particle_manager.instanceBuffers)&&(i < gf3d_particle_manager.chain_length); i++)
+    {
+        if (gf3d_particle_manager.instanceBuffers[i] != VK_NULL_HANDLE)vkDestroyBuffer(gf3d_particle_manager.device,gf3d_particle_manager.instanceBuffers[i],NULL);
+        if (gf3d_particle_manager.instanceMemory[i] != VK_NULL_HANDLE)
+        {
+            vkUnmapMemory(gf3d_particle_manager.device,gf3d_particle_manager.instanceMemory[i]);
+            gf3d_memory_vk_free(gf3d_particle_manager.device,gf3d_particle_manager.instanceMemory[i]);
+        }
+    }
+    gf3d_memory_free(gf3d_particle_manager.instanceBuffers);
+    gf3d_memory_free(gf3d_particle_manager.instanceMemory);
+    gf3d_memory_free(gf3d_particle_manager.instances);
+    gf3d_texture_free(gf3d_particle_manager.defaultTexture);
+    memset(&gf3d_particle_manager,0,sizeof(ParticleManager));
+    if (__DEBUG)slog("particle manager closed");
+}
+
+void gf3d_particle_manager_init(Uint32 max_particles)
+{
+    Uint32 count;
+    if (!max_particles)
+    {
+        slog("cannot initialize particle manager for 0 particles");
+        return;
+    }
+    gf3d_particle_manager.chain_length = gf3d_swapchain_get_chain_length();
+    gf3d_particle_manager.device = gf3d_vgraphics_get_default_logical_device();
+    gf3d_particle_manager.maxParticles = max_particles;
+    gf3d_particle_instance_buffers_create();
+
+    gf3d_particle_get_attribute_descriptions(&count);
+    gf3d_particle_manager.pipe = gf3d_pipeline_create_from_config(
+        gf3d_vgraphics_get_default_logical_device(),
+        "config/particle_pipeline.cfg",
+        gf3d_vgraphics_get_view_extent(),
+        PARTICLE_MAX_BATCHES,
+        gf3d_particle_get_bind_description(),
+        gf3d_particle_get_attribute_descriptions(NULL),
+        count,
+        sizeof(ParticleUBO),
+        VK_INDEX_TYPE_UINT16
+    );
+    if (!gf3d_particle_manager.pipe)slog("particles will not be drawn: failed to create the particle pipeline");
+    gf3d_particle_manager.defaultTexture = gf3d_particle_default_texture_create();
+    atexit(gf3d_particle_manager_close);
+    if (__DEBUG)slog("particle manager initialized for %u particles a frame",max_particles);
+}
+
+/**
+ * @brief make the per frame instance buffers
+ */
+void gf3d_particle_instance_buffers_create()
+{
+    Uint32 i;
+    size_t bufferSize;
+
+    gf3d_particle_manager.instanceBuffers = gf3d_memory_alloc_array(MT_Particle,sizeof(VkBuffer),gf3d_particle_manager.chain_length);
+    gf3d_particle_manager.instanceMemory = gf3d_memory_alloc_array(MT_Particle,sizeof(VkDeviceMemory),gf3d_particle_manager.chain_length);
+    gf3d_particle_manager.instances = gf3d_memory_alloc_array(MT_Particle,sizeof(ParticleInstance *),gf3d_particle_manager.chain_length);
+    if ((!gf3d_particle_manager.instanceBuffers)||(!gf3d_particle_manager.instanceMemory)||(!gf3d_particle_manager.instances))
+    {
+        slog("failed to allocate particle instance buffers");
+        return;
+    }
+    bufferSize = sizeof(ParticleInstance) * gf3d_particle_manager.maxParticles;
+    for (i = 0; i < gf3d_particle_manager.chain_length; i++)
+    {
+        if (!gf3d_buffer_create(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &gf3d_particle_manager.instanceBuffers[i], &gf3d_particle_manager.instanceMemory[i], MT_Particle))
+        {
+            slog("failed to create particle instance buffer");
+            return;
+        }
+        vkMapMemory(gf3d_particle_manager.device, gf3d_particle_manager.instanceMemory[i], 0, bufferSize, 0, (void **)&gf3d_particle_manager.instances[i]);
+    }
+}
+
+/**
+ * @brief make the soft white circle particles are drawn with when no texture is given
+ */
+Texture *gf3d_particle_default_texture_create()
+{
+    int x,y;
+    float dx,dy,d;
+    Uint32 *pixels;
+    SDL_Surface *surface;
+
+    surface = SDL_CreateRGBSurfaceWithFormat(0,PARTICLE_TEXTURE_SIZE,PARTICLE_TEXTURE_SIZE,32,SDL_PIXELFORMAT_RGBA32);
+    if (!surface)
+    {
+        slog("failed to create the default particle surface: %s",SDL_GetError());
+        return NULL;
+    }
+    for (y = 0; y < PARTICLE_TEXTURE_SIZE; y++)
+    {
+        pixels = (Uint32 *)((Uint8 *)surface->pixels + y * surface->pitch);
+        for (x = 0; x < PARTICLE_TEXTURE_SIZE; x++)
+        {
+            dx = (x + 0.5f) / (PARTICLE_TEXTURE_SIZE * 0.5f) - 1;
+            dy = (y + 0.5f) / (PARTICLE_TEXTURE_SIZE * 0.5f) - 1;
+            d = 1 - sqrtf(dx * dx + dy * dy);
+            if (d < 0)d = 0;
+            pixels[x] = SDL_MapRGBA(surface->format,255,255,255,(Uint8)(d * d * 255));
+        }
+    }
+    return gf3d_texture_convert_surface_full(surface,1,TR_GpuOnly);
+}
+
+Particle gf3d_particle(GFC_Vector3D position, GFC_Color color, float size)
+{
+    Particle particle = {0};
+    particle.position = position;
+    particle.color = color;
+    particle.color2 = color;
+    particle.size = size;
+    return particle;
+}
+
+void gf3d_particle_reset_pipes()
+{
+    if (!gf3d_particle_manager.pipe)return;
+    gf3d_pipeline_reset_frame(gf3d_particle_manager.pipe,gf3d_vgraphics_get_current_buffer_frame());
+    gf3d_particle_manager.instanceCount = 0;
+    gf3d_particle_manager.batchCount = 0;
+    gf3d_particle_manager.batchTexture = NULL;
+}
+
+/**
+ * @brief queue an instanced draw for a run of this frame's instances
+ */
+void gf3d_particle_queue_instances(Uint32 first,Uint32 count,Texture *texture,GFC_Vector4D uvRect)
+{
+    ParticleUBO ubo = {0};
+
+    if (!count)return;
+    gf3d_vgraphics_get_view(&ubo.view);
+    gf3d_vgraphics_get_projection_matrix(&ubo.proj);
+    ubo.uvRect = uvRect;
+    // no index buffer, the vertex shader makes the quad's two triangles from the vertex index
+    gf3d_pipeline_queue_render_instanced(
+        gf3d_particle_manager.pipe,
+        gf3d_particle_manager.instanceBuffers[gf3d_vgraphics_get_current_buffer_frame()],
+        first,
+        count,
+        6,
+        VK_NULL_HANDLE,
+        &ubo,
+        texture);
+    gf3d_render_stats_add(RS_ParticleBatches,1);
+}
+
+void gf3d_particle_queue_indirect(VkBuffer instanceBuffer,VkBuffer indirectBuffer,VkDeviceSize indirectOffset,Texture *texture)
+{
+    ParticleUBO ubo = {0};
+
+    if (!gf3d_particle_manager.pipe)return;
+    // keep the draw order the same as the calls
+    gf3d_particle_submit_pipe_commands();
+    gf3d_vgraphics_get_view(&ubo.view);
+    gf3d_vgraphics_get_projection_matrix(&ubo.proj);
+    ubo.uvRect = gfc_vector4d(0,0,1,1);
+    gf3d_pipeline_queue_render_indirect(
+        gf3d_particle_manager.pipe,
+        instanceBuffer,
+        indirectBuffer,
+        indirectOffset,
+        &ubo,
+        texture ? texture : gf3d_particle_manager.defaultTexture);
+    gf3d_render_stats_add(RS_ParticleBatches,1);
+}
+
+void gf3d_particle_submit_pipe_commands()
+{
+    if (!gf3d_particle_manager.batchCount)return;
+    gf3d_particle_queue_instances(
+        gf3d_particle_manager.batchStart,
+        gf3d_particle_manager.batchCount,
+        gf3d_particle_manager.batchTexture,
+        gf3d_particle_manager.batchRect);
+    gf3d_particle_manager.batchCount = 0;
+}
+
+/**
+ * @brief take instances from this frame's buffer
+ * @param count how many are wanted
+ * @param first [output] the index of the first one
+ * @return how many were taken, fewer than asked for if the buffer is nearly full
+ */
+Uint32 gf3d_particle_instances_reserve(Uint32 count,Uint32 *first)
+{
+    Uint32 left;
+    if ((!gf3d_particle_manager.pipe)||(!gf3d_particle_manager.instances))return 0;
+    left = gf3d_particle_manager.maxParticles - gf3d_particle_manager.instanceCount;
+    if (count > left)
+    {
+        gf3d_log(LL_Warning,"particle instance buffer full, dropping %u particles",count - left);
+        count = left;
+    }
+    *first = gf3d_particle_manager.instanceCount;
+    gf3d_particle_manager.instanceCount += count;
+    gf3d_render_stats_add(RS_Particles,count);
+    return count;
+}
+
+/**
+ * @brief make room for one particle in the batch for a texture and rect, starting a new batch if either changed
+ * @return NULL if the frame's instance buffer is full, where to write the particle otherwise
+ */
+ParticleInstance *gf3d_particle_batch_reserve(Texture *texture,GFC_Vector4D uvRect)
+{
+    Uint32 first;
+    if (!texture)texture = gf3d_particle_manager.defaultTexture;
+    if ((gf3d_particle_manager.batchCount)&&((texture != gf3d_particle_manager.batchTexture)||(memcmp(&uvRect,&gf3d_particle_manager.batchRect,sizeof(GFC_Vector4D)) != 0)))
+    {
+        gf3d_particle_submit_pipe_commands();
+    }
+    if (!gf3d_particle_instances_reserve(1,&first))return NULL;
+    if (!gf3d_particle_manager.batchCount)
+    {
+        gf3d_particle_manager.batchTexture = texture;
+        gf3d_particle_manager.batchRect = uvRect;
+        gf3d_particle_manager.batchStart = first;
+    }
+    gf3d_particle_manager.batchCount++;
+    return &gf3d_particle_manager.instances[gf3d_vgraphics_get_current_buffer_frame()][first];
+}
+
+void gf3d_particle_draw_full(Particle particle,Texture *texture,GFC_Vector4D uvRect)
+{
+    ParticleInstance *instance;
+    instance = gf3d_particle_batch_reserve(texture,uvRect);
+    if (!instance)return;
+    instance->position[0] = particle.position.x;
+    instance->position[1] = particle.position.y;
+    instance->position[2] = particle.position.z;
+    instance->size = particle.size;
+    instance->color[0] = particle.color.r;
+    instance->color[1] = particle.color.g;
+    instance->color[2] = particle.color.b;
+    instance->color[3] = particle.color.a;
+}
+
+void gf3d_particle_draw(Particle particle)
+{
+    gf3d_particle_draw_full(particle,NULL,gfc_vector4d(0,0,1,1));
+}
+
+void gf3d_particle_draw_textured(Particle particle,Texture *texture)
+{
+    gf3d_particle_draw_full(particle,texture,gfc_vector4d(0,0,1,1));
+}
+
+void gf3d_particle_draw_sprite(Particle particle,Sprite *sprite,int frame)
+{
+    Uint32 col,row;
+    float width,height;
+    if ((!sprite)||(!sprite->texture))return;
+    if (frame < 0)frame = 0;
+    width = sprite->texture->width;
+    height = sprite->texture->height;
+    col = sprite->framesPerLine ? frame % sprite->framesPerLine : 0;
+    row = sprite->framesPerLine ? frame / sprite->framesPerLine : 0;
+    gf3d_particle_draw_full(particle,sprite->texture,gfc_vector4d(
+        (sprite->atlasX + col * sprite->frameWidth) / width,
+        (sprite->atlasY + row * sprite->frameHeight) / height,
+        sprite->frameWidth / width,
+        sprite->frameHeight / height));
+}
+
+void gf3d_particle_trail_draw(GFC_Color color, float size, Uint8 count, GFC_Edge3D trail)
+{
+    Uint32 i;
+    Particle particle;
+    particle = gf3d_particle(trail.a,color,size);
+    for (i = 0; i < count; i++)
+    {
+        particle.position = gfc_vector3d_lerp(trail.a,trail.b,count > 1 ? i / (float)(count - 1) : 0);
+        gf3d_particle_draw(particle);
+    }
+}
+
+void gf3d_particle_draw_array(Particle *particle,Uint32 count)
+{
+    Uint32 i;
+    if (!particle)return;
+    for (i = 0; i < count; i++)
+    {
+        gf3d_particle_draw(particle[i]);
+    }
+}
+
+void gf3d_particle_draw_list(GFC_List *list)
+{
+    Uint32 i,c;
+    Particle *particle;
+    c = gfc_list_get_count(list);
+    for (i = 0; i < c; i++)
+    {
+        particle = gfc_list_get_nth(list,i);
+        if (!particle)continue;
+        gf3d_particle_draw(*particle);
+    }
+}
+
+Pipeline *gf3d_particle_get_pipeline()
+{
+    return gf3d_particle_manager.pipe;
+}
+
+void draw_guiding_lights(GFC_Vector3D position,GFC_Vector3D rotation,float width, float length)
+{
+    GFC_Vector3D forward,right,up;
+    GFC_Vector3D offset,end;
+    Uint8 count;
+
+    gfc_vector3d_angle_vectors(rotation,&forward,&right,&up);
+    count = (Uint8)MIN(MAX(length,2),255);
+    gfc_vector3d_scale(forward,forward,length);
+    gfc_vector3d_scale(offset,right,width * 0.5);
+    gfc_vector3d_add(end,position,forward);
+    gf3d_particle_trail_draw(GFC_COLOR_RED,1,count,gfc_edge3d_from_vectors(
+        gfc_vector3d(position.x - offset.x,position.y - offset.y,position.z - offset.z),
+        gfc_vector3d(end.x - offset.x,end.y - offset.y,end.z - offset.z)));
+    gf3d_particle_trail_draw(GFC_COLOR_GREEN,1,count,gfc_edge3d_from_vectors(
+        gfc_vector3d(position.x + offset.x,position.y + offset.y,position.z + offset.z),
+        gfc_vector3d(end.x + offset.x,end.y + offset.y,end.z + offset.z)));
+}
+
+/*
+ * emitters
+ */
+
+/**
+ * @brief a fast random number for spawn variance, so spawning does not contend on rand()
+ * @return a value from -1 to 1
+ */
+static float gf3d_particle_crandom(Uint32 *seed)
+{
+    Uint32 x = *seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+    return (x >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+ParticleEmitter *gf3d_particle_emitter_new(Uint32 maxParticles)
+{
+    Uint32 i,capacity;
+    float *data;
+    ParticleEmitter *emitter = NULL;
+
+    if (!maxParticles)
+    {
+        slog("cannot make a particle emitter for 0 particles");
+        return NULL;
+    }
+    for (i = 0; i < PARTICLE_MAX_EMITTERS; i++)
+    {
+        if (gf3d_particle_manager.emitterList[i]._inuse)continue;
+        emitter = &gf3d_particle_manager.emitterList[i];
+        break;
+    }
+    if (!emitter)
+    {
+        slog("no free particle emitter slots");
+        return NULL;
+    }
+    // a multiple of 4 keeps every array 16 byte aligned within the one allocation
+    capacity = (maxParticles + 3) & ~3;
+    data = gf3d_memory_alloc_array(MT_Particle,sizeof(float) * 8,capacity);
+    if (!data)
+    {
+        slog("failed to allocate particle emitter for %u particles",maxParticles);
+        return NULL;
+    }
+    memset(emitter,0,sizeof(ParticleEmitter));
+    emitter->_inuse = 1;
+    emitter->capacity = capacity;
+    emitter->px = data;
+    emitter->py = data + capacity;
+    emitter->pz = data + capacity * 2;
+    emitter->vx = data + capacity * 3;
+    emitter->vy = data + capacity * 4;
+    emitter->vz = data + capacity * 5;
+    emitter->age = data + capacity * 6;
+    emitter->invLife = data + capacity * 7;
+    emitter->lifetime = 1;
+    emitter->color = gfc_color(1,1,1,1);
+    emitter->color2 = gfc_color(1,1,1,0);
+    emitter->size = 1;
+    emitter->size2 = 1;
+    emitter->seed = 2463534242u + i;
+    return emitter;
+}
+
+void gf3d_particle_emitter_free(ParticleEmitter *emitter)
+{
+    if ((!emitter)||(!emitter->_inuse))return;
+    gf3d_memory_free(emitter->px);
+    memset(emitter,0,sizeof(ParticleEmitter));
+}
+
+void gf3d_particle_emitter_burst(ParticleEmitter *emitter,Uint32 count)
+{
+    Uint32 i,index;
+    float life;
+    if ((!emitter)||(!emitter->_inuse))return;
+    for (i = 0; i < count; i++)
+    {
+        if (emitter->count == emitter->capacity)
+        {
+            // full, the oldest makes way
+            emitter->tail = (emitter->tail + 1) % emitter->capacity;
+            emitter->count--;
+        }
+        index = (emitter->tail + emitter->count) % emitter->capacity;
+        emitter->count++;
+        emitter->px[index] = emitter->position.x + gf3d_particle_crandom(&emitter->seed) * emitter->spawnRadius;
+        emitter->py[index] = emitter->position.y + gf3d_particle_crandom(&emitter->seed) * emitter->spawnRadius;
+        emitter->pz[index] = emitter->position.z + gf3d_particle_crandom(&emitter->seed) * emitter->spawnRadius;
+        emitter->vx[index] = emitter->velocity.x + gf3d_particle_crandom(&emitter->seed) * emitter->velocityVariance.x;
+        emitter->vy[index] = emitter->velocity.y + gf3d_particle_crandom(&emitter->seed) * emitter->velocityVariance.y;
+        emitter->vz[index] = emitter->velocity.z + gf3d_particle_crandom(&emitter->seed) * emitter->velocityVariance.z;
+        emitter->age[index] = 0;
+        life = emitter->lifetime + gf3d_particle_crandom(&emitter->seed) * emitter->lifetimeVariance;
+        emitter->invLife[index] = life > 0.0001f ? 1.0f / life : 10000.0f;
+    }
+}
+
+static void gf3d_particle_integrate_one(ParticleEmitter *emitter,Uint32 i,float dt,float damping,float ax,float ay,float az)
+{
+    emitter->vx[i] = emitter->vx[i] * damping + ax;
+    emitter->vy[i] = emitter->vy[i] * damping + ay;
+    emitter->vz[i] = emitter->vz[i] * damping + az;
+    emitter->px[i] += emitter->vx[i] * dt;
+    emitter->py[i] += emitter->vy[i] * dt;
+    emitter->pz[i] += emitter->vz[i] * dt;
+    emitter->age[i] += dt;
+}
+
+/**
+ * @brief move a contiguous run of particles forward a step
+ */
+static void gf3d_particle_integrate(ParticleJob *job,Uint32 start,Uint32 end)
+{
+    Uint32 i = start;
+    ParticleEmitter *emitter = job->emitter;
+    float dt = job->dt,damping = job->damping;
+    float ax = emitter->acceleration.x * dt,ay = emitter->acceleration.y * dt,az = emitter->acceleration.z * dt;
+#ifdef GF3D_PARTICLE_SSE
+    __m128 vdt,vdamp,vax,vay,vaz,vx,vy,vz;
+    // one at a time up to a multiple of 4, where the arrays are 16 byte aligned
+    for (; (i < end)&&(i & 3); i++)
+    {
+        gf3d_particle_integrate_one(emitter,i,dt,damping,ax,ay,az);
+    }
+    vdt = _mm_set1_ps(dt);
+    vdamp = _mm_set1_ps(damping);
+    vax = _mm_set1_ps(ax);
+    vay = _mm_set1_ps(ay);
+    vaz = _mm_set1_ps(az);
+    for (; i + 4 <= end; i += 4)
+    {
+        vx = _mm_add_ps(_mm_mul_ps(_mm_load_ps(&emitter->vx[i]),vdamp),vax);
+        vy = _mm_add_ps(_mm_mul_ps(_mm_load_ps(&emitter->vy[i]),vdamp),vay);
+        vz = _mm_add_ps(_mm_mul_ps(_mm_load_ps(&emitter->vz[i]),vdamp),vaz);
+        _mm_store_ps(&emitter->vx[i],vx);
+        _mm_store_ps(&emitter->vy[i],vy);
+        _mm_store_ps(&emitter->vz[i],vz);
+        _mm_store_ps(&emitter->px[i],_mm_add_ps(_mm_load_ps(&emitter->px[i]),_mm_mul_ps(vx,vdt)));
+        _mm_store_ps(&emitter->py[i],_mm_add_ps(_mm_load_ps(&emitter->py[i]),_mm_mul_ps(vy,vdt)));
+        _mm_store_ps(&emitter->pz[i],_mm_add_ps(_mm_load_ps(&emitter->pz[i]),_mm_mul_ps(vz,vdt)));
+        _mm_store_ps(&emitter->age[i],_mm_add_ps(_mm_load_ps(&emitter->age[i]),vdt));
+    }
+#endif
+    for (; i < end; i++)
+    {
+        gf3d_particle_integrate_one(emitter,i,dt,damping,ax,ay,az);
+    }
+}
+
+static void gf3d_particle_write_one(ParticleJob *job,Uint32 i,ParticleInstance *out)
+{
+    float t;
+    ParticleEmitter *emitter = job->emitter;
+    t = emitter->age[i] * emitter->invLife[i];
+    out->position[0] = emitter->px[i];
+    out->position[1] = emitter->py[i];
+    out->position[2] = emitter->pz[i];
+    // particles that died out of order draw nothing until the tail passes them
+    out->size = t < 1 ? job->size + job->sizeDelta * t : 0;
+    if (t > 1)t = 1;
+    out->color[0] = job->color[0] + job->colorDelta[0] * t;
+    out->color[1] = job->color[1] + job->colorDelta[1] * t;
+    out->color[2] = job->color[2] + job->colorDelta[2] * t;
+    out->color[3] = job->color[3] + job->colorDelta[3] * t;
+}
+
+/**
+ * @brief write a contiguous run of particles as instances, fading their color and size by age
+ */
+static void gf3d_particle_write(ParticleJob *job,Uint32 start,Uint32 end,ParticleInstance *out)
+{
+    Uint32 i = start;
+#ifdef GF3D_PARTICLE_SSE
+    ParticleEmitter *emitter = job->emitter;
+    __m128 one,t,alive,x,y,z,s,r,g,b,a;
+    __m128 c0r,c0g,c0b,c0a,cdr,cdg,cdb,cda,s0,sd;
+    for (; (i < end)&&(i & 3); i++,out++)
+    {
+        gf3d_particle_write_one(job,i,out);
+    }
+    one = _mm_set1_ps(1);
+    c0r = _mm_set1_ps(job->color[0]);
+    c0g = _mm_set1_ps(job->color[1]);
+    c0b = _mm_set1_ps(job->color[2]);
+    c0a = _mm_set1_ps(job->color[3]);
+    cdr = _mm_set1_ps(job->colorDelta[0]);
+    cdg = _mm_set1_ps(job->colorDelta[1]);
+    cdb = _mm_set1_ps(job->colorDelta[2]);
+    cda = _mm_set1_ps(job->colorDelta[3]);
+    s0 = _mm_set1_ps(job->size);
+    sd = _mm_set1_ps(job->sizeDelta);
+    for (; i + 4 <= end; i += 4,out += 4)
+    {
+        t = _mm_mul_ps(_mm_load_ps(&emitter->age[i]),_mm_load_ps(&emitter->invLife[i]));
+        alive = _mm_cmplt_ps(t,one);
+        t = _mm_min_ps(t,one);
+        x = _mm_load_ps(&emitter->px[i]);
+        y = _mm_load_ps(&emitter->py[i]);
+        z = _mm_load_ps(&emitter->pz[i]);
+        s = _mm_and_ps(_mm_add_ps(s0,_mm_mul_ps(sd,t)),alive);
+        r = _mm_add_ps(c0r,_mm_mul_ps(cdr,t));
+        g = _mm_add_ps(c0g,_mm_mul_ps(cdg,t));
+        b = _mm_add_ps(c0b,_mm_mul_ps(cdb,t));
+        a = _mm_add_ps(c0a,_mm_mul_ps(cda,t));
+        // four particles of structure of arrays become four instances
+        _MM_TRANSPOSE4_PS(x,y,z,s);
+        _MM_TRANSPOSE4_PS(r,g,b,a);
+        _mm_storeu_ps(out[0].position,x);
+        _mm_storeu_ps(out[0].color,r);
+        _mm_storeu_ps(out[1].position,y);
+        _mm_storeu_ps(out[1].color,g);
+        _mm_storeu_ps(out[2].position,z);
+        _mm_storeu_ps(out[2].color,b);
+        _mm_storeu_ps(out[3].position,s);
+        _mm_storeu_ps(out[3].color,a);
+    }
+#endif
+    for (; i < end; i++,out++)
+    {
+        gf3d_particle_write_one(job,i,out);
+    }
+}
+
+/**
+ * @brief the part of the ring a job works on, as up to two contiguous runs
+ * @return how many runs, 0 if the job has nothing to do
+ */
+static Uint32 gf3d_particle_job_runs(ParticleJob *job,Uint32 jobIndex,Uint32 runs[2][2])
+{
+    Uint32 first,count,start,length;
+    ParticleEmitter *emitter = job->emitter;
+    first = jobIndex * PARTICLE_SLICE;
+    if (first >= job->count)return 0;
+    count = MIN(PARTICLE_SLICE,job->count - first);
+    start = (emitter->tail + first) % emitter->capacity;
+    length = MIN(count,emitter->capacity - start);
+    runs[0][0] = start;
+    runs[0][1] = start + length;
+    if (length == count)return 1;
+    runs[1][0] = 0;
+    runs[1][1] = count - length;
+    return 2;
+}
+
+static void gf3d_particle_integrate_job(void *data,Uint32 jobIndex,Uint32 threadIndex)
+{
+    Uint32 i,runCount,runs[2][2];
+    ParticleJob *job = (ParticleJob *)data;
+    runCount = gf3d_particle_job_runs(job,jobIndex,runs);
+    for (i = 0; i < runCount; i++)
+    {
+        gf3d_particle_integrate(job,runs[i][0],runs[i][1]);
+    }
+}
+
+static void gf3d_particle_write_job(void *data,Uint32 jobIndex,Uint32 threadIndex)
+{
+    Uint32 i,runCount,runs[2][2];
+    ParticleInstance *out;
+    ParticleJob *job = (ParticleJob *)data;
+    runCount = gf3d_particle_job_runs(job,jobIndex,runs);
+    out = job->instances + jobIndex * PARTICLE_SLICE;
+    for (i = 0; i < runCount; i++)
+    {
+        gf3d_particle_write(job,runs[i][0],runs[i][1],out);
+        out += runs[i][1] - runs[i][0];
+    }
+}
+
+void gf3d_particle_emitter_update(ParticleEmitter *emitter,float dt)
+{
+    Uint32 spawn;
+    ParticleJob job = {0};
+
+    if ((!emitter)||(!emitter->_inuse)||(dt <= 0))return;
+    if (emitter->count)
+    {
+        job.emitter = emitter;
+        job.count = emitter->count;
+        job.dt = dt;
+        job.damping = MAX(0,1 - emitter->drag * dt);
+        gf3d_jobs_dispatch((emitter->count + PARTICLE_SLICE - 1) / PARTICLE_SLICE,gf3d_particle_integrate_job,&job);
+    }
+    // lifetimes vary, so only retire from the tail while the oldest are dead
+    while ((emitter->count)&&(emitter->age[emitter->tail] * emitter->invLife[emitter->tail] >= 1))
+    {
+        emitter->tail = (emitter->tail + 1) % emitter->capacity;
+        emitter->count--;
+    }
+    emitter->spawnDebt += emitter->rate * dt;
+    spawn = (Uint32)emitter->spawnDebt;
+    emitter->spawnDebt -= spawn;
+    gf3d_particle_emitter_burst(emitter,spawn);
+}
+
+void gf3d_particle_emitter_draw(ParticleEmitter *emitter)
+{
+    Uint32 count,first;
+    ParticleJob job = {0};
+    Texture *texture;
+
+    if ((!emitter)||(!emitter->_inuse)||(!emitter->count))return;
+    // keep the emitter's instances out of the open batch's run
+    gf3d_particle_submit_pipe_commands();
+    count = gf3d_particle_instances_reserve(emitter->count,&first);
+    if (!count)return;
+    job.emitter = emitter;
+    job.count = count;
+    job.instances = gf3d_particle_manager.instances[gf3d_vgraphics_get_current_buffer_frame()] + first;
+    job.color[0] = emitter->color.r;
+    job.color[1] = emitter->color.g;
+    job.color[2] = emitter->color.b;
+    job.color[3] = emitter->color.a;
+    job.colorDelta[0] = emitter->color2.r - emitter->color.r;
+    job.colorDelta[1] = emitter->color2.g - emitter->color.g;
+    job.colorDelta[2] = emitter->color2.b - emitter->color.b;
+    job.colorDelta[3] = emitter->color2.a - emitter->color.a;
+    job.size = emitter->size;
+    job.sizeDelta = emitter->size2 - emitter->size;
+    // when the buffer is short, the oldest particles are the ones written
+    gf3d_jobs_dispatch((count + PARTICLE_SLICE - 1) / PARTICLE_SLICE,gf3d_particle_write_job,&job);
+    texture = emitter->texture ? emitter->texture : gf3d_particle_manager.defaultTexture;
+    gf3d_particle_queue_instances(first,count,texture,gfc_vector4d(0,0,1,1));
+}
+
+void gf3d_particle_emitters_update(float dt)
+{
+    Uint32 i;
+    for (i = 0; i < PARTICLE_MAX_EMITTERS; i++)
+    {
+        if (!gf3d_particle_manager.emitterList[i]._inuse)continue;
+        gf3d_particle_emitter_update(&gf3d_particle_manager.emitterList[i],dt);
+    }
+}
+
+void gf3d_particle_emitters_draw()
+{
+    Uint32 i;
+    for (i = 0; i < PARTICLE_MAX_EMITTERS; i++)
+    {
+        if (!gf3d_particle_manager.emitterList[i]._inuse)continue;
+        gf3d_particle_emitter_draw(&gf3d_particle_manager.emitterList[i]);
+    }
+}
+
+VkVertexInputBindingDescription *gf3d_particle_get_bind_description()
+{
+    gf3d_particle_manager.bindingDescription.binding = 0;
+    gf3d_particle_manager.bindingDescription.stride = sizeof(ParticleInstance);
+    gf3d_particle_manager.bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    return &gf3d_particle_manager.bindingDescription;
+}
+
+VkVertexInputAttributeDescription *gf3d_particle_get_attribute_descriptions(Uint32 *count)
+{
+    gf3d_particle_manager.attributeDescriptions[0].binding = 0;
+    gf3d_particle_manager.attributeDescriptions[0].location = 0;
+    gf3d_particle_manager.attributeDescriptions[0].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    gf3d_particle_manager.attributeDescriptions[0].offset = offsetof(ParticleInstance,position);
+
+    gf3d_particle_manager.attributeDescriptions[1].binding = 0;
+    gf3d_particle_manager.attributeDescriptions[1].location = 1;
+    gf3d_particle_manager.attributeDescriptions[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    gf3d_particle_manager.attributeDescriptions[1].offset = offsetof(ParticleInstance,color);
+    if (count)*count = PARTICLE_ATTRIBUTE_COUNT;
+    return gf3d_particle_manager.attributeDescriptions;
+}
+
+/*eol@eof*/
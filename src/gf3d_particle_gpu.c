@@ -0,0 +1,465 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "simple_logger.h"
+
+#include "gfc_types.h"
+
+#include "gf3d_buffers.h"
+#include "gf3d_memory.h"
+#include "gf3d_device.h"
+#include "gf3d_vqueues.h"
+#include "gf3d_vgraphics.h"
+#include "gf3d_commands.h"
+#include "gf3d_pipeline.h"
+#include "gf3d_gpu_timer.h"
+#include "gf3d_profiler.h"
+#include "gf3d_particle.h"
+#include "gf3d_particle_gpu.h"
+
+#define PARTICLE_GPU_MAX_EMITTERS 16
+#define PARTICLE_GPU_GROUP_SIZE 256         /**<local_size_x of the compute shaders*/
+#define PARTICLE_GPU_BINDINGS 4             /**<particles, indices, counters, instances*/
+
+extern int __DEBUG;
+
+/**
+ * layouts shared with shaders/particle_emit.comp and shaders/particle_update.comp
+ */
+typedef struct
+{
+    float   position[3];
+    float   age;
+    float   velocity[3];
+    float   invLife;
+}GpuParticle;
+
+typedef struct
+{
+    VkDrawIndirectCommand   draw[2];    /**<one per alive list, its instanceCount is the list's length*/
+    Sint32                  freeCount;  /**<entries on the free list*/
+    Uint32                  padding[3];
+}GpuParticleCounters;
+
+/**
+ * @brief the push constants for both passes, 128 bytes is all the device has to give
+ */
+typedef struct
+{
+    float   position[4];            /**<xyz and the spawn radius*/
+    float   velocity[4];            /**<xyz and the lifetime*/
+    float   velocityVariance[4];    /**<xyz and the lifetime variance*/
+    float   acceleration[4];        /**<xyz and the drag*/
+    float   color[4];
+    float   color2[4];
+    float   size;
+    float   size2;
+    float   dt;
+    Uint32  emitCount;
+    Uint32  seed;
+    Uint32  capacity;
+    Uint32  parity;
+    Uint32  padding;
+}GpuParticlePush;
+
+typedef struct
+{
+    Bool                enabled;
+    VkDevice            device;
+    Pipeline           *emitPipe;
+    Pipeline           *updatePipe;
+    Uint32              maxParticles;       /**<the most one dispatch can cover*/
+    GpuParticleEmitter  emitterList[PARTICLE_GPU_MAX_EMITTERS];
+}GpuParticleManager;
+
+static GpuParticleManager gf3d_particle_gpu = {0};
+
+void gf3d_particle_gpu_close()
+{
+    Uint32 i;
+    for (i = 0; i < PARTICLE_GPU_MAX_EMITTERS; i++)
+    {
+        gf3d_particle_gpu_emitter_free(&gf3d_particle_gpu.emitterList[i]);
+    }
+    gf3d_pipeline_free(gf3d_particle_gpu.emitPipe);
+    gf3d_pipeline_free(gf3d_particle_gpu.updatePipe);
+    memset(&gf3d_particle_gpu,0,sizeof(GpuParticleManager));
+    if (__DEBUG)slog("gpu particles closed");
+}
+
+void gf3d_particle_gpu_init()
+{
+    Uint64 maxParticles;
+    GF3D_Device *gpu;
+
+    gf3d_particle_gpu.device = gf3d_vgraphics_get_default_logical_device();
+    atexit(gf3d_particle_gpu_close);
+    gpu = gf3d_device_get_chosen_gpu_info();
+    if ((!gpu)||(!gf3d_vqueues_graphics_supports_compute()))
+    {
+        slog("graphics queue does not support compute, gpu particles disabled");
+        return;
+    }
+    // drivers often report 2^31-1 groups, so this is done in 64 bits.  The index buffer holds three lists and
+    // the shaders index every buffer with 32 bit uints, one storage buffer binding can only cover so much
+    maxParticles = (Uint64)gpu->deviceProperties.limits.maxComputeWorkGroupCount[0] * PARTICLE_GPU_GROUP_SIZE;
+    maxParticles = MIN(maxParticles,UINT32_MAX / 3);
+    maxParticles = MIN(maxParticles,gpu->deviceProperties.limits.maxStorageBufferRange / (sizeof(float) * 8));
+    gf3d_particle_gpu.maxParticles = (Uint32)maxParticles;
+    gf3d_particle_gpu.emitPipe = gf3d_pipeline_compute_create_from_config(
+        gf3d_particle_gpu.device,
+        "config/particle_emit_pipeline.cfg",
+        PARTICLE_GPU_MAX_EMITTERS);
+    gf3d_particle_gpu.updatePipe = gf3d_pipeline_compute_create_from_config(
+        gf3d_particle_gpu.device,
+        "config/particle_update_pipeline.cfg",
+        PARTICLE_GPU_MAX_EMITTERS);
+    if ((!gf3d_particle_gpu.emitPipe)||(!gf3d_particle_gpu.updatePipe))
+    {
+        slog("failed to create the particle compute pipelines, gpu particles disabled");
+        return;
+    }
+    if ((gf3d_particle_gpu.emitPipe->pushConstantSize < sizeof(GpuParticlePush))||(gf3d_particle_gpu.updatePipe->pushConstantSize < sizeof(GpuParticlePush)))
+    {
+        slog("particle compute pipelines need %u bytes of push constants, gpu particles disabled",(Uint32)sizeof(GpuParticlePush));
+        return;
+    }
+    gf3d_particle_gpu.enabled = true;
+    if (__DEBUG)slog("gpu particles initialized");
+}
+
+Bool gf3d_particle_gpu_enabled()
+{
+    return gf3d_particle_gpu.enabled;
+}
+
+/**
+ * @brief make a mapped staging buffer to fill before gf3d_particle_gpu_staging_end copies it
+ * @return NULL on error, the mapped memory otherwise
+ */
+static void *gf3d_particle_gpu_staging_begin(VkDeviceSize size,VkBuffer *buffer,VkDeviceMemory *memory)
+{
+    void *data = NULL;
+    if (!gf3d_buffer_create(size,VK_BUFFER_USAGE_TRANSFER_SRC_BIT,VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,buffer,memory,MT_Staging))
+    {
+        slog("failed to create staging buffer for gpu particles");
+        return NULL;
+    }
+    if (vkMapMemory(gf3d_particle_gpu.device,*memory,0,size,0,&data) != VK_SUCCESS)
+    {
+        slog("failed to map staging buffer for gpu particles");
+        vkDestroyBuffer(gf3d_particle_gpu.device,*buffer,NULL);
+        gf3d_memory_vk_free(gf3d_particle_gpu.device,*memory);
+        return NULL;
+    }
+    return data;
+}
+
+static void gf3d_particle_gpu_staging_end(VkBuffer dst,VkDeviceSize size,VkBuffer buffer,VkDeviceMemory memory)
+{
+    vkUnmapMemory(gf3d_particle_gpu.device,memory);
+    gf3d_buffer_copy(buffer,dst,size);
+    vkDestroyBuffer(gf3d_particle_gpu.device,buffer,NULL);
+    gf3d_memory_vk_free(gf3d_particle_gpu.device,memory);
+}
+
+/**
+ * @brief every slot starts on the free list and both alive lists start empty
+ */
+static int gf3d_particle_gpu_emitter_reset(GpuParticleEmitter *emitter)
+{
+    Uint32 i;
+    Uint32 *freeList;
+    GpuParticleCounters *counters;
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingMemory;
+
+    freeList = gf3d_particle_gpu_staging_begin(sizeof(Uint32) * emitter->capacity,&stagingBuffer,&stagingMemory);
+    if (!freeList)return 0;
+    // popped from the end, so the first particles take the first slots
+    for (i = 0; i < emitter->capacity; i++)
+    {
+        freeList[i] = emitter->capacity - 1 - i;
+    }
+    gf3d_particle_gpu_staging_end(emitter->indexBuffer,sizeof(Uint32) * emitter->capacity,stagingBuffer,stagingMemory);
+
+    counters = gf3d_particle_gpu_staging_begin(sizeof(GpuParticleCounters),&stagingBuffer,&stagingMemory);
+    if (!counters)return 0;
+    memset(counters,0,sizeof(GpuParticleCounters));
+    // the vertex shader makes each quad's two triangles from the vertex index
+    counters->draw[0].vertexCount = 6;
+    counters->draw[1].vertexCount = 6;
+    counters->freeCount = emitter->capacity;
+    gf3d_particle_gpu_staging_end(emitter->counterBuffer,sizeof(GpuParticleCounters),stagingBuffer,stagingMemory);
+    return 1;
+}
+
+GpuParticleEmitter *gf3d_particle_gpu_emitter_new(Uint32 maxParticles)
+{
+    Uint32 i;
+    GpuParticleEmitter *emitter = NULL;
+    VkMemoryPropertyFlags local = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    if (!gf3d_particle_gpu.enabled)
+    {
+        slog("gpu particles are not available");
+        return NULL;
+    }
+    if (!maxParticles)
+    {
+        slog("cannot make a gpu particle emitter for 0 particles");
+        return NULL;
+    }
+    if (maxParticles > gf3d_particle_gpu.maxParticles)
+    {
+        slog("gpu particle emitter for %u particles is too big, clamping to %u",maxParticles,gf3d_particle_gpu.maxParticles);
+        maxParticles = gf3d_particle_gpu.maxParticles;
+    }
+    for (i = 0; i < PARTICLE_GPU_MAX_EMITTERS; i++)
+    {
+        if (gf3d_particle_gpu.emitterList[i]._inuse)continue;
+        emitter = &gf3d_particle_gpu.emitterList[i];
+        break;
+    }
+    if (!emitter)
+    {
+        slog("no free gpu particle emitter slots");
+        return NULL;
+    }
+    memset(emitter,0,sizeof(GpuParticleEmitter));
+    emitter->_inuse = 1;
+    emitter->capacity = maxParticles;
+    if ((!gf3d_buffer_create(sizeof(GpuParticle) * maxParticles,VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,local,&emitter->particleBuffer,&emitter->particleMemory,MT_Particle))||
+        (!gf3d_buffer_create(sizeof(Uint32) * maxParticles * 3,VK_BUFFER_USAGE_STORAGE_BUFFER_BIT|VK_BUFFER_USAGE_TRANSFER_DST_BIT,local,&emitter->indexBuffer,&emitter->indexMemory,MT_Particle))||
+        (!gf3d_buffer_create(sizeof(GpuParticleCounters),VK_BUFFER_USAGE_STORAGE_BUFFER_BIT|VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT|VK_BUFFER_USAGE_TRANSFER_DST_BIT,local,&emitter->counterBuffer,&emitter->counterMemory,MT_Particle))||
+        (!gf3d_buffer_create(sizeof(float) * 8 * maxParticles,VK_BUFFER_USAGE_STORAGE_BUFFER_BIT|VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,local,&emitter->instanceBuffer,&emitter->instanceMemory,MT_Particle))||
+        (!gf3d_particle_gpu_emitter_reset(emitter)))
+    {
+        slog("failed to create buffers for a gpu particle emitter of %u particles",maxParticles);
+        gf3d_particle_gpu_emitter_free(emitter);
+        return NULL;
+    }
+    emitter->lifetime = 1;
+    emitter->color = gfc_color(1,1,1,1);
+    emitter->color2 = gfc_color(1,1,1,0);
+    emitter->size = 1;
+    emitter->size2 = 1;
+    emitter->seed = 2463534242u + i;
+    return emitter;
+}
+
+void gf3d_particle_gpu_emitter_free(GpuParticleEmitter *emitter)
+{
+    VkDevice device = gf3d_particle_gpu.device;
+    if ((!emitter)||(!emitter->_inuse))return;
+    // the frame's graphics submission may still be drawing from the counter and instance buffers
+    if (device != VK_NULL_HANDLE)vkDeviceWaitIdle(device);
+    if (emitter->particleBuffer != VK_NULL_HANDLE)vkDestroyBuffer(device,emitter->particleBuffer,NULL);
+    if (emitter->indexBuffer != VK_NULL_HANDLE)vkDestroyBuffer(device,emitter->indexBuffer,NULL);
+    if (emitter->counterBuffer != VK_NULL_HANDLE)vkDestroyBuffer(device,emitter->counterBuffer,NULL);
+    if (emitter->instanceBuffer != VK_NULL_HANDLE)vkDestroyBuffer(device,emitter->instanceBuffer,NULL);
+    if (emitter->particleMemory != VK_NULL_HANDLE)gf3d_memory_vk_free(device,emitter->particleMemory);
+    if (emitter->indexMemory != VK_NULL_HANDLE)gf3d_memory_vk_free(device,emitter->indexMemory);
+    if (emitter->counterMemory != VK_NULL_HANDLE)gf3d_memory_vk_free(device,emitter->counterMemory);
+    if (emitter->instanceMemory != VK_NULL_HANDLE)gf3d_memory_vk_free(device,emitter->instanceMemory);
+    memset(emitter,0,sizeof(GpuParticleEmitter));
+}
+
+void gf3d_particle_gpu_emitter_burst(GpuParticleEmitter *emitter,Uint32 count)
+{
+    if ((!emitter)||(!emitter->_inuse))return;
+    emitter->pendingEmit = MIN(emitter->pendingEmit + count,emitter->capacity);
+}
+
+void gf3d_particle_gpu_emitter_update(GpuParticleEmitter *emitter,float dt)
+{
+    Uint32 spawn;
+    if ((!emitter)||(!emitter->_inuse)||(dt <= 0))return;
+    // steps between frames are simulated as one, only the time adds up
+    emitter->pendingTime += dt;
+    emitter->spawnDebt += emitter->rate * dt;
+    spawn = (Uint32)emitter->spawnDebt;
+    emitter->spawnDebt -= spawn;
+    gf3d_particle_gpu_emitter_burst(emitter,spawn);
+}
+
+void gf3d_particle_gpu_emitter_draw(GpuParticleEmitter *emitter)
+{
+    if ((!emitter)||(!emitter->_inuse)||(!gf3d_particle_gpu.enabled))return;
+    // this frame's dispatch writes the list the current one is not
+    gf3d_particle_queue_indirect(
+        emitter->instanceBuffer,
+        emitter->counterBuffer,
+        sizeof(VkDrawIndirectCommand) * (emitter->parity ^ 1),
+        emitter->texture);
+}
+
+void gf3d_particle_gpu_emitters_update(float dt)
+{
+    Uint32 i;
+    for (i = 0; i < PARTICLE_GPU_MAX_EMITTERS; i++)
+    {
+        if (!gf3d_particle_gpu.emitterList[i]._inuse)continue;
+        gf3d_particle_gpu_emitter_update(&gf3d_particle_gpu.emitterList[i],dt);
+    }
+}
+
+void gf3d_particle_gpu_emitters_draw()
+{
+    Uint32 i;
+    for (i = 0; i < PARTICLE_GPU_MAX_EMITTERS; i++)
+    {
+        if (!gf3d_particle_gpu.emitterList[i]._inuse)continue;
+        gf3d_particle_gpu_emitter_draw(&gf3d_particle_gpu.emitterList[i]);
+    }
+}
+
+static void gf3d_particle_gpu_push_constants(GpuParticleEmitter *emitter,GpuParticlePush *push)
+{
+    push->position[0] = emitter->position.x;
+    push->position[1] = emitter->position.y;
+    push->position[2] = emitter->position.z;
+    push->position[3] = emitter->spawnRadius;
+    push->velocity[0] = emitter->velocity.x;
+    push->velocity[1] = emitter->velocity.y;
+    push->velocity[2] = emitter->velocity.z;
+    push->velocity[3] = emitter->lifetime;
+    push->velocityVariance[0] = emitter->velocityVariance.x;
+    push->velocityVariance[1] = emitter->velocityVariance.y;
+    push->velocityVariance[2] = emitter->velocityVariance.z;
+    push->velocityVariance[3] = emitter->lifetimeVariance;
+    push->acceleration[0] = emitter->acceleration.x;
+    push->acceleration[1] = emitter->acceleration.y;
+    push->acceleration[2] = emitter->acceleration.z;
+    push->acceleration[3] = emitter->drag;
+    push->color[0] = emitter->color.r;
+    push->color[1] = emitter->color.g;
+    push->color[2] = emitter->color.b;
+    push->color[3] = emitter->color.a;
+    push->color2[0] = emitter->color2.r;
+    push->color2[1] = emitter->color2.g;
+    push->color2[2] = emitter->color2.b;
+    push->color2[3] = emitter->color2.a;
+    push->size = emitter->size;
+    push->size2 = emitter->size2;
+    push->dt = emitter->pendingTime;
+    push->emitCount = emitter->pendingEmit;
+    push->seed = emitter->seed;
+    push->capacity = emitter->capacity;
+    push->parity = emitter->parity;
+}
+
+/**
+ * @brief take a descriptor set from a compute pipe for this frame and point it at an emitter's buffers
+ */
+static VkDescriptorSet *gf3d_particle_gpu_descriptor_set(Pipeline *pipe,GpuParticleEmitter *emitter)
+{
+    VkDescriptorSet *descriptorSet;
+    VkDescriptorBufferInfo buffers[PARTICLE_GPU_BINDINGS] = {0};
+
+    descriptorSet = gf3d_pipeline_get_descriptor_set(pipe,gf3d_vgraphics_get_current_buffer_frame());
+    if (!descriptorSet)return NULL;
+    buffers[0].buffer = emitter->particleBuffer;
+    buffers[1].buffer = emitter->indexBuffer;
+    buffers[2].buffer = emitter->counterBuffer;
+    buffers[3].buffer = emitter->instanceBuffer;
+    buffers[0].range = buffers[1].range = buffers[2].range = buffers[3].range = VK_WHOLE_SIZE;
+    gf3d_pipeline_write_storage_buffers(pipe,descriptorSet,buffers,PARTICLE_GPU_BINDINGS);
+    return descriptorSet;
+}
+
+static void gf3d_particle_gpu_barrier(VkCommandBuffer commandBuffer,VkPipelineStageFlags srcStage,VkAccessFlags srcAccess,VkPipelineStageFlags dstStage,VkAccessFlags dstAccess)
+{
+    VkMemoryBarrier barrier = {0};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(commandBuffer,srcStage,dstStage,0,1,&barrier,0,NULL,0,NULL);
+}
+
+void gf3d_particle_gpu_dispatch()
+{
+    Uint32 i,zone;
+    Uint32 emitters[PARTICLE_GPU_MAX_EMITTERS];
+    Uint32 emitterCount = 0;
+    GpuParticleEmitter *emitter;
+    GpuParticlePush push[PARTICLE_GPU_MAX_EMITTERS];
+    VkDescriptorSet *emitSets[PARTICLE_GPU_MAX_EMITTERS];
+    VkDescriptorSet *updateSets[PARTICLE_GPU_MAX_EMITTERS];
+    VkCommandBuffer commandBuffer;
+
+    if (!gf3d_particle_gpu.enabled)return;
+    for (i = 0; i < PARTICLE_GPU_MAX_EMITTERS; i++)
+    {
+        if (!gf3d_particle_gpu.emitterList[i]._inuse)continue;
+        emitters[emitterCount++] = i;
+    }
+    if (!emitterCount)return;
+    GF3D_PROFILE_BEGIN("gpu_particles");
+    memset(push,0,sizeof(push));
+    for (i = 0; i < emitterCount; i++)
+    {
+        emitter = &gf3d_particle_gpu.emitterList[emitters[i]];
+        gf3d_particle_gpu_push_constants(emitter,&push[i]);
+        emitSets[i] = emitter->pendingEmit ? gf3d_particle_gpu_descriptor_set(gf3d_particle_gpu.emitPipe,emitter) : NULL;
+        updateSets[i] = gf3d_particle_gpu_descriptor_set(gf3d_particle_gpu.updatePipe,emitter);
+    }
+
+    commandBuffer = gf3d_command_begin_single_time(gf3d_vgraphics_get_graphics_command_pool());
+    gf3d_gpu_timer_buffer_begin(commandBuffer);
+    zone = gf3d_gpu_timer_begin(commandBuffer,"gpu_particles");
+    // the list each emitter is about to write starts empty
+    for (i = 0; i < emitterCount; i++)
+    {
+        emitter = &gf3d_particle_gpu.emitterList[emitters[i]];
+        vkCmdFillBuffer(
+            commandBuffer,
+            emitter->counterBuffer,
+            sizeof(VkDrawIndirectCommand) * (emitter->parity ^ 1) + offsetof(VkDrawIndirectCommand,instanceCount),
+            sizeof(Uint32),
+            0);
+    }
+    gf3d_particle_gpu_barrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,VK_ACCESS_SHADER_READ_BIT|VK_ACCESS_SHADER_WRITE_BIT);
+    // emit: pop free slots and append them to the list being read
+    for (i = 0; i < emitterCount; i++)
+    {
+        if (!emitSets[i])continue;
+        gf3d_pipeline_dispatch(commandBuffer,gf3d_particle_gpu.emitPipe,emitSets[i],&push[i],(push[i].emitCount + PARTICLE_GPU_GROUP_SIZE - 1) / PARTICLE_GPU_GROUP_SIZE);
+    }
+    gf3d_particle_gpu_barrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,VK_ACCESS_SHADER_READ_BIT|VK_ACCESS_SHADER_WRITE_BIT);
+    // update: move the live, free the dead and compact the rest into the other list and the instances
+    // the live count stays on the gpu, so the dispatch covers the whole emitter and the extra threads exit early
+    for (i = 0; i < emitterCount; i++)
+    {
+        gf3d_pipeline_dispatch(commandBuffer,gf3d_particle_gpu.updatePipe,updateSets[i],&push[i],(push[i].capacity + PARTICLE_GPU_GROUP_SIZE - 1) / PARTICLE_GPU_GROUP_SIZE);
+    }
+    // the draws read the counts and instances, the next frame's passes read and clear the rest
+    gf3d_particle_gpu_barrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT|VK_PIPELINE_STAGE_VERTEX_INPUT_BIT|VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT|VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_INDIRECT_COMMAND_READ_BIT|VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT|VK_ACCESS_SHADER_READ_BIT|VK_ACCESS_SHADER_WRITE_BIT|VK_ACCESS_TRANSFER_WRITE_BIT);
+    gf3d_gpu_timer_end(commandBuffer,zone);
+    gf3d_gpu_timer_buffer_end(commandBuffer);
+    gf3d_command_end_single_time(gf3d_vgraphics_get_graphics_command_pool(),commandBuffer);
+
+    for (i = 0; i < emitterCount; i++)
+    {
+        emitter = &gf3d_particle_gpu.emitterList[emitters[i]];
+        emitter->parity ^= 1;
+        emitter->pendingEmit = 0;
+        emitter->pendingTime = 0;
+        // a new stream of random numbers for the next dispatch
+        emitter->seed = emitter->seed * 1664525u + 1013904223u;
+    }
+    GF3D_PROFILE_END();
+}
+
+/*eol@eof*/
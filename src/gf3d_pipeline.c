@@ -10,7 +10,17 @@
 #include "gf3d_swapchain.h"
 #include "gf3d_vgraphics.h"
 #include "gf3d_shaders.h"
+#include "gf3d_commands.h"
+#include "gf3d_jobs.h"
+#include "gf3d_arena.h"
+#include "gf3d_memory.h"
+#include "gf3d_sampler.h"
 #include "gf3d_pipeline.h"
+#include "gf3d_profiler.h"
+#include "gf3d_render_stats.h"
+#include "gf3d_log.h"
+
+#define GF3D_PIPELINE_MIN_SLICE_DRAWS 64  /**<below this many draws per slice, splitting the draw list costs more than it saves*/
 
 extern int __DEBUG;
 
@@ -19,10 +29,18 @@ typedef struct
     Uint32              maxPipelines;
     Pipeline           *pipelineList;
     Uint32              chainLength;
+    PipelineFrameStats  frameStats;     /**<gathered while submitting the frame*/
 }PipelineManager;
 
 static PipelineManager gf3d_pipeline = {0};
 
+typedef struct
+{
+    Pipeline   *pipe;
+    Uint32      frame;
+    Uint32      sliceCount;
+}PipelineRecordJob;
+
 void gf3d_pipeline_close();
 void gf3d_pipeline_create_basic_descriptor_pool(Pipeline *pipe,VkDescriptorPoolSize *poolSize,int poolSizeCount);
 void gf3d_pipeline_create_basic_descriptor_pool_from_config(Pipeline *pipe,SJson *config);
@@ -37,7 +55,7 @@ void gf3d_pipeline_init(Uint32 max_pipelines)
         slog("cannot initialize zero pipelines");
         return;
     }
-    gf3d_pipeline.pipelineList = (Pipeline *)gfc_allocate_array(sizeof(Pipeline),max_pipelines);
+    gf3d_pipeline.pipelineList = (Pipeline *)gf3d_memory_alloc_array(MT_Pipeline,sizeof(Pipeline),max_pipelines);
     if (!gf3d_pipeline.pipelineList)
     {
         slog("failed to allocate pipeline manager");
@@ -58,43 +76,77 @@ void gf3d_pipeline_close()
         {
             gf3d_pipeline_free(&gf3d_pipeline.pipelineList[i]);
         }
-        free(gf3d_pipeline.pipelineList);
+        gf3d_memory_free(gf3d_pipeline.pipelineList);
     }
     memset(&gf3d_pipeline,0,sizeof(PipelineManager));
     if (__DEBUG)slog("pipeline system closed");
 }
 
-void gf3d_pipeline_call_render(
+void gf3d_pipeline_call_render_to(
+    VkCommandBuffer commandBuffer,
     Pipeline *pipe,
     VkDescriptorSet * descriptorSet,
     VkBuffer vertexBuffer,
     Uint32 vertexCount,
-    VkBuffer indexBuffer)
+    Uint32 firstIndex,
+    VkBuffer indexBuffer,
+    Uint32 instanceCount,
+    Uint32 firstInstance)
 {
     VkDeviceSize offsets[] = {0};
     if ((!pipe)||(!descriptorSet))return;
-    vkCmdBindVertexBuffers(pipe->commandBuffer, 0, 1, &vertexBuffer, offsets);
-    if (indexBuffer != VK_NULL_HANDLE)vkCmdBindIndexBuffer(pipe->commandBuffer, indexBuffer, 0, pipe->indexType);
-    vkCmdBindDescriptorSets(pipe->commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipe->pipelineLayout, 0, 1, descriptorSet, 0, NULL);
-    if (indexBuffer != VK_NULL_HANDLE)vkCmdDrawIndexed(pipe->commandBuffer, vertexCount, 1, 0, 0, 0);
-    else vkCmdDraw(pipe->commandBuffer, vertexCount,1,0,0);
+    if (!instanceCount)instanceCount = 1;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
+    if (indexBuffer != VK_NULL_HANDLE)vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, pipe->indexType);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipe->pipelineLayout, 0, 1, descriptorSet, 0, NULL);
+    if (indexBuffer != VK_NULL_HANDLE)vkCmdDrawIndexed(commandBuffer, vertexCount, instanceCount, firstIndex, 0, firstInstance);
+    else vkCmdDraw(commandBuffer, vertexCount,instanceCount,0,firstInstance);
 }
 
-void gf3d_pipeline_update_descriptor_set(Pipeline *pipe, PipelineDrawCall *drawCall)
+void gf3d_pipeline_call_render_indirect_to(
+    VkCommandBuffer commandBuffer,
+    Pipeline *pipe,
+    VkDescriptorSet * descriptorSet,
+    VkBuffer vertexBuffer,
+    VkBuffer indirectBuffer,
+    VkDeviceSize indirectOffset)
 {
-    int count = 1;
-    int frame;
-    UniformBuffer *buffer;
-    VkDescriptorImageInfo imageInfo = {0};
-    VkWriteDescriptorSet descriptorWrite[2] = {0};
-    VkDescriptorBufferInfo bufferInfo = {0};
-    if ((!pipe)||(!drawCall))return;    
+    VkDeviceSize offsets[] = {0};
+    if ((!pipe)||(!descriptorSet))return;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipe->pipelineLayout, 0, 1, descriptorSet, 0, NULL);
+    vkCmdDrawIndirect(commandBuffer, indirectBuffer, indirectOffset, 1, sizeof(VkDrawIndirectCommand));
+}
 
-    frame = gf3d_vgraphics_get_current_buffer_frame();
-    buffer = gf3d_uniform_buffer_list_get_nth_buffer(pipe->uboBigBuffer, 0, frame);
-    bufferInfo.buffer = buffer->uniformBuffer;
-    bufferInfo.offset = drawCall->index * pipe->uboDataSize;
-    bufferInfo.range = pipe->uboDataSize;
+void gf3d_pipeline_call_render(
+    Pipeline *pipe,
+    VkDescriptorSet * descriptorSet,
+    VkBuffer vertexBuffer,
+    Uint32 vertexCount,
+    VkBuffer indexBuffer)
+{
+    if (!pipe)return;
+    gf3d_pipeline_call_render_to(pipe->commandBuffer,pipe,descriptorSet,vertexBuffer,vertexCount,0,indexBuffer,1,0);
+}
+
+/**
+ * @brief fill in the descriptor writes for a draw call's ubo and texture
+ * @param descriptorWrite room for two writes
+ * @param bufferInfo where the ubo write points
+ * @param imageInfo where the texture write points
+ * @return how many writes were filled in
+ */
+static Uint32 gf3d_pipeline_fill_descriptor_writes(
+    Pipeline *pipe,
+    PipelineDrawCall *drawCall,
+    UniformBuffer *buffer,
+    VkWriteDescriptorSet *descriptorWrite,
+    VkDescriptorBufferInfo *bufferInfo,
+    VkDescriptorImageInfo *imageInfo)
+{
+    bufferInfo->buffer = buffer->uniformBuffer;
+    bufferInfo->offset = drawCall->index * pipe->uboDataSize;
+    bufferInfo->range = pipe->uboDataSize;
 
     descriptorWrite[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptorWrite[0].dstSet = *(drawCall->descriptorSet);
@@ -102,57 +154,155 @@ void gf3d_pipeline_update_descriptor_set(Pipeline *pipe, PipelineDrawCall *drawC
     descriptorWrite[0].dstArrayElement = 0;
     descriptorWrite[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     descriptorWrite[0].descriptorCount = 1;
-    descriptorWrite[0].pBufferInfo = &bufferInfo;
-
-    if (drawCall->texture)
-    {
-        count = 2;
-        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfo.imageView = drawCall->texture->textureImageView;
-        imageInfo.sampler = drawCall->texture->textureSampler;
-        descriptorWrite[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrite[1].dstSet = *drawCall->descriptorSet;
-        descriptorWrite[1].dstBinding = 1;
-        descriptorWrite[1].dstArrayElement = 0;
-        descriptorWrite[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorWrite[1].descriptorCount = 1;                        
-        descriptorWrite[1].pImageInfo = &imageInfo;
-        descriptorWrite[1].pTexelBufferView = NULL; // Optional
+    descriptorWrite[0].pBufferInfo = bufferInfo;
+
+    if (!drawCall->texture)return 1;
+    imageInfo->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo->imageView = drawCall->texture->textureImageView;
+    imageInfo->sampler = drawCall->texture->textureSampler;
+    descriptorWrite[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite[1].dstSet = *drawCall->descriptorSet;
+    descriptorWrite[1].dstBinding = 1;
+    descriptorWrite[1].dstArrayElement = 0;
+    descriptorWrite[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite[1].descriptorCount = 1;
+    descriptorWrite[1].pImageInfo = imageInfo;
+    descriptorWrite[1].pTexelBufferView = NULL; // Optional
+    return 2;
+}
+
+void gf3d_pipeline_update_descriptor_set(Pipeline *pipe, PipelineDrawCall *drawCall)
+{
+    Uint32 count;
+    UniformBuffer *buffer;
+    VkDescriptorImageInfo imageInfo = {0};
+    VkWriteDescriptorSet descriptorWrite[2] = {0};
+    VkDescriptorBufferInfo bufferInfo = {0};
+    if ((!pipe)||(!drawCall))return;    
+
+    buffer = gf3d_uniform_buffer_list_get_nth_buffer(pipe->uboBigBuffer, 0, gf3d_vgraphics_get_current_buffer_frame());
+    count = gf3d_pipeline_fill_descriptor_writes(pipe,drawCall,buffer,descriptorWrite,&bufferInfo,&imageInfo);
+    vkUpdateDescriptorSets(pipe->device, count, descriptorWrite, 0, NULL);
+    gf3d_render_stats_add(RS_DescriptorWrites,count);
+}
+
+/**
+ * @brief write the descriptor sets for a range of draw calls with one vkUpdateDescriptorSets call
+ * @note the write arrays come from the calling thread's frame arena, falling back to one update per draw call
+ */
+void gf3d_pipeline_update_descriptor_sets(Pipeline *pipe,Uint32 start,Uint32 end)
+{
+    Uint32 i,n,count = 0;
+    UniformBuffer *buffer;
+    VkWriteDescriptorSet *descriptorWrite;
+    VkDescriptorBufferInfo *bufferInfo;
+    VkDescriptorImageInfo *imageInfo;
+    if ((!pipe)||(start >= end))return;
+    n = end - start;
+    descriptorWrite = gf3d_frame_alloc_array(sizeof(VkWriteDescriptorSet),n * 2);
+    bufferInfo = gf3d_frame_alloc_array(sizeof(VkDescriptorBufferInfo),n);
+    imageInfo = gf3d_frame_alloc_array(sizeof(VkDescriptorImageInfo),n);
+    if ((!descriptorWrite)||(!bufferInfo)||(!imageInfo))
+    {
+        for (i = start; i < end; i++)
+        {
+            if (!pipe->drawCallList[i].inuse)continue;
+            gf3d_pipeline_update_descriptor_set(pipe, &pipe->drawCallList[i]);
+        }
+        return;
+    }
+    buffer = gf3d_uniform_buffer_list_get_nth_buffer(pipe->uboBigBuffer, 0, gf3d_vgraphics_get_current_buffer_frame());
+    for (i = start; i < end; i++)
+    {
+        if (!pipe->drawCallList[i].inuse)continue;
+        count += gf3d_pipeline_fill_descriptor_writes(
+            pipe,
+            &pipe->drawCallList[i],
+            buffer,
+            &descriptorWrite[count],
+            &bufferInfo[i - start],
+            &imageInfo[i - start]);
     }
+    if (!count)return;
     vkUpdateDescriptorSets(pipe->device, count, descriptorWrite, 0, NULL);
+    gf3d_render_stats_add(RS_DescriptorWrites,count);
 }
 
-void gf3d_pipeline_render_drawcall(Pipeline *pipe,PipelineDrawCall *drawCall)
+void gf3d_pipeline_render_drawcall(VkCommandBuffer commandBuffer,Pipeline *pipe,PipelineDrawCall *drawCall)
 {
     if ((!pipe)||(!drawCall))return;
-    gf3d_pipeline_call_render(
+    if (drawCall->indirectBuffer != VK_NULL_HANDLE)
+    {
+        gf3d_pipeline_call_render_indirect_to(
+            commandBuffer,
+            pipe,
+            drawCall->descriptorSet,
+            drawCall->vertexBuffer,
+            drawCall->indirectBuffer,
+            drawCall->indirectOffset);
+        return;
+    }
+    gf3d_pipeline_call_render_to(
+        commandBuffer,
         pipe,
         drawCall->descriptorSet,
         drawCall->vertexBuffer,
         drawCall->vertexCount,
-        drawCall->indexBuffer);
+        drawCall->firstIndex,
+        drawCall->indexBuffer,
+        drawCall->instanceCount,
+        drawCall->firstInstance);
 }
 
-void gf3d_pipeline_render_all_drawcalls(Pipeline *pipe)
+/**
+ * job: record one contiguous slice of the draw call list into a secondary command buffer from this thread's pool.
+ * descriptor sets are per draw call, so writing them here does not race with other slices
+ */
+void gf3d_pipeline_record_slice(void *data,Uint32 slice,Uint32 thread)
 {
-    int i;
-    if (!pipe)return;
-    for (i = 0; i < pipe->drawCallCount; i++)
+    int i,start,end;
+    VkCommandBuffer commandBuffer;
+    PipelineRecordJob *job = (PipelineRecordJob *)data;
+    Pipeline *pipe;
+    if (!job)return;
+    pipe = job->pipe;
+    start = (pipe->drawCallCount * slice) / job->sliceCount;
+    end = (pipe->drawCallCount * (slice + 1)) / job->sliceCount;
+    commandBuffer = gf3d_command_secondary_begin(thread,job->frame,pipe);
+    pipe->secondaryBuffers[slice] = commandBuffer;
+    if (commandBuffer == VK_NULL_HANDLE)return;
+    GF3D_PROFILE_BEGIN("record_slice");
+    gf3d_pipeline_update_descriptor_sets(pipe,start,end);
+    for (i = start; i < end; i++)
     {
         if (!pipe->drawCallList[i].inuse)continue;
-        gf3d_pipeline_render_drawcall(pipe,&pipe->drawCallList[i]);
+        gf3d_pipeline_render_drawcall(commandBuffer,pipe,&pipe->drawCallList[i]);
     }
+    gf3d_command_secondary_end(commandBuffer);
+    GF3D_PROFILE_END();
 }
 
-
-void gf3d_pipeline_update_descriptor_sets(Pipeline *pipe)
+void gf3d_pipeline_record_commands(Pipeline *pipe,Uint32 frame)
 {
-    int i;
-    for (i = 0;i < pipe->drawCallCount;i++)
+    int i,count;
+    PipelineRecordJob job = {0};
+    if (!pipe)return;
+    pipe->commandBuffer = gf3d_command_rendering_begin_secondary(frame,pipe);
+    if ((!pipe->drawCallCount)||(!pipe->secondaryBufferCount))return;
+
+    job.pipe = pipe;
+    job.frame = frame;
+    job.sliceCount = (pipe->drawCallCount + GF3D_PIPELINE_MIN_SLICE_DRAWS - 1) / GF3D_PIPELINE_MIN_SLICE_DRAWS;
+    if (job.sliceCount > pipe->secondaryBufferCount)job.sliceCount = pipe->secondaryBufferCount;
+    gf3d_jobs_dispatch(job.sliceCount,gf3d_pipeline_record_slice,&job);
+
+    //skip any slice that failed to get a command buffer
+    for (i = 0,count = 0; i < job.sliceCount; i++)
     {
-        if (!pipe->drawCallList[i].inuse)continue;
-        gf3d_pipeline_update_descriptor_set(pipe, &pipe->drawCallList[i]);
-    }    
+        if (pipe->secondaryBuffers[i] == VK_NULL_HANDLE)continue;
+        pipe->secondaryBuffers[count++] = pipe->secondaryBuffers[i];
+    }
+    gf3d_command_execute_secondary(pipe->commandBuffer,pipe->secondaryBuffers,count);
 }
 
 PipelineDrawCall *gf3d_pipeline_draw_call_new(Pipeline *pipe)
@@ -163,7 +313,7 @@ PipelineDrawCall *gf3d_pipeline_draw_call_new(Pipeline *pipe)
     ptr = pipe->uboData;
     if (pipe->drawCallCount >= pipe->drawCallListCount)
     {
-        if (__DEBUG)slog("cannot queue up any more draw calls this frame");
+        gf3d_log(LL_Debug,"cannot queue up any more draw calls this frame");
         return NULL;
     }
     i = pipe->drawCallCount;
@@ -183,23 +333,88 @@ void gf3d_pipeline_queue_render(
     VkBuffer indexBuffer,
     void *uboData,
     Texture *texture)
+{
+    gf3d_pipeline_queue_render_range(pipe,vertexBuffer,0,vertexCount,indexBuffer,uboData,texture);
+}
+
+void gf3d_pipeline_queue_render_range(
+    Pipeline *pipe,
+    VkBuffer vertexBuffer,
+    Uint32 firstIndex,
+    Uint32 indexCount,
+    VkBuffer indexBuffer,
+    void *uboData,
+    Texture *texture)
 {
     PipelineDrawCall *drawCall;
     if (!pipe)return;
     drawCall = gf3d_pipeline_draw_call_new(pipe);
     if (!drawCall)
     {
-        slog("failed to get a drawcall for pipeline");
+        gf3d_log(LL_Warning,"failed to get a drawcall for pipeline %s",pipe->name);
         return;
     }
     drawCall->descriptorSet = gf3d_pipeline_get_descriptor_set(pipe, gf3d_vgraphics_get_current_buffer_frame());
     drawCall->vertexBuffer = vertexBuffer;
-    drawCall->vertexCount = vertexCount;
+    drawCall->vertexCount = indexCount;
+    drawCall->firstIndex = firstIndex;
     drawCall->indexBuffer = indexBuffer;
     drawCall->texture = texture;
     memcpy(drawCall->uboData,uboData,pipe->uboDataSize);
 }
 
+void gf3d_pipeline_queue_render_instanced(
+    Pipeline *pipe,
+    VkBuffer instanceBuffer,
+    Uint32 firstInstance,
+    Uint32 instanceCount,
+    Uint32 indexCount,
+    VkBuffer indexBuffer,
+    void *uboData,
+    Texture *texture)
+{
+    PipelineDrawCall *drawCall;
+    if ((!pipe)||(!instanceCount))return;
+    drawCall = gf3d_pipeline_draw_call_new(pipe);
+    if (!drawCall)
+    {
+        gf3d_log(LL_Warning,"failed to get a drawcall for pipeline %s",pipe->name);
+        return;
+    }
+    drawCall->descriptorSet = gf3d_pipeline_get_descriptor_set(pipe, gf3d_vgraphics_get_current_buffer_frame());
+    drawCall->vertexBuffer = instanceBuffer;
+    drawCall->vertexCount = indexCount;
+    drawCall->indexBuffer = indexBuffer;
+    drawCall->instanceCount = instanceCount;
+    drawCall->firstInstance = firstInstance;
+    drawCall->texture = texture;
+    memcpy(drawCall->uboData,uboData,pipe->uboDataSize);
+}
+
+void gf3d_pipeline_queue_render_indirect(
+    Pipeline *pipe,
+    VkBuffer instanceBuffer,
+    VkBuffer indirectBuffer,
+    VkDeviceSize indirectOffset,
+    void *uboData,
+    Texture *texture)
+{
+    PipelineDrawCall *drawCall;
+    if ((!pipe)||(indirectBuffer == VK_NULL_HANDLE))return;
+    drawCall = gf3d_pipeline_draw_call_new(pipe);
+    if (!drawCall)
+    {
+        gf3d_log(LL_Warning,"failed to get a drawcall for pipeline %s",pipe->name);
+        return;
+    }
+    drawCall->descriptorSet = gf3d_pipeline_get_descriptor_set(pipe, gf3d_vgraphics_get_current_buffer_frame());
+    drawCall->vertexBuffer = instanceBuffer;
+    drawCall->indirectBuffer = indirectBuffer;
+    drawCall->indirectOffset = indirectOffset;
+    drawCall->texture = texture;
+    memcpy(drawCall->uboData,uboData,pipe->uboDataSize);
+}
+
 void gf3_pipeline_update_ubos(Pipeline *pipe)
 {
     int frame;
@@ -220,6 +435,7 @@ void gf3_pipeline_update_ubos(Pipeline *pipe)
     vkMapMemory(device, buffer->uniformBufferMemory, 0, buffer->bufferSize, 0, &data);
         memcpy(data, pipe->uboData, buffer->bufferSize);
     vkUnmapMemory(device, buffer->uniformBufferMemory);
+    gf3d_render_stats_add(RS_UboBytes,buffer->bufferSize);
 }
 
 Pipeline *gf3d_pipeline_new()
@@ -289,14 +505,20 @@ int gf3d_pipeline_render_pass_create(VkDevice device,SJson *config,VkRenderPass
     {
         depthAttachment = gf3d_config_attachment_description(item,gf3d_pipeline_find_depth_format());
         depthAttachmentRef.attachment = 1;
-        depthAttachmentRef.layout = depthAttachment.finalLayout;
+        depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
     }
     item = sj_object_get_value(config,"colorAttachment");
     if (item)
     {
         colorAttachment = gf3d_config_attachment_description(item,gf3d_swapchain_get_format());
         colorAttachmentRef.attachment = 0;
-        colorAttachmentRef.layout = colorAttachment.finalLayout;
+        colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        if (gf3d_swapchain_is_offscreen())
+        {
+            // nothing presents offscreen images, leave them ready to be copied out instead
+            if (colorAttachment.finalLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR)colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            if (colorAttachment.initialLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR)colorAttachment.initialLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        }
     }
     
     item = sj_object_get_value(config,"dependency");
@@ -368,6 +590,132 @@ int gf3d_pipelin_depth_stencil_create_info_from_json(SJson *json,VkPipelineDepth
     return 1;
 }
 
+/**
+ * @brief make a compute pipeline from the pipeline object of a config.  It has no render pass, ubo or draw calls, its
+ * descriptor sets are taken per frame like a graphics pipeline's and filled in by whoever dispatches with it
+ */
+static Pipeline *gf3d_pipeline_compute_create(VkDevice device,const char *configFile,SJson *config,Uint32 descriptorCount)
+{
+    const char *shaderFile;
+    Pipeline *pipe;
+    VkPushConstantRange pushConstantRange = {0};
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {0};
+    VkComputePipelineCreateInfo pipelineInfo = {0};
+
+    shaderFile = sj_object_get_value_as_string(config,"compute_shader");
+    if (!shaderFile)
+    {
+        slog("compute pipeline %s has no compute_shader",configFile);
+        return NULL;
+    }
+    pipe = gf3d_pipeline_new();
+    if (!pipe)
+    {
+        slog("failed to get memory for a new pipeline");
+        return NULL;
+    }
+    pipe->device = device;
+    pipe->bindPoint = VK_PIPELINE_BIND_POINT_COMPUTE;
+    gfc_line_cpy(pipe->name,configFile);
+
+    pipe->compShader = (char *)gf3d_shaders_load_data(shaderFile,&pipe->compSize);
+    if (!pipe->compShader)
+    {
+        gf3d_pipeline_free(pipe);
+        return NULL;
+    }
+    pipe->compModule = gf3d_shaders_create_module(pipe->compShader,pipe->compSize,device);
+
+    sj_object_get_value_as_Uint32(config,"descriptorCount",&descriptorCount);
+    pipe->descriptorSetCount = descriptorCount;
+    gf3d_pipeline_create_basic_descriptor_pool_from_config(pipe,config);
+    gf3d_pipeline_create_basic_descriptor_set_layout_from_config(pipe,config);
+    gf3d_pipeline_create_descriptor_sets(pipe);
+
+    sj_object_get_value_as_Uint32(config,"pushConstantSize",&pipe->pushConstantSize);
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = pipe->pushConstantSize;
+
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &pipe->descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = pipe->pushConstantSize ? 1 : 0;
+    pipelineLayoutInfo.pPushConstantRanges = pipe->pushConstantSize ? &pushConstantRange : NULL;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, NULL, &pipe->pipelineLayout) != VK_SUCCESS)
+    {
+        slog("failed to create pipeline layout!");
+        gf3d_pipeline_free(pipe);
+        return NULL;
+    }
+
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = pipe->compModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = pipe->pipelineLayout;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+    if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &pipe->pipeline) != VK_SUCCESS)
+    {
+        slog("failed to create compute pipeline!");
+        gf3d_pipeline_free(pipe);
+        return NULL;
+    }
+    if (__DEBUG)slog("compute pipeline created from file '%s'",configFile);
+    return pipe;
+}
+
+Pipeline *gf3d_pipeline_compute_create_from_config(VkDevice device,const char *configFile,Uint32 descriptorCount)
+{
+    VkExtent2D extent = {0};
+    Pipeline *pipe;
+    pipe = gf3d_pipeline_create_from_config(device,configFile,extent,descriptorCount,NULL,NULL,0,0,0);
+    if ((pipe)&&(pipe->bindPoint != VK_PIPELINE_BIND_POINT_COMPUTE))
+    {
+        slog("pipeline %s is not a compute pipeline",configFile);
+        gf3d_pipeline_free(pipe);
+        return NULL;
+    }
+    return pipe;
+}
+
+void gf3d_pipeline_dispatch(VkCommandBuffer commandBuffer,Pipeline *pipe,VkDescriptorSet *descriptorSet,const void *pushConstants,Uint32 groupCount)
+{
+    if ((!pipe)||(!descriptorSet)||(!groupCount))return;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipe->pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipe->pipelineLayout, 0, 1, descriptorSet, 0, NULL);
+    if ((pushConstants)&&(pipe->pushConstantSize))
+    {
+        vkCmdPushConstants(commandBuffer, pipe->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, pipe->pushConstantSize, pushConstants);
+    }
+    vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+}
+
+void gf3d_pipeline_write_storage_buffers(Pipeline *pipe,VkDescriptorSet *descriptorSet,const VkDescriptorBufferInfo *buffers,Uint32 count)
+{
+    Uint32 i;
+    VkWriteDescriptorSet *descriptorWrite;
+    ArenaMark mark;
+    if ((!pipe)||(!descriptorSet)||(!buffers)||(!count))return;
+    mark = gf3d_scratch_begin();
+    descriptorWrite = gf3d_scratch_alloc_array(sizeof(VkWriteDescriptorSet),count);
+    for (i = 0; i < count; i++)
+    {
+        descriptorWrite[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite[i].dstSet = *descriptorSet;
+        descriptorWrite[i].dstBinding = i;
+        descriptorWrite[i].dstArrayElement = 0;
+        descriptorWrite[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrite[i].descriptorCount = 1;
+        descriptorWrite[i].pBufferInfo = &buffers[i];
+    }
+    vkUpdateDescriptorSets(pipe->device, count, descriptorWrite, 0, NULL);
+    gf3d_scratch_end(mark);
+    gf3d_render_stats_add(RS_DescriptorWrites,count);
+}
+
 Pipeline *gf3d_pipeline_create_from_config(
     VkDevice device,
     const char *configFile,
@@ -401,11 +749,6 @@ Pipeline *gf3d_pipeline_create_from_config(
     VkPipelineColorBlendStateCreateInfo colorBlending = {0};
     VkPipelineDepthStencilStateCreateInfo depthStencil = {0};
     
-    if (!vertexInputDescription)
-    {
-        slog("must provide vertexInputDescription to create the pipeline");
-        return NULL;
-    }
     if (!configFile)return NULL;
     file = gfc_pak_load_json(configFile);
     if (!file)
@@ -420,6 +763,19 @@ Pipeline *gf3d_pipeline_create_from_config(
         sj_free(file);
         return NULL;
     }
+    str = sj_object_get_value_as_string(config,"type");
+    if ((str)&&(strcmp(str,"compute") == 0))
+    {
+        pipe = gf3d_pipeline_compute_create(device,configFile,config,descriptorCount);
+        sj_free(file);
+        return pipe;
+    }
+    if (!vertexInputDescription)
+    {
+        slog("must provide vertexInputDescription to create the pipeline");
+        sj_free(file);
+        return NULL;
+    }
     
     pipe = gf3d_pipeline_new();
     if (!pipe)
@@ -428,11 +784,18 @@ Pipeline *gf3d_pipeline_create_from_config(
         sj_free(file);
         return NULL;
     }
+    pipe->device = device;// so a failure part way through can free what was made
 
     vertFile = sj_object_get_value_as_string(config,"vertex_shader");
     if (vertFile)
     {
         pipe->vertShader = (char *)gf3d_shaders_load_data(vertFile,&pipe->vertSize);
+        if (!pipe->vertShader)
+        {
+            sj_free(file);
+            gf3d_pipeline_free(pipe);
+            return NULL;
+        }
         pipe->vertModule = gf3d_shaders_create_module(pipe->vertShader,pipe->vertSize,device);
         vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
@@ -451,6 +814,12 @@ Pipeline *gf3d_pipeline_create_from_config(
     if (fragFile)
     {
         pipe->fragShader = (char *)gf3d_shaders_load_data(fragFile,&pipe->fragSize);
+        if (!pipe->fragShader)
+        {
+            sj_free(file);
+            gf3d_pipeline_free(pipe);
+            return NULL;
+        }
         pipe->fragModule = gf3d_shaders_create_module(pipe->fragShader,pipe->fragSize,device);
         fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -578,15 +947,20 @@ Pipeline *gf3d_pipeline_create_from_config(
         gf3d_pipeline_free(pipe);
         return NULL;
     }
-    pipe->drawCallList = gfc_allocate_array(sizeof(PipelineDrawCall),descriptorCount);
+    pipe->drawCallList = gf3d_memory_alloc_array(MT_Pipeline,sizeof(PipelineDrawCall),descriptorCount);
     if (pipe->drawCallList)
     {
         pipe->drawCallListCount = descriptorCount;
     }
     pipe->uboBufferSize = bufferSize * descriptorCount;
-    pipe->uboData = gfc_allocate_array(bufferSize,descriptorCount);
+    pipe->uboData = gf3d_memory_alloc_array(MT_Pipeline,bufferSize,descriptorCount);
     pipe->uboDataSize = bufferSize;
     pipe->uboBigBuffer = gf3d_uniform_buffer_list_new(device,bufferSize*descriptorCount,1,gf3d_swapchain_get_swap_image_count());
+    pipe->secondaryBuffers = (VkCommandBuffer *)gf3d_memory_alloc_array(MT_Pipeline,sizeof(VkCommandBuffer),gf3d_jobs_get_thread_count());
+    if (pipe->secondaryBuffers)
+    {
+        pipe->secondaryBufferCount = gf3d_jobs_get_thread_count();
+    }
     gfc_line_cpy(pipe->name,configFile);
     pipe->indexType = indexType;
     if (__DEBUG)slog("pipeline created from file '%s'",configFile);
@@ -600,18 +974,28 @@ void gf3d_pipeline_free(Pipeline *pipe)
     if (!pipe->inUse)return;
     if (pipe->drawCallList)
     {
-        free(pipe->drawCallList);
+        gf3d_memory_free(pipe->drawCallList);
     }
     if (pipe->uboBigBuffer)
     {
         gf3d_uniform_buffer_list_free(pipe->uboBigBuffer);
     }
-    if (pipe->uboData)free(pipe->uboData);
+    if (pipe->uboData)gf3d_memory_free(pipe->uboData);
+    if (pipe->secondaryBuffers)gf3d_memory_free(pipe->secondaryBuffers);//the buffers themselves belong to the command thread pools
     if (pipe->descriptorCursor)
     {
-        free(pipe->descriptorCursor);
+        gf3d_memory_free(pipe->descriptorCursor);
         pipe->descriptorCursor = NULL;
     }
+    if (pipe->descriptorSets)
+    {
+        // the sets themselves go with their pools
+        for (i = 0;i < gf3d_pipeline.chainLength;i++)
+        {
+            gf3d_memory_free(pipe->descriptorSets[i]);
+        }
+        gf3d_memory_free(pipe->descriptorSets);
+    }
     if (pipe->descriptorPool != NULL)
     {
         for (i = 0;i < gf3d_pipeline.chainLength;i++)
@@ -621,12 +1005,16 @@ void gf3d_pipeline_free(Pipeline *pipe)
                 vkDestroyDescriptorPool(pipe->device, pipe->descriptorPool[i], NULL);
             }
         }
-        free(pipe->descriptorPool);
+        gf3d_memory_free(pipe->descriptorPool);
     }
     if (pipe->descriptorSetLayout != VK_NULL_HANDLE)
     {
         vkDestroyDescriptorSetLayout(pipe->device, pipe->descriptorSetLayout, NULL);
     }
+    for (i = 0;i < pipe->immutableSamplerCount;i++)
+    {
+        gf3d_sampler_free(pipe->immutableSamplers[i]);
+    }
     if (pipe->pipeline != VK_NULL_HANDLE)
     {
         vkDestroyPipeline(pipe->device, pipe->pipeline, NULL);
@@ -647,6 +1035,14 @@ void gf3d_pipeline_free(Pipeline *pipe)
     {
         vkDestroyShaderModule(pipe->device, pipe->vertModule, NULL);
     }
+    if (pipe->compModule != VK_NULL_HANDLE)
+    {
+        vkDestroyShaderModule(pipe->device, pipe->compModule, NULL);
+    }
+    if (pipe->compShader != NULL)
+    {
+        free(pipe->compShader);
+    }
     if (pipe->fragShader != NULL)
     {
         free(pipe->fragShader);
@@ -663,6 +1059,7 @@ void gf3d_pipeline_create_basic_descriptor_pool_from_config(Pipeline *pipe,SJson
     const char *str;
     int i,c,pools = 0;
     VkDescriptorPoolSize *poolSize;
+    ArenaMark mark;
     SJson *list,*item;
     
     if ((!pipe)||(!config))
@@ -678,7 +1075,8 @@ void gf3d_pipeline_create_basic_descriptor_pool_from_config(Pipeline *pipe,SJson
     }
     c = sj_array_get_count(list);
     if (!c)return;// no descriptorPools
-    poolSize = gfc_allocate_array(sizeof(VkDescriptorPoolSize),c);
+    mark = gf3d_scratch_begin();
+    poolSize = gf3d_scratch_alloc_array(sizeof(VkDescriptorPoolSize),c);
     for (i = 0,pools = 0;i < c;i++)
     {
         item = sj_array_get_nth(list,i);
@@ -691,7 +1089,7 @@ void gf3d_pipeline_create_basic_descriptor_pool_from_config(Pipeline *pipe,SJson
     }
     
     gf3d_pipeline_create_basic_descriptor_pool(pipe,poolSize,pools);
-    free(poolSize);
+    gf3d_scratch_end(mark);
 }
 
 
@@ -710,7 +1108,7 @@ void gf3d_pipeline_create_basic_descriptor_pool(Pipeline *pipe,VkDescriptorPoolS
     poolInfo.poolSizeCount = poolSizeCount;
     poolInfo.pPoolSizes = poolSize;
     poolInfo.maxSets = pipe->descriptorSetCount;
-    pipe->descriptorPool = (VkDescriptorPool *)gfc_allocate_array(sizeof(VkDescriptorPool),gf3d_pipeline.chainLength);
+    pipe->descriptorPool = (VkDescriptorPool *)gf3d_memory_alloc_array(MT_Pipeline,sizeof(VkDescriptorPool),gf3d_pipeline.chainLength);
 
     for (i =0; i < gf3d_pipeline.chainLength;i++)
     {
@@ -731,6 +1129,7 @@ void gf3d_pipeline_reset_all_pipes()
 {
     int i;
     Uint32 bufferFrame = gf3d_vgraphics_get_current_buffer_frame();
+    gf3d_command_thread_pools_reset(bufferFrame);
     for (i = 0; i < gf3d_pipeline.maxPipelines;i++)
     {
         if (!gf3d_pipeline.pipelineList[i].inUse)continue;
@@ -748,43 +1147,93 @@ void gf3d_pipeline_reset_frame(Pipeline *pipe,Uint32 frame)
     }
     pipe->descriptorCursor[frame] = 0;
     
-    pipe->commandBuffer = gf3d_command_rendering_begin(frame,pipe);
+    pipe->commandBuffer = VK_NULL_HANDLE;//begun when the frame is recorded
+    //only what was used last frame needs clearing
+    memset(pipe->drawCallList,0,sizeof(PipelineDrawCall)*pipe->drawCallCount);
+    memset(pipe->uboData,0,pipe->uboDataSize*pipe->drawCallCount);
     pipe->drawCallCount = 0;
-    memset(pipe->drawCallList,0,sizeof(PipelineDrawCall)*pipe->drawCallListCount);//clear this out
-    memset(pipe->uboData,0,pipe->uboBufferSize);
 }
 
 void gf3d_pipeline_submit_commands(Pipeline *pipe)
 {
-    if (!pipe)return;
-    gf3d_command_rendering_end(pipe->commandBuffer);
+    if ((!pipe)||(pipe->commandBuffer == VK_NULL_HANDLE))return;
+    gf3d_command_rendering_end_secondary(pipe->commandBuffer,pipe);
+    pipe->commandBuffer = VK_NULL_HANDLE;
+}
+
+void gf3d_pipeline_add_render_stats(Pipeline *pipe)
+{
+    int i;
+    Uint32 draws = 0,instances = 0,triangles = 0,count;
+    if ((!pipe)||(!pipe->drawCallCount))return;
+    for (i = 0; i < pipe->drawCallCount; i++)
+    {
+        if (!pipe->drawCallList[i].inuse)continue;
+        //indirect draws have no counts on the cpu, they show up as one instance and no triangles
+        count = MAX(pipe->drawCallList[i].instanceCount,1);
+        draws++;
+        instances += count;
+        triangles += pipe->drawCallList[i].vertexCount / 3 * count;
+    }
+    gf3d_render_stats_add_pipeline(pipe->name,draws,instances,triangles);
 }
 
 void gf3d_pipeline_submit_all_pipe_commands()
 {
     int i;
+    Uint64 start,uboDone,recordDone,submitDone;
+    double frequency = (double)SDL_GetPerformanceFrequency();
+    Uint32 bufferFrame = gf3d_vgraphics_get_current_buffer_frame();
+    memset(&gf3d_pipeline.frameStats,0,sizeof(PipelineFrameStats));
     for (i = 0; i < gf3d_pipeline.maxPipelines;i++)
     {
         if (!gf3d_pipeline.pipelineList[i].inUse)continue;
+        if (gf3d_pipeline.pipelineList[i].bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE)continue;//dispatched by their owners
+        GF3D_PROFILE_BEGIN(gf3d_pipeline.pipelineList[i].name);
+        GF3D_PROFILE_COUNTER("draw_calls",gf3d_pipeline.pipelineList[i].drawCallCount);
+        start = SDL_GetPerformanceCounter();
         //Update UBOS
+        GF3D_PROFILE_BEGIN("update_ubos");
         gf3_pipeline_update_ubos(&gf3d_pipeline.pipelineList[i]);
-        //Update Descriptor sets
-        gf3d_pipeline_update_descriptor_sets(&gf3d_pipeline.pipelineList[i]);
-        //Set commands
-        gf3d_pipeline_render_all_drawcalls(&gf3d_pipeline.pipelineList[i]);
+        GF3D_PROFILE_END();
+        uboDone = SDL_GetPerformanceCounter();
+        //Update descriptor sets and record commands, in parallel slices
+        GF3D_PROFILE_BEGIN("record_commands");
+        gf3d_pipeline_record_commands(&gf3d_pipeline.pipelineList[i],bufferFrame);
+        GF3D_PROFILE_END();
+        recordDone = SDL_GetPerformanceCounter();
         //submit commands
+        GF3D_PROFILE_BEGIN("submit");
         gf3d_pipeline_submit_commands(&gf3d_pipeline.pipelineList[i]);
+        GF3D_PROFILE_END();
+        submitDone = SDL_GetPerformanceCounter();
+        GF3D_PROFILE_END();
+
+        gf3d_pipeline_add_render_stats(&gf3d_pipeline.pipelineList[i]);
+        gf3d_pipeline.frameStats.drawCalls += gf3d_pipeline.pipelineList[i].drawCallCount;
+        gf3d_pipeline.frameStats.pipelines++;
+        gf3d_pipeline.frameStats.uboTime += (uboDone - start) / frequency;
+        gf3d_pipeline.frameStats.recordTime += (recordDone - uboDone) / frequency;
+        gf3d_pipeline.frameStats.submitTime += (submitDone - recordDone) / frequency;
     }
 }
 
+void gf3d_pipeline_get_frame_stats(PipelineFrameStats *stats)
+{
+    if (!stats)return;
+    memcpy(stats,&gf3d_pipeline.frameStats,sizeof(PipelineFrameStats));
+}
+
 void gf3d_pipeline_create_descriptor_sets(Pipeline *pipe)
 {
     int i;
     int r;
     VkDescriptorSetLayout *layouts = NULL;
     VkDescriptorSetAllocateInfo allocInfo = {0};
+    ArenaMark mark;
 
-    layouts = (VkDescriptorSetLayout *)gfc_allocate_array(sizeof(VkDescriptorSetLayout),pipe->descriptorSetCount);
+    mark = gf3d_scratch_begin();
+    layouts = (VkDescriptorSetLayout *)gf3d_scratch_alloc_array(sizeof(VkDescriptorSetLayout),pipe->descriptorSetCount);
     for (i = 0; i < pipe->descriptorSetCount; i++)
     {
         memcpy(&layouts[i],&pipe->descriptorSetLayout,sizeof(VkDescriptorSetLayout));
@@ -794,12 +1243,12 @@ void gf3d_pipeline_create_descriptor_sets(Pipeline *pipe)
     allocInfo.descriptorSetCount = pipe->descriptorSetCount;
     allocInfo.pSetLayouts = layouts;
     
-    pipe->descriptorCursor = (Uint32 *)gfc_allocate_array(sizeof(Uint32),gf3d_pipeline.chainLength);
-    pipe->descriptorSets = (VkDescriptorSet **)gfc_allocate_array(sizeof(VkDescriptorSet*),gf3d_pipeline.chainLength);
+    pipe->descriptorCursor = (Uint32 *)gf3d_memory_alloc_array(MT_Pipeline,sizeof(Uint32),gf3d_pipeline.chainLength);
+    pipe->descriptorSets = (VkDescriptorSet **)gf3d_memory_alloc_array(MT_Pipeline,sizeof(VkDescriptorSet*),gf3d_pipeline.chainLength);
 
     for (i = 0; i < gf3d_pipeline.chainLength; i++)
     {    
-        pipe->descriptorSets[i] = (VkDescriptorSet *)gfc_allocate_array(sizeof(VkDescriptorSet),pipe->descriptorSetCount);
+        pipe->descriptorSets[i] = (VkDescriptorSet *)gf3d_memory_alloc_array(MT_Pipeline,sizeof(VkDescriptorSet),pipe->descriptorSetCount);
         allocInfo.descriptorPool = pipe->descriptorPool[i];
         if ((r = vkAllocateDescriptorSets(pipe->device, &allocInfo, pipe->descriptorSets[i])) != VK_SUCCESS)
         {
@@ -807,19 +1256,23 @@ void gf3d_pipeline_create_descriptor_sets(Pipeline *pipe)
             else if (r == VK_ERROR_FRAGMENTED_POOL)slog("fragmented pool");
             else if (r == VK_ERROR_OUT_OF_DEVICE_MEMORY)slog("out of device memory");
             else if (r == VK_ERROR_OUT_OF_HOST_MEMORY)slog("out of host memory");
-            free(layouts);
+            gf3d_scratch_end(mark);
             return;
         }
         if (__DEBUG)slog("allocated descriptor set %i for pipeline %s!",i,pipe->name);
     }
+    gf3d_scratch_end(mark);
 }
 
 void gf3d_pipeline_create_basic_descriptor_set_layout_from_config(Pipeline *pipe,SJson *config)
 {
     VkDescriptorSetLayoutCreateInfo layoutInfo = {0};    
     VkDescriptorSetLayoutBinding *bindings;
-    SJson *list,*item;
-    int i,c;
+    VkSampler *immutable;
+    SamplerState samplerState;
+    SJson *list,*item,*sampler;
+    ArenaMark mark;
+    int i,j,c;
     if (!pipe)
     {
         slog("no pipe specified");
@@ -842,7 +1295,8 @@ void gf3d_pipeline_create_basic_descriptor_set_layout_from_config(Pipeline *pipe
         slog("descriptorSetLayout empty");
         return;
     }
-    bindings = gfc_allocate_array(sizeof(VkDescriptorSetLayoutBinding),c);
+    mark = gf3d_scratch_begin();
+    bindings = gf3d_scratch_alloc_array(sizeof(VkDescriptorSetLayoutBinding),c);
     for (i = 0;i < c; i++)
     {
         item = sj_array_get_nth(list,i);
@@ -851,6 +1305,26 @@ void gf3d_pipeline_create_basic_descriptor_set_layout_from_config(Pipeline *pipe
         sj_object_get_value_as_Uint32(item,"descriptorCount",&bindings[i].descriptorCount);
         bindings[i].descriptorType = gf3d_config_descriptor_type_from_str(sj_object_get_value_as_string(item,"descriptorType"));
         bindings[i].stageFlags = gf3d_config_shader_stage_flags(sj_object_get_value(item,"stageFlags"));
+        sampler = sj_object_get_value(item,"immutableSampler");
+        if (!sampler)continue;
+        if ((bindings[i].descriptorType != VK_DESCRIPTOR_TYPE_SAMPLER)&&(bindings[i].descriptorType != VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER))
+        {
+            slog("pipeline %s binding %u has an immutable sampler but does not take one",pipe->name,bindings[i].binding);
+            continue;
+        }
+        if (pipe->immutableSamplerCount >= GF3D_PIPELINE_MAX_IMMUTABLE_SAMPLERS)
+        {
+            slog("pipeline %s has too many immutable samplers",pipe->name);
+            continue;
+        }
+        // draws still pass a sampler with their texture, the layout's wins
+        samplerState = gf3d_sampler_state_from_json(sampler);
+        pipe->immutableSamplers[pipe->immutableSamplerCount] = gf3d_sampler_get(&samplerState);
+        if (pipe->immutableSamplers[pipe->immutableSamplerCount] == VK_NULL_HANDLE)continue;
+        immutable = gf3d_scratch_alloc_array(sizeof(VkSampler),bindings[i].descriptorCount);
+        for (j = 0; j < bindings[i].descriptorCount; j++)immutable[j] = pipe->immutableSamplers[pipe->immutableSamplerCount];
+        bindings[i].pImmutableSamplers = immutable;
+        pipe->immutableSamplerCount++;
     }
 
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -861,7 +1335,7 @@ void gf3d_pipeline_create_basic_descriptor_set_layout_from_config(Pipeline *pipe
     {
         slog("failed to create descriptor set layout!");
     }
-    free(bindings);
+    gf3d_scratch_end(mark);
 }
 
 VkDescriptorSet * gf3d_pipeline_get_descriptor_set(Pipeline *pipe, Uint32 frame)
@@ -0,0 +1,334 @@
+#include <stdio.h>
+#include <string.h>
+#include <SDL.h>
+
+#include "simple_logger.h"
+#include "simple_json.h"
+
+#include "gfc_text.h"
+#include "gfc_pak.h"
+
+#include "gf3d_memory.h"
+#include "gf3d_jobs.h"
+#include "gf3d_profiler.h"
+
+#define GF3D_PROFILER_MAX_DEPTH 32
+#define GF3D_PROFILER_DEFAULT_EVENTS 65536
+
+extern int __DEBUG;
+
+typedef enum
+{
+    PE_Zone,
+    PE_Counter,
+    PE_Frame
+}ProfilerEventType;
+
+typedef struct
+{
+    const char         *name;
+    Uint64              start;      /**<performance counter at the start of the zone, or when the counter was set*/
+    Uint64              end;        /**<performance counter at the end of the zone, 0 while it is open*/
+    double              value;      /**<counter value, or frame number for frame markers*/
+    ProfilerEventType   type;
+}ProfilerEvent;
+
+typedef struct
+{
+    ProfilerEvent  *events;         /**<ring buffer*/
+    Uint64          head;           /**<total events written, the next slot is head % capacity*/
+    Uint64          stack[GF3D_PROFILER_MAX_DEPTH];/**<event numbers of the open zones*/
+    Uint32          depth;
+    Uint32          overflow;       /**<zones opened past the max depth, closed without being recorded*/
+}ProfilerThread;
+
+typedef struct
+{
+    ProfilerThread *threads;        /**<one per job system thread*/
+    Uint32          threadCount;
+    Uint32          capacity;       /**<events per thread*/
+    Uint32          frame;          /**<frames since start up*/
+    Uint32          captureStart;   /**<first frame to capture*/
+    Uint32          captureEnd;     /**<first frame after the capture*/
+    Uint8           pending;
+    Uint8           capturing;
+    Uint64          startTime;      /**<performance counter at the start of the capture*/
+    double          frequency;
+    GFC_TextLine    output;
+}Profiler;
+
+static Profiler gf3d_profiler = {0};
+
+void gf3d_profiler_close();
+void gf3d_profiler_write(const char *filename);
+
+void gf3d_profiler_init(const char *config)
+{
+    SJson *json,*setup;
+    int capacity = GF3D_PROFILER_DEFAULT_EVENTS;
+    const char *output = NULL;
+
+    gfc_line_cpy(gf3d_profiler.output,"gf3d_trace.json");
+    if (config)
+    {
+        json = gfc_pak_load_json(config);
+        if (json)
+        {
+            setup = sj_object_get_value(json,"setup");
+            sj_object_get_value_as_int(setup,"profiler_events",&capacity);
+            output = sj_object_get_value_as_string(setup,"trace_file");
+            if (output)gfc_line_cpy(gf3d_profiler.output,output);
+            sj_free(json);
+        }
+    }
+    if (capacity <= 0)capacity = GF3D_PROFILER_DEFAULT_EVENTS;
+    gf3d_profiler.capacity = capacity;
+    gf3d_profiler.threadCount = gf3d_jobs_get_thread_count();
+    gf3d_profiler.threads = gf3d_memory_alloc_array(MT_General,sizeof(ProfilerThread),gf3d_profiler.threadCount);
+    if (!gf3d_profiler.threads)
+    {
+        slog("failed to allocate profiler threads");
+        return;
+    }
+    gf3d_profiler.frequency = (double)SDL_GetPerformanceFrequency();
+    atexit(gf3d_profiler_close);
+    if (__DEBUG)slog("profiler initialized for %i threads, %i events each",gf3d_profiler.threadCount,capacity);
+}
+
+void gf3d_profiler_close()
+{
+    Uint32 i;
+    if (gf3d_profiler.capturing)
+    {
+        // write what we have rather than lose it
+        gf3d_profiler_write(gf3d_profiler.output);
+    }
+    if (gf3d_profiler.threads)
+    {
+        for (i = 0; i < gf3d_profiler.threadCount; i++)
+        {
+            if (gf3d_profiler.threads[i].events)gf3d_memory_free(gf3d_profiler.threads[i].events);
+        }
+        gf3d_memory_free(gf3d_profiler.threads);
+    }
+    memset(&gf3d_profiler,0,sizeof(Profiler));
+}
+
+void gf3d_profiler_set_output(const char *filename)
+{
+    if (!filename)return;
+    gfc_line_cpy(gf3d_profiler.output,filename);
+}
+
+void gf3d_profiler_capture(Uint32 frames)
+{
+    gf3d_profiler_capture_range(gf3d_profiler.frame + 1,frames);
+}
+
+void gf3d_profiler_capture_range(Uint32 first,Uint32 frames)
+{
+    if ((gf3d_profiler.capturing)||(!frames))return;
+    gf3d_profiler.captureStart = first;
+    gf3d_profiler.captureEnd = first + frames;
+    gf3d_profiler.pending = 1;
+}
+
+Uint8 gf3d_profiler_capturing()
+{
+    return gf3d_profiler.capturing;
+}
+
+static ProfilerEvent *gf3d_profiler_event_new(ProfilerThread *thread,Uint64 *number)
+{
+    ProfilerEvent *event;
+    event = &thread->events[thread->head % gf3d_profiler.capacity];
+    if (number)*number = thread->head;
+    thread->head++;
+    return event;
+}
+
+static ProfilerThread *gf3d_profiler_get_thread()
+{
+    Uint32 index = gf3d_jobs_get_thread_index();
+    if (index >= gf3d_profiler.threadCount)return NULL;
+    return &gf3d_profiler.threads[index];
+}
+
+static void gf3d_profiler_start_capture()
+{
+    Uint32 i;
+    ProfilerThread *thread;
+    for (i = 0; i < gf3d_profiler.threadCount; i++)
+    {
+        thread = &gf3d_profiler.threads[i];
+        if (!thread->events)
+        {
+            // only pay for the buffers once something is captured
+            thread->events = gf3d_memory_alloc_array(MT_General,sizeof(ProfilerEvent),gf3d_profiler.capacity);
+            if (!thread->events)
+            {
+                slog("failed to allocate profiler events, capture cancelled");
+                return;
+            }
+        }
+        thread->head = 0;
+        thread->depth = 0;
+        thread->overflow = 0;
+    }
+    gf3d_profiler.startTime = SDL_GetPerformanceCounter();
+    gf3d_profiler.capturing = 1;
+    slog("profiler capturing frames %i to %i",gf3d_profiler.captureStart,gf3d_profiler.captureEnd - 1);
+}
+
+void gf3d_profiler_frame_begin()
+{
+    ProfilerEvent *event;
+    if (!gf3d_profiler.threads)return;
+    gf3d_profiler.frame++;
+    if ((gf3d_profiler.capturing)&&(gf3d_profiler.frame >= gf3d_profiler.captureEnd))
+    {
+        gf3d_profiler.capturing = 0;
+        gf3d_profiler_write(gf3d_profiler.output);
+    }
+    if ((gf3d_profiler.pending)&&(gf3d_profiler.frame >= gf3d_profiler.captureStart))
+    {
+        gf3d_profiler.pending = 0;
+        gf3d_profiler_start_capture();
+    }
+    if (!gf3d_profiler.capturing)return;
+    event = gf3d_profiler_event_new(&gf3d_profiler.threads[0],NULL);
+    event->name = "frame";
+    event->start = SDL_GetPerformanceCounter();
+    event->end = event->start;
+    event->value = gf3d_profiler.frame;
+    event->type = PE_Frame;
+}
+
+void gf3d_profiler_begin(const char *name)
+{
+    ProfilerThread *thread;
+    ProfilerEvent *event;
+    Uint64 number;
+    if (!gf3d_profiler.capturing)return;
+    thread = gf3d_profiler_get_thread();
+    if (!thread)return;
+    if (thread->depth >= GF3D_PROFILER_MAX_DEPTH)
+    {
+        thread->overflow++;
+        return;
+    }
+    event = gf3d_profiler_event_new(thread,&number);
+    event->name = name;
+    event->end = 0;
+    event->type = PE_Zone;
+    thread->stack[thread->depth++] = number;
+    event->start = SDL_GetPerformanceCounter();
+}
+
+void gf3d_profiler_end()
+{
+    Uint64 now,number;
+    ProfilerThread *thread;
+    if (!gf3d_profiler.capturing)return;
+    now = SDL_GetPerformanceCounter();
+    thread = gf3d_profiler_get_thread();
+    if (!thread)return;
+    if (thread->overflow)
+    {
+        thread->overflow--;
+        return;
+    }
+    if (!thread->depth)return;// opened before the capture started
+    number = thread->stack[--thread->depth];
+    if (thread->head - number > gf3d_profiler.capacity)return;// the ring has already written over it
+    thread->events[number % gf3d_profiler.capacity].end = now;
+}
+
+void gf3d_profiler_counter(const char *name,double value)
+{
+    ProfilerThread *thread;
+    ProfilerEvent *event;
+    if (!gf3d_profiler.capturing)return;
+    thread = gf3d_profiler_get_thread();
+    if (!thread)return;
+    event = gf3d_profiler_event_new(thread,NULL);
+    event->name = name;
+    event->start = SDL_GetPerformanceCounter();
+    event->end = event->start;
+    event->value = value;
+    event->type = PE_Counter;
+}
+
+static double gf3d_profiler_to_us(Uint64 time)
+{
+    if (time < gf3d_profiler.startTime)return 0;
+    return (time - gf3d_profiler.startTime) * 1000000.0 / gf3d_profiler.frequency;
+}
+
+void gf3d_profiler_write(const char *filename)
+{
+    FILE *file;
+    Uint32 i;
+    Uint64 n,first;
+    Uint32 written = 0,dropped = 0;
+    ProfilerThread *thread;
+    ProfilerEvent *event;
+
+    if (!filename)return;
+    file = fopen(filename,"w");
+    if (!file)
+    {
+        slog("failed to open trace file %s for writing",filename);
+        return;
+    }
+    fprintf(file,"{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file,"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"gf3d\"}}");
+    for (i = 0; i < gf3d_profiler.threadCount; i++)
+    {
+        if (i == 0)fprintf(file,",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"main\"}}");
+        else fprintf(file,",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"worker %u\"}}",i,i);
+    }
+    for (i = 0; i < gf3d_profiler.threadCount; i++)
+    {
+        thread = &gf3d_profiler.threads[i];
+        if (!thread->events)continue;
+        first = 0;
+        if (thread->head > gf3d_profiler.capacity)
+        {
+            first = thread->head - gf3d_profiler.capacity;
+            dropped += first;
+        }
+        for (n = first; n < thread->head; n++)
+        {
+            event = &thread->events[n % gf3d_profiler.capacity];
+            switch (event->type)
+            {
+                case PE_Zone:
+                    if (!event->end)continue;// never closed
+                    fprintf(file,",\n{\"name\":\"%s\",\"cat\":\"gf3d\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                        event->name,i,
+                        gf3d_profiler_to_us(event->start),
+                        (event->end - event->start) * 1000000.0 / gf3d_profiler.frequency);
+                    break;
+                case PE_Counter:
+                    fprintf(file,",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"value\":%g}}",
+                        event->name,i,
+                        gf3d_profiler_to_us(event->start),
+                        event->value);
+                    break;
+                case PE_Frame:
+                    fprintf(file,",\n{\"name\":\"frame %u\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}",
+                        (Uint32)event->value,i,
+                        gf3d_profiler_to_us(event->start));
+                    break;
+            }
+            written++;
+        }
+    }
+    fprintf(file,"\n]}\n");
+    fclose(file);
+    if (dropped)slog("profiler ring buffers wrapped, %i oldest events lost.  Raise profiler_events or capture fewer frames",dropped);
+    slog("wrote %i profiler events to %s",written,filename);
+}
+
+/*eol@eof*/
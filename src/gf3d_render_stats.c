@@ -0,0 +1,161 @@
+#include <string.h>
+#include <SDL.h>
+
+#include "simple_logger.h"
+
+#include "gfc_text.h"
+
+#include "gf2d_font.h"
+
+#include "gf3d_memory.h"
+#include "gf3d_texture_stream.h"
+#include "gf3d_render_stats.h"
+
+typedef struct
+{
+    SDL_atomic_t        current[RS_MAX];
+    Uint32              last[RS_MAX];
+    RenderStatsPipeline currentPipes[GF3D_RENDER_STATS_MAX_PIPELINES];
+    Uint32              currentPipeCount;
+    RenderStatsPipeline lastPipes[GF3D_RENDER_STATS_MAX_PIPELINES];
+    Uint32              lastPipeCount;
+    Uint32              allocCount;     /**<the tracker's allocation total when the last frame closed*/
+}RenderStats;
+
+static RenderStats gf3d_render_stats = {0};
+
+static const char *gf3d_render_stats_names[RS_MAX] =
+{
+    "draw_calls",
+    "instances",
+    "triangles",
+    "descriptor_writes",
+    "bytes_uploaded",
+    "ubo_bytes",
+    "textures_created",
+    "glyphs_drawn",
+    "glyphs_rasterized",
+    "text_cache_hits",
+    "text_cache_misses",
+    "sprite_quads",
+    "sprite_batches",
+    "particles",
+    "particle_batches",
+    "entities_visible",
+    "entities_culled",
+    "frame_arena_bytes",
+    "arena_heap_allocs",
+    "heap_allocs",
+    "texture_stream_uploads",
+    "texture_evictions"
+};
+
+void gf3d_render_stats_add(RenderStat stat,Uint32 amount)
+{
+    if ((stat < 0)||(stat >= RS_MAX)||(!amount))return;
+    SDL_AtomicAdd(&gf3d_render_stats.current[stat],amount);
+}
+
+void gf3d_render_stats_add_pipeline(const char *name,Uint32 drawCalls,Uint32 instances,Uint32 triangles)
+{
+    RenderStatsPipeline *pipe;
+    gf3d_render_stats_add(RS_DrawCalls,drawCalls);
+    gf3d_render_stats_add(RS_Instances,instances);
+    gf3d_render_stats_add(RS_Triangles,triangles);
+    if (gf3d_render_stats.currentPipeCount >= GF3D_RENDER_STATS_MAX_PIPELINES)return;
+    pipe = &gf3d_render_stats.currentPipes[gf3d_render_stats.currentPipeCount++];
+    pipe->name = name;
+    pipe->drawCalls = drawCalls;
+    pipe->instances = instances;
+    pipe->triangles = triangles;
+}
+
+void gf3d_render_stats_frame_end()
+{
+    int i;
+    Uint32 allocCount;
+    allocCount = gf3d_memory_get_stats(MD_Cpu,MT_MAX).allocCount;
+    gf3d_render_stats_add(RS_HeapAllocs,allocCount - gf3d_render_stats.allocCount);
+    gf3d_render_stats.allocCount = allocCount;
+    for (i = 0; i < RS_MAX; i++)
+    {
+        gf3d_render_stats.last[i] = SDL_AtomicSet(&gf3d_render_stats.current[i],0);
+    }
+    memcpy(gf3d_render_stats.lastPipes,gf3d_render_stats.currentPipes,sizeof(RenderStatsPipeline)*gf3d_render_stats.currentPipeCount);
+    gf3d_render_stats.lastPipeCount = gf3d_render_stats.currentPipeCount;
+    gf3d_render_stats.currentPipeCount = 0;
+}
+
+Uint32 gf3d_render_stats_get(RenderStat stat)
+{
+    if ((stat < 0)||(stat >= RS_MAX))return 0;
+    return gf3d_render_stats.last[stat];
+}
+
+const char *gf3d_render_stats_get_name(RenderStat stat)
+{
+    if ((stat < 0)||(stat >= RS_MAX))return NULL;
+    return gf3d_render_stats_names[stat];
+}
+
+Uint32 gf3d_render_stats_get_pipeline_count()
+{
+    return gf3d_render_stats.lastPipeCount;
+}
+
+const RenderStatsPipeline *gf3d_render_stats_get_pipeline(Uint32 index)
+{
+    if (index >= gf3d_render_stats.lastPipeCount)return NULL;
+    return &gf3d_render_stats.lastPipes[index];
+}
+
+void gf3d_render_stats_draw_overlay(GFC_Vector2D position)
+{
+    Uint32 i;
+    GFC_TextLine line;
+    Uint32 *last = gf3d_render_stats.last;
+    RenderStatsPipeline *pipe;
+
+    gfc_line_sprintf(line,"draws: %u  instances: %u  triangles: %u",last[RS_DrawCalls],last[RS_Instances],last[RS_Triangles]);
+    gf2d_font_draw_line_tag(line,FT_Small,GFC_COLOR_WHITE,position);
+    for (i = 0; i < gf3d_render_stats.lastPipeCount; i++)
+    {
+        pipe = &gf3d_render_stats.lastPipes[i];
+        position.y += 16;
+        gfc_line_sprintf(line,"  %s: %u draws, %u instances, %u triangles",pipe->name ? pipe->name : "pipeline",pipe->drawCalls,pipe->instances,pipe->triangles);
+        gf2d_font_draw_line_tag(line,FT_Small,GFC_COLOR_WHITE,position);
+    }
+    position.y += 16;
+    gfc_line_sprintf(line,"descriptor writes: %u  ubo: %.1fKB  uploaded: %.1fKB",last[RS_DescriptorWrites],last[RS_UboBytes] / 1024.0,last[RS_BytesUploaded] / 1024.0);
+    gf2d_font_draw_line_tag(line,FT_Small,GFC_COLOR_WHITE,position);
+    position.y += 16;
+    gfc_line_sprintf(line,"textures created: %u  glyphs: %u drawn %u rasterized",last[RS_TexturesCreated],last[RS_GlyphsDrawn],last[RS_GlyphsRasterized]);
+    gf2d_font_draw_line_tag(line,FT_Small,GFC_COLOR_WHITE,position);
+    position.y += 16;
+    gfc_line_sprintf(line,"text cache: %u hits %u misses",last[RS_TextCacheHits],last[RS_TextCacheMisses]);
+    // the overlay's own changing text misses the text cache, so this line is never quite zero while it is up
+    gf2d_font_draw_line_tag(line,FT_Small,GFC_COLOR_WHITE,position);
+    position.y += 16;
+    gfc_line_sprintf(line,"sprites: %u quads in %u batches",last[RS_SpriteQuads],last[RS_SpriteBatches]);
+    gf2d_font_draw_line_tag(line,FT_Small,GFC_COLOR_WHITE,position);
+    position.y += 16;
+    gfc_line_sprintf(line,"particles: %u in %u batches",last[RS_Particles],last[RS_ParticleBatches]);
+    gf2d_font_draw_line_tag(line,FT_Small,GFC_COLOR_WHITE,position);
+    position.y += 16;
+    gfc_line_sprintf(line,"entities: %u visible %u culled",last[RS_EntitiesVisible],last[RS_EntitiesCulled]);
+    gf2d_font_draw_line_tag(line,FT_Small,GFC_COLOR_WHITE,position);
+    position.y += 16;
+    gfc_line_sprintf(line,"frame arena: %.1fKB  heap allocs: %u (arenas %u)",last[RS_FrameArenaBytes] / 1024.0,last[RS_HeapAllocs],last[RS_ArenaHeapAllocs]);
+    gf2d_font_draw_line_tag(line,FT_Small,GFC_COLOR_WHITE,position);
+    if (gf3d_texture_stream_get_budget())
+    {
+        position.y += 16;
+        gfc_line_sprintf(line,"streamed textures: %.1fMB of %.1fMB  uploads: %u  evictions: %u",
+            gf3d_texture_stream_get_resident() / (1024.0 * 1024.0),
+            gf3d_texture_stream_get_budget() / (1024.0 * 1024.0),
+            last[RS_TextureStreamUploads],last[RS_TextureEvictions]);
+        gf2d_font_draw_line_tag(line,FT_Small,GFC_COLOR_WHITE,position);
+    }
+}
+
+/*eol@eof*/
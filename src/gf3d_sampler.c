@@ -0,0 +1,212 @@
+#include <string.h>
+
+#include "simple_logger.h"
+
+#include "gf3d_vgraphics.h"
+#include "gf3d_memory.h"
+#include "gf3d_config.h"
+#include "gf3d_sampler.h"
+
+typedef struct
+{
+    Uint8           _inuse;
+    Uint32          refCount;
+    SamplerState    state;
+    VkSampler       sampler;
+}SamplerEntry;
+
+typedef struct
+{
+    SamplerEntry   *samplers;
+    Uint32          maxSamplers;
+    Uint32          count;
+    VkDevice        device;
+    float           maxAnisotropy;  /**<the device limit, 0 if anisotropic filtering is not supported*/
+    SamplerEntry   *fallback;       /**<the default sampler, held by the cache so it is always there to hand out*/
+}SamplerManager;
+
+extern int __DEBUG;
+static SamplerManager gf3d_sampler = {0};
+
+void gf3d_sampler_close();
+
+void gf3d_sampler_init(Uint32 maxSamplers)
+{
+    VkPhysicalDeviceFeatures features;
+    VkPhysicalDeviceProperties properties;
+
+    if (!maxSamplers)
+    {
+        slog("cannot initialize sampler cache for 0 samplers");
+        return;
+    }
+    gf3d_sampler.samplers = gf3d_memory_alloc_array(MT_Texture,sizeof(SamplerEntry),maxSamplers);
+    if (!gf3d_sampler.samplers)
+    {
+        slog("failed to initialize sampler cache: not enough memory");
+        return;
+    }
+    gf3d_sampler.maxSamplers = maxSamplers;
+    gf3d_sampler.device = gf3d_vgraphics_get_default_logical_device();
+    // the device is created with every feature it supports, so support is enough to use it
+    vkGetPhysicalDeviceFeatures(gf3d_vgraphics_get_default_physical_device(),&features);
+    vkGetPhysicalDeviceProperties(gf3d_vgraphics_get_default_physical_device(),&properties);
+    if (features.samplerAnisotropy)gf3d_sampler.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
+    if (gf3d_sampler_get(NULL) != VK_NULL_HANDLE)gf3d_sampler.fallback = &gf3d_sampler.samplers[0];
+    atexit(gf3d_sampler_close);
+    if (__DEBUG)slog("sampler cache initialized, max anisotropy %.0f",gf3d_sampler.maxAnisotropy);
+}
+
+void gf3d_sampler_close()
+{
+    Uint32 i;
+    if (!gf3d_sampler.samplers)return;
+    if (gf3d_sampler.fallback)gf3d_sampler.fallback->refCount--;// the cache's own reference
+    for (i = 0; i < gf3d_sampler.maxSamplers; i++)
+    {
+        if (!gf3d_sampler.samplers[i]._inuse)continue;
+        if ((__DEBUG)&&(gf3d_sampler.samplers[i].refCount))slog("sampler %u still has %u references at close",i,gf3d_sampler.samplers[i].refCount);
+        vkDestroySampler(gf3d_sampler.device,gf3d_sampler.samplers[i].sampler,NULL);
+    }
+    gf3d_memory_free(gf3d_sampler.samplers);
+    memset(&gf3d_sampler,0,sizeof(SamplerManager));
+}
+
+SamplerState gf3d_sampler_state_default()
+{
+    SamplerState state = {0};
+    state.magFilter = VK_FILTER_LINEAR;
+    state.minFilter = VK_FILTER_LINEAR;
+    state.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    state.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    state.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    state.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    state.maxAnisotropy = 16;
+    state.minLod = 0;
+    state.maxLod = VK_LOD_CLAMP_NONE;
+    return state;
+}
+
+SamplerState gf3d_sampler_state_from_json(SJson *json)
+{
+    const char *str;
+    SamplerState state;
+
+    state = gf3d_sampler_state_default();
+    if (!json)return state;
+    if ((str = sj_object_get_value_as_string(json,"magFilter")))state.magFilter = gf3d_config_filter_from_str(str);
+    if ((str = sj_object_get_value_as_string(json,"minFilter")))state.minFilter = gf3d_config_filter_from_str(str);
+    if ((str = sj_object_get_value_as_string(json,"mipmapMode")))state.mipmapMode = gf3d_config_sampler_mipmap_mode_from_str(str);
+    if ((str = sj_object_get_value_as_string(json,"addressMode")))
+    {
+        state.addressModeU = state.addressModeV = state.addressModeW = gf3d_config_sampler_address_mode_from_str(str);
+    }
+    if ((str = sj_object_get_value_as_string(json,"addressModeU")))state.addressModeU = gf3d_config_sampler_address_mode_from_str(str);
+    if ((str = sj_object_get_value_as_string(json,"addressModeV")))state.addressModeV = gf3d_config_sampler_address_mode_from_str(str);
+    if ((str = sj_object_get_value_as_string(json,"addressModeW")))state.addressModeW = gf3d_config_sampler_address_mode_from_str(str);
+    sj_get_float_value(sj_object_get_value(json,"maxAnisotropy"),&state.maxAnisotropy);
+    sj_get_float_value(sj_object_get_value(json,"minLod"),&state.minLod);
+    sj_get_float_value(sj_object_get_value(json,"maxLod"),&state.maxLod);
+    return state;
+}
+
+/**
+ * @brief hand out another reference to the default sampler when a state could not get its own
+ * @return VK_NULL_HANDLE if there is no default sampler either
+ */
+VkSampler gf3d_sampler_get_fallback()
+{
+    if (!gf3d_sampler.fallback)return VK_NULL_HANDLE;
+    slog("using the default sampler instead");
+    gf3d_sampler.fallback->refCount++;
+    return gf3d_sampler.fallback->sampler;
+}
+
+VkSampler gf3d_sampler_get(const SamplerState *state)
+{
+    Uint32 i;
+    SamplerState key;
+    SamplerEntry *entry = NULL;
+    VkSamplerCreateInfo samplerInfo = {0};
+
+    if (!gf3d_sampler.samplers)
+    {
+        slog("sampler cache not initialized");
+        return VK_NULL_HANDLE;
+    }
+    key = state ? *state : gf3d_sampler_state_default();
+    // clamp first, so states asking for more than the device has share a sampler
+    key.maxAnisotropy = MIN(key.maxAnisotropy,gf3d_sampler.maxAnisotropy);
+    if (key.maxAnisotropy <= 1)key.maxAnisotropy = 0;
+    for (i = 0; i < gf3d_sampler.maxSamplers; i++)
+    {
+        if (!gf3d_sampler.samplers[i]._inuse)
+        {
+            if (!entry)entry = &gf3d_sampler.samplers[i];
+            continue;
+        }
+        if (memcmp(&gf3d_sampler.samplers[i].state,&key,sizeof(SamplerState)) == 0)
+        {
+            gf3d_sampler.samplers[i].refCount++;
+            return gf3d_sampler.samplers[i].sampler;
+        }
+    }
+    if (!entry)
+    {
+        slog("no free sampler slots, %u samplers are in use",gf3d_sampler.maxSamplers);
+        return gf3d_sampler_get_fallback();
+    }
+
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = key.magFilter;
+    samplerInfo.minFilter = key.minFilter;
+    samplerInfo.addressModeU = key.addressModeU;
+    samplerInfo.addressModeV = key.addressModeV;
+    samplerInfo.addressModeW = key.addressModeW;
+    samplerInfo.anisotropyEnable = key.maxAnisotropy > 0 ? VK_TRUE : VK_FALSE;
+    samplerInfo.maxAnisotropy = key.maxAnisotropy > 0 ? key.maxAnisotropy : 1;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerInfo.mipmapMode = key.mipmapMode;
+    samplerInfo.mipLodBias = 0.0f;
+    samplerInfo.minLod = key.minLod;
+    samplerInfo.maxLod = key.maxLod;
+
+    if (vkCreateSampler(gf3d_sampler.device, &samplerInfo, NULL, &entry->sampler) != VK_SUCCESS)
+    {
+        slog("failed to create texture sampler!");
+        entry->sampler = VK_NULL_HANDLE;
+        return gf3d_sampler_get_fallback();
+    }
+    entry->_inuse = 1;
+    entry->refCount = 1;
+    entry->state = key;
+    gf3d_sampler.count++;
+    if (__DEBUG)slog("created sampler, %u live",gf3d_sampler.count);
+    return entry->sampler;
+}
+
+void gf3d_sampler_free(VkSampler sampler)
+{
+    Uint32 i;
+    if ((sampler == VK_NULL_HANDLE)||(!gf3d_sampler.samplers))return;
+    for (i = 0; i < gf3d_sampler.maxSamplers; i++)
+    {
+        if ((!gf3d_sampler.samplers[i]._inuse)||(gf3d_sampler.samplers[i].sampler != sampler))continue;
+        if (gf3d_sampler.samplers[i].refCount)gf3d_sampler.samplers[i].refCount--;
+        if (gf3d_sampler.samplers[i].refCount)return;
+        vkDestroySampler(gf3d_sampler.device,sampler,NULL);
+        memset(&gf3d_sampler.samplers[i],0,sizeof(SamplerEntry));
+        gf3d_sampler.count--;
+        return;
+    }
+}
+
+Uint32 gf3d_sampler_get_count()
+{
+    return gf3d_sampler.count;
+}
+
+/*eol@eof*/
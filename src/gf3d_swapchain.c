@@ -3,10 +3,14 @@
 
 #include "simple_logger.h"
 
+#include "gf3d_buffers.h"
+#include "gf3d_memory.h"
 #include "gf3d_swapchain.h"
 #include "gf3d_vqueues.h"
 #include "gf3d_vgraphics.h"
 
+#define GF3D_SWAPCHAIN_OFFSCREEN_IMAGES 2
+
 extern int __DEBUG;
 
 typedef struct
@@ -30,6 +34,9 @@ typedef struct
     VkImage                     depthImage;
     VkDeviceMemory              depthImageMemory;
     VkImageView                 depthImageView;
+    Bool                        offscreen;              // images are our own, not the presentation engine's
+    VkFormat                    offscreenFormat;
+    VkDeviceMemory             *offscreenMemory;        // one per swap image when offscreen
 }vSwapChain;
 
 static vSwapChain gf3d_swapchain = {0};
@@ -53,7 +60,7 @@ void gf3d_swapchain_init(VkPhysicalDevice device,VkDevice logicalDevice,VkSurfac
 
     if (gf3d_swapchain.formatCount != 0)
     {
-        gf3d_swapchain.formats = (VkSurfaceFormatKHR*)gfc_allocate_array(sizeof(VkSurfaceFormatKHR),gf3d_swapchain.formatCount);
+        gf3d_swapchain.formats = (VkSurfaceFormatKHR*)gf3d_memory_alloc_array(MT_Swapchain,sizeof(VkSurfaceFormatKHR),gf3d_swapchain.formatCount);
         vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &gf3d_swapchain.formatCount, gf3d_swapchain.formats);
         if (__DEBUG)
         {
@@ -70,7 +77,7 @@ void gf3d_swapchain_init(VkPhysicalDevice device,VkDevice logicalDevice,VkSurfac
 
     if (gf3d_swapchain.presentModeCount != 0)
     {
-        gf3d_swapchain.presentModes = (VkPresentModeKHR*)gfc_allocate_array(sizeof(VkPresentModeKHR),gf3d_swapchain.presentModeCount);
+        gf3d_swapchain.presentModes = (VkPresentModeKHR*)gf3d_memory_alloc_array(MT_Swapchain,sizeof(VkPresentModeKHR),gf3d_swapchain.presentModeCount);
         vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &gf3d_swapchain.presentModeCount, gf3d_swapchain.presentModes);
         if (__DEBUG)
         {
@@ -93,6 +100,49 @@ void gf3d_swapchain_init(VkPhysicalDevice device,VkDevice logicalDevice,VkSurfac
     atexit(gf3d_swapchain_close);
 }
 
+void gf3d_swapchain_init_offscreen(VkDevice logicalDevice,Uint32 width,Uint32 height)
+{
+    int i;
+
+    gf3d_swapchain.device = logicalDevice;
+    gf3d_swapchain.offscreen = true;
+    gf3d_swapchain.offscreenFormat = VK_FORMAT_B8G8R8A8_UNORM;
+    gf3d_swapchain.extent.width = width;
+    gf3d_swapchain.extent.height = height;
+    gf3d_swapchain.swapChainCount = GF3D_SWAPCHAIN_OFFSCREEN_IMAGES;
+    gf3d_swapchain.swapImageCount = GF3D_SWAPCHAIN_OFFSCREEN_IMAGES;
+    atexit(gf3d_swapchain_close);
+
+    gf3d_swapchain.swapImages = (VkImage *)gf3d_memory_alloc_array(MT_Swapchain,sizeof(VkImage),gf3d_swapchain.swapImageCount);
+    gf3d_swapchain.offscreenMemory = (VkDeviceMemory *)gf3d_memory_alloc_array(MT_Swapchain,sizeof(VkDeviceMemory),gf3d_swapchain.swapImageCount);
+    gf3d_swapchain.imageViews = (VkImageView *)gf3d_memory_alloc_array(MT_Swapchain,sizeof(VkImageView),gf3d_swapchain.swapImageCount);
+    if ((!gf3d_swapchain.swapImages)||(!gf3d_swapchain.offscreenMemory)||(!gf3d_swapchain.imageViews))
+    {
+        slog("failed to allocate offscreen images");
+        gf3d_swapchain_close();
+        return;
+    }
+    for (i = 0; i < gf3d_swapchain.swapImageCount; i++)
+    {
+        gf3d_swapchain_create_image(
+            width,
+            height,
+            gf3d_swapchain.offscreenFormat,
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            &gf3d_swapchain.swapImages[i],
+            &gf3d_swapchain.offscreenMemory[i]);
+        gf3d_swapchain.imageViews[i] = gf3d_vgraphics_create_image_view(gf3d_swapchain.swapImages[i],gf3d_swapchain.offscreenFormat);
+    }
+    if (__DEBUG)slog("rendering offscreen to %i images at (%i,%i)",gf3d_swapchain.swapImageCount,width,height);
+}
+
+Bool gf3d_swapchain_is_offscreen()
+{
+    return gf3d_swapchain.offscreen;
+}
+
 void gf3d_swapchain_create_frame_buffer(VkFramebuffer *buffer,VkImageView *imageView,Pipeline *pipe)
 {
     VkFramebufferCreateInfo framebufferInfo = {0};
@@ -129,7 +179,7 @@ void gf3d_swapchain_setup_frame_buffers(Pipeline *pipe)
         slog("failed to setup frame buffers for pipeline, no pipeline specified");
         return;
     }
-    gf3d_swapchain.frameBuffers = (VkFramebuffer *)gfc_allocate_array(sizeof(VkFramebuffer),gf3d_swapchain.swapImageCount);
+    gf3d_swapchain.frameBuffers = (VkFramebuffer *)gf3d_memory_alloc_array(MT_Swapchain,sizeof(VkFramebuffer),gf3d_swapchain.swapImageCount);
     for (i = 0; i < gf3d_swapchain.swapImageCount;i++)
     {
         gf3d_swapchain_create_frame_buffer(&gf3d_swapchain.frameBuffers[i],&gf3d_swapchain.imageViews[i],pipe);
@@ -139,6 +189,7 @@ void gf3d_swapchain_setup_frame_buffers(Pipeline *pipe)
 
 VkFormat gf3d_swapchain_get_format()
 {
+    if (gf3d_swapchain.offscreen)return gf3d_swapchain.offscreenFormat;
     return gf3d_swapchain.formats[gf3d_swapchain.chosenFormat].format;
 }
 
@@ -202,10 +253,10 @@ void gf3d_swapchain_create(VkDevice device,VkSurfaceKHR surface)
         gf3d_swapchain_close();
         return;
     }
-    gf3d_swapchain.swapImages = (VkImage *)gfc_allocate_array(sizeof(VkImage),gf3d_swapchain.swapImageCount);
+    gf3d_swapchain.swapImages = (VkImage *)gf3d_memory_alloc_array(MT_Swapchain,sizeof(VkImage),gf3d_swapchain.swapImageCount);
     vkGetSwapchainImagesKHR(device, gf3d_swapchain.swapChain, &gf3d_swapchain.swapImageCount,gf3d_swapchain.swapImages );
     
-    gf3d_swapchain.imageViews = (VkImageView *)gfc_allocate_array(sizeof(VkImageView),gf3d_swapchain.swapImageCount);
+    gf3d_swapchain.imageViews = (VkImageView *)gf3d_memory_alloc_array(MT_Swapchain,sizeof(VkImageView),gf3d_swapchain.swapImageCount);
     for (i = 0 ; i < gf3d_swapchain.swapImageCount; i++)
     {
         gf3d_swapchain.imageViews[i] = gf3d_vgraphics_create_image_view(gf3d_swapchain.swapImages[i],gf3d_swapchain.formats[gf3d_swapchain.chosenFormat].format);
@@ -273,7 +324,7 @@ void gf3d_swapchain_close()
     }
     if (gf3d_swapchain.depthImageMemory != VK_NULL_HANDLE)
     {
-        vkFreeMemory(gf3d_swapchain.device, gf3d_swapchain.depthImageMemory, NULL);
+        gf3d_memory_vk_free(gf3d_swapchain.device, gf3d_swapchain.depthImageMemory);
     }
     if (gf3d_swapchain.frameBuffers)
     {
@@ -283,32 +334,55 @@ void gf3d_swapchain_close()
         }
         free (gf3d_swapchain.frameBuffers);
     }
-    vkDestroySwapchainKHR(gf3d_swapchain.device, gf3d_swapchain.swapChain, NULL);
+    if (gf3d_swapchain.swapChain != VK_NULL_HANDLE)
+    {
+        vkDestroySwapchainKHR(gf3d_swapchain.device, gf3d_swapchain.swapChain, NULL);
+    }
     if (gf3d_swapchain.imageViews)
     {
         for (i = 0;i < gf3d_swapchain.swapImageCount;i++)
         {
+            if (gf3d_swapchain.imageViews[i] == VK_NULL_HANDLE)continue;
             vkDestroyImageView(gf3d_swapchain.device,gf3d_swapchain.imageViews[i],NULL);
         }
-        free(gf3d_swapchain.imageViews);
+        gf3d_memory_free(gf3d_swapchain.imageViews);
     }
     if (gf3d_swapchain.swapImages)
     {
-        free(gf3d_swapchain.swapImages);
+        if (gf3d_swapchain.offscreen)
+        {
+            // offscreen images are ours to destroy, swap chain images belong to the swap chain
+            for (i = 0;i < gf3d_swapchain.swapImageCount;i++)
+            {
+                if (gf3d_swapchain.swapImages[i] == VK_NULL_HANDLE)continue;
+                vkDestroyImage(gf3d_swapchain.device,gf3d_swapchain.swapImages[i],NULL);
+            }
+        }
+        gf3d_memory_free(gf3d_swapchain.swapImages);
+    }
+    if (gf3d_swapchain.offscreenMemory)
+    {
+        for (i = 0;i < gf3d_swapchain.swapImageCount;i++)
+        {
+            if (gf3d_swapchain.offscreenMemory[i] == VK_NULL_HANDLE)continue;
+            gf3d_memory_vk_free(gf3d_swapchain.device,gf3d_swapchain.offscreenMemory[i]);
+        }
+        gf3d_memory_free(gf3d_swapchain.offscreenMemory);
     }
     if (gf3d_swapchain.formats)
     {
-        free(gf3d_swapchain.formats);
+        gf3d_memory_free(gf3d_swapchain.formats);
     }
     if (gf3d_swapchain.presentModes)
     {
-        free(gf3d_swapchain.presentModes);
+        gf3d_memory_free(gf3d_swapchain.presentModes);
     }
     memset(&gf3d_swapchain,0,sizeof(vSwapChain));
 }
 
 Bool gf3d_swapchain_validation_check()
 {
+    if (gf3d_swapchain.offscreen)return true;
     if (!gf3d_swapchain.presentModeCount)
     {
         slog("swapchain has no usable presentation modes");
@@ -467,6 +541,75 @@ void gf3d_swapchain_create_depth_image()
     gf3d_swapchain_transition_image_layout(gf3d_swapchain.depthImage, gf3d_pipeline_find_depth_format(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
 }
 
+SDL_Surface *gf3d_swapchain_read_back_image(Uint32 index)
+{
+    SDL_Surface *surface;
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    VkDeviceSize size;
+    VkBufferImageCopy region = {0};
+    VkCommandBuffer commandBuffer;
+    Command *commandPool;
+    void *data;
+    Uint32 row,rowSize;
+
+    if (!gf3d_swapchain.offscreen)
+    {
+        slog("can only read back frames when rendering offscreen");
+        return NULL;
+    }
+    if (index >= gf3d_swapchain.swapImageCount)
+    {
+        slog("swap image index %i out of range",index);
+        return NULL;
+    }
+    rowSize = gf3d_swapchain.extent.width * 4;
+    size = (VkDeviceSize)rowSize * gf3d_swapchain.extent.height;
+    if (!gf3d_buffer_create(
+        size,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &stagingBuffer,
+        &stagingBufferMemory,
+        MT_Staging))
+    {
+        slog("failed to create a buffer to read back the frame");
+        return NULL;
+    }
+
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent.width = gf3d_swapchain.extent.width;
+    region.imageExtent.height = gf3d_swapchain.extent.height;
+    region.imageExtent.depth = 1;
+
+    // render passes leave offscreen images in transfer source layout, ready for this
+    commandPool = gf3d_vgraphics_get_graphics_command_pool();
+    commandBuffer = gf3d_command_begin_single_time(commandPool);
+    vkCmdCopyImageToBuffer(commandBuffer,gf3d_swapchain.swapImages[index],VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,stagingBuffer,1,&region);
+    gf3d_command_end_single_time(commandPool, commandBuffer);
+
+    surface = SDL_CreateRGBSurfaceWithFormat(0,gf3d_swapchain.extent.width,gf3d_swapchain.extent.height,32,SDL_PIXELFORMAT_BGRA32);
+    if (!surface)
+    {
+        slog("failed to create surface for the frame: %s",SDL_GetError());
+    }
+    else
+    {
+        vkMapMemory(gf3d_swapchain.device, stagingBufferMemory, 0, size, 0, &data);
+        for (row = 0; row < gf3d_swapchain.extent.height; row++)
+        {
+            memcpy((Uint8*)surface->pixels + row * surface->pitch,(Uint8*)data + row * rowSize,rowSize);
+        }
+        vkUnmapMemory(gf3d_swapchain.device, stagingBufferMemory);
+    }
+    vkDestroyBuffer(gf3d_swapchain.device, stagingBuffer, NULL);
+    gf3d_memory_vk_free(gf3d_swapchain.device, stagingBufferMemory);
+    return surface;
+}
+
 uint32_t gf3d_swapchain_find_Memory_type(uint32_t typeFilter, VkMemoryPropertyFlags properties)
 {
     uint32_t i;
@@ -517,7 +660,7 @@ void gf3d_swapchain_create_image(uint32_t width, uint32_t height, VkFormat forma
     allocInfo.allocationSize = memRequirements.size;
     allocInfo.memoryTypeIndex = gf3d_swapchain_find_Memory_type(memRequirements.memoryTypeBits, properties);
 
-    if (vkAllocateMemory(gf3d_swapchain.device, &allocInfo, NULL, imageMemory) != VK_SUCCESS)
+    if (gf3d_memory_vk_allocate(gf3d_swapchain.device, &allocInfo, MT_Swapchain, imageMemory) != VK_SUCCESS)
     {
         slog("failed to allocate image memory!");
     }
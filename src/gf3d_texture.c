@@ -1,19 +1,29 @@
 #include <SDL_image.h>
 
 #include "simple_logger.h"
+#include "simple_json.h"
 
 #include "gfc_pak.h"
 
 #include "gf3d_vgraphics.h"
 #include "gf3d_buffers.h"
+#include "gf3d_memory.h"
 #include "gf3d_swapchain.h"
+#include "gf3d_compressed.h"
+#include "gf3d_sampler.h"
 #include "gf3d_texture.h"
+#include "gf3d_profiler.h"
+#include "gf3d_render_stats.h"
 
 typedef struct
 {
     Uint32          max_textures;
     Texture       * texture_list;
     VkDevice        device;
+    Uint8           mipmaps;        /**<build a full mip chain for 3d textures*/
+    Uint8           mipFiles;       /**<look for precomputed mip levels next to the image file*/
+    Uint8           blitMips;       /**<the device can linearly blit RGBA8, so mips are made on the gpu*/
+    Uint8           compressed;     /**<load a baked .dds in place of a .png when there is one*/
 }TextureManager;
 
 extern int __DEBUG;
@@ -23,14 +33,20 @@ void gf3d_texture_close();
 void gf3d_texture_delete(Texture *tex);
 void gf3d_texture_delete_all();
 
-void gf3d_texture_init(Uint32 max_textures)
+void gf3d_texture_init(Uint32 max_textures,const char *config)
 {
+    SJson *json,*setup;
+    short int mipmaps = 1;
+    short int mipFiles = 0;
+    short int compressed = 0;
+    VkFormatProperties formatProps;
+    VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
     if (!max_textures)
     {
         slog("cannot initialize texture system for 0 textures");
         return;
     }
-    gf3d_texture.texture_list = gfc_allocate_array(sizeof(Texture),max_textures);
+    gf3d_texture.texture_list = gf3d_memory_alloc_array(MT_Texture,sizeof(Texture),max_textures);
     if (!gf3d_texture.texture_list)
     {
         slog("failed to initialize texture system: not enough memory");
@@ -38,8 +54,25 @@ void gf3d_texture_init(Uint32 max_textures)
     }
     gf3d_texture.max_textures = max_textures;
     gf3d_texture.device = gf3d_vgraphics_get_default_logical_device();
+    if (config)
+    {
+        json = gfc_pak_load_json(config);
+        if (json)
+        {
+            setup = sj_object_get_value(json,"setup");
+            sj_get_bool_value(sj_object_get_value(setup,"mipmaps"),&mipmaps);
+            sj_get_bool_value(sj_object_get_value(setup,"mip_files"),&mipFiles);
+            sj_get_bool_value(sj_object_get_value(setup,"compressed_textures"),&compressed);
+            sj_free(json);
+        }
+    }
+    gf3d_texture.mipmaps = mipmaps;
+    gf3d_texture.mipFiles = mipFiles;
+    gf3d_texture.compressed = compressed;
+    vkGetPhysicalDeviceFormatProperties(gf3d_vgraphics_get_default_physical_device(),VK_FORMAT_R8G8B8A8_UNORM,&formatProps);
+    gf3d_texture.blitMips = ((formatProps.optimalTilingFeatures & blitFeatures) == blitFeatures);
     atexit(gf3d_texture_close);
-    if (__DEBUG)slog("texture system initialized");
+    if (__DEBUG)slog("texture system initialized, mipmaps %s",!mipmaps ? "off" : gf3d_texture.blitMips ? "blit on the gpu" : "filtered on the cpu");
 }
 
 void gf3d_texture_close()
@@ -48,7 +81,7 @@ void gf3d_texture_close()
     gf3d_texture_delete_all();
     if (gf3d_texture.texture_list != NULL)
     {
-        free(gf3d_texture.texture_list);
+        gf3d_memory_free(gf3d_texture.texture_list);
     }
 }
 
@@ -78,13 +111,12 @@ Texture *gf3d_texture_new()
     return NULL;
 }
 
-void gf3d_texture_delete(Texture *tex)
+void gf3d_texture_release_image(Texture *tex)
 {
     if (!tex)return;
-    
     if ((tex->textureSampler)&&(tex->textureSampler != VK_NULL_HANDLE))
     {
-        vkDestroySampler(gf3d_texture.device, tex->textureSampler, NULL);
+        gf3d_sampler_free(tex->textureSampler);
     }
     if ((tex->textureImageView)&&(tex->textureImageView != VK_NULL_HANDLE))
     {
@@ -96,8 +128,20 @@ void gf3d_texture_delete(Texture *tex)
     }
     if ((tex->textureImage)&&(tex->textureImageMemory != VK_NULL_HANDLE))
     {
-        vkFreeMemory(gf3d_texture.device, tex->textureImageMemory, NULL);
+        gf3d_memory_vk_free(gf3d_texture.device, tex->textureImageMemory);
     }
+    tex->textureSampler = VK_NULL_HANDLE;
+    tex->textureImageView = VK_NULL_HANDLE;
+    tex->textureImage = VK_NULL_HANDLE;
+    tex->textureImageMemory = VK_NULL_HANDLE;
+    tex->residentBytes = 0;
+}
+
+void gf3d_texture_delete(Texture *tex)
+{
+    if (!tex)return;
+    
+    gf3d_texture_release_image(tex);
     if (tex->surface)
     {
         SDL_FreeSurface(tex->surface);
@@ -135,122 +179,266 @@ Texture *gf3d_texture_get_by_filename(const char * filename)
     return NULL;
 }
 
-void gf3d_texture_copy_buffer_to_image(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
+Uint32 gf3d_texture_get_mip_count(Uint32 width,Uint32 height)
+{
+    Uint32 levels = 1;
+    while ((width > 1)||(height > 1))
+    {
+        width = MAX(1,width >> 1);
+        height = MAX(1,height >> 1);
+        levels++;
+    }
+    return levels;
+}
+
+SDL_Surface *gf3d_texture_mip_downsample(SDL_Surface *src)
+{
+    SDL_Surface *dst;
+    Uint32 x,y,sx,sy,x0,x1,y0,y1;
+    Uint32 dw,dh;
+    Uint32 sum[3],weight,count;
+    Uint8 *in,*out;
+
+    if (!src)return NULL;
+    dw = MAX(1,src->w >> 1);
+    dh = MAX(1,src->h >> 1);
+    dst = SDL_CreateRGBSurfaceWithFormat(0,dw,dh,32,src->format->format);
+    if (!dst)
+    {
+        slog("failed to create mip level %ux%u: %s",dw,dh,SDL_GetError());
+        return NULL;
+    }
+    SDL_LockSurface(src);
+    SDL_LockSurface(dst);
+    for (y = 0; y < dh; y++)
+    {
+        // odd sizes fold the leftover row and column into the last texel instead of dropping them
+        y0 = y * src->h / dh;
+        y1 = (y + 1) * src->h / dh;
+        out = (Uint8 *)dst->pixels + y * dst->pitch;
+        for (x = 0; x < dw; x++)
+        {
+            x0 = x * src->w / dw;
+            x1 = (x + 1) * src->w / dw;
+            memset(sum,0,sizeof(sum));
+            weight = count = 0;
+            for (sy = y0; sy < y1; sy++)
+            {
+                in = (Uint8 *)src->pixels + sy * src->pitch + x0 * 4;
+                for (sx = x0; sx < x1; sx++,in += 4,count++)
+                {
+                    // weight color by alpha so transparent texels do not darken the edges of cutouts
+                    sum[0] += in[0] * in[3];
+                    sum[1] += in[1] * in[3];
+                    sum[2] += in[2] * in[3];
+                    weight += in[3];
+                }
+            }
+            if (weight)
+            {
+                out[0] = (sum[0] + weight / 2) / weight;
+                out[1] = (sum[1] + weight / 2) / weight;
+                out[2] = (sum[2] + weight / 2) / weight;
+            }
+            else out[0] = out[1] = out[2] = 0;
+            out[3] = (weight + count / 2) / count;
+            out += 4;
+        }
+    }
+    SDL_UnlockSurface(dst);
+    SDL_UnlockSurface(src);
+    return dst;
+}
+
+/**
+ * @brief check if every texel of a 32 bit surface is fully opaque
+ */
+static Bool gf3d_texture_surface_is_opaque(SDL_Surface *surface)
 {
+    int x,y;
+    Uint8 *in;
+    if (!surface)return 0;
+    SDL_LockSurface(surface);
+    for (y = 0; y < surface->h; y++)
+    {
+        in = (Uint8 *)surface->pixels + y * surface->pitch + 3;
+        for (x = 0; x < surface->w; x++,in += 4)
+        {
+            if (*in == 255)continue;
+            SDL_UnlockSurface(surface);
+            return 0;
+        }
+    }
+    SDL_UnlockSurface(surface);
+    return 1;
+}
+
+void gf3d_texture_copy_surface(Uint8 *dst,SDL_Surface *surface)
+{
+    int y;
+    SDL_LockSurface(surface);
+    for (y = 0; y < surface->h; y++)
+    {
+        memcpy(dst + y * surface->w * 4,(Uint8 *)surface->pixels + y * surface->pitch,surface->w * 4);
+    }
+    SDL_UnlockSurface(surface);
+}
+
+void gf3d_texture_image_barrier(
+    VkCommandBuffer commandBuffer,
+    VkImage image,
+    Uint32 baseLevel,
+    Uint32 levelCount,
+    VkImageLayout oldLayout,
+    VkImageLayout newLayout,
+    VkAccessFlags srcAccess,
+    VkAccessFlags dstAccess,
+    VkPipelineStageFlags srcStage,
+    VkPipelineStageFlags dstStage)
+{
+    VkImageMemoryBarrier barrier = {0};
+
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = baseLevel;
+    barrier.subresourceRange.levelCount = levelCount;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    vkCmdPipelineBarrier(commandBuffer,srcStage,dstStage,0,0,NULL,0,NULL,1,&barrier);
+}
+
+/**
+ * @brief copy the uploaded levels into the image, blit the rest down from the last uploaded level and leave everything ready to sample
+ * @param stagingBuffer holds the uploaded levels back to back, largest first
+ * @param uploaded how many levels are in the staging buffer
+ */
+void gf3d_texture_upload_levels(Texture *tex,VkBuffer stagingBuffer,Uint32 uploaded)
+{
+    Uint32 i,levels;
+    Uint32 width,height,baseWidth,baseHeight;
+    VkDeviceSize offset = 0;
     VkCommandBuffer commandBuffer;
     Command * commandPool;
     VkBufferImageCopy region = {0};
+    VkImageBlit blit = {0};
 
+    // a streamed texture's image starts at its resident level, everything here is relative to that
+    levels = tex->mipLevels - tex->residentLevel;
+    baseWidth = MAX(1,tex->width >> tex->residentLevel);
+    baseHeight = MAX(1,tex->height >> tex->residentLevel);
     commandPool = gf3d_vgraphics_get_graphics_command_pool();
     commandBuffer = gf3d_command_begin_single_time(commandPool);
-    
-    
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
+
+    gf3d_texture_image_barrier(commandBuffer,tex->textureImage,0,levels,
+        VK_IMAGE_LAYOUT_UNDEFINED,VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        0,VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,VK_PIPELINE_STAGE_TRANSFER_BIT);
 
     region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
     region.imageSubresource.baseArrayLayer = 0;
     region.imageSubresource.layerCount = 1;
-
-    region.imageOffset.x = 0;
-    region.imageOffset.y = 0;
-    region.imageOffset.z = 0;
-    
-    region.imageExtent.width = width;
-    region.imageExtent.height = height;
     region.imageExtent.depth = 1;
-    
-    vkCmdCopyBufferToImage(
-        commandBuffer,
-        buffer,
-        image,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        1,
-        &region
-    );
+    width = baseWidth;
+    height = baseHeight;
+    for (i = 0; i < uploaded; i++)
+    {
+        region.bufferOffset = offset;
+        region.imageSubresource.mipLevel = i;
+        region.imageExtent.width = width;
+        region.imageExtent.height = height;
+        vkCmdCopyBufferToImage(commandBuffer,stagingBuffer,tex->textureImage,VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,1,&region);
+        offset += gf3d_compressed_level_size(tex->format,width,height);
+        width = MAX(1,width >> 1);
+        height = MAX(1,height >> 1);
+    }
+    gf3d_render_stats_add(RS_BytesUploaded,offset);
+
+    // when only part of the chain was uploaded, the levels above the last one are never blit sources
+    if ((uploaded > 1)&&(uploaded < levels))
+    {
+        gf3d_texture_image_barrier(commandBuffer,tex->textureImage,0,uploaded - 1,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT,VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+
+    // each blit reads the level above it, which then has nothing left to do but be sampled
+    blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.srcSubresource.layerCount = 1;
+    blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.dstSubresource.layerCount = 1;
+    blit.srcOffsets[1].z = 1;
+    blit.dstOffsets[1].z = 1;
+    for (i = uploaded; i < levels; i++)
+    {
+        gf3d_texture_image_barrier(commandBuffer,tex->textureImage,i - 1,1,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT,VK_ACCESS_TRANSFER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        blit.srcSubresource.mipLevel = i - 1;
+        blit.srcOffsets[1].x = MAX(1,baseWidth >> (i - 1));
+        blit.srcOffsets[1].y = MAX(1,baseHeight >> (i - 1));
+        blit.dstSubresource.mipLevel = i;
+        blit.dstOffsets[1].x = MAX(1,baseWidth >> i);
+        blit.dstOffsets[1].y = MAX(1,baseHeight >> i);
+        vkCmdBlitImage(commandBuffer,
+            tex->textureImage,VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            tex->textureImage,VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1,&blit,VK_FILTER_LINEAR);
+
+        gf3d_texture_image_barrier(commandBuffer,tex->textureImage,i - 1,1,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_READ_BIT,VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+    // whatever was not a blit source is still a transfer destination
+    i = (uploaded < levels) ? levels - 1 : 0;
+    gf3d_texture_image_barrier(commandBuffer,tex->textureImage,i,levels - i,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT,VK_ACCESS_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
 
     gf3d_command_end_single_time(commandPool, commandBuffer);
 }
 
 void gf3d_texture_create_sampler(Texture *tex)
 {
-    VkSamplerCreateInfo samplerInfo = {0};
-
     if (!tex)return;
-
-    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    samplerInfo.magFilter = VK_FILTER_LINEAR;
-    samplerInfo.minFilter = VK_FILTER_LINEAR;
-    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.anisotropyEnable = VK_TRUE;
-    samplerInfo.maxAnisotropy = 16;
-    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-    samplerInfo.unnormalizedCoordinates = VK_FALSE;
-    samplerInfo.compareEnable = VK_FALSE;
-    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    samplerInfo.mipLodBias = 0.0f;
-    samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = 0.0f;
-    
-    if (vkCreateSampler(gf3d_texture.device, &samplerInfo, NULL, &tex->textureSampler) != VK_SUCCESS)
-    {
-        slog("failed to create texture sampler!");
-        return;
-    }
+    // every texture samples the same way, the view limits the levels so one sampler covers any mip count
+    tex->textureSampler = gf3d_sampler_get(NULL);
 }
 
-Texture *gf3d_texture_convert_surface(SDL_Surface * surface)
+/**
+ * @brief create the image for the resident levels and bind its memory
+ * @note tex->format, size, mipLevels and residentLevel must be set.  On error the caller cleans up what was made
+ * @return 0 on error, 1 otherwise
+ */
+Uint8 gf3d_texture_allocate_image(Texture *tex,VkImageUsageFlags usage)
 {
-    void* data;
-    Texture *tex;
-    VkDeviceSize imageSize;
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
     VkImageCreateInfo imageInfo = {0};
     VkMemoryRequirements memRequirements;
     VkMemoryAllocateInfo allocInfo = {0};
 
-    if (!surface)
-    {
-        slog("no surface provided for texture conversion");
-        return NULL;
-    }
-
-    tex = gf3d_texture_new();
-    if (!tex)
-    {
-        SDL_FreeSurface(surface);
-        return NULL;
-    }
-    tex->surface = gf3d_vgraphics_screen_convert(&surface);
-    tex->width = tex->surface->w;
-    tex->height = tex->surface->h;
-    imageSize = tex->surface->w * tex->surface->h * 4;
-    
-    gf3d_buffer_create(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory);
-    
-    SDL_LockSurface(tex->surface);
-        vkMapMemory(gf3d_texture.device, stagingBufferMemory, 0, imageSize, 0, &data);
-            memcpy(data, tex->surface->pixels, imageSize);
-        vkUnmapMemory(gf3d_texture.device, stagingBufferMemory);
-    SDL_UnlockSurface(tex->surface);    
-    
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.extent.width = tex->surface->w;
-    imageInfo.extent.height = tex->surface->h;
+    imageInfo.extent.width = MAX(1,tex->width >> tex->residentLevel);
+    imageInfo.extent.height = MAX(1,tex->height >> tex->residentLevel);
     imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
+    imageInfo.mipLevels = tex->mipLevels - tex->residentLevel;
     imageInfo.arrayLayers = 1;    
-    imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    imageInfo.format = tex->format;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.usage = usage;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageInfo.flags = 0; // Optional
@@ -258,9 +446,7 @@ Texture *gf3d_texture_convert_surface(SDL_Surface * surface)
     if (vkCreateImage(gf3d_texture.device, &imageInfo, NULL, &tex->textureImage) != VK_SUCCESS)
     {
         slog("failed to create image!");
-        gf3d_texture_delete(tex);
-        SDL_FreeSurface(tex->surface);
-        return NULL;
+        return 0;
     }
     vkGetImageMemoryRequirements(gf3d_texture.device, tex->textureImage, &memRequirements);
 
@@ -268,46 +454,309 @@ Texture *gf3d_texture_convert_surface(SDL_Surface * surface)
     allocInfo.allocationSize = memRequirements.size;
     allocInfo.memoryTypeIndex = gf3d_vgraphics_find_memory_type(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-    if (vkAllocateMemory(gf3d_texture.device, &allocInfo, NULL, &tex->textureImageMemory) != VK_SUCCESS)
+    if (gf3d_memory_vk_allocate(gf3d_texture.device, &allocInfo, MT_Texture, &tex->textureImageMemory) != VK_SUCCESS)
     {
         slog("failed to allocate image memory!");
-        gf3d_texture_delete(tex);
-        return NULL;
+        return 0;
     }
+    tex->residentBytes = memRequirements.size;
 
     vkBindImageMemory(gf3d_texture.device, tex->textureImage, tex->textureImageMemory, 0);    
-    
-    gf3d_swapchain_transition_image_layout(tex->textureImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    return 1;
+}
+
+/**
+ * @brief create the image and its memory, upload the staged levels and make the view and sampler
+ * @note tex->format, size, mipLevels and residentLevel must be set.  The staging buffer is destroyed either way
+ * @param uploaded how many levels are staged, the rest are blitted
+ * @return 0 on error, after deleting the texture.  1 otherwise
+ */
+Uint8 gf3d_texture_create_image(Texture *tex,VkBuffer stagingBuffer,VkDeviceMemory stagingBufferMemory,Uint32 uploaded)
+{
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 
-    gf3d_texture_copy_buffer_to_image(stagingBuffer, tex->textureImage, tex->surface->w, tex->surface->h);
+    // blits read the level above, streamed textures copy their smaller levels out when evicted
+    if ((uploaded < tex->mipLevels - tex->residentLevel)||(tex->streamed))usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    if (!gf3d_texture_allocate_image(tex,usage))
+    {
+        gf3d_texture_delete(tex);
+        vkDestroyBuffer(gf3d_texture.device, stagingBuffer, NULL);
+        gf3d_memory_vk_free(gf3d_texture.device, stagingBufferMemory);
+        return 0;
+    }
     
-    gf3d_swapchain_transition_image_layout(tex->textureImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    gf3d_texture_upload_levels(tex,stagingBuffer,uploaded);
 
-    tex->textureImageView = gf3d_vgraphics_create_image_view(tex->textureImage, VK_FORMAT_R8G8B8A8_UNORM);
+    tex->textureImageView = gf3d_vgraphics_create_image_view(tex->textureImage, tex->format);
     
     gf3d_texture_create_sampler(tex);
     
     vkDestroyBuffer(gf3d_texture.device, stagingBuffer, NULL);
-    vkFreeMemory(gf3d_texture.device, stagingBufferMemory, NULL);
+    gf3d_memory_vk_free(gf3d_texture.device, stagingBufferMemory);
+    gf3d_render_stats_add(RS_TexturesCreated,1);
+    return 1;
+}
+
+/**
+ * @brief make a texture from a surface and any precomputed mip levels
+ * @param mips precomputed levels 1 through mipCount, each half the size of the one before.  They are freed
+ * @param retention whether the converted base level stays in tex->surface once it is on the gpu
+ */
+Texture *gf3d_texture_convert_surface_levels(SDL_Surface * surface,Uint8 mipmaps,SDL_Surface **mips,Uint32 mipCount,TextureRetention retention)
+{
+    Uint32 i,uploaded;
+    Uint8 blit;
+    Uint8* data;
+    Texture *tex;
+    SDL_Surface *level,*next;
+    VkDeviceSize imageSize,offset;
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+
+    if (!surface)
+    {
+        slog("no surface provided for texture conversion");
+        for (i = 0; i < mipCount; i++)SDL_FreeSurface(mips[i]);
+        return NULL;
+    }
+
+    tex = gf3d_texture_new();
+    if (!tex)
+    {
+        SDL_FreeSurface(surface);
+        for (i = 0; i < mipCount; i++)SDL_FreeSurface(mips[i]);
+        return NULL;
+    }
+    tex->surface = gf3d_vgraphics_screen_convert(&surface);
+    tex->width = tex->surface->w;
+    tex->height = tex->surface->h;
+    tex->format = VK_FORMAT_R8G8B8A8_UNORM;
+    tex->mipLevels = 1;
+    if ((mipmaps)&&(gf3d_texture.mipmaps))tex->mipLevels = gf3d_texture_get_mip_count(tex->width,tex->height);
+    for (i = tex->mipLevels - 1; i < mipCount; i++)SDL_FreeSurface(mips[i]);
+    mipCount = MIN(mipCount,tex->mipLevels - 1);
+
+    // levels come from disk first, then from the gpu if it can blit, otherwise they are filtered here.
+    // the blit does not weight color by alpha, so anything with transparency is filtered here on every device
+    blit = gf3d_texture.blitMips;
+    if ((blit)&&(tex->mipLevels > 1 + mipCount)&&(!gf3d_texture_surface_is_opaque(tex->surface)))blit = 0;
+    uploaded = 1 + mipCount;
+    if (!blit)uploaded = tex->mipLevels;
+    imageSize = 0;
+    for (i = 0; i < uploaded; i++)
+    {
+        imageSize += MAX(1,tex->width >> i) * MAX(1,tex->height >> i) * 4;
+    }
+    
+    gf3d_buffer_create(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory, MT_Staging);
+    
+    vkMapMemory(gf3d_texture.device, stagingBufferMemory, 0, imageSize, 0, (void **)&data);
+        gf3d_texture_copy_surface(data,tex->surface);
+        offset = tex->width * tex->height * 4;
+        level = tex->surface;
+        for (i = 1; i < uploaded; i++)
+        {
+            if (i <= mipCount)next = gf3d_vgraphics_screen_convert(&mips[i - 1]);
+            else next = gf3d_texture_mip_downsample(level);
+            if (!next)break;
+            gf3d_texture_copy_surface(data + offset,next);
+            offset += next->w * next->h * 4;
+            if (level != tex->surface)SDL_FreeSurface(level);
+            level = next;
+        }
+        if (level != tex->surface)SDL_FreeSurface(level);
+    vkUnmapMemory(gf3d_texture.device, stagingBufferMemory);
+    for (; i <= mipCount; i++)SDL_FreeSurface(mips[i - 1]);
+    if (i < uploaded)
+    {
+        // a level failed part way down the chain, blit the rest or sample what made it
+        if (!blit)tex->mipLevels = i;
+        uploaded = i;
+    }
+    
+    if (!gf3d_texture_create_image(tex,stagingBuffer,stagingBufferMemory,uploaded))return NULL;
+    if (retention == TR_GpuOnly)
+    {
+        // the staging copy is gone too, the gpu image is all that is left
+        SDL_FreeSurface(tex->surface);
+        tex->surface = NULL;
+    }
     return tex;
 }
 
+Texture *gf3d_texture_convert_surface_full(SDL_Surface * surface,Uint8 mipmaps,TextureRetention retention)
+{
+    return gf3d_texture_convert_surface_levels(surface,mipmaps,NULL,0,retention);
+}
 
-Texture *gf3d_texture_load(const char *filename)
+Texture *gf3d_texture_convert_surface(SDL_Surface * surface)
+{
+    return gf3d_texture_convert_surface_levels(surface,1,NULL,0,TR_GpuOnly);
+}
+
+void gf3d_texture_update_region(Texture *tex,Uint32 x,Uint32 y,Uint32 w,Uint32 h)
+{
+    Uint32 row;
+    Uint8 *data;
+    VkDeviceSize size;
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    VkCommandBuffer commandBuffer;
+    Command * commandPool;
+    VkBufferImageCopy region = {0};
+
+    if ((!tex)||(!tex->surface)||(tex->textureImage == VK_NULL_HANDLE))
+    {
+        slog("cannot update a texture without cpu pixels and an image");
+        return;
+    }
+    if ((tex->mipLevels != 1)||(tex->format != VK_FORMAT_R8G8B8A8_UNORM))
+    {
+        slog("only single level RGBA textures can be updated");
+        return;
+    }
+    if ((!w)||(!h)||(x + w > tex->width)||(y + h > tex->height))
+    {
+        slog("texture update region %u,%u %ux%u is outside the %ux%u texture",x,y,w,h,tex->width,tex->height);
+        return;
+    }
+    size = w * h * 4;
+    if (!gf3d_buffer_create(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory, MT_Staging))
+    {
+        return;
+    }
+    vkMapMemory(gf3d_texture.device, stagingBufferMemory, 0, size, 0, (void **)&data);
+        SDL_LockSurface(tex->surface);
+        for (row = 0; row < h; row++)
+        {
+            memcpy(data + row * w * 4,(Uint8 *)tex->surface->pixels + (y + row) * tex->surface->pitch + x * 4,w * 4);
+        }
+        SDL_UnlockSurface(tex->surface);
+    vkUnmapMemory(gf3d_texture.device, stagingBufferMemory);
+
+    commandPool = gf3d_vgraphics_get_graphics_command_pool();
+    commandBuffer = gf3d_command_begin_single_time(commandPool);
+    gf3d_texture_image_barrier(commandBuffer,tex->textureImage,0,1,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_ACCESS_SHADER_READ_BIT,VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,VK_PIPELINE_STAGE_TRANSFER_BIT);
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset.x = x;
+    region.imageOffset.y = y;
+    region.imageExtent.width = w;
+    region.imageExtent.height = h;
+    region.imageExtent.depth = 1;
+    vkCmdCopyBufferToImage(commandBuffer,stagingBuffer,tex->textureImage,VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,1,&region);
+    gf3d_texture_image_barrier(commandBuffer,tex->textureImage,0,1,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT,VK_ACCESS_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    gf3d_command_end_single_time(commandPool, commandBuffer);
+
+    vkDestroyBuffer(gf3d_texture.device, stagingBuffer, NULL);
+    gf3d_memory_vk_free(gf3d_texture.device, stagingBufferMemory);
+    gf3d_render_stats_add(RS_BytesUploaded,size);
+}
+
+Uint8 gf3d_texture_format_supported(VkFormat format)
+{
+    VkFormatProperties formatProps;
+    VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    vkGetPhysicalDeviceFormatProperties(gf3d_vgraphics_get_default_physical_device(),format,&formatProps);
+    return ((formatProps.optimalTilingFeatures & needed) == needed);
+}
+
+/**
+ * @brief decode a compressed image and upload it as RGBA8, for devices that cannot sample the format
+ */
+Texture *gf3d_texture_convert_decoded(CompressedImage *image)
+{
+    Uint32 i,mipCount = 0;
+    SDL_Surface *surface;
+    SDL_Surface *mips[GF3D_COMPRESSED_MAX_LEVELS];
+
+    surface = gf3d_compressed_image_decode(image,0);
+    if (!surface)return NULL;
+    for (i = 1; i < image->mipLevels; i++)
+    {
+        mips[mipCount] = gf3d_compressed_image_decode(image,i);
+        if (!mips[mipCount])break;
+        mipCount++;
+    }
+    return gf3d_texture_convert_surface_levels(surface,1,mips,mipCount,TR_GpuOnly);
+}
+
+Texture *gf3d_texture_convert_compressed(CompressedImage *image)
+{
+    Uint32 i;
+    Uint8* data;
+    Texture *tex;
+    VkDeviceSize imageSize = 0,offset = 0;
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+
+    if (!image)return NULL;
+    if (!gf3d_texture_format_supported(image->format))
+    {
+        if (__DEBUG)slog("device cannot sample format %i, decoding on the cpu",image->format);
+        return gf3d_texture_convert_decoded(image);
+    }
+    tex = gf3d_texture_new();
+    if (!tex)return NULL;
+    tex->width = image->width;
+    tex->height = image->height;
+    tex->format = image->format;
+    // compressed levels cannot be blitted, so the chain is only what the file holds
+    tex->mipLevels = gf3d_texture.mipmaps ? image->mipLevels : 1;
+    for (i = 0; i < tex->mipLevels; i++)imageSize += image->levelSize[i];
+
+    gf3d_buffer_create(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory, MT_Staging);
+
+    vkMapMemory(gf3d_texture.device, stagingBufferMemory, 0, imageSize, 0, (void **)&data);
+        for (i = 0; i < tex->mipLevels; i++)
+        {
+            memcpy(data + offset,image->levels[i],image->levelSize[i]);
+            offset += image->levelSize[i];
+        }
+    vkUnmapMemory(gf3d_texture.device, stagingBufferMemory);
+
+    if (!gf3d_texture_create_image(tex,stagingBuffer,stagingBufferMemory,tex->mipLevels))return NULL;
+    return tex;
+}
+
+/**
+ * @brief load a compressed texture
+ * @param baked if set, filename is the source image and its baked .dds is loaded instead
+ */
+Texture *gf3d_texture_load_compressed(const char *filename,Uint8 baked)
+{
+    Texture *tex;
+    CompressedImage *image;
+
+    GF3D_PROFILE_BEGIN("file_read");
+    if (baked)image = gf3d_compressed_image_load_baked(filename);
+    else image = gf3d_compressed_image_load(filename);
+    GF3D_PROFILE_END();
+    if (!image)return NULL;
+    GF3D_PROFILE_BEGIN("texture_upload");
+    tex = gf3d_texture_convert_compressed(image);
+    GF3D_PROFILE_END();
+    gf3d_compressed_image_free(image);
+    return tex;
+}
+
+SDL_Surface *gf3d_texture_load_surface(const char *filename)
 {
     void *mem;
     SDL_RWops *src;
     size_t fileSize = 0;
     SDL_Surface * surface;
-    Texture *tex;
 
-    tex = gf3d_texture_get_by_filename(filename);
-    if (tex)
-    {
-        tex->_refcount++;
-        return tex;
-    }
+    GF3D_PROFILE_BEGIN("file_read");
     mem = gfc_pak_file_extract(filename,&fileSize);
+    GF3D_PROFILE_END();
     if (!mem)
     {
         slog("failed to load image %s",filename);
@@ -317,22 +766,134 @@ Texture *gf3d_texture_load(const char *filename)
     if (!src)
     {
         slog("failed to read image %s",filename);
+        free(mem);
         return NULL;
     }
+    GF3D_PROFILE_BEGIN("texture_decode");
     surface = IMG_Load_RW(src,1);
+    GF3D_PROFILE_END();
     free(mem);
     if (!surface)
     {
         slog("failed to load texture file %s",filename);
         return NULL;
     }
-    tex = gf3d_texture_convert_surface(surface);
+    return surface;
+}
+
+/**
+ * @brief load levels named like images/rock_mip1.png, images/rock_mip2.png next to images/rock.png
+ * @note stops at the first level that is missing or the wrong size
+ * @return how many levels were loaded into mips
+ */
+Uint32 gf3d_texture_load_mip_files(const char *filename,Uint32 width,Uint32 height,SDL_Surface **mips,Uint32 maxMips)
+{
+    Uint32 i;
+    const char *ext;
+    GFC_TextLine mipname;
+    SDL_Surface *surface;
+
+    ext = strrchr(filename,'.');
+    if (!ext)ext = filename + strlen(filename);
+    for (i = 0; i < maxMips; i++)
+    {
+        gfc_line_sprintf(mipname,"%.*s_mip%u%s",(int)(ext - filename),filename,i + 1,ext);
+        surface = gf3d_texture_load_surface(mipname);
+        if (!surface)break;
+        if ((surface->w != MAX(1,width >> (i + 1)))||(surface->h != MAX(1,height >> (i + 1))))
+        {
+            slog("mip level %s is %ix%i, expected %ux%u",mipname,surface->w,surface->h,MAX(1,width >> (i + 1)),MAX(1,height >> (i + 1)));
+            SDL_FreeSurface(surface);
+            break;
+        }
+        mips[i] = surface;
+    }
+    if ((__DEBUG)&&(i))slog("loaded %u precomputed mip levels for %s",i,filename);
+    return i;
+}
+
+SDL_Surface *gf3d_texture_get_surface(Texture *tex)
+{
+    const char *ext;
+    SDL_Surface *surface = NULL;
+    CompressedImage *image;
+
+    if (!tex)return NULL;
+    if (tex->surface)return tex->surface;
+    if (!strlen(tex->filename))
+    {
+        slog("texture has no pixels on the cpu and no file to reload them from");
+        return NULL;
+    }
+    ext = strrchr(tex->filename,'.');
+    if ((ext)&&((strcmp(ext,".dds") == 0)||(strcmp(ext,".ktx2") == 0)))
+    {
+        image = gf3d_compressed_image_load(tex->filename);
+        if (image)
+        {
+            surface = gf3d_compressed_image_decode(image,0);
+            gf3d_compressed_image_free(image);
+        }
+    }
+    else surface = gf3d_texture_load_surface(tex->filename);
+    if (!surface)return NULL;
+    tex->surface = gf3d_vgraphics_screen_convert(&surface);
+    if (__DEBUG)slog("reloaded cpu pixels for texture %s",tex->filename);
+    return tex->surface;
+}
+
+Texture *gf3d_texture_load(const char *filename)
+{
+    return gf3d_texture_load_full(filename,TR_GpuOnly);
+}
+
+Texture *gf3d_texture_load_full(const char *filename,TextureRetention retention)
+{
+    Uint32 mipCount = 0;
+    const char *ext;
+    SDL_Surface * surface;
+    SDL_Surface * mips[32];
+    Texture *tex;
+
+    if (!filename)return NULL;
+    tex = gf3d_texture_get_by_filename(filename);
+    if (tex)
+    {
+        tex->_refcount++;
+        if (retention == TR_KeepSurface)gf3d_texture_get_surface(tex);
+        return tex;
+    }
+    ext = strrchr(filename,'.');
+    if (!ext)ext = filename + strlen(filename);
+    if ((strcmp(ext,".dds") == 0)||(strcmp(ext,".ktx2") == 0))
+    {
+        tex = gf3d_texture_load_compressed(filename,0);
+    }
+    else if (gf3d_texture.compressed)
+    {
+        // prefer the baked version, it skips the decode and is a quarter of the size or less
+        tex = gf3d_texture_load_compressed(filename,1);
+    }
+    if (!tex)
+    {
+        surface = gf3d_texture_load_surface(filename);
+        if (!surface)return NULL;
+        if ((gf3d_texture.mipmaps)&&(gf3d_texture.mipFiles))
+        {
+            mipCount = gf3d_texture_load_mip_files(filename,surface->w,surface->h,mips,gf3d_texture_get_mip_count(surface->w,surface->h) - 1);
+        }
+        GF3D_PROFILE_BEGIN("texture_upload");
+        tex = gf3d_texture_convert_surface_levels(surface,1,mips,mipCount,retention);
+        GF3D_PROFILE_END();
+    }
     
     if (!tex)
     {
         return NULL;
     }
     gfc_line_cpy(tex->filename,filename);
+    // compressed uploads never had the pixels as a surface, decode them if they are wanted
+    if ((retention == TR_KeepSurface)&&(!tex->surface))gf3d_texture_get_surface(tex);
     return tex;
 }
 
@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <SDL_image.h>
+
+#include "simple_logger.h"
+
+#include "gf3d_memory.h"
+#include "gf3d_texture.h"
+#include "gf3d_compressed.h"
+#include "gf3d_texture_bake.h"
+
+#define BAKE_PATH_MAX 512
+
+typedef struct
+{
+    Uint32  baked;
+    Uint32  skipped;        /**<already up to date*/
+    Uint64  sourceBytes;    /**<what the baked images take as RGBA8 with mips*/
+    Uint64  bakedBytes;
+}TextureBakeStats;
+
+extern int __DEBUG;
+static TextureBakeStats gf3d_texture_bake = {0};
+
+VkFormat gf3d_texture_bake_choose_format(const char *source,SDL_Surface *surface)
+{
+    int x,y;
+    Uint8 *row;
+    const char *name;
+    char lower[BAKE_PATH_MAX];
+
+    name = strrchr(source,'/');
+    name = name ? name + 1 : source;
+    for (x = 0; (name[x])&&(x < BAKE_PATH_MAX - 1); x++)lower[x] = tolower((unsigned char)name[x]);
+    lower[x] = '\0';
+    if (strstr(lower,"normal"))return VK_FORMAT_BC5_UNORM_BLOCK;
+    SDL_LockSurface(surface);
+    for (y = 0; y < surface->h; y++)
+    {
+        row = (Uint8 *)surface->pixels + y * surface->pitch;
+        for (x = 0; x < surface->w; x++)
+        {
+            if (row[x * 4 + 3] != 255)
+            {
+                SDL_UnlockSurface(surface);
+                return VK_FORMAT_BC3_UNORM_BLOCK;
+            }
+        }
+    }
+    SDL_UnlockSurface(surface);
+    return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+}
+
+Uint8 gf3d_texture_bake_file(const char *source,const char *dest)
+{
+    Uint32 i,mipLevels,width,height;
+    Uint8 ok = 1;
+    VkFormat format;
+    SDL_Surface *loaded,*level,*next;
+    Uint8 *levels[GF3D_COMPRESSED_MAX_LEVELS] = {0};
+    size_t levelSize[GF3D_COMPRESSED_MAX_LEVELS] = {0};
+    size_t bakedSize = 0;
+    Uint64 sourceSize = 0;
+
+    if ((!source)||(!dest))return 0;
+    loaded = IMG_Load(source);
+    if (!loaded)
+    {
+        slog("failed to load %s to bake: %s",source,SDL_GetError());
+        return 0;
+    }
+    level = SDL_ConvertSurfaceFormat(loaded,SDL_PIXELFORMAT_RGBA32,0);
+    SDL_FreeSurface(loaded);
+    if (!level)
+    {
+        slog("failed to convert %s to RGBA: %s",source,SDL_GetError());
+        return 0;
+    }
+    format = gf3d_texture_bake_choose_format(source,level);
+    width = level->w;
+    height = level->h;
+    mipLevels = MIN(gf3d_texture_get_mip_count(level->w,level->h),GF3D_COMPRESSED_MAX_LEVELS);
+    for (i = 0; i < mipLevels; i++)
+    {
+        levels[i] = gf3d_compressed_encode(level,format,&levelSize[i]);
+        sourceSize += level->w * level->h * 4;
+        bakedSize += levelSize[i];
+        next = NULL;
+        if (i + 1 < mipLevels)next = gf3d_texture_mip_downsample(level);
+        if ((!levels[i])||((i + 1 < mipLevels)&&(!next)))
+        {
+            ok = 0;
+            mipLevels = i + 1;
+        }
+        SDL_FreeSurface(level);
+        level = next;
+    }
+    if (level)SDL_FreeSurface(level);
+    if ((ok)&&(!gf3d_compressed_save_dds(dest,format,width,height,mipLevels,levels,levelSize)))ok = 0;
+    for (i = 0; i < GF3D_COMPRESSED_MAX_LEVELS; i++)
+    {
+        if (levels[i])gf3d_memory_free(levels[i]);
+    }
+    if (!ok)
+    {
+        slog("failed to bake %s",source);
+        return 0;
+    }
+    gf3d_texture_bake.sourceBytes += sourceSize;
+    gf3d_texture_bake.bakedBytes += bakedSize;
+    gf3d_texture_bake.baked++;
+    slog("baked %s: %s, %u levels, %.1fKB",dest,
+        format == VK_FORMAT_BC5_UNORM_BLOCK ? "BC5" : format == VK_FORMAT_BC3_UNORM_BLOCK ? "BC3" : "BC1",
+        mipLevels,bakedSize / 1024.0);
+    return 1;
+}
+
+/**
+ * @brief bake source into a DDS with the same name, unless the DDS is already newer
+ */
+Uint32 gf3d_texture_bake_png(const char *source)
+{
+    char dest[BAKE_PATH_MAX];
+    struct stat sourceStat,destStat;
+    size_t len = strlen(source);
+
+    if ((len < 4)||(len >= BAKE_PATH_MAX))return 0;
+    snprintf(dest,sizeof(dest),"%.*s.dds",(int)(len - 4),source);
+    if ((stat(source,&sourceStat) == 0)&&(stat(dest,&destStat) == 0)&&(destStat.st_mtime >= sourceStat.st_mtime))
+    {
+        if (__DEBUG)slog("%s is up to date",dest);
+        gf3d_texture_bake.skipped++;
+        return 0;
+    }
+    return gf3d_texture_bake_file(source,dest) ? 0 : 1;
+}
+
+Uint32 gf3d_texture_bake_directory(const char *path,Uint8 recursive)
+{
+    DIR *dir;
+    struct dirent *entry;
+    struct stat info;
+    char child[BAKE_PATH_MAX];
+    size_t len;
+    Uint32 failed = 0;
+
+    if (!path)return 0;
+    dir = opendir(path);
+    if (!dir)
+    {
+        slog("failed to open directory %s to bake",path);
+        return 1;
+    }
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (entry->d_name[0] == '.')continue;
+        if (snprintf(child,sizeof(child),"%s/%s",path,entry->d_name) >= sizeof(child))
+        {
+            slog("path too long to bake: %s/%s",path,entry->d_name);
+            failed++;
+            continue;
+        }
+        if (stat(child,&info) != 0)continue;
+        if (S_ISDIR(info.st_mode))
+        {
+            if (recursive)failed += gf3d_texture_bake_directory(child,recursive);
+            continue;
+        }
+        len = strlen(entry->d_name);
+        if ((len < 4)||(strcasecmp(entry->d_name + len - 4,".png") != 0))continue;
+        failed += gf3d_texture_bake_png(child);
+    }
+    closedir(dir);
+    return failed;
+}
+
+Uint32 gf3d_texture_bake_all()
+{
+    Uint32 failed = 0;
+
+    memset(&gf3d_texture_bake,0,sizeof(TextureBakeStats));
+    failed += gf3d_texture_bake_directory("models",1);
+    failed += gf3d_texture_bake_directory("images",0);
+    slog("texture bake: %u baked, %u up to date, %u failed.  %.1fMB of RGBA8 became %.1fMB",
+        gf3d_texture_bake.baked,
+        gf3d_texture_bake.skipped,
+        failed,
+        gf3d_texture_bake.sourceBytes / (1024.0 * 1024.0),
+        gf3d_texture_bake.bakedBytes / (1024.0 * 1024.0));
+    return failed;
+}
+
+/*eol@eof*/
@@ -0,0 +1,723 @@
+#include <SDL.h>
+#include <SDL_image.h>
+
+#include "simple_logger.h"
+#include "simple_json.h"
+
+#include "gfc_pak.h"
+
+#include "gf3d_vgraphics.h"
+#include "gf3d_buffers.h"
+#include "gf3d_memory.h"
+#include "gf3d_compressed.h"
+#include "gf3d_profiler.h"
+#include "gf3d_render_stats.h"
+#include "gf3d_texture_stream.h"
+
+#define GF3D_TEXTURE_STREAM_BASE_SIZE   64  /**<levels this size and smaller are loaded first and never evicted*/
+#define GF3D_TEXTURE_STREAM_MAX_JOBS    8   /**<loads in flight for larger levels*/
+#define GF3D_TEXTURE_STREAM_UPLOADS     4   /**<finished loads uploaded per frame*/
+#define GF3D_TEXTURE_STREAM_IDLE_FRAMES 60  /**<frames without a draw before a texture only wants its base levels*/
+
+typedef struct TextureStreamJob_S
+{
+    Texture        *texture;
+    Uint32          streamId;
+    GFC_TextLine    filename;
+    Sint32          first;          /**<the largest level to load, -1 for the base levels*/
+    /* filled in by the loader */
+    VkFormat        format;
+    Uint32          width,height;
+    Uint32          mipLevels;
+    Uint8          *data;           /**<levels first through mipLevels - 1 back to back, NULL on error*/
+    size_t          size;
+    struct TextureStreamJob_S *next;
+}TextureStreamJob;
+
+typedef struct
+{
+    Texture        *texture;
+    Uint32          streamId;
+    VkDeviceSize    pendingBytes;   /**<what the load in flight will add once it is uploaded*/
+}TextureStreamRecord;
+
+typedef struct
+{
+    VkDeviceSize        budget;         /**<0 when streaming is off*/
+    VkDeviceSize        resident;
+    Uint8               mipmaps;
+    Uint8               compressed;
+    Uint32              frame;
+    Uint32              nextStreamId;
+    Uint32              inFlight;
+    TextureStreamRecord *records;
+    Uint32              maxTextures;
+    TextureStreamJob   *queue;          /**<waiting for the loader*/
+    TextureStreamJob   *finished;       /**<waiting to be uploaded*/
+    SDL_mutex          *lock;
+    SDL_sem            *wake;
+    SDL_Thread         *loader;
+    SDL_atomic_t        running;
+}TextureStreamer;
+
+extern int __DEBUG;
+static TextureStreamer gf3d_texture_stream = {0};
+
+void gf3d_texture_stream_close();
+static int gf3d_texture_stream_loader(void *data);
+
+/* from gf3d_texture.c */
+Texture *gf3d_texture_new();
+void gf3d_texture_delete(Texture *tex);
+Texture *gf3d_texture_get_by_filename(const char * filename);
+void gf3d_texture_release_image(Texture *tex);
+void gf3d_texture_copy_surface(Uint8 *dst,SDL_Surface *surface);
+void gf3d_texture_create_sampler(Texture *tex);
+Uint8 gf3d_texture_format_supported(VkFormat format);
+Uint8 gf3d_texture_allocate_image(Texture *tex,VkImageUsageFlags usage);
+Uint8 gf3d_texture_create_image(Texture *tex,VkBuffer stagingBuffer,VkDeviceMemory stagingBufferMemory,Uint32 uploaded);
+void gf3d_texture_image_barrier(
+    VkCommandBuffer commandBuffer,
+    VkImage image,
+    Uint32 baseLevel,
+    Uint32 levelCount,
+    VkImageLayout oldLayout,
+    VkImageLayout newLayout,
+    VkAccessFlags srcAccess,
+    VkAccessFlags dstAccess,
+    VkPipelineStageFlags srcStage,
+    VkPipelineStageFlags dstStage);
+
+void gf3d_texture_stream_init(Uint32 maxTextures,const char *config)
+{
+    SJson *json,*setup;
+    int budgetMB = 0;
+    short int mipmaps = 1;
+    short int compressed = 0;
+
+    if (config)
+    {
+        json = gfc_pak_load_json(config);
+        if (json)
+        {
+            setup = sj_object_get_value(json,"setup");
+            sj_get_integer_value(sj_object_get_value(setup,"texture_budget_mb"),&budgetMB);
+            sj_get_bool_value(sj_object_get_value(setup,"mipmaps"),&mipmaps);
+            sj_get_bool_value(sj_object_get_value(setup,"compressed_textures"),&compressed);
+            sj_free(json);
+        }
+    }
+    if ((budgetMB <= 0)||(!maxTextures))
+    {
+        if (__DEBUG)slog("texture streaming off");
+        return;
+    }
+    gf3d_texture_stream.records = gf3d_memory_alloc_array(MT_Texture,sizeof(TextureStreamRecord),maxTextures);
+    if (!gf3d_texture_stream.records)
+    {
+        slog("failed to allocate texture streaming records, streaming off");
+        return;
+    }
+    gf3d_texture_stream.maxTextures = maxTextures;
+    gf3d_texture_stream.mipmaps = mipmaps;
+    gf3d_texture_stream.compressed = compressed;
+    gf3d_texture_stream.lock = SDL_CreateMutex();
+    gf3d_texture_stream.wake = SDL_CreateSemaphore(0);
+    if ((!gf3d_texture_stream.lock)||(!gf3d_texture_stream.wake))
+    {
+        slog("failed to create texture streaming locks: %s",SDL_GetError());
+        gf3d_texture_stream_close();
+        return;
+    }
+    SDL_AtomicSet(&gf3d_texture_stream.running,1);
+    gf3d_texture_stream.loader = SDL_CreateThread(gf3d_texture_stream_loader,"gf3d_texture_stream",NULL);
+    if (!gf3d_texture_stream.loader)
+    {
+        slog("failed to start texture streaming thread: %s",SDL_GetError());
+        gf3d_texture_stream_close();
+        return;
+    }
+    // only set once everything is up, a zero budget is what turns streaming off
+    gf3d_texture_stream.budget = (VkDeviceSize)budgetMB * 1024 * 1024;
+    atexit(gf3d_texture_stream_close);
+    if (__DEBUG)slog("texture streaming started with a %iMB budget",budgetMB);
+}
+
+void gf3d_texture_stream_job_free(TextureStreamJob *job)
+{
+    if (!job)return;
+    if (job->data)gf3d_memory_free(job->data);
+    gf3d_memory_free(job);
+}
+
+void gf3d_texture_stream_close()
+{
+    TextureStreamJob *job;
+
+    gf3d_texture_stream.budget = 0;
+    SDL_AtomicSet(&gf3d_texture_stream.running,0);
+    if (gf3d_texture_stream.loader)
+    {
+        SDL_SemPost(gf3d_texture_stream.wake);
+        SDL_WaitThread(gf3d_texture_stream.loader,NULL);
+        gf3d_texture_stream.loader = NULL;
+    }
+    while ((job = gf3d_texture_stream.queue) != NULL)
+    {
+        gf3d_texture_stream.queue = job->next;
+        gf3d_texture_stream_job_free(job);
+    }
+    while ((job = gf3d_texture_stream.finished) != NULL)
+    {
+        gf3d_texture_stream.finished = job->next;
+        gf3d_texture_stream_job_free(job);
+    }
+    if (gf3d_texture_stream.wake)SDL_DestroySemaphore(gf3d_texture_stream.wake);
+    if (gf3d_texture_stream.lock)SDL_DestroyMutex(gf3d_texture_stream.lock);
+    if (gf3d_texture_stream.records)gf3d_memory_free(gf3d_texture_stream.records);
+    memset(&gf3d_texture_stream,0,sizeof(TextureStreamer));
+    if (__DEBUG)slog("texture streaming closed");
+}
+
+Uint32 gf3d_texture_stream_base_level(Uint32 width,Uint32 height,Uint32 mipLevels)
+{
+    Uint32 level = 0;
+    while ((level + 1 < mipLevels)&&((MAX(width,height) >> level) > GF3D_TEXTURE_STREAM_BASE_SIZE))level++;
+    return level;
+}
+
+/**
+ * @brief how much device memory a texture would need with levels from level down
+ * @note ignores the driver's alignment, it is only used against the budget
+ */
+VkDeviceSize gf3d_texture_stream_level_bytes(Texture *tex,Uint32 level)
+{
+    VkDeviceSize size = 0;
+    for (; level < tex->mipLevels; level++)
+    {
+        size += gf3d_compressed_level_size(tex->format,MAX(1,tex->width >> level),MAX(1,tex->height >> level));
+    }
+    return size;
+}
+
+/**
+ * @brief how much more device memory a texture needs to hold levels from level down
+ */
+VkDeviceSize gf3d_texture_stream_raise_cost(Texture *tex,Uint32 level)
+{
+    VkDeviceSize size = gf3d_texture_stream_level_bytes(tex,level);
+    return (size > tex->residentBytes) ? size - tex->residentBytes : 0;
+}
+
+/* loader thread */
+
+/**
+ * @brief keep the levels of a compressed image the job asked for, decoding them if the device cannot sample the format
+ * @return 0 if the image could not be used, 1 otherwise
+ */
+Uint8 gf3d_texture_stream_decode_compressed(TextureStreamJob *job,CompressedImage *image)
+{
+    Uint32 i,first;
+    size_t offset = 0;
+    Uint8 supported;
+    SDL_Surface *surface;
+
+    job->width = image->width;
+    job->height = image->height;
+    job->mipLevels = gf3d_texture_stream.mipmaps ? image->mipLevels : 1;
+    first = (job->first < 0) ? gf3d_texture_stream_base_level(job->width,job->height,job->mipLevels) : MIN((Uint32)job->first,job->mipLevels - 1);
+    supported = gf3d_texture_format_supported(image->format);
+    job->format = supported ? image->format : VK_FORMAT_R8G8B8A8_UNORM;
+    job->size = 0;
+    for (i = first; i < job->mipLevels; i++)
+    {
+        job->size += gf3d_compressed_level_size(job->format,MAX(1,job->width >> i),MAX(1,job->height >> i));
+    }
+    job->data = gf3d_memory_alloc_array(MT_Staging,1,job->size);
+    if (!job->data)return 0;
+    for (i = first; i < job->mipLevels; i++)
+    {
+        if (supported)
+        {
+            memcpy(job->data + offset,image->levels[i],image->levelSize[i]);
+            offset += image->levelSize[i];
+            continue;
+        }
+        surface = gf3d_compressed_image_decode(image,i);
+        if (!surface)
+        {
+            gf3d_memory_free(job->data);
+            job->data = NULL;
+            return 0;
+        }
+        gf3d_texture_copy_surface(job->data + offset,surface);
+        offset += surface->w * surface->h * 4;
+        SDL_FreeSurface(surface);
+    }
+    job->first = first;
+    return 1;
+}
+
+/**
+ * @brief decode an image file and filter it down to the levels the job asked for
+ */
+Uint8 gf3d_texture_stream_decode_surface(TextureStreamJob *job)
+{
+    void *mem;
+    Uint32 i,first;
+    size_t offset = 0;
+    size_t fileSize = 0;
+    SDL_RWops *src;
+    SDL_Surface *loaded,*level,*next;
+
+    mem = gfc_pak_file_extract(job->filename,&fileSize);
+    if (!mem)
+    {
+        slog("failed to load image %s",job->filename);
+        return 0;
+    }
+    src = SDL_RWFromMem(mem,fileSize);
+    loaded = src ? IMG_Load_RW(src,1) : NULL;
+    free(mem);
+    if (!loaded)
+    {
+        slog("failed to load texture file %s",job->filename);
+        return 0;
+    }
+    level = SDL_ConvertSurfaceFormat(loaded,SDL_PIXELFORMAT_RGBA32,0);
+    SDL_FreeSurface(loaded);
+    if (!level)
+    {
+        slog("failed to convert %s to RGBA: %s",job->filename,SDL_GetError());
+        return 0;
+    }
+    job->format = VK_FORMAT_R8G8B8A8_UNORM;
+    job->width = level->w;
+    job->height = level->h;
+    job->mipLevels = gf3d_texture_stream.mipmaps ? gf3d_texture_get_mip_count(level->w,level->h) : 1;
+    first = (job->first < 0) ? gf3d_texture_stream_base_level(job->width,job->height,job->mipLevels) : MIN((Uint32)job->first,job->mipLevels - 1);
+    job->size = 0;
+    for (i = first; i < job->mipLevels; i++)
+    {
+        job->size += MAX(1,job->width >> i) * MAX(1,job->height >> i) * 4;
+    }
+    job->data = gf3d_memory_alloc_array(MT_Staging,1,job->size);
+    for (i = 0; (job->data)&&(level)&&(i < job->mipLevels); i++)
+    {
+        if (i >= first)
+        {
+            gf3d_texture_copy_surface(job->data + offset,level);
+            offset += level->w * level->h * 4;
+        }
+        if (i + 1 == job->mipLevels)break;
+        next = gf3d_texture_mip_downsample(level);
+        SDL_FreeSurface(level);
+        level = next;
+    }
+    if (level)SDL_FreeSurface(level);
+    else if (job->data)
+    {
+        gf3d_memory_free(job->data);
+        job->data = NULL;
+    }
+    job->first = first;
+    return job->data != NULL;
+}
+
+void gf3d_texture_stream_decode(TextureStreamJob *job)
+{
+    const char *ext;
+    CompressedImage *image = NULL;
+
+    ext = strrchr(job->filename,'.');
+    if (!ext)ext = job->filename + strlen(job->filename);
+    if ((strcmp(ext,".dds") == 0)||(strcmp(ext,".ktx2") == 0))
+    {
+        image = gf3d_compressed_image_load(job->filename);
+    }
+    else if (gf3d_texture_stream.compressed)
+    {
+        image = gf3d_compressed_image_load_baked(job->filename);
+    }
+    if (image)
+    {
+        // BC7 on a device without it has no software decoder, the source image is tried next
+        if (gf3d_texture_stream_decode_compressed(job,image))
+        {
+            gf3d_compressed_image_free(image);
+            return;
+        }
+        gf3d_compressed_image_free(image);
+    }
+    gf3d_texture_stream_decode_surface(job);
+}
+
+static int gf3d_texture_stream_loader(void *data)
+{
+    TextureStreamJob *job,**tail;
+
+    while (SDL_AtomicGet(&gf3d_texture_stream.running))
+    {
+        SDL_SemWait(gf3d_texture_stream.wake);
+        SDL_LockMutex(gf3d_texture_stream.lock);
+        job = gf3d_texture_stream.queue;
+        if (job)gf3d_texture_stream.queue = job->next;
+        SDL_UnlockMutex(gf3d_texture_stream.lock);
+        if (!job)continue;
+        job->next = NULL;
+        gf3d_texture_stream_decode(job);
+        SDL_LockMutex(gf3d_texture_stream.lock);
+        for (tail = &gf3d_texture_stream.finished; *tail; tail = &(*tail)->next);
+        *tail = job;
+        SDL_UnlockMutex(gf3d_texture_stream.lock);
+    }
+    return 0;
+}
+
+/* main thread */
+
+Uint8 gf3d_texture_stream_request(TextureStreamRecord *record,Sint32 first)
+{
+    Texture *tex = record->texture;
+    TextureStreamJob *job,**tail;
+
+    job = gf3d_memory_alloc_array(MT_Texture,sizeof(TextureStreamJob),1);
+    if (!job)return 0;
+    job->texture = tex;
+    job->streamId = tex->streamId;
+    gfc_line_cpy(job->filename,tex->filename);
+    job->first = first;
+    SDL_LockMutex(gf3d_texture_stream.lock);
+    for (tail = &gf3d_texture_stream.queue; *tail; tail = &(*tail)->next);
+    *tail = job;
+    SDL_UnlockMutex(gf3d_texture_stream.lock);
+    SDL_SemPost(gf3d_texture_stream.wake);
+    tex->streamPending = 1;
+    record->pendingBytes = 0;
+    if (first >= 0)record->pendingBytes = gf3d_texture_stream_raise_cost(tex,first);
+    gf3d_texture_stream.inFlight++;
+    return 1;
+}
+
+Texture *gf3d_texture_load_streaming(const char *filename)
+{
+    Uint32 i;
+    Texture *tex;
+    TextureStreamRecord *record = NULL;
+
+    if (!filename)return NULL;
+    if (!gf3d_texture_stream.budget)return gf3d_texture_load(filename);
+    tex = gf3d_texture_get_by_filename(filename);
+    if (tex)
+    {
+        tex->_refcount++;
+        return tex;
+    }
+    for (i = 0; i < gf3d_texture_stream.maxTextures; i++)
+    {
+        if ((!gf3d_texture_stream.records[i].texture)||(gf3d_texture_stream.records[i].texture->streamId != gf3d_texture_stream.records[i].streamId))
+        {
+            record = &gf3d_texture_stream.records[i];
+            break;
+        }
+    }
+    if (!record)
+    {
+        slog("no free texture streaming records, loading %s whole",filename);
+        return gf3d_texture_load(filename);
+    }
+    tex = gf3d_texture_new();
+    if (!tex)return NULL;
+    gfc_line_cpy(tex->filename,filename);
+    tex->streamed = 1;
+    tex->streamId = ++gf3d_texture_stream.nextStreamId;
+    tex->lastUsed = gf3d_texture_stream.frame;
+    record->texture = tex;
+    record->streamId = tex->streamId;
+    if (!gf3d_texture_stream_request(record,-1))
+    {
+        slog("failed to queue texture %s for streaming",filename);
+        memset(record,0,sizeof(TextureStreamRecord));
+        gf3d_texture_delete(tex);
+        return NULL;
+    }
+    return tex;
+}
+
+/**
+ * @brief get the texture a record tracks, forgetting it if the texture was deleted or its slot reused
+ */
+Texture *gf3d_texture_stream_get_record_texture(TextureStreamRecord *record)
+{
+    Texture *tex = record->texture;
+    if (!tex)return NULL;
+    if ((!tex->_inuse)||(!tex->streamed)||(tex->streamId != record->streamId))
+    {
+        memset(record,0,sizeof(TextureStreamRecord));
+        return NULL;
+    }
+    return tex;
+}
+
+/**
+ * @brief move a new image and what describes it into a texture, the texture's own image must be released already
+ */
+void gf3d_texture_stream_adopt(Texture *tex,Texture *next)
+{
+    tex->format = next->format;
+    tex->width = next->width;
+    tex->height = next->height;
+    tex->mipLevels = next->mipLevels;
+    tex->residentLevel = next->residentLevel;
+    tex->residentBytes = next->residentBytes;
+    tex->textureImage = next->textureImage;
+    tex->textureImageMemory = next->textureImageMemory;
+    tex->textureImageView = next->textureImageView;
+    tex->textureSampler = next->textureSampler;
+}
+
+/**
+ * @brief get a copy of a texture with none of its vulkan objects, to build a replacement image in
+ */
+void gf3d_texture_stream_blank_copy(Texture *next,Texture *tex)
+{
+    memcpy(next,tex,sizeof(Texture));
+    next->surface = NULL;
+    next->textureImage = VK_NULL_HANDLE;
+    next->textureImageMemory = VK_NULL_HANDLE;
+    next->textureImageView = VK_NULL_HANDLE;
+    next->textureSampler = VK_NULL_HANDLE;
+    next->residentBytes = 0;
+}
+
+void gf3d_texture_stream_apply(TextureStreamJob *job)
+{
+    Uint8 *data;
+    Uint8 firstLoad;
+    Texture next;
+    Texture *tex = job->texture;
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+
+    if ((!tex->_inuse)||(!tex->streamed)||(tex->streamId != job->streamId))return;// deleted while it was loading
+    tex->streamPending = 0;
+    if (!job->data)
+    {
+        // keep whatever is resident, or the placeholder, rather than asking again every frame
+        slog("failed to stream texture %s, it will not be streamed further",job->filename);
+        tex->streamed = 0;
+        return;
+    }
+    firstLoad = (tex->textureImage == VK_NULL_HANDLE);
+    gf3d_texture_stream_blank_copy(&next,tex);
+    next.format = job->format;
+    next.width = job->width;
+    next.height = job->height;
+    next.mipLevels = job->mipLevels;
+    next.residentLevel = job->first;
+
+    gf3d_buffer_create(job->size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory, MT_Staging);
+    vkMapMemory(gf3d_vgraphics_get_default_logical_device(), stagingBufferMemory, 0, job->size, 0, (void **)&data);
+        memcpy(data,job->data,job->size);
+    vkUnmapMemory(gf3d_vgraphics_get_default_logical_device(), stagingBufferMemory);
+
+    if (!gf3d_texture_create_image(&next,stagingBuffer,stagingBufferMemory,next.mipLevels - next.residentLevel))
+    {
+        slog("failed to upload streamed texture %s, it will not be streamed further",job->filename);
+        tex->streamed = 0;
+        return;
+    }
+    // the upload waited for the queue to idle, nothing is still reading the old image
+    gf3d_texture_release_image(tex);
+    gf3d_texture_stream_adopt(tex,&next);
+    if (firstLoad)tex->wantedLevel = tex->residentLevel;// whatever was asked before the size was known does not count
+    gf3d_render_stats_add(RS_TextureStreamUploads,1);
+    if (__DEBUG)slog("streamed %s in from level %u (%ux%u)",tex->filename,tex->residentLevel,MAX(1,tex->width >> tex->residentLevel),MAX(1,tex->height >> tex->residentLevel));
+}
+
+/**
+ * @brief drop a texture's levels above level by copying the rest into a smaller image
+ * @return how many bytes of device memory were freed
+ */
+VkDeviceSize gf3d_texture_stream_shrink(Texture *tex,Uint32 level)
+{
+    Uint32 i,count,offset;
+    VkDeviceSize freed;
+    Texture next;
+    Command *commandPool;
+    VkCommandBuffer commandBuffer;
+    VkImageCopy region = {0};
+
+    if ((!tex->textureImage)||(level <= tex->residentLevel)||(level >= tex->mipLevels))return 0;
+    gf3d_texture_stream_blank_copy(&next,tex);
+    next.residentLevel = level;
+    if (!gf3d_texture_allocate_image(&next,VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT))
+    {
+        gf3d_texture_release_image(&next);
+        return 0;
+    }
+    count = next.mipLevels - level;
+    offset = level - tex->residentLevel;
+
+    commandPool = gf3d_vgraphics_get_graphics_command_pool();
+    commandBuffer = gf3d_command_begin_single_time(commandPool);
+    gf3d_texture_image_barrier(commandBuffer,tex->textureImage,offset,count,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        VK_ACCESS_SHADER_READ_BIT,VK_ACCESS_TRANSFER_READ_BIT,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,VK_PIPELINE_STAGE_TRANSFER_BIT);
+    gf3d_texture_image_barrier(commandBuffer,next.textureImage,0,count,
+        VK_IMAGE_LAYOUT_UNDEFINED,VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        0,VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,VK_PIPELINE_STAGE_TRANSFER_BIT);
+    region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.srcSubresource.layerCount = 1;
+    region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.dstSubresource.layerCount = 1;
+    region.extent.depth = 1;
+    for (i = 0; i < count; i++)
+    {
+        region.srcSubresource.mipLevel = offset + i;
+        region.dstSubresource.mipLevel = i;
+        region.extent.width = MAX(1,tex->width >> (level + i));
+        region.extent.height = MAX(1,tex->height >> (level + i));
+        vkCmdCopyImage(commandBuffer,
+            tex->textureImage,VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            next.textureImage,VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1,&region);
+    }
+    gf3d_texture_image_barrier(commandBuffer,next.textureImage,0,count,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT,VK_ACCESS_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    gf3d_command_end_single_time(commandPool,commandBuffer);
+
+    next.textureImageView = gf3d_vgraphics_create_image_view(next.textureImage,next.format);
+    gf3d_texture_create_sampler(&next);
+    freed = (tex->residentBytes > next.residentBytes) ? tex->residentBytes - next.residentBytes : 0;
+    gf3d_texture_release_image(tex);
+    gf3d_texture_stream_adopt(tex,&next);
+    gf3d_render_stats_add(RS_TextureEvictions,1);
+    if (__DEBUG)slog("evicted %s down to level %u",tex->filename,level);
+    return freed;
+}
+
+/**
+ * @brief find the least recently drawn texture holding more levels than it wants
+ * @param exclude a texture not to pick
+ */
+Texture *gf3d_texture_stream_get_lru(Texture *exclude)
+{
+    Uint32 i;
+    Texture *tex,*best = NULL;
+
+    for (i = 0; i < gf3d_texture_stream.maxTextures; i++)
+    {
+        tex = gf3d_texture_stream_get_record_texture(&gf3d_texture_stream.records[i]);
+        if ((!tex)||(tex == exclude)||(tex->streamPending)||(!tex->textureImage))continue;
+        if (tex->residentLevel >= tex->wantedLevel)continue;
+        if ((!best)||((Sint32)(tex->lastUsed - best->lastUsed) < 0))best = tex;
+    }
+    return best;
+}
+
+/**
+ * @brief shrink least recently used textures until needed more bytes fit in the budget
+ * @return the new resident total
+ */
+VkDeviceSize gf3d_texture_stream_evict(VkDeviceSize resident,VkDeviceSize needed,Texture *exclude)
+{
+    VkDeviceSize freed;
+    Texture *victim;
+
+    while (resident + needed > gf3d_texture_stream.budget)
+    {
+        victim = gf3d_texture_stream_get_lru(exclude);
+        if (!victim)break;
+        freed = gf3d_texture_stream_shrink(victim,victim->wantedLevel);
+        if (!freed)break;
+        resident = (freed < resident) ? resident - freed : 0;
+    }
+    return resident;
+}
+
+void gf3d_texture_stream_update()
+{
+    Uint32 i,level;
+    VkDeviceSize resident = 0,cost;
+    Texture *tex;
+    TextureStreamJob *job;
+    TextureStreamRecord *record;
+
+    if (!gf3d_texture_stream.budget)return;
+    GF3D_PROFILE_BEGIN("texture_stream");
+    gf3d_texture_stream.frame++;
+    for (i = 0; i < GF3D_TEXTURE_STREAM_UPLOADS; i++)
+    {
+        SDL_LockMutex(gf3d_texture_stream.lock);
+        job = gf3d_texture_stream.finished;
+        if (job)gf3d_texture_stream.finished = job->next;
+        SDL_UnlockMutex(gf3d_texture_stream.lock);
+        if (!job)break;
+        gf3d_texture_stream_apply(job);
+        gf3d_texture_stream_job_free(job);
+        gf3d_texture_stream.inFlight--;
+    }
+    for (i = 0; i < gf3d_texture_stream.maxTextures; i++)
+    {
+        record = &gf3d_texture_stream.records[i];
+        tex = gf3d_texture_stream_get_record_texture(record);
+        if (!tex)continue;
+        if ((tex->mipLevels)&&(gf3d_texture_stream.frame - tex->lastUsed > GF3D_TEXTURE_STREAM_IDLE_FRAMES))
+        {
+            tex->wantedLevel = MAX(tex->wantedLevel,gf3d_texture_stream_base_level(tex->width,tex->height,tex->mipLevels));
+        }
+        resident += tex->residentBytes;
+        if (tex->streamPending)resident += record->pendingBytes;
+    }
+    resident = gf3d_texture_stream_evict(resident,0,NULL);
+    for (i = 0; (i < gf3d_texture_stream.maxTextures)&&(gf3d_texture_stream.inFlight < GF3D_TEXTURE_STREAM_MAX_JOBS); i++)
+    {
+        record = &gf3d_texture_stream.records[i];
+        tex = gf3d_texture_stream_get_record_texture(record);
+        if ((!tex)||(tex->streamPending)||(!tex->textureImage))continue;
+        // only what was drawn last frame asks for more
+        if ((tex->wantedLevel >= tex->residentLevel)||(gf3d_texture_stream.frame - tex->lastUsed > 1))continue;
+        level = tex->wantedLevel;
+        cost = gf3d_texture_stream_raise_cost(tex,level);
+        resident = gf3d_texture_stream_evict(resident,cost,tex);
+        // settle for a smaller level than asked for if that is all that fits
+        while ((level < tex->residentLevel)&&(resident + gf3d_texture_stream_raise_cost(tex,level) > gf3d_texture_stream.budget))level++;
+        if (level >= tex->residentLevel)continue;
+        if (!gf3d_texture_stream_request(record,level))break;
+        resident += record->pendingBytes;
+    }
+    gf3d_texture_stream.resident = resident;
+    GF3D_PROFILE_END();
+}
+
+void gf3d_texture_stream_touch(Texture *tex,float pixels)
+{
+    Uint32 size,level = 0;
+
+    if ((!tex)||(!tex->streamed))return;
+    if (tex->mipLevels)
+    {
+        // the largest level that is still at least as big as the texture is on screen
+        size = MAX(tex->width,tex->height);
+        while ((level + 1 < tex->mipLevels)&&((float)(size >> (level + 1)) >= pixels))level++;
+        if ((tex->lastUsed != gf3d_texture_stream.frame)||(level < tex->wantedLevel))tex->wantedLevel = level;
+    }
+    tex->lastUsed = gf3d_texture_stream.frame;
+}
+
+VkDeviceSize gf3d_texture_stream_get_resident()
+{
+    return gf3d_texture_stream.resident;
+}
+
+VkDeviceSize gf3d_texture_stream_get_budget()
+{
+    return gf3d_texture_stream.budget;
+}
+
+/*eol@eof*/
@@ -0,0 +1,409 @@
+#include <math.h>
+#include <string.h>
+
+#include "simple_logger.h"
+
+#include "gf3d_arena.h"
+#include "gf3d_memory.h"
+#include "gf3d_tri_bvh.h"
+
+#define TRI_BVH_BINS        12      /**<how many buckets to evaluate split costs with*/
+#define TRI_BVH_LEAF_MIN    4       /**<always make a leaf at or below this many triangles*/
+#define TRI_BVH_LEAF_MAX    16      /**<never make a leaf above this many triangles*/
+#define TRI_BVH_STACK       128
+
+typedef struct
+{
+    float min[3],max[3];
+}TriBVHBounds;
+
+typedef struct
+{
+    TriBVH         *bvh;
+    TriBVHBounds   *triBounds;
+    float          *centroids;      /**<three per triangle*/
+    Uint32         *indices;
+}TriBVHBuild;
+
+static void gf3d_tri_bvh_bounds_clear(TriBVHBounds *b)
+{
+    b->min[0] = b->min[1] = b->min[2] = 3.4e38f;
+    b->max[0] = b->max[1] = b->max[2] = -3.4e38f;
+}
+
+static void gf3d_tri_bvh_bounds_grow(TriBVHBounds *b,const TriBVHBounds *add)
+{
+    int i;
+    for (i = 0; i < 3; i++)
+    {
+        if (add->min[i] < b->min[i])b->min[i] = add->min[i];
+        if (add->max[i] > b->max[i])b->max[i] = add->max[i];
+    }
+}
+
+static float gf3d_tri_bvh_bounds_area(const TriBVHBounds *b)
+{
+    float dx = b->max[0] - b->min[0];
+    float dy = b->max[1] - b->min[1];
+    float dz = b->max[2] - b->min[2];
+    if ((dx < 0)||(dy < 0)||(dz < 0))return 0;
+    return 2 * (dx * dy + dy * dz + dz * dx);
+}
+
+static void gf3d_tri_bvh_make_leaf(TriBVHNode *node,Uint32 start,Uint32 count)
+{
+    node->start = start;
+    node->count = count;
+    node->axis = 0;
+}
+
+/**
+ * build the subtree for indices [start,start+count), returns the node index
+ */
+Uint32 gf3d_tri_bvh_build_node(TriBVHBuild *build,Uint32 start,Uint32 count)
+{
+    Uint32 i,index,mid,bin,best = 0;
+    int axis = 0,a;
+    float extent,bestExtent = 0,cost,bestCost,leafCost,scale;
+    float centroidMin[3],centroidMax[3];
+    TriBVHBounds bounds,bins[TRI_BVH_BINS],left,right;
+    Uint32 binCount[TRI_BVH_BINS],leftCount,rightTotal;
+    float rightArea[TRI_BVH_BINS];
+    Uint32 rightCount[TRI_BVH_BINS];
+    TriBVHNode *node;
+    Uint32 tri,swap;
+
+    index = build->bvh->nodeCount++;
+    node = &build->bvh->nodes[index];
+
+    gf3d_tri_bvh_bounds_clear(&bounds);
+    for (a = 0; a < 3; a++)
+    {
+        centroidMin[a] = 3.4e38f;
+        centroidMax[a] = -3.4e38f;
+    }
+    for (i = start; i < start + count; i++)
+    {
+        tri = build->indices[i];
+        gf3d_tri_bvh_bounds_grow(&bounds,&build->triBounds[tri]);
+        for (a = 0; a < 3; a++)
+        {
+            if (build->centroids[tri * 3 + a] < centroidMin[a])centroidMin[a] = build->centroids[tri * 3 + a];
+            if (build->centroids[tri * 3 + a] > centroidMax[a])centroidMax[a] = build->centroids[tri * 3 + a];
+        }
+    }
+    memcpy(node->min,bounds.min,sizeof(float)*3);
+    memcpy(node->max,bounds.max,sizeof(float)*3);
+
+    if (count <= TRI_BVH_LEAF_MIN)
+    {
+        gf3d_tri_bvh_make_leaf(node,start,count);
+        return index;
+    }
+    for (a = 0; a < 3; a++)
+    {
+        extent = centroidMax[a] - centroidMin[a];
+        if (extent > bestExtent)
+        {
+            bestExtent = extent;
+            axis = a;
+        }
+    }
+    if (bestExtent < GFC_EPSILON)
+    {
+        // every centroid is in the same place, nothing to split on
+        if (count <= TRI_BVH_LEAF_MAX)
+        {
+            gf3d_tri_bvh_make_leaf(node,start,count);
+            return index;
+        }
+        mid = start + count / 2;
+        goto split;
+    }
+
+    // bin the centroids along the widest axis and pick the cheapest split by surface area
+    for (bin = 0; bin < TRI_BVH_BINS; bin++)
+    {
+        binCount[bin] = 0;
+        gf3d_tri_bvh_bounds_clear(&bins[bin]);
+    }
+    scale = TRI_BVH_BINS / bestExtent;
+    for (i = start; i < start + count; i++)
+    {
+        tri = build->indices[i];
+        bin = (Uint32)((build->centroids[tri * 3 + axis] - centroidMin[axis]) * scale);
+        if (bin >= TRI_BVH_BINS)bin = TRI_BVH_BINS - 1;
+        binCount[bin]++;
+        gf3d_tri_bvh_bounds_grow(&bins[bin],&build->triBounds[tri]);
+    }
+    // sweep from the right so each split knows what is on its far side
+    gf3d_tri_bvh_bounds_clear(&right);
+    rightTotal = 0;
+    for (bin = TRI_BVH_BINS - 1; bin > 0; bin--)
+    {
+        gf3d_tri_bvh_bounds_grow(&right,&bins[bin]);
+        rightTotal += binCount[bin];
+        rightCount[bin - 1] = rightTotal;
+        rightArea[bin - 1] = gf3d_tri_bvh_bounds_area(&right);
+    }
+    gf3d_tri_bvh_bounds_clear(&left);
+    leftCount = 0;
+    bestCost = 3.4e38f;
+    for (bin = 0; bin < TRI_BVH_BINS - 1; bin++)
+    {
+        gf3d_tri_bvh_bounds_grow(&left,&bins[bin]);
+        leftCount += binCount[bin];
+        if ((!leftCount)||(!rightCount[bin]))continue;
+        cost = gf3d_tri_bvh_bounds_area(&left) * leftCount + rightArea[bin] * rightCount[bin];
+        if (cost < bestCost)
+        {
+            bestCost = cost;
+            best = bin;
+        }
+    }
+    leafCost = gf3d_tri_bvh_bounds_area(&bounds) * count;
+    if ((bestCost >= leafCost)&&(count <= TRI_BVH_LEAF_MAX))
+    {
+        gf3d_tri_bvh_make_leaf(node,start,count);
+        return index;
+    }
+
+    // partition the indices around the chosen bin
+    mid = start;
+    for (i = start; i < start + count; i++)
+    {
+        tri = build->indices[i];
+        bin = (Uint32)((build->centroids[tri * 3 + axis] - centroidMin[axis]) * scale);
+        if (bin >= TRI_BVH_BINS)bin = TRI_BVH_BINS - 1;
+        if (bin <= best)
+        {
+            swap = build->indices[mid];
+            build->indices[mid] = tri;
+            build->indices[i] = swap;
+            mid++;
+        }
+    }
+    if ((mid == start)||(mid == start + count))mid = start + count / 2;
+split:
+    node->axis = axis;
+    node->count = 0;
+    gf3d_tri_bvh_build_node(build,start,mid - start);
+    // the recursive call may not move the node list, it was sized up front
+    build->bvh->nodes[index].start = gf3d_tri_bvh_build_node(build,mid,start + count - mid);
+    return index;
+}
+
+void gf3d_tri_bvh_free(TriBVH *bvh)
+{
+    if (!bvh)return;
+    if (bvh->nodes)gf3d_memory_free(bvh->nodes);
+    if (bvh->triangles)gf3d_memory_free(bvh->triangles);
+    if (bvh->faces)gf3d_memory_free(bvh->faces);
+    gf3d_memory_free(bvh);
+}
+
+TriBVH *gf3d_tri_bvh_build(const Vertex *vertices,const Face *faces,Uint32 faceCount)
+{
+    Uint32 i,j,tri;
+    int a;
+    GFC_Vector3D corner;
+    TriBVHBuild build = {0};
+    ArenaMark mark;
+    TriBVH *bvh;
+    if ((!vertices)||(!faces)||(!faceCount))return NULL;
+    bvh = gf3d_memory_alloc_array(MT_Loader,sizeof(TriBVH),1);
+    if (!bvh)return NULL;
+    bvh->nodes = gf3d_memory_alloc_array(MT_Loader,sizeof(TriBVHNode),faceCount * 2);
+    bvh->triangles = gf3d_memory_alloc_array(MT_Loader,sizeof(GFC_Vector3D),faceCount * 3);
+    bvh->faces = gf3d_memory_alloc_array(MT_Loader,sizeof(Uint32),faceCount);
+    build.bvh = bvh;
+    mark = gf3d_scratch_begin();
+    build.triBounds = gf3d_scratch_alloc_array(sizeof(TriBVHBounds),faceCount);
+    build.centroids = gf3d_scratch_alloc_array(sizeof(float),faceCount * 3);
+    build.indices = gf3d_scratch_alloc_array(sizeof(Uint32),faceCount);
+    if ((!bvh->nodes)||(!bvh->triangles)||(!bvh->faces)||(!build.triBounds)||(!build.centroids)||(!build.indices))
+    {
+        slog("failed to allocate triangle bvh for %i faces",faceCount);
+        gf3d_tri_bvh_free(bvh);
+        bvh = NULL;
+        goto done;
+    }
+    for (i = 0; i < faceCount; i++)
+    {
+        build.indices[i] = i;
+        gf3d_tri_bvh_bounds_clear(&build.triBounds[i]);
+        for (j = 0; j < 3; j++)
+        {
+            corner = vertices[faces[i].verts[j]].vertex;
+            for (a = 0; a < 3; a++)
+            {
+                float v = (a == 0) ? corner.x : ((a == 1) ? corner.y : corner.z);
+                if (v < build.triBounds[i].min[a])build.triBounds[i].min[a] = v;
+                if (v > build.triBounds[i].max[a])build.triBounds[i].max[a] = v;
+            }
+        }
+        for (a = 0; a < 3; a++)
+        {
+            build.centroids[i * 3 + a] = (build.triBounds[i].min[a] + build.triBounds[i].max[a]) * 0.5;
+        }
+    }
+    gf3d_tri_bvh_build_node(&build,0,faceCount);
+
+    // store the triangles in leaf order so leaf tests walk memory linearly
+    for (i = 0; i < faceCount; i++)
+    {
+        tri = build.indices[i];
+        bvh->faces[i] = tri;
+        for (j = 0; j < 3; j++)
+        {
+            bvh->triangles[i * 3 + j] = vertices[faces[tri].verts[j]].vertex;
+        }
+    }
+    bvh->triangleCount = faceCount;
+done:
+    gf3d_scratch_end(mark);
+    return bvh;
+}
+
+/**
+ * slab test, returns 1 if the segment between tmin 0 and tmax enters the node
+ */
+static Uint8 gf3d_tri_bvh_ray_node(const TriBVHNode *node,const float *origin,const float *invDir,float tmax)
+{
+    int i;
+    float t1,t2,tmin = 0,swap;
+    for (i = 0; i < 3; i++)
+    {
+        t1 = (node->min[i] - origin[i]) * invDir[i];
+        t2 = (node->max[i] - origin[i]) * invDir[i];
+        if (t1 > t2)
+        {
+            swap = t1;
+            t1 = t2;
+            t2 = swap;
+        }
+        if (t1 > tmin)tmin = t1;
+        if (t2 < tmax)tmax = t2;
+        if (tmin > tmax)return 0;
+    }
+    return 1;
+}
+
+/**
+ * two sided moller-trumbore, returns 1 and sets t if the segment hits the triangle before tmax
+ */
+static Uint8 gf3d_tri_bvh_ray_triangle(const GFC_Vector3D *tri,GFC_Vector3D origin,GFC_Vector3D dir,float tmax,float *t)
+{
+    GFC_Vector3D edge1,edge2,p,q,s;
+    float det,invDet,u,v,hit;
+    gfc_vector3d_sub(edge1,tri[1],tri[0]);
+    gfc_vector3d_sub(edge2,tri[2],tri[0]);
+    gfc_vector3d_cross_product(&p,dir,edge2);
+    det = gfc_vector3d_dot_product(edge1,p);
+    if (fabsf(det) < GFC_EPSILON)return 0;
+    invDet = 1.0 / det;
+    gfc_vector3d_sub(s,origin,tri[0]);
+    u = gfc_vector3d_dot_product(s,p) * invDet;
+    if ((u < 0)||(u > 1))return 0;
+    gfc_vector3d_cross_product(&q,s,edge1);
+    v = gfc_vector3d_dot_product(dir,q) * invDet;
+    if ((v < 0)||(u + v > 1))return 0;
+    hit = gfc_vector3d_dot_product(edge2,q) * invDet;
+    if ((hit < 0)||(hit > tmax))return 0;
+    *t = hit;
+    return 1;
+}
+
+/**
+ * shared traversal.  With anyHit set it stops at the first triangle hit
+ */
+static Uint8 gf3d_tri_bvh_trace(TriBVH *bvh,GFC_Vector3D start,GFC_Vector3D end,Uint8 anyHit,float *fraction,Uint32 *hitTriangle)
+{
+    Uint32 stack[TRI_BVH_STACK];
+    int top = 0,i;
+    Uint32 index,near,far;
+    float origin[3],invDir[3],dirComponents[3];
+    float tmax = 1,t;
+    Uint8 hit = 0;
+    GFC_Vector3D dir;
+    TriBVHNode *node;
+    if ((!bvh)||(!bvh->nodeCount))return 0;
+    gfc_vector3d_sub(dir,end,start);
+    origin[0] = start.x;
+    origin[1] = start.y;
+    origin[2] = start.z;
+    dirComponents[0] = dir.x;
+    dirComponents[1] = dir.y;
+    dirComponents[2] = dir.z;
+    for (i = 0; i < 3; i++)
+    {
+        // an infinite inverse keeps the slab test correct for axis aligned rays
+        invDir[i] = (fabsf(dirComponents[i]) > GFC_EPSILON) ? 1.0 / dirComponents[i] : ((dirComponents[i] < 0) ? -1e30f : 1e30f);
+    }
+    index = 0;
+    for (;;)
+    {
+        node = &bvh->nodes[index];
+        if (gf3d_tri_bvh_ray_node(node,origin,invDir,tmax))
+        {
+            if (node->count)
+            {
+                for (i = 0; i < node->count; i++)
+                {
+                    if (!gf3d_tri_bvh_ray_triangle(&bvh->triangles[(node->start + i) * 3],start,dir,tmax,&t))continue;
+                    tmax = t;
+                    hit = 1;
+                    if (hitTriangle)*hitTriangle = node->start + i;
+                    if (anyHit)goto done;
+                }
+            }
+            else
+            {
+                // visit the child on the near side of the split first so hits there prune the far side
+                near = index + 1;
+                far = node->start;
+                if (dirComponents[node->axis] < 0)
+                {
+                    near = node->start;
+                    far = index + 1;
+                }
+                if (top >= TRI_BVH_STACK)
+                {
+                    slog("triangle bvh too deep to trace");
+                    break;
+                }
+                stack[top++] = far;
+                index = near;
+                continue;
+            }
+        }
+        if (!top)break;
+        index = stack[--top];
+    }
+done:
+    if ((hit)&&(fraction))*fraction = tmax;
+    return hit;
+}
+
+Uint8 gf3d_tri_bvh_ray_closest(TriBVH *bvh,GFC_Vector3D start,GFC_Vector3D end,float *fraction,GFC_Vector3D *contact,Uint32 *face)
+{
+    float t;
+    Uint32 triangle = 0;
+    if (!gf3d_tri_bvh_trace(bvh,start,end,0,&t,&triangle))return 0;
+    if (fraction)*fraction = t;
+    if (contact)
+    {
+        contact->x = start.x + (end.x - start.x) * t;
+        contact->y = start.y + (end.y - start.y) * t;
+        contact->z = start.z + (end.z - start.z) * t;
+    }
+    if (face)*face = bvh->faces[triangle];
+    return 1;
+}
+
+Uint8 gf3d_tri_bvh_ray_any(TriBVH *bvh,GFC_Vector3D start,GFC_Vector3D end)
+{
+    return gf3d_tri_bvh_trace(bvh,start,end,1,NULL,NULL);
+}
+
+/*eol@eof*/
@@ -1,6 +1,8 @@
 #include "simple_logger.h"
 
 #include "gf3d_buffers.h"
+#include "gf3d_memory.h"
+#include "gf3d_log.h"
 #include "gf3d_uniform_buffers.h"
 
 void gf3d_uniform_buffer_setup(UniformBuffer *buffer,VkDeviceSize bufferSize)
@@ -13,7 +15,8 @@ void gf3d_uniform_buffer_setup(UniformBuffer *buffer,VkDeviceSize bufferSize)
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
         &buffer->uniformBuffer,
-        &buffer->uniformBufferMemory);
+        &buffer->uniformBufferMemory,
+        MT_Pipeline);
 }
 
 UniformBufferList *gf3d_uniform_buffer_list_new(VkDevice device,VkDeviceSize bufferSize, Uint32 bufferCount,Uint32 bufferFrames)
@@ -25,7 +28,7 @@ UniformBufferList *gf3d_uniform_buffer_list_new(VkDevice device,VkDeviceSize buf
         slog("cannot allocate zero buffers!");
         return NULL;
     }
-    bufferList = gfc_allocate_array(sizeof(UniformBufferList),1);
+    bufferList = gf3d_memory_alloc_array(MT_Pipeline,sizeof(UniformBufferList),1);
     if (!bufferList)
     {
         slog("failed to allocate unform buffers list");
@@ -34,7 +37,7 @@ UniformBufferList *gf3d_uniform_buffer_list_new(VkDevice device,VkDeviceSize buf
     
     bufferList->device = device;
     
-    bufferList->buffers = gfc_allocate_array(sizeof(UniformBuffer  *),bufferFrames);
+    bufferList->buffers = gf3d_memory_alloc_array(MT_Pipeline,sizeof(UniformBuffer  *),bufferFrames);
     
     if (!bufferList->buffers)
     {
@@ -42,10 +45,12 @@ UniformBufferList *gf3d_uniform_buffer_list_new(VkDevice device,VkDeviceSize buf
         slog("failed to allocate unform buffers list");
         return NULL;
     }
+    bufferList->buffer_frames = bufferFrames;
+    bufferList->buffer_count = bufferCount;
     
     for (j = 0; j < bufferFrames; j ++)
     {
-        bufferList->buffers[j] = gfc_allocate_array(sizeof(UniformBuffer),bufferCount);
+        bufferList->buffers[j] = gf3d_memory_alloc_array(MT_Pipeline,sizeof(UniformBuffer),bufferCount);
         if (!bufferList->buffers[j])
         {
             gf3d_uniform_buffer_list_free(bufferList);
@@ -59,14 +64,12 @@ UniformBufferList *gf3d_uniform_buffer_list_new(VkDevice device,VkDeviceSize buf
                 VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
                 &bufferList->buffers[j][i].uniformBuffer,
-                &bufferList->buffers[j][i].uniformBufferMemory);
+                &bufferList->buffers[j][i].uniformBufferMemory,
+                MT_Pipeline);
                 bufferList->buffers[j][i].bufferSize = bufferSize;
         }
         
     }
-    bufferList->buffer_count = bufferCount;
-    bufferList->buffer_frames = bufferFrames;
-    
     
     return bufferList;
 }
@@ -75,8 +78,9 @@ void gf3d_uniform_buffer_list_free(UniformBufferList *list)
 {
     int i,j;
     if (!list)return;
-    for (j = 0; j < list->buffer_frames;j++)
+    for (j = 0; (list->buffers)&&(j < list->buffer_frames);j++)
     {
+        if (!list->buffers[j])continue;
         for (i = 0; i < list->buffer_count; i++)
         {
             if (list->buffers[j][i].uniformBuffer)
@@ -85,10 +89,13 @@ void gf3d_uniform_buffer_list_free(UniformBufferList *list)
             }
             if (list->buffers[j][i].uniformBufferMemory)
             {
-                vkFreeMemory(list->device, list->buffers[j][i].uniformBufferMemory, NULL);
+                gf3d_memory_vk_free(list->device, list->buffers[j][i].uniformBufferMemory);
             }
         }
+        gf3d_memory_free(list->buffers[j]);
     }
+    gf3d_memory_free(list->buffers);
+    gf3d_memory_free(list);
 }
 
 UniformBuffer *gf3d_uniform_buffer_list_get_nth_buffer(UniformBufferList *list, Uint32 nth, Uint32 bufferFrame)
@@ -96,12 +103,12 @@ UniformBuffer *gf3d_uniform_buffer_list_get_nth_buffer(UniformBufferList *list,
     if (!list)return NULL;
     if (bufferFrame >= list->buffer_frames)
     {
-        slog("buffer frame out of range");
+        gf3d_log(LL_Error,"buffer frame out of range");
         return NULL;
     }
     if (nth >= list->buffer_count)
     {
-        slog("index out of range");
+        gf3d_log(LL_Error,"index out of range");
         return NULL;
     }
     return &list->buffers[bufferFrame][nth];
@@ -10,6 +10,7 @@
 #include "gfc_list.h"
 #include "gfc_pak.h"
 
+#include "gf3d_memory.h"
 #include "gf3d_validation.h"
 
 typedef struct
@@ -43,13 +44,13 @@ void gf3d_validation_query_layer_properties()
     
     if (!gf3d_validation.layerCount)return;
     
-    gf3d_validation.availableLayers = (VkLayerProperties *)gfc_allocate_array(sizeof(VkLayerProperties),gf3d_validation.layerCount);
+    gf3d_validation.availableLayers = (VkLayerProperties *)gf3d_memory_alloc_array(MT_General,sizeof(VkLayerProperties),gf3d_validation.layerCount);
     vkEnumerateInstanceLayerProperties(&gf3d_validation.layerCount, gf3d_validation.availableLayers);
     
     gf3d_validation.layers = gfc_list_new();
     for (i = 0; i < gf3d_validation.layerCount;i++)
     {
-        newLayer = gfc_allocate_array(sizeof(ValidationLayer),1);
+        newLayer = gf3d_memory_alloc_array(MT_General,sizeof(ValidationLayer),1);
         if (!newLayer)continue;
         newLayer->properties = &gf3d_validation.availableLayers[i];
         newLayer->name = newLayer->properties->layerName;
@@ -63,14 +64,14 @@ void gf3d_validation_close()
 {
     if (gf3d_validation.enabledLayers)
     {
-        free(gf3d_validation.enabledLayers);// data pointed to by this is owned elsewhere
+        gf3d_memory_free(gf3d_validation.enabledLayers);// data pointed to by this is owned elsewhere
     }
     if (gf3d_validation.availableLayers)
     {
-        free(gf3d_validation.availableLayers);
+        gf3d_memory_free(gf3d_validation.availableLayers);
         gf3d_validation.availableLayers = NULL;
     }
-    gfc_list_foreach(gf3d_validation.layers,free);
+    gfc_list_foreach(gf3d_validation.layers,gf3d_memory_free);
     gfc_list_delete(gf3d_validation.layers);
     memset(&gf3d_validation,0,sizeof(GF3D_Validation_Manager));
     slog("validation layers closed");
@@ -118,7 +119,7 @@ void gf3d_validation_build_enabled_layer_list()
     }
     if (!count)return;// nothing to do
     gf3d_validation.enabledCount = count;
-    gf3d_validation.enabledLayers = gfc_allocate_array(sizeof(char *),count);
+    gf3d_validation.enabledLayers = gf3d_memory_alloc_array(MT_General,sizeof(char *),count);
     for (i = 0,index = 0; i < c; i++)
     {
         layer = gfc_list_get_nth(gf3d_validation.layers,i);
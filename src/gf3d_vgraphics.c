@@ -26,9 +26,19 @@
 #include "gf3d_swapchain.h"
 #include "gf3d_pipeline.h"
 #include "gf3d_commands.h"
+#include "gf3d_jobs.h"
+#include "gf3d_arena.h"
+#include "gf3d_memory.h"
+#include "gf3d_gpu_timer.h"
+#include "gf3d_render_stats.h"
+#include "gf3d_sampler.h"
 #include "gf3d_texture.h"
+#include "gf3d_texture_stream.h"
 #include "gf3d_mesh.h"
+#include "gf3d_particle.h"
+#include "gf3d_particle_gpu.h"
 #include "gf2d_sprite.h"
+#include "gf2d_atlas.h"
 
 #include "gf3d_vgraphics.h"
 
@@ -77,6 +87,7 @@ typedef struct
     Uint32                      amask;
     Bool                        enable_3d;
     Bool                        enable_2d;
+    Bool                        headless;       /**<no window, render to offscreen images*/
 }vGraphics;
 
 static vGraphics gf3d_vgraphics = {0};
@@ -112,6 +123,10 @@ void gf3d_vgraphics_init(const char *config)
     short int fullscreen = 0;
     short int enableValidation = 0;
     short int enableDebug = 0;
+    short int headless = 0;
+    short int gpuParticles = 0;
+    int workerThreads = -1;
+    int maxParticles = 65536;
     
     json = gfc_pak_load_json(config);
     if (!json)
@@ -136,6 +151,11 @@ void gf3d_vgraphics_init(const char *config)
     sj_get_bool_value(sj_object_get_value(setup,"fullscreen"),&fullscreen);
     sj_get_bool_value(sj_object_get_value(json,"enable_debug"),&enableDebug);
     sj_get_bool_value(sj_object_get_value(json,"enable_validation"),&enableValidation);
+    sj_object_get_value_as_int(setup,"worker_threads",&workerThreads);
+    sj_object_get_value_as_int(setup,"max_particles",&maxParticles);
+    sj_get_bool_value(sj_object_get_value(setup,"gpu_particles"),&gpuParticles);
+    sj_get_bool_value(sj_object_get_value(setup,"headless"),&headless);
+    if (headless)gf3d_vgraphics.headless = 1;
     
     if (resolution.y == 0)
     {
@@ -170,11 +190,23 @@ void gf3d_vgraphics_init(const char *config)
         );
     
     gf3d_vgraphics.device = gf3d_vgraphics_get_default_logical_device();
+    gf3d_memory_device_init(gf3d_vgraphics_get_default_physical_device());
 
     gf3d_vqueues_setup_device_queues(gf3d_vgraphics.device);
     // swap chain!!!
-    gf3d_swapchain_init(gf3d_vgraphics.gpu,gf3d_vgraphics.device,gf3d_vgraphics.surface,resolution.x,resolution.y);
+    if (gf3d_vgraphics.headless)
+    {
+        gf3d_swapchain_init_offscreen(gf3d_vgraphics.device,resolution.x,resolution.y);
+    }
+    else
+    {
+        gf3d_swapchain_init(gf3d_vgraphics.gpu,gf3d_vgraphics.device,gf3d_vgraphics.surface,resolution.x,resolution.y);
+    }
+    gf3d_jobs_init(workerThreads);// before any pipelines, they size their command slices from the thread count
+    gf3d_arena_system_init(256 * 1024,1024 * 1024);// per thread, grows to fit after the first frames
+    gf3d_sampler_init(64);// before pipelines, their layouts can hold immutable samplers
     gf3d_pipeline_init(16);// how many different rendering pipelines we need
+    gf3d_gpu_timer_init(gf3d_vgraphics.device,16);// one zone per pipeline
     
     // 2D stuff
     SDL_PixelFormatEnumToMasks(SDL_PIXELFORMAT_RGBA32,
@@ -194,14 +226,19 @@ void gf3d_vgraphics_init(const char *config)
         gf3d_vgraphics.bmask,
         gf3d_vgraphics.amask);
 
-    gf3d_texture_init(1024);
+    gf3d_texture_init(1024,config);
+    gf3d_texture_stream_init(1024,config);
 
-    gf3d_command_system_init(16 * gf3d_swapchain_get_swap_image_count(), gf3d_vgraphics.device);
+    gf3d_command_system_init((16 + gf3d_jobs_get_thread_count()) * gf3d_swapchain_get_swap_image_count(), gf3d_vgraphics.device);
     gf3d_vgraphics.graphicsCommandPool = gf3d_command_graphics_pool_setup(gf3d_swapchain_get_swap_image_count());
+    gf3d_command_thread_pools_init(gf3d_jobs_get_thread_count(),gf3d_swapchain_get_swap_image_count());
 
     gf3d_vgraphics.enable_2d = 1;
     gf3d_mesh_init(1024);
+    gf3d_particle_manager_init(maxParticles);// after the meshes and before the sprites, pipelines draw in the order they are made
+    if (gpuParticles)gf3d_particle_gpu_init();
     gf2d_sprite_manager_init(1024);
+    gf2d_atlas_init(config);
     renderPipe = gf3d_mesh_get_pipeline();
 
     gf3d_swapchain_create_depth_image();
@@ -221,17 +258,28 @@ void gf3d_vgraphics_setup(
 )
 {
     Uint32 flags = SDL_WINDOW_VULKAN;
+    Uint32 sdlFlags = SDL_INIT_EVERYTHING;
     Uint32 i;
     Uint32 enabledExtensionCount = 0;
     
-    if (SDL_Init(SDL_INIT_EVERYTHING) != 0)
+    if (gf3d_vgraphics.headless)
+    {
+        // no display or audio device to rely on, but input and timers still need to work
+        SDL_SetHint(SDL_HINT_VIDEODRIVER,"dummy");
+        sdlFlags = SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_EVENTS;
+    }
+    if (SDL_Init(sdlFlags) != 0)
     {
         slog("Unable to initilaize SDL system: %s",SDL_GetError());
         return;
     }
     atexit(SDL_Quit);
     SDL_ShowCursor(SDL_DISABLE);
-    if (fullscreen)
+    if (gf3d_vgraphics.headless)
+    {
+        if (__DEBUG)slog("running headless, rendering offscreen at (%i,%i)",renderWidth,renderHeight);
+    }
+    else if (fullscreen)
     {
         if (renderWidth == 0)
         {
@@ -243,13 +291,16 @@ void gf3d_vgraphics_setup(
         }
     }
 	slog_sync();
-    gf3d_vgraphics.main_window = SDL_CreateWindow(windowName,
-                             SDL_WINDOWPOS_UNDEFINED,
-                             SDL_WINDOWPOS_UNDEFINED,
-                             renderWidth, renderHeight,
-                             flags);
+    if (!gf3d_vgraphics.headless)
+    {
+        gf3d_vgraphics.main_window = SDL_CreateWindow(windowName,
+                                 SDL_WINDOWPOS_UNDEFINED,
+                                 SDL_WINDOWPOS_UNDEFINED,
+                                 renderWidth, renderHeight,
+                                 flags);
+    }
 	slog_sync();
-    if (!gf3d_vgraphics.main_window)
+    if ((!gf3d_vgraphics.headless)&&(!gf3d_vgraphics.main_window))
     {
         slog("failed to create main window: %s",SDL_GetError());
         gf3d_vgraphics_close();
@@ -263,10 +314,14 @@ void gf3d_vgraphics_setup(
     
 	slog_sync();
     // get the extensions that are needed for rendering to an SDL Window
-    SDL_Vulkan_GetInstanceExtensions(gf3d_vgraphics.main_window, &(gf3d_vgraphics.sdl_extension_count), NULL);
-    if (gf3d_vgraphics.sdl_extension_count > 0)
+    if (gf3d_vgraphics.headless)
+    {
+        // offscreen rendering needs no surface extensions
+    }
+    else if ((SDL_Vulkan_GetInstanceExtensions(gf3d_vgraphics.main_window, &(gf3d_vgraphics.sdl_extension_count), NULL))&&
+        (gf3d_vgraphics.sdl_extension_count > 0))
     {
-        gf3d_vgraphics.sdl_extension_names = gfc_allocate_array(sizeof(const char *),gf3d_vgraphics.sdl_extension_count);
+        gf3d_vgraphics.sdl_extension_names = gf3d_memory_alloc_array(MT_General,sizeof(const char *),gf3d_vgraphics.sdl_extension_count);
         
         SDL_Vulkan_GetInstanceExtensions(gf3d_vgraphics.main_window, &(gf3d_vgraphics.sdl_extension_count), gf3d_vgraphics.sdl_extension_names);
         for (i = 0; i < gf3d_vgraphics.sdl_extension_count;i++)
@@ -331,9 +386,12 @@ void gf3d_vgraphics_setup(
     atexit(gf3d_vgraphics_close);
     
     // create a surface for the window
-    SDL_Vulkan_CreateSurface(gf3d_vgraphics.main_window, gf3d_vgraphics.vk_instance, &gf3d_vgraphics.surface);
+    if (!gf3d_vgraphics.headless)
+    {
+        SDL_Vulkan_CreateSurface(gf3d_vgraphics.main_window, gf3d_vgraphics.vk_instance, &gf3d_vgraphics.surface);
+    }
     
-    if (gf3d_vgraphics.surface == VK_NULL_HANDLE)
+    if ((!gf3d_vgraphics.headless)&&(gf3d_vgraphics.surface == VK_NULL_HANDLE))
     {
         slog("failed to create render target surface");
         gf3d_vgraphics_close();
@@ -362,11 +420,26 @@ void gf3d_vgraphics_setup(
     slog_sync();
 }
 
+void gf3d_vgraphics_set_headless(Bool headless)
+{
+    if (gf3d_vgraphics.device != VK_NULL_HANDLE)
+    {
+        slog("headless mode must be set before gf3d_vgraphics_init");
+        return;
+    }
+    gf3d_vgraphics.headless = headless;
+}
+
+Bool gf3d_vgraphics_is_headless()
+{
+    return gf3d_vgraphics.headless;
+}
+
 void gf3d_vgraphics_close()
 {
     if (gf3d_vgraphics.sdl_extension_names)
     {
-        free(gf3d_vgraphics.sdl_extension_names);
+        gf3d_memory_free(gf3d_vgraphics.sdl_extension_names);
     }
     gf3d_debug_close();
         
@@ -458,6 +531,11 @@ Uint32 gf3d_vgraphics_render_begin()
     Uint32 imageIndex;
     VkSwapchainKHR swapChains[1] = {0};
 
+    if (gf3d_vgraphics.headless)
+    {
+        // offscreen images are just used in turn
+        return (gf3d_vgraphics.bufferFrame + 1) % gf3d_swapchain_get_swap_image_count();
+    }
     /*
     Acquire an image from the swap chain
     Execute the command buffer with that image as attachment in the framebuffer
@@ -484,7 +562,12 @@ Uint32 gf3d_vgraphics_render_begin()
 void gf3d_vgraphics_render_start()
 {
     gf3d_vgraphics.bufferFrame = gf3d_vgraphics_render_begin();
+    gf3d_gpu_timer_frame_begin();
+    gf3d_arena_frame_reset();
+    gf3d_texture_stream_update();// before any draws, so they see this frame's images
     gf3d_pipeline_reset_all_pipes();
+    gf3d_sprite_reset_pipes();
+    gf3d_particle_reset_pipes();
 }
 
 Uint32  gf3d_vgraphics_get_current_buffer_frame()
@@ -501,8 +584,14 @@ void gf3d_vgraphics_render_end()
     VkSemaphore signalSemaphores[] = {gf3d_vgraphics.renderFinishedSemaphore};
     VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
     
+    gf2d_sprite_batch_flush();
+    gf3d_particle_submit_pipe_commands();
+    gf3d_particle_gpu_dispatch();// before the particle pipeline draws what it writes
     gf3d_pipeline_submit_all_pipe_commands();
+    gf3d_render_stats_frame_end();
     
+    if (gf3d_vgraphics.headless)return;// nothing to present
+
     swapChains[0] = gf3d_swapchain_get();
 
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -537,6 +626,32 @@ void gf3d_vgraphics_render_end()
     vkQueuePresentKHR(gf3d_vqueues_get_present_queue(), &presentInfo);
 }
 
+SDL_Surface *gf3d_vgraphics_read_back_frame()
+{
+    if (!gf3d_vgraphics.headless)
+    {
+        slog("frames can only be read back in headless mode");
+        return NULL;
+    }
+    return gf3d_swapchain_read_back_image(gf3d_vgraphics.bufferFrame);
+}
+
+int gf3d_vgraphics_save_frame(const char *filename)
+{
+    SDL_Surface *frame;
+    if (!filename)return 0;
+    frame = gf3d_vgraphics_read_back_frame();
+    if (!frame)return 0;
+    if (SDL_SaveBMP(frame,filename) != 0)
+    {
+        slog("failed to save frame to %s: %s",filename,SDL_GetError());
+        SDL_FreeSurface(frame);
+        return 0;
+    }
+    SDL_FreeSurface(frame);
+    return 1;
+}
+
 void gf3d_vgraphics_semaphores_close()
 {
     vkDestroySemaphore(gf3d_vgraphics.device, gf3d_vgraphics.renderFinishedSemaphore, NULL);
@@ -629,7 +744,7 @@ VkImageView gf3d_vgraphics_create_image_view(VkImage image, VkFormat format)
     viewInfo.format = format;
     viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
 
@@ -5,6 +5,7 @@
 
 #include "gfc_vector.h"
 
+#include "gf3d_memory.h"
 #include "gf3d_vqueues.h"
 
 extern int __DEBUG;
@@ -89,6 +90,12 @@ void gf3d_vqueues_choose_present_family()
     int bestFamily = -1;
     VkBool32 supported;
     
+    if (gf3d_vqueues.surface == VK_NULL_HANDLE)
+    {
+        // rendering offscreen, nothing is presented so the graphics queue stands in
+        gf3d_vqueues.queue_list[VQ_Present].queue_family = gf3d_vqueues.queue_list[VQ_Graphics].queue_family;
+        return;
+    }
     for (i = 0; i < gf3d_vqueues.queue_family_count; i++)
     {
         vkGetPhysicalDeviceSurfaceSupportKHR(
@@ -118,7 +125,7 @@ void gf3d_vqueues_choose_present_family()
 void gf3d_vqueues_init(VkPhysicalDevice device,VkSurfaceKHR surface)
 {
     Uint32 i;
-    VkBool32 supported;
+    VkBool32 supported = VK_FALSE;
 
     gf3d_vqueues.queue_list[VQ_Graphics].queue_family = -1;
     gf3d_vqueues.queue_list[VQ_Present].queue_family = -1;
@@ -143,7 +150,7 @@ void gf3d_vqueues_init(VkPhysicalDevice device,VkSurfaceKHR surface)
         return;
     }
     
-    gf3d_vqueues.queue_family_properties = (VkQueueFamilyProperties*)gfc_allocate_array(sizeof(VkQueueFamilyProperties),gf3d_vqueues.queue_family_count);
+    gf3d_vqueues.queue_family_properties = (VkQueueFamilyProperties*)gf3d_memory_alloc_array(MT_General,sizeof(VkQueueFamilyProperties),gf3d_vqueues.queue_family_count);
     
     vkGetPhysicalDeviceQueueFamilyProperties(
         device,
@@ -164,11 +171,14 @@ void gf3d_vqueues_init(VkPhysicalDevice device,VkSurfaceKHR surface)
                 gf3d_vqueues.queue_family_properties[i].minImageTransferGranularity.height,
                 gf3d_vqueues.queue_family_properties[i].minImageTransferGranularity.depth);
         }
-        vkGetPhysicalDeviceSurfaceSupportKHR(
-            device,
-            i,
-            surface,
-            &supported);
+        if (surface != VK_NULL_HANDLE)
+        {
+            vkGetPhysicalDeviceSurfaceSupportKHR(
+                device,
+                i,
+                surface,
+                &supported);
+        }
         if (gf3d_vqueues.queue_family_properties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
         {
             if (__DEBUG)slog("Queue handles graphics operations");
@@ -211,7 +221,7 @@ void gf3d_vqueues_init(VkPhysicalDevice device,VkSurfaceKHR surface)
     }
     else
     {
-        gf3d_vqueues.queue_create_info = (VkDeviceQueueCreateInfo*)gfc_allocate_array(
+        gf3d_vqueues.queue_create_info = (VkDeviceQueueCreateInfo*)gf3d_memory_alloc_array(MT_General,
             sizeof(VkDeviceQueueCreateInfo),
             gf3d_vqueues.work_queue_count);
         i = 0;
@@ -285,11 +295,11 @@ void gf3d_vqueues_close()
 {
     if (gf3d_vqueues.queue_create_info)
     {
-        free(gf3d_vqueues.queue_create_info);
+        gf3d_memory_free(gf3d_vqueues.queue_create_info);
     }
     if (gf3d_vqueues.queue_family_properties)
     {
-        free(gf3d_vqueues.queue_family_properties);
+        gf3d_memory_free(gf3d_vqueues.queue_family_properties);
     }
     memset(&gf3d_vqueues,0,sizeof(vQueues));
     if (__DEBUG)slog("vqueues closed");
@@ -300,6 +310,20 @@ Sint32 gf3d_vqueues_get_graphics_queue_family()
     return gf3d_vqueues.queue_list[VQ_Graphics].queue_family;
 }
 
+Uint32 gf3d_vqueues_get_graphics_timestamp_bits()
+{
+    Sint32 family = gf3d_vqueues.queue_list[VQ_Graphics].queue_family;
+    if ((!gf3d_vqueues.queue_family_properties)||(family < 0)||(family >= gf3d_vqueues.queue_family_count))return 0;
+    return gf3d_vqueues.queue_family_properties[family].timestampValidBits;
+}
+
+Bool gf3d_vqueues_graphics_supports_compute()
+{
+    Sint32 family = gf3d_vqueues.queue_list[VQ_Graphics].queue_family;
+    if ((!gf3d_vqueues.queue_family_properties)||(family < 0)||(family >= gf3d_vqueues.queue_family_count))return false;
+    return (gf3d_vqueues.queue_family_properties[family].queueFlags & VK_QUEUE_COMPUTE_BIT) ? true : false;
+}
+
 Sint32 gf3d_vqueues_get_present_queue_family()
 {
     return gf3d_vqueues.queue_list[VQ_Present].queue_family;
@@ -6,6 +6,9 @@
 #include "monster.h"
 #include "entity.h"
 #include "gfc_input.h"
+#include "gf3d_clock.h"
+#include "gf3d_memory.h"
+#include "gf3d_log.h"
 
 typedef struct
 {
@@ -29,21 +32,22 @@ void monster_system_close();
 
 void monster_think(Entity *self) {
     MonsterEntityData *data;
-    float rotationSpeed = 0.05f;
+    float step = gf3d_clock_get_step();
+    float rotationSpeed;
     
     if ((!self) || (!self->data)) return;
     data = (MonsterEntityData*)self->data;
     
-    // Different behaviors based on type
+    // Different behaviors based on type, in radians per second
     switch(data->behavior_type) {
         case 1: // Fast
-            rotationSpeed = 0.1f;
+            rotationSpeed = 3.0f * step;
             break;
         case 2: // Slow  
-            rotationSpeed = 0.02f;
+            rotationSpeed = 0.6f * step;
             break;
         default: // Normal
-            rotationSpeed = 0.05f;
+            rotationSpeed = 1.5f * step;
             break;
     }
     
@@ -67,10 +71,10 @@ void monster_think(Entity *self) {
     // Auto-rotation for demonstration (different behaviors)
     if (data->behavior_type == 1) {
         // Fast entities auto-spin
-        self->rotation.y += 0.03f;
+        self->rotation.y += 0.9f * step;
     } else if (data->behavior_type == 2) {
         // Slow entities auto-bob up and down
-        self->position.z = sin(data->creation_time + SDL_GetTicks() * 0.001f) * 2.0f;
+        self->position.z = sin(data->creation_time + gf3d_clock_get_sim_time()) * 2.0f;
     }
     
     // Keep rotations in valid range for all axes
@@ -89,7 +93,7 @@ void monster_update(Entity *self) {
 
 void monster_free_data(Entity *self) {
     if ((!self) || (!self->data)) return;
-    free(self->data);
+    gf3d_memory_free(self->data);
     self->data = NULL;
 }
 
@@ -97,7 +101,7 @@ void monster_free(Monster* monster)
 {
     if (!monster) return;
     
-    slog("Freeing monster entity");
+    gf3d_log(LL_Debug, "Freeing monster entity");
     
     if (monster->entity) {
         entity_free(monster->entity);
@@ -112,7 +116,7 @@ void monster_free(Monster* monster)
         monster_system.monster_count--;
     }
     
-    slog("Monster freed. Current count: %d", monster_system.monster_count);
+    gf3d_log(LL_Info, "Monster freed. Current count: %d", monster_system.monster_count);
 }
 
 void monster_set_camera_ent(Entity *self, Entity *camera) {
@@ -131,7 +135,7 @@ void monster_system_init(Uint32 max_monsters)
         return;
     }
     
-    monster_system.monster_list = gfc_allocate_array(sizeof(Monster), max_monsters);
+    monster_system.monster_list = gf3d_memory_alloc_array(MT_Entity, sizeof(Monster), max_monsters);
     if (!monster_system.monster_list) {
         slog("failed to allocate %i monsters for the system", max_monsters);
         return;
@@ -153,7 +157,7 @@ void monster_system_close()
                 monster_free(&monster_system.monster_list[i]);
             }
         }
-        free(monster_system.monster_list);
+        gf3d_memory_free(monster_system.monster_list);
         monster_system.monster_list = NULL;
     }
     monster_system.monster_max = 0;
@@ -177,13 +181,13 @@ Monster* monster_new(Mesh* mesh, Texture* texture, GFC_Vector3D position)
     for (i = 0; i < monster_system.monster_max; i++) {
         if (!monster_system.monster_list[i].entity) { // Check if entity is NULL (free slot)
             monster = &monster_system.monster_list[i];
-            slog("Found free monster slot at index %d", i);
+            gf3d_log(LL_Debug, "Found free monster slot at index %d", i);
             break;
         }
     }
     
     if (!monster) {
-        slog("no free monster slots available (current count: %d, max: %d)", 
+        gf3d_log(LL_Warning, "no free monster slots available (current count: %d, max: %d)", 
              monster_system.monster_count, monster_system.monster_max);
         return NULL;
     }
@@ -191,15 +195,15 @@ Monster* monster_new(Mesh* mesh, Texture* texture, GFC_Vector3D position)
     // Create entity
     entity = entity_new();
     if (!entity) {
-        slog("failed to create entity for monster");
+        gf3d_log(LL_Error, "failed to create entity for monster");
         return NULL;
     }
     
     // Create monster data
-    data = gfc_allocate_array(sizeof(MonsterEntityData), 1);
+    data = gf3d_memory_alloc_array(MT_Entity, sizeof(MonsterEntityData), 1);
     if (!data) {
         entity_free(entity);
-        slog("failed to allocate monster data");
+        gf3d_log(LL_Error, "failed to allocate monster data");
         return NULL;
     }
     
@@ -224,31 +228,29 @@ Monster* monster_new(Mesh* mesh, Texture* texture, GFC_Vector3D position)
     data->move_step = 0.1f;
     data->direction = 1; // Not used for spinning, but keep for compatibility
     data->behavior_type = monster_system.monster_count % 3; // Cycle through 0, 1, 2
-    data->creation_time = SDL_GetTicks() * 0.001f; // Store creation time
-    data->behavior_type = monster_system.monster_count % 3; // Cycle through 0, 1, 2
-    data->creation_time = SDL_GetTicks() * 0.001f; // Store creation time
+    data->creation_time = gf3d_clock_get_sim_time(); // Store creation time
     
     gfc_line_cpy(entity->name, "monster");
     
     monster_system.monster_count++;
     
-    slog("created monster at position (%f, %f, %f) with behavior type %d", 
+    gf3d_log(LL_Info, "created monster at position (%f, %f, %f) with behavior type %d", 
          position.x, position.y, position.z, data->behavior_type);
     return monster;
 }
 
 void monster_cleanup_oldest() {
     int i;
-    float oldest_time = SDL_GetTicks() * 0.001f;
+    float oldest_time = 0;
     int oldest_index = -1;
     
-    slog("Looking for oldest monster to clean up...");
+    gf3d_log(LL_Debug, "Looking for oldest monster to clean up...");
     
     // Find the oldest monster
     for (i = 0; i < monster_system.monster_max; i++) {
         if (monster_system.monster_list[i].entity) {
             MonsterEntityData* data = (MonsterEntityData*)monster_system.monster_list[i].entity->data;
-            if (data && data->creation_time < oldest_time) {
+            if (data && ((oldest_index < 0) || (data->creation_time < oldest_time))) {
                 oldest_time = data->creation_time;
                 oldest_index = i;
             }
@@ -257,10 +259,10 @@ void monster_cleanup_oldest() {
     
     // Remove the oldest monster to demonstrate cleanup
     if (oldest_index >= 0) {
-        slog("Cleaning up oldest monster at index %d (created at time %.2f)", oldest_index, oldest_time);
+        gf3d_log(LL_Info, "Cleaning up oldest monster at index %d (created at time %.2f)", oldest_index, oldest_time);
         monster_free(&monster_system.monster_list[oldest_index]);
-        slog("Cleanup complete. Slots available for new monsters.");
+        gf3d_log(LL_Debug, "Cleanup complete. Slots available for new monsters.");
     } else {
-        slog("No monsters to clean up");
+        gf3d_log(LL_Info, "No monsters to clean up");
     }
 }
\ No newline at end of file
@@ -7,13 +7,15 @@
 #include "gfc_types.h"
 #include "gfc_matrix.h"
 #include "gfc_color.h"
+#include "gf3d_memory.h"
 #include "gf3d_mesh.h"
 #include "gf3d_texture.h"
+#include "gf3d_texture_stream.h"
 #include "world.h"
 
 World* world_new() {
     World* world;
-    world = gfc_allocate_array(sizeof(World), 1);
+    world = gf3d_memory_alloc_array(MT_Entity,sizeof(World), 1);
     if (!world) return NULL;
     
     memset(world, 0, sizeof(World));
@@ -23,13 +25,12 @@ World* world_new() {
     return world;
 }
 
-Uint8 world_edge_test(World* world, GFC_Vector3D start, GFC_Vector3D end) {
-    // TODO: Work on collision detection between edge and world geometry
-    // Notes: check intersection with terrain mesh triangles
-    if (!world) return 0;
-    
-    // Placeholder implementation - always return no collision for now
-    return 0;
+Uint8 world_edge_test(World* world, GFC_Vector3D start, GFC_Vector3D end, GFC_Vector3D* contact) {
+    GFC_Matrix4 modelMat;
+    if ((!world) || (!world->terrain)) return 0;
+    // terrain is drawn untransformed, see world_draw
+    gfc_matrix4_identity(modelMat);
+    return gf3d_mesh_edge_test(world->terrain, modelMat, gfc_edge3d_from_vectors(start, end), NULL, contact);
 }
 
 World* world_load(const char* filename) {
@@ -74,7 +75,8 @@ World* world_load(const char* filename) {
         }
     }
     if (str) {
-        world->terrain = gf3d_mesh_load(str);
+        // the collision copy builds the triangle bvh now, so the first ground query of play does not pay for it
+        world->terrain = gf3d_mesh_load_full(str, MR_Collision);
         if (!world->terrain) {
             slog("failed to load terrain mesh: %s", str);
         } else {
@@ -92,7 +94,7 @@ World* world_load(const char* filename) {
         }
     }
     if (str) {
-        world->texture = gf3d_texture_load(str);
+        world->texture = gf3d_texture_load_streaming(str);
         if (!world->texture) {
             slog("failed to load terrain texture: %s", str);
         } else {
@@ -121,7 +123,7 @@ void world_free(World* world) {
         gfc_list_delete(world->entities);
     }
     
-    free(world);
+    gf3d_memory_free(world);
 }
 
 void world_draw(World* world) {